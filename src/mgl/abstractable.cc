@@ -29,13 +29,18 @@ using namespace std;
 #include <unistd.h>
 #endif
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 
+#include <jsoncpp/json/reader.h>
 #include <jsoncpp/json/value.h>
 #include <jsoncpp/json/writer.h>
 #include <map>
 #include <vector>
 
+#include "Exception.h"
+
 std::ostream &MyComputer::log()
 {
     return cout;
@@ -335,6 +340,11 @@ void ProgressJSONStream::outputJson(const char* taskName, unsigned int percent)
     std::cout << writer.write(msg);
 }
 
+void ProgressJSONStream::onReport(const Json::Value& msg) {
+    Json::FastWriter writer;
+    std::cout << writer.write(msg);
+}
+
 void ProgressJSONStream::onTick(const char* taskName, 
         unsigned int count, unsigned int ticks)
 {
@@ -349,22 +359,284 @@ void ProgressJSONStream::onTick(const char* taskName,
     }
 }
 
+void JobFeatures::terms(Scalar out[TERM_COUNT]) const {
+    out[0] = 1;
+    out[1] = triangles;
+    out[2] = layers;
+    out[3] = footprint * layers;
+    out[4] = support ? footprint * layers : 0;
+}
+
+const char* JobFeatures::termName(unsigned int term) {
+    static const char* NAMES[TERM_COUNT] = { "constant", "triangles", 
+            "layers", "footprintLayers", "supportFootprintLayers" };
+    return term < TERM_COUNT ? NAMES[term] : "";
+}
+
+const Scalar ProgressModel::MIN_SECONDS = 0.001;
+
+/*
+ Fitted by mgl_bench -f on the bundled models, with the default, support
+ and raft variants, on one core. Only their ratios matter for the
+ percentages, the seconds left are scaled to the machine as a job runs.
+ */
+static const struct {
+    const char* task;
+    Scalar coefficients[JobFeatures::TERM_COUNT];
+} FITTED_TASKS[] = {
+    { "outlines",
+            { 0, 1.84e-05, 0, 0, 9.6e-08 } },
+    { "Loop Processing",
+            { 0, 4.75e-07, 4.02e-06, 4.03e-09, 3.29e-09 } },
+    { "support",
+            { 0, 7.21e-06, 0, 2.79e-07, 2.79e-07 } },
+    { "rafts",
+            { 0, 3.45e-08, 0, 0, 1.97e-08 } },
+    { "insets",
+            { 0, 1.13e-05, 0.000165, 9.26e-08, 5.57e-08 } },
+    { "spurs",
+            { 0, 6.53e-06, 0, 0, 8.28e-08 } },
+    { "flat surfaces",
+            { 0, 2.08e-06, 0, 0, 3.5e-06 } },
+    { "roofing",
+            { 0.000412, 8.17e-07, 0, 2.44e-08, 0 } },
+    { "flooring",
+            { 3.59e-05, 7.57e-07, 1.19e-05, 1.69e-08, 1.32e-09 } },
+    { "infills",
+            { 0, 2.96e-05, 0.00195, 1.45e-07, 2.77e-08 } },
+    { "Path generation",
+            { 0, 1.69e-05, 0, 0, 2.6e-06 } },
+    { "gcode",
+            { 0, 1.97e-06, 0.000146, 7.75e-08, 0 } },
+};
+
+ProgressModel::ProgressModel() {
+    for(size_t i = 0; i < sizeof(FITTED_TASKS) / sizeof(FITTED_TASKS[0]); 
+            ++i) {
+        coefficients[FITTED_TASKS[i].task] = Coefficients(
+                FITTED_TASKS[i].coefficients, FITTED_TASKS[i].coefficients + 
+                JobFeatures::TERM_COUNT);
+    }
+}
+
+void ProgressModel::load(const Json::Value& fitted) {
+    const Json::Value& tasks = fitted["tasks"];
+    if(!tasks.isObject()) {
+        Exception mixup("Progress model has no \"tasks\" object");
+        throw mixup;
+    }
+    Json::Value::Members names = tasks.getMemberNames();
+    for(Json::Value::Members::const_iterator name = names.begin(); 
+            name != names.end(); ++name) {
+        const Json::Value& values = tasks[*name];
+        if(!values.isArray() || values.size() != JobFeatures::TERM_COUNT) {
+            stringstream ss;
+            ss << "Progress model task \"" << *name << "\" needs " << 
+                    JobFeatures::TERM_COUNT << " coefficients";
+            Exception mixup(ss.str().c_str());
+            throw mixup;
+        }
+        Coefficients& taskCoefficients = coefficients[*name];
+        taskCoefficients.clear();
+        for(Json::Value::UInt i = 0; i < values.size(); ++i)
+            taskCoefficients.push_back(values[i].asDouble());
+    }
+}
+
+void ProgressModel::loadFile(const std::string& path) {
+    ifstream in(path.c_str());
+    Json::Value fitted;
+    Json::Reader reader;
+    if(!in || !reader.parse(in, fitted)) {
+        string msg = "Progress model: \"";
+        msg += path;
+        msg += "\" can't be read";
+        Exception mixup(msg.c_str());
+        throw mixup;
+    }
+    load(fitted);
+}
+
+/**
+ Solves the @a n normal equations in @a normal, whose last column is
+ the right hand side, for @a result, by Gaussian elimination with
+ partial pivoting. Terms not @a used are held at zero.
+ */
+static void solveNormal(Scalar normal[][JobFeatures::TERM_COUNT + 1], 
+        const bool used[], Scalar result[]) {
+    const unsigned int n = JobFeatures::TERM_COUNT;
+    Scalar m[n][n + 1];
+    for(unsigned int j = 0; j < n; ++j) {
+        for(unsigned int k = 0; k <= n; ++k)
+            m[j][k] = used[j] && (used[k] || k == n) ? normal[j][k] : 0;
+        if(!used[j])
+            m[j][j] = 1;
+    }
+    for(unsigned int col = 0; col < n; ++col) {
+        unsigned int pivot = col;
+        for(unsigned int j = col + 1; j < n; ++j) {
+            if(fabs(m[j][col]) > fabs(m[pivot][col]))
+                pivot = j;
+        }
+        for(unsigned int k = 0; k <= n; ++k)
+            std::swap(m[col][k], m[pivot][k]);
+        for(unsigned int j = col + 1; j < n; ++j) {
+            Scalar factor = m[j][col] / m[col][col];
+            for(unsigned int k = col; k <= n; ++k)
+                m[j][k] -= factor * m[col][k];
+        }
+    }
+    for(unsigned int j = n; j-- > 0; ) {
+        Scalar sum = m[j][n];
+        for(unsigned int k = j + 1; k < n; ++k)
+            sum -= m[j][k] * result[k];
+        result[j] = sum / m[j][j];
+    }
+}
+
+void ProgressModel::fit(const std::string& task, 
+        const std::vector<JobFeatures>& samples, 
+        const std::vector<Scalar>& seconds) {
+    const unsigned int n = JobFeatures::TERM_COUNT;
+    //scale every term to at most one, so they weigh alike in the ridge
+    Scalar scale[n];
+    Scalar row[n];
+    for(unsigned int j = 0; j < n; ++j)
+        scale[j] = 0;
+    for(size_t i = 0; i < samples.size(); ++i) {
+        samples[i].terms(row);
+        for(unsigned int j = 0; j < n; ++j)
+            scale[j] = std::max(scale[j], Scalar(fabs(row[j])));
+    }
+    for(unsigned int j = 0; j < n; ++j) {
+        if(scale[j] == 0)
+            scale[j] = 1;
+    }
+    //normal equations, with the right hand side as the last column
+    Scalar normal[n][n + 1];
+    for(unsigned int j = 0; j < n; ++j) {
+        for(unsigned int k = 0; k <= n; ++k)
+            normal[j][k] = 0;
+        //terms that never vary, or that the samples can't tell apart, 
+        //stay small rather than cancel out each other
+        normal[j][j] = 1e-3 * (1 + samples.size());
+    }
+    for(size_t i = 0; i < samples.size() && i < seconds.size(); ++i) {
+        samples[i].terms(row);
+        for(unsigned int j = 0; j < n; ++j)
+            row[j] /= scale[j];
+        for(unsigned int j = 0; j < n; ++j) {
+            for(unsigned int k = 0; k < n; ++k)
+                normal[j][k] += row[j] * row[k];
+            normal[j][n] += row[j] * seconds[i];
+        }
+    }
+    /*
+     No term makes a task quicker, but with few models a fit may trade a
+     negative term against a positive one and predict nonsense for the
+     next model. So the most negative term is dropped and the rest
+     fitted again, until none is negative.
+     */
+    bool used[n];
+    for(unsigned int j = 0; j < n; ++j)
+        used[j] = true;
+    Scalar result[n];
+    for(unsigned int pass = 0; pass < n; ++pass) {
+        solveNormal(normal, used, result);
+        unsigned int worst = n;
+        for(unsigned int j = 0; j < n; ++j) {
+            if(used[j] && result[j] < 0 && 
+                    (worst == n || result[j] < result[worst]))
+                worst = j;
+        }
+        if(worst == n)
+            break;
+        used[worst] = false;
+        result[worst] = 0;
+    }
+    Coefficients& fitted = coefficients[task];
+    fitted.resize(n);
+    for(unsigned int j = 0; j < n; ++j)
+        fitted[j] = used[j] ? result[j] / scale[j] : 0;
+}
+
+Scalar ProgressModel::predict(const std::string& task, 
+        const JobFeatures& features) const {
+    CoefficientMap::const_iterator iter = coefficients.find(task);
+    if(iter == coefficients.end())
+        return MIN_SECONDS;
+    Scalar row[JobFeatures::TERM_COUNT];
+    features.terms(row);
+    Scalar seconds = 0;
+    for(unsigned int j = 0; j < JobFeatures::TERM_COUNT; ++j)
+        seconds += iter->second[j] * row[j];
+    return std::max(seconds, MIN_SECONDS);
+}
+
+Scalar ProgressModel::predictJob(const JobFeatures& features) const {
+    Scalar seconds = 0;
+    for(CoefficientMap::const_iterator iter = coefficients.begin(); 
+            iter != coefficients.end(); ++iter)
+        seconds += predict(iter->first, features);
+    return seconds;
+}
+
+bool ProgressModel::knows(const std::string& task) const {
+    return coefficients.find(task) != coefficients.end();
+}
+
+Json::Value ProgressModel::toJson() const {
+    Json::Value out(Json::objectValue);
+    for(unsigned int j = 0; j < JobFeatures::TERM_COUNT; ++j)
+        out["terms"].append(JobFeatures::termName(j));
+    out["tasks"] = Json::Value(Json::objectValue);
+    for(CoefficientMap::const_iterator iter = coefficients.begin(); 
+            iter != coefficients.end(); ++iter) {
+        Json::Value& values = out["tasks"][iter->first];
+        values = Json::Value(Json::arrayValue);
+        for(size_t j = 0; j < iter->second.size(); ++j)
+            values.append(iter->second[j]);
+    }
+    return out;
+}
+
 ProgressJSONStreamTotal::ProgressJSONStreamTotal(const GrueConfig& grueConf, 
         unsigned int count)
         : ProgressJSONStream(count), grueCfg(grueConf), curstage(0), 
-        accumulator(0){
-    addStage("outlines", 20);
+        accumulator(0), startTime(-1) {
+    if(!grueConf.get_progressModelFile().empty())
+        model.loadFile(grueConf.get_progressModelFile());
+    addStage("outlines");
+    addStage("Loop Processing");
     if(grueConf.get_doSupport())
-        addStage("support", 50);
+        addStage("support");
     if(grueConf.get_doRaft())
-        addStage("rafts", 5);
-    addStage("insets", 5);
-    addStage("flat surfaces", grueConf.get_doSupport() ? 100 : 50);
-    addStage("roofing", 10);
-    addStage("flooring", 10);
-    addStage("infills", 20);
-    addStage("Path generation", 100);
-    addStage("gcode", 5);
+        addStage("rafts");
+    addStage("insets");
+    addStage("spurs");
+    addStage("flat surfaces");
+    addStage("roofing");
+    addStage("flooring");
+    addStage("infills");
+    addStage("Path generation");
+    //streamed gcode is written as the paths are planned
+    if(!grueConf.get_doStreaming())
+        addStage("gcode");
+    //every stage weighs the same until the job is known
+    weighStages(JobFeatures());
+}
+
+void ProgressJSONStreamTotal::onStart(const char* taskName, unsigned int) {
+    StageMap::const_iterator iter = stagemap.find(taskName);
+    if(iter == stagemap.end())
+        return;
+    curstage = iter->second;
+    if(startTime < 0)
+        startTime = StageTimer::now();
+}
+
+void ProgressJSONStreamTotal::onFeatures(const JobFeatures& features) {
+    weighStages(features);
 }
 
 Json::Value ProgressJSONStreamTotal::makeJson(const char* taskName, 
@@ -373,21 +645,36 @@ Json::Value ProgressJSONStreamTotal::makeJson(const char* taskName,
     StageMap::const_iterator iter = stagemap.find(taskName);
     if(iter != stagemap.end())
         curstage = iter->second;
-    unsigned int totalPercent = static_cast<unsigned int>(((
-            proportions[curstage].first + 0.01 * 
-            proportions[curstage].second * percent) / 
-            accumulator) * 100);
+    Scalar done = proportions[curstage].first + 0.01 * 
+            proportions[curstage].second * percent;
+    unsigned int totalPercent = static_cast<unsigned int>(
+            done / accumulator * 100);
     msg["totalPercentComplete"] = totalPercent;
+    msg["etaSeconds"] = secondsLeft(done);
     return msg;
 }
 
-void ProgressJSONStreamTotal::addStage(const std::string& name, float weight) {
-    stagemap[name] = proportions.size();
-    proportions.push_back(Proportion(accumulator, weight));
-    accumulator += weight;
+void ProgressJSONStreamTotal::addStage(const std::string& name) {
+    stagemap[name] = stageNames.size();
+    stageNames.push_back(name);
 }
 
+void ProgressJSONStreamTotal::weighStages(const JobFeatures& features) {
+    proportions.clear();
+    accumulator = 0;
+    for(size_t i = 0; i < stageNames.size(); ++i) {
+        Scalar weight = model.predict(stageNames[i], features);
+        if(grueCfg.get_doStreaming() && stageNames[i] == "Path generation")
+            weight += model.predict("gcode", features);
+        proportions.push_back(Proportion(accumulator, weight));
+        accumulator += weight;
+    }
+}
 
-
-
-
+Scalar ProgressJSONStreamTotal::secondsLeft(Scalar done) const {
+    Scalar left = accumulator - done;
+    //too little has run to tell this machine from the one fitted on
+    if(startTime < 0 || done < 0.01 * accumulator)
+        return left;
+    return left * (StageTimer::now() - startTime) / done;
+}
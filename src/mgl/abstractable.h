@@ -26,9 +26,11 @@
 #include <sstream>
 #include <string>
 #include <map>
+#include <vector>
 #include <sys/stat.h>
 #include <jsoncpp/json/value.h>
 #include "configuration.h"
+#include "stage_timer.h"
 
 namespace mgl {
 
@@ -92,6 +94,78 @@ public:
 
 
 
+/**
+ @brief what a job is known to be before its stages run, cheap to measure
+ once the model is sliced into layers
+ */
+class JobFeatures
+{
+public:
+    /// how many terms a fitted stage time has
+    static const unsigned int TERM_COUNT = 5;
+
+    JobFeatures(size_t triangleCount = 0, size_t layerCount = 0,
+            Scalar footprintArea = 0, bool withSupport = false)
+        : triangles(triangleCount), layers(layerCount),
+        footprint(footprintArea), support(withSupport) {}
+
+    /**
+     @brief the values the coefficients of a stage multiply: one,
+     triangles, layers, footprint times layers, and footprint times
+     layers again when support is on, zero when not
+     */
+    void terms(Scalar out[TERM_COUNT]) const;
+    /// name of a term, as written with fitted coefficients
+    static const char* termName(unsigned int term);
+
+    size_t triangles;
+    size_t layers;
+    Scalar footprint;  ///< mm^2 of the plate under the model's bounding box
+    bool support;
+};
+
+/**
+ @brief predicts the seconds each progress task of a job takes, from its
+ features, as a sum of terms with coefficients fitted by mgl_bench -f
+ */
+class ProgressModel
+{
+public:
+    /// tasks predicted below this take this long
+    static const Scalar MIN_SECONDS;
+
+    /// the coefficients fitted on the bundled models
+    ProgressModel();
+    /**
+     @brief take the coefficients of the tasks in @a fitted, as written
+     by toJson, keeping the others
+     */
+    void load(const Json::Value& fitted);
+    /// load a file written by mgl_bench -f, throws on failure
+    void loadFile(const std::string& path);
+    /**
+     @brief fit the coefficients of @a task by least squares to the
+     @a seconds it took for each of @a samples
+     */
+    void fit(const std::string& task, const std::vector<JobFeatures>& samples,
+            const std::vector<Scalar>& seconds);
+    /// seconds @a task will take, or MIN_SECONDS for an unknown task
+    Scalar predict(const std::string& task,
+            const JobFeatures& features) const;
+    /**
+     @brief seconds a whole job takes, every known task added up, a
+     little over for jobs without support or a raft
+     */
+    Scalar predictJob(const JobFeatures& features) const;
+    bool knows(const std::string& task) const;
+    Json::Value toJson() const;
+
+private:
+    typedef std::vector<Scalar> Coefficients;
+    typedef std::map<std::string, Coefficients> CoefficientMap;
+    CoefficientMap coefficients;
+};
+
 //
 // ASCII art
 //
@@ -118,6 +192,7 @@ protected:
         ticks = 0;
         this->count = count;
         task = taskName;
+        onStart(taskName, count);
     }
 
     void tick()
@@ -127,6 +202,12 @@ protected:
     }
 
     virtual void onTick(const char* taskName, unsigned int size, unsigned int it)=0;
+    /// called as each task begins, before its first tick
+    virtual void onStart(const char*, unsigned int) {}
+    /// receives results that are not progress, like time estimates
+    virtual void onReport(const Json::Value&) {}
+    /// told what the job is like once the model is sliced
+    virtual void onFeatures(const JobFeatures&) {}
 
 };
 
@@ -148,26 +229,45 @@ class ProgressJSONStream : public ProgressBar {
 public:
 	ProgressJSONStream(unsigned int count = 0);
 	void onTick(const char* taskName, unsigned int count, unsigned int tick);
+	void onReport(const Json::Value& msg);
 protected:
     virtual void outputJson(const char* taskName, unsigned int percent);
     virtual Json::Value makeJson(const char* taskName, unsigned int percent);
 };
 
+/**
+ Adds the progress of the whole job and the seconds it has left to each
+ message. Each task is weighed by the seconds the ProgressModel predicts
+ for it, from the features of the job once they are known. The seconds
+ left are scaled by how long the tasks done so far took against their
+ prediction, so a slower or faster machine than the one fitted on still
+ gets a fair estimate.
+ */
 class ProgressJSONStreamTotal : public ProgressJSONStream {
 public:
     ProgressJSONStreamTotal(const GrueConfig& grueConf, unsigned int count = 0);
+    void onStart(const char* taskName, unsigned int count);
+    void onFeatures(const JobFeatures& features);
 protected:
-    typedef std::pair<float, float> Proportion;
+    typedef std::pair<Scalar, Scalar> Proportion;
     typedef std::vector<Proportion> ProportionCollection;
     typedef std::map<std::string, size_t> StageMap;
     Json::Value makeJson(const char* taskName, unsigned int percent);
-    void addStage(const std::string& name, float weight);
-    
+    void addStage(const std::string& name);
+    /// weigh every stage by its predicted seconds for @a features
+    void weighStages(const JobFeatures& features);
+    /// seconds left once the predicted seconds @a done have passed
+    Scalar secondsLeft(Scalar done) const;
+
     const GrueConfig& grueCfg;
+    ProgressModel model;
+    std::vector<std::string> stageNames;
     StageMap stagemap;
     ProportionCollection proportions;
     unsigned int curstage;
-    float accumulator;
+    Scalar accumulator;
+    /// when the first stage started, negative until then
+    double startTime;
 };
 
 
@@ -175,11 +275,13 @@ protected:
 /// used as a base class to provide progress bar support
 ///
 /// This is used for top level operations that take time (Pather, Gcoder, Slicer)
-/// and need to report progress
+/// and need to report progress. Each task started is also timed as a stage
+/// when the StageTimer is enabled.
 class Progressive
 {
 
 	ProgressBar *progress;
+	StageTimer::Task timing;
 public:
 
 	Progressive(ProgressBar *progress = NULL)
@@ -195,6 +297,7 @@ public:
 protected:
     void initProgress(const char* title, unsigned int ticks)
     {
+        timing.start(title);
         if(progress)
         {
             progress->reset(ticks, title);
@@ -207,6 +310,13 @@ protected:
             progress->tick();
         }
     }
+    void report(const Json::Value& msg)
+    {
+        if(progress)
+        {
+            progress->onReport(msg);
+        }
+    }
 
 };
 
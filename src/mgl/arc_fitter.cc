@@ -0,0 +1,125 @@
+#include "arc_fitter.h"
+#include <algorithm>
+#include <cmath>
+
+namespace mgl {
+
+ArcFitter::ArcFitter(Scalar tolerance, size_t minPoints, Scalar maxRadius)
+        : m_tolerance(tolerance), m_minPoints(std::max<size_t>(minPoints, 3)),
+        m_maxRadius(maxRadius), m_movesIn(0), m_movesOut(0), m_arcs(0),
+        m_maxDeviation(0) {}
+
+void ArcFitter::fit(const std::vector<Point2Type>& points,
+        std::vector<Piece>& pieces) {
+    pieces.clear();
+    if(points.size() < 2)
+        return;
+    const size_t lastPoint = points.size() - 1;
+    size_t start = 0;
+    while(start < lastPoint) {
+        Piece best;
+        Scalar bestDeviation = 0;
+        size_t end = start + m_minPoints - 1;
+        for(; end <= lastPoint; ++end) {
+            Piece arc;
+            Scalar deviation;
+            if(!tryArc(points, start, end, arc, deviation))
+                break;
+            best = arc;
+            best.end = end;
+            bestDeviation = deviation;
+        }
+        if(best.isArc) {
+            ++m_arcs;
+            m_maxDeviation = std::max(m_maxDeviation, bestDeviation);
+        } else {
+            best.end = start + 1;
+        }
+        pieces.push_back(best);
+        start = best.end;
+    }
+    m_movesIn += lastPoint;
+    m_movesOut += pieces.size();
+}
+
+bool ArcFitter::tryArc(const std::vector<Point2Type>& points,
+        size_t first, size_t last,
+        Piece& arc, Scalar& deviation) const {
+    //circle through the first, middle and last points, relative to the
+    //first for precision
+    const Point2Type& origin = points[first];
+    Point2Type b = points[(first + last) / 2] - origin;
+    Point2Type c = points[last] - origin;
+    Scalar d = 2 * b.crossProduct(c);
+    //collinear, nearly collinear points fail the radius test below
+    if(d == 0)
+        return false;
+    Scalar bb = b.squaredMagnitude();
+    Scalar cc = c.squaredMagnitude();
+    Point2Type offset((c.y * bb - b.y * cc) / d, (b.x * cc - c.x * bb) / d);
+    Scalar radius = offset.magnitude();
+    if(radius > m_maxRadius || radius <= m_tolerance)
+        return false;
+    Point2Type center = origin + offset;
+    bool clockwise = d < 0;
+
+    Scalar sweep = 0;
+    Scalar worst = 0;
+    Point2Type from = points[first] - center;
+    Scalar fromError = std::fabs(from.magnitude() - radius);
+    for(size_t index = first + 1; index <= last; ++index) {
+        Point2Type to = points[index] - center;
+        Scalar toError = std::fabs(to.magnitude() - radius);
+        if(toError > m_tolerance)
+            return false;
+        //every segment turns the same way around the center
+        Scalar turn = from.crossProduct(to);
+        if(clockwise ? turn >= 0 : turn <= 0)
+            return false;
+        sweep += std::atan2(std::fabs(turn), from.dotProduct(to));
+        //the segment cuts inside the arc by its sagitta
+        Scalar halfChord = 0.5 * (to - from).magnitude();
+        if(halfChord >= radius)
+            return false;
+        Scalar sagitta = radius -
+                std::sqrt(radius * radius - halfChord * halfChord);
+        Scalar error = std::max(fromError, toError) + sagitta;
+        if(error > m_tolerance)
+            return false;
+        worst = std::max(worst, error);
+        from = to;
+        fromError = toError;
+    }
+    //ends that nearly meet could be read as a full circle
+    if(sweep >= M_TAU || 
+            (points[last] - points[first]).magnitude() <= m_tolerance)
+        return false;
+    arc.isArc = true;
+    arc.center = center;
+    arc.clockwise = clockwise;
+    deviation = worst;
+    return true;
+}
+
+Scalar ArcFitter::compression() const {
+    if(!m_movesOut)
+        return 1.0;
+    return static_cast<Scalar>(m_movesIn) / m_movesOut;
+}
+
+void ArcFitter::reset() {
+    m_movesIn = 0;
+    m_movesOut = 0;
+    m_arcs = 0;
+    m_maxDeviation = 0;
+}
+
+void ArcFitter::merge(const ArcFitter& other) {
+    m_movesIn += other.m_movesIn;
+    m_movesOut += other.m_movesOut;
+    m_arcs += other.m_arcs;
+    m_maxDeviation = std::max(m_maxDeviation, other.m_maxDeviation);
+}
+
+}
+
@@ -0,0 +1,101 @@
+/*
+ * File:   arc_fitter.h
+ *
+ * Replaces runs of short moves along a circle with arcs
+ */
+
+#ifndef MGL_ARC_FITTER_H
+#define	MGL_ARC_FITTER_H
+
+#include "mgl.h"
+#include <vector>
+
+namespace mgl {
+
+/**
+ @brief Splits a polyline into straight moves and circular arcs.
+
+ Curved outlines reach the gcoder as many short segments. Where a run
+ of at least minPoints points lies on a circle, and every segment of
+ the run stays within the tolerance of it, the run can be written as
+ one G2/G3 move instead.
+
+ Runs are grown greedily from each point: the circle through the first,
+ middle and last points of the run is tested, and the run is extended
+ until that fails. Arcs always turn the same way, and sweep less than
+ a full circle with their ends more than the tolerance apart.
+
+ The fitter counts what it has done across calls, so the savings and
+ the worst deviation of a whole print can be reported.
+ */
+class ArcFitter {
+public:
+    /// one move of a fitted polyline
+    class Piece {
+    public:
+        Piece() : end(0), isArc(false), clockwise(false) {}
+        /// index of the point where the move ends, it begins where
+        /// the one before it ended, or at the first point
+        size_t end;
+        bool isArc;
+        Point2Type center;
+        bool clockwise;
+    };
+
+    /**
+     @param tolerance how far, in mm, an arc may stray from the segments
+     it replaces
+     @param minPoints fewest points an arc may replace
+     @param maxRadius larger circles are treated as straight
+     */
+    ArcFitter(Scalar tolerance = 0.01, size_t minPoints = 4,
+            Scalar maxRadius = 1000.0);
+
+    /**
+     @brief split @a points into lines and arcs
+     @param points the polyline, in order
+     @param pieces cleared, then filled with the moves covering
+     @a points, each line covering a single segment
+     */
+    void fit(const std::vector<Point2Type>& points,
+            std::vector<Piece>& pieces);
+
+    /// segments given to fit since the last reset
+    size_t movesIn() const { return m_movesIn; }
+    /// moves fit produced since the last reset
+    size_t movesOut() const { return m_movesOut; }
+    /// arcs among movesOut
+    size_t arcs() const { return m_arcs; }
+    /// movesIn over movesOut, 1 if nothing was fitted
+    Scalar compression() const;
+    /// furthest, in mm, any arc strayed from its segments
+    Scalar maxDeviation() const { return m_maxDeviation; }
+    /// forget the counts
+    void reset();
+    /// add the counts of @a other to these
+    void merge(const ArcFitter& other);
+
+private:
+    /**
+     @brief test whether points @a first to @a last lie on an arc
+     @param arc receives the center and direction on success
+     @param deviation receives how far the arc strays on success
+     */
+    bool tryArc(const std::vector<Point2Type>& points,
+            size_t first, size_t last,
+            Piece& arc, Scalar& deviation) const;
+
+    Scalar m_tolerance;
+    size_t m_minPoints;
+    Scalar m_maxRadius;
+
+    size_t m_movesIn;
+    size_t m_movesOut;
+    size_t m_arcs;
+    Scalar m_maxDeviation;
+};
+
+}
+
+#endif	/* MGL_ARC_FITTER_H */
+
@@ -0,0 +1,9 @@
+#ifndef MGL_BASIC_KDTREE_H
+#define	MGL_BASIC_KDTREE_H
+
+#include "basic_kdtree_decl.h"
+#include "basic_kdtree_impl.h"
+
+
+#endif	/* MGL_BASIC_KDTREE_H */
+
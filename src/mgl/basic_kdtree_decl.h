@@ -0,0 +1,167 @@
+#ifndef MGL_BASIC_KDTREE_DECL_H
+#define	MGL_BASIC_KDTREE_DECL_H
+
+#include "mgl.h"
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace mgl {
+
+/*
+ basic_kdtree is a point index for nearest neighbour queries.
+ 
+ Unlike the other spacial indexes, which store bounding boxes, this one 
+ stores values at single points. It is built once from a range of 
+ (position, value) pairs and afterwards only supports removal, which 
+ makes it a good fit for sets of candidates that are consumed one by one.
+ 
+ Values are returned in order of increasing distance from a query point 
+ by a nearest_query. Queries are lazy, each call to next() does only 
+ enough work to produce the next value, so asking for the first few 
+ neighbours of a large set is cheap. Values at exactly the same distance 
+ come out in increasing order of value, value_type must therefore 
+ support operator< and operator==.
+ 
+ Interface methods:
+ 
+ template <typename ITER>
+ void build(ITER first, ITER last); //replace contents with a range of point_value
+ bool erase(position, value);       //remove one matching value
+ nearest_query(tree, point);        //incremental nearest neighbour search
+ void swap(basic_kdtree& other);    //fast swap implementation
+ 
+ */
+
+template <typename T>
+class basic_kdtree {
+public:
+    typedef T value_type;
+    typedef std::pair<Point2Type, value_type> point_value;
+    
+    /**
+     @brief Yields the values of a basic_kdtree in order of increasing 
+     distance from a point. Values erased from the tree after the query 
+     was started are skipped.
+     */
+    class nearest_query {
+    public:
+        nearest_query(const basic_kdtree& tree, const Point2Type& point);
+        /**
+         @brief fetch the next nearest value
+         @param value where the value is written
+         @param squaredDistance where the squared distance to the value 
+         is written
+         @return false when no values remain
+         */
+        bool next(value_type& value, Scalar& squaredDistance);
+    private:
+        class candidate {
+        public:
+            candidate(Scalar d, size_t i) 
+                    : distance(d), index(i), 
+                    begin(0), end(0), depth(0), isPoint(true) {}
+            candidate(Scalar d, size_t b, size_t e, size_t dep, 
+                    const Point2Type& mn, const Point2Type& mx) 
+                    : distance(d), index(0), begin(b), end(e), depth(dep), 
+                    minCorner(mn), maxCorner(mx), isPoint(false) {}
+            Scalar distance;
+            size_t index;
+            size_t begin;
+            size_t end;
+            size_t depth;
+            Point2Type minCorner;
+            Point2Type maxCorner;
+            bool isPoint;
+        };
+        class candidateCompare {
+        public:
+            candidateCompare(const basic_kdtree* tree = NULL) : m_tree(tree) {}
+            //true if lhs should be visited after rhs
+            bool operator ()(const candidate& lhs, const candidate& rhs) const;
+        private:
+            const basic_kdtree* m_tree;
+        };
+        typedef std::priority_queue<candidate, std::vector<candidate>, 
+                candidateCompare> candidate_queue;
+        
+        void pushRange(size_t begin, size_t end, size_t depth, 
+                const Point2Type& minCorner, const Point2Type& maxCorner);
+        
+        const basic_kdtree& m_tree;
+        Point2Type m_point;
+        candidate_queue m_queue;
+    };
+    
+    basic_kdtree() : m_size(0) {}
+    template <typename ITER>
+    basic_kdtree(ITER first, ITER last) : m_size(0) { build(first, last); }
+    
+    /*!Replace the contents of this tree with a range of point_value
+     @first: start of the range
+     @last: end of the range*/
+    template <typename ITER>
+    void build(ITER first, ITER last);
+    /*!Remove one value stored at position
+     @return: true if something was removed*/
+    bool erase(const Point2Type& position, const value_type& value);
+    /*!Find the nearest value to point
+     @return: false if the tree is empty*/
+    bool nearest(const Point2Type& point, value_type& value) const;
+    /*!Append the count nearest values to point to result, nearest first
+     @result: Object supporting push_back(...) where output is placed*/
+    template <typename COLLECTION>
+    void nearest(COLLECTION& result, const Point2Type& point, 
+            size_t count) const;
+    /*!Swap contents of this object with that of another*/
+    void swap(basic_kdtree& other);
+    
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    
+private:
+    
+    class entry {
+    public:
+        entry(const point_value& pv = point_value()) 
+                : position(pv.first), value(pv.second), alive(true) {}
+        Point2Type position;
+        value_type value;
+        bool alive;
+    };
+    
+    class axisCompare {
+    public:
+        axisCompare(size_t axis) : m_axis(axis) {}
+        bool operator ()(const entry& lhs, const entry& rhs) const {
+            return coordinate(lhs.position, m_axis) < 
+                    coordinate(rhs.position, m_axis);
+        }
+    private:
+        size_t m_axis;
+    };
+    
+    static Scalar coordinate(const Point2Type& point, size_t axis) {
+        return axis ? point.y : point.x;
+    }
+    static size_t middle(size_t begin, size_t end) {
+        return begin + (end - begin) / 2;
+    }
+    
+    void buildRange(size_t begin, size_t end, size_t depth);
+    bool eraseRange(size_t begin, size_t end, size_t depth, 
+            const Point2Type& position, const value_type& value);
+    
+    /* The tree is implicit: the range [begin, end) is split at its 
+     middle element, which is stored there. m_live holds the number of 
+     values not yet erased in the subtree rooted at each element. */
+    std::vector<entry> m_entries;
+    std::vector<size_t> m_live;
+    size_t m_size;
+};
+
+}
+
+#endif	/* MGL_BASIC_KDTREE_DECL_H */
+
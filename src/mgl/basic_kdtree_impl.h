@@ -0,0 +1,175 @@
+#ifndef MGL_BASIC_KDTREE_IMPL_H
+#define	MGL_BASIC_KDTREE_IMPL_H
+
+#include "basic_kdtree_decl.h"
+#include <algorithm>
+#include <limits>
+
+namespace mgl {
+
+template <typename T>
+template <typename ITER>
+void basic_kdtree<T>::build(ITER first, ITER last) {
+    m_entries.clear();
+    for(; first != last; ++first) {
+        m_entries.push_back(entry(*first));
+    }
+    m_live.assign(m_entries.size(), 0);
+    m_size = m_entries.size();
+    buildRange(0, m_entries.size(), 0);
+}
+template <typename T>
+void basic_kdtree<T>::buildRange(size_t begin, size_t end, size_t depth) {
+    if(begin >= end)
+        return;
+    size_t mid = middle(begin, end);
+    std::nth_element(m_entries.begin() + begin, m_entries.begin() + mid, 
+            m_entries.begin() + end, axisCompare(depth % 2));
+    m_live[mid] = end - begin;
+    buildRange(begin, mid, depth + 1);
+    buildRange(mid + 1, end, depth + 1);
+}
+template <typename T>
+bool basic_kdtree<T>::erase(const Point2Type& position, 
+        const value_type& value) {
+    if(eraseRange(0, m_entries.size(), 0, position, value)) {
+        --m_size;
+        return true;
+    }
+    return false;
+}
+template <typename T>
+bool basic_kdtree<T>::eraseRange(size_t begin, size_t end, size_t depth, 
+        const Point2Type& position, const value_type& value) {
+    if(begin >= end)
+        return false;
+    size_t mid = middle(begin, end);
+    if(m_live[mid] == 0)
+        return false;
+    entry& current = m_entries[mid];
+    bool found = false;
+    if(current.alive && current.position == position && 
+            current.value == value) {
+        current.alive = false;
+        found = true;
+    } else {
+        Scalar split = coordinate(current.position, depth % 2);
+        Scalar here = coordinate(position, depth % 2);
+        //values equal to the split may have landed on either side
+        if(here <= split)
+            found = eraseRange(begin, mid, depth + 1, position, value);
+        if(!found && here >= split)
+            found = eraseRange(mid + 1, end, depth + 1, position, value);
+    }
+    if(found)
+        --m_live[mid];
+    return found;
+}
+template <typename T>
+bool basic_kdtree<T>::nearest(const Point2Type& point, 
+        value_type& value) const {
+    nearest_query query(*this, point);
+    Scalar distance;
+    return query.next(value, distance);
+}
+template <typename T>
+template <typename COLLECTION>
+void basic_kdtree<T>::nearest(COLLECTION& result, const Point2Type& point, 
+        size_t count) const {
+    nearest_query query(*this, point);
+    value_type value;
+    Scalar distance;
+    for(size_t found = 0; found < count && query.next(value, distance); 
+            ++found) {
+        result.push_back(value);
+    }
+}
+template <typename T>
+void basic_kdtree<T>::swap(basic_kdtree& other) {
+    m_entries.swap(other.m_entries);
+    m_live.swap(other.m_live);
+    std::swap(m_size, other.m_size);
+}
+template <typename T>
+basic_kdtree<T>::nearest_query::nearest_query(const basic_kdtree& tree, 
+        const Point2Type& point) 
+        : m_tree(tree), m_point(point), 
+        m_queue(candidateCompare(&tree)) {
+    const Scalar big = std::numeric_limits<Scalar>::max();
+    pushRange(0, m_tree.m_entries.size(), 0, 
+            Point2Type(-big, -big), Point2Type(big, big));
+}
+template <typename T>
+void basic_kdtree<T>::nearest_query::pushRange(size_t begin, size_t end, 
+        size_t depth, const Point2Type& minCorner, 
+        const Point2Type& maxCorner) {
+    if(begin >= end || m_tree.m_live[middle(begin, end)] == 0)
+        return;
+    //squared distance from m_point to the box is a lower bound
+    Scalar dx = 0;
+    Scalar dy = 0;
+    if(m_point.x < minCorner.x)
+        dx = minCorner.x - m_point.x;
+    else if(m_point.x > maxCorner.x)
+        dx = m_point.x - maxCorner.x;
+    if(m_point.y < minCorner.y)
+        dy = minCorner.y - m_point.y;
+    else if(m_point.y > maxCorner.y)
+        dy = m_point.y - maxCorner.y;
+    m_queue.push(candidate(dx * dx + dy * dy, begin, end, depth, 
+            minCorner, maxCorner));
+}
+template <typename T>
+bool basic_kdtree<T>::nearest_query::next(value_type& value, 
+        Scalar& squaredDistance) {
+    while(!m_queue.empty()) {
+        candidate current = m_queue.top();
+        m_queue.pop();
+        if(current.isPoint) {
+            const entry& found = m_tree.m_entries[current.index];
+            if(!found.alive)
+                continue;
+            value = found.value;
+            squaredDistance = current.distance;
+            return true;
+        }
+        size_t mid = middle(current.begin, current.end);
+        const entry& split = m_tree.m_entries[mid];
+        if(split.alive) {
+            m_queue.push(candidate(
+                    (split.position - m_point).squaredMagnitude(), mid));
+        }
+        size_t axis = current.depth % 2;
+        Point2Type lowMax = current.maxCorner;
+        Point2Type highMin = current.minCorner;
+        if(axis) {
+            lowMax.y = highMin.y = split.position.y;
+        } else {
+            lowMax.x = highMin.x = split.position.x;
+        }
+        pushRange(current.begin, mid, current.depth + 1, 
+                current.minCorner, lowMax);
+        pushRange(mid + 1, current.end, current.depth + 1, 
+                highMin, current.maxCorner);
+    }
+    return false;
+}
+template <typename T>
+bool basic_kdtree<T>::nearest_query::candidateCompare::operator ()(
+        const candidate& lhs, const candidate& rhs) const {
+    if(lhs.distance != rhs.distance)
+        return lhs.distance > rhs.distance;
+    /* at equal distance, open subtrees before reporting points so that 
+     every point at this distance is queued and ties break by value */
+    if(lhs.isPoint != rhs.isPoint)
+        return lhs.isPoint;
+    if(!lhs.isPoint)
+        return false;
+    return m_tree->m_entries[rhs.index].value < 
+            m_tree->m_entries[lhs.index].value;
+}
+
+}
+
+#endif	/* MGL_BASIC_KDTREE_IMPL_H */
+
@@ -153,6 +153,42 @@ bool boolCheck(const Json::Value &value, const char *name) {
     return value.asBool();
 }
 
+static GrueConfig::CommentLevel commentLevelCheck(const Json::Value &value, 
+        const char *name, GrueConfig::CommentLevel defaultval) {
+    if (value.isNull())
+        return defaultval;
+    string level = stringCheck(value, name);
+    if (level == "none")
+        return GrueConfig::COMMENT_NONE;
+    if (level == "layer")
+        return GrueConfig::COMMENT_LAYER;
+    if (level == "path")
+        return GrueConfig::COMMENT_PATH;
+    if (level == "move")
+        return GrueConfig::COMMENT_MOVE;
+    stringstream ss;
+    ss << "Field \"" << name << "\" in configuration file must be one of " 
+            "none, layer, path or move, not \"" << level << "\"";
+    ConfigException mixup(ss.str().c_str());
+    throw mixup;
+}
+
+static GrueConfig::OutputFormat outputFormatCheck(const Json::Value &value, 
+        const char *name, GrueConfig::OutputFormat defaultval) {
+    if (value.isNull())
+        return defaultval;
+    string format = stringCheck(value, name);
+    if (format == "gcode")
+        return GrueConfig::OUTPUT_GCODE;
+    if (format == "x3g")
+        return GrueConfig::OUTPUT_X3G;
+    stringstream ss;
+    ss << "Field \"" << name << "\" in configuration file must be one of " 
+            "gcode or x3g, not \"" << format << "\"";
+    ConfigException mixup(ss.str().c_str());
+    throw mixup;
+}
+
 Configuration::Configuration()
 : filename("") {
 }
@@ -191,7 +227,12 @@ GrueConfig::GrueConfig()
         doAnchor(INVALID_BOOL), doPutModelOnPlatform(INVALID_BOOL), 
         doPrintLayerMessages(INVALID_BOOL), doPrintProgress(INVALID_BOOL), 
         minLayerDuration(INVALID_SCALAR), 
-        minSpeedMultiplier(INVALID_SCALAR),
+        minSpeedMultiplier(INVALID_SCALAR), gcodeDecimals(INVALID_UINT), 
+        commentLevel(COMMENT_MOVE), outputFormat(OUTPUT_GCODE), 
+        threads(INVALID_UINT), maxConcurrentJobs(INVALID_UINT), 
+        jobMemoryBudget(INVALID_UINT), gcodeThreads(INVALID_UINT), 
+        doStreaming(INVALID_BOOL), 
+        streamQueueLayers(INVALID_UINT), 
         coarseness(INVALID_SCALAR), preCoarseness(INVALID_SCALAR), 
         directionWeight(INVALID_SCALAR), 
         layerH(INVALID_SCALAR), firstLayerZ(INVALID_SCALAR), 
@@ -216,9 +257,17 @@ GrueConfig::GrueConfig()
         raftModelSpacing(INVALID_SCALAR), raftDensity(INVALID_SCALAR), 
         doSupport(INVALID_BOOL), supportMargin(INVALID_SCALAR), 
         supportDensity(INVALID_SCALAR), doGraphOptimization(INVALID_BOOL), 
-        doFixedLayerStart(INVALID_BOOL), 
+        doFixedLayerStart(INVALID_BOOL), pathingThreads(INVALID_UINT), 
+        iterativeEffort(INVALID_UINT), iterativeTimeLimit(INVALID_SCALAR), 
         rapidMoveFeedRateXY(INVALID_SCALAR), rapidMoveFeedRateZ(INVALID_SCALAR), 
-        useEaxis(INVALID_BOOL), 
+        maxAcceleration(INVALID_SCALAR), junctionDeviation(INVALID_SCALAR), 
+        doCornerLinks(INVALID_BOOL), 
+        xStepsPerMm(INVALID_SCALAR), yStepsPerMm(INVALID_SCALAR), 
+        zStepsPerMm(INVALID_SCALAR), aStepsPerMm(INVALID_SCALAR), 
+        bStepsPerMm(INVALID_SCALAR), 
+        useEaxis(INVALID_BOOL), doModalMoves(INVALID_BOOL), 
+        doRelativeE(INVALID_BOOL), doArcFitting(INVALID_BOOL), 
+        arcTolerance(INVALID_SCALAR), 
         /*
         // we don't need these for std::strings
         commentOpen(""), 
@@ -231,6 +280,13 @@ GrueConfig::GrueConfig()
         startingB(INVALID_SCALAR), startingFeed(INVALID_SCALAR),
         centerX(INVALID_SCALAR), centerY(INVALID_SCALAR) {}
 void GrueConfig::loadFromFile(const Configuration& config) {
+    //the stages with their own thread counts fall back on this
+    threads = uintCheck(config["threads"], "threads", 1);
+    //how the slicing daemon shares them between jobs
+    maxConcurrentJobs = uintCheck(config["maxConcurrentJobs"], 
+            "maxConcurrentJobs", 1);
+    jobMemoryBudget = uintCheck(config["jobMemoryBudget"], 
+            "jobMemoryBudget", 0);
     loadSlicingParams(config);
     doRaft = boolCheck(config["doRaft"], "doRaft");
     if(doRaft)
@@ -242,6 +298,8 @@ void GrueConfig::loadFromFile(const Configuration& config) {
             config["doGraphOptimization"], "doGraphOptimization", true);
     doFixedLayerStart = boolCheck(
             config["doFixedLayerStart"], "doFixedLayerStart", true);
+    pathingThreads = uintCheck(
+            config["pathingThreads"], "pathingThreads", threads);
     if(doGraphOptimization)
         loadPathingParams(config);
     loadGantryParams(config);
@@ -302,6 +360,24 @@ void GrueConfig::loadGantryParams(const Configuration& config) {
             config["rapidMoveFeedRateXY"], "rapidMoveFeedRateXY"));
     rapidMoveFeedRateZ = (doubleCheck(
             config["rapidMoveFeedRateZ"], "rapidMoveFeedRateZ"));
+    maxAcceleration = doubleCheck(
+            config["maxAcceleration"], "maxAcceleration", 1000.0);
+    junctionDeviation = doubleCheck(
+            config["junctionDeviation"], "junctionDeviation", 0.05);
+    //configs from before the motion model keep their link choices
+    doCornerLinks = boolCheck(config["doCornerLinks"], "doCornerLinks", 
+            !config["maxAcceleration"].isNull());
+    //a Replicator's, for x3g output
+    xStepsPerMm = doubleCheck(
+            config["xStepsPerMm"], "xStepsPerMm", 94.139704);
+    yStepsPerMm = doubleCheck(
+            config["yStepsPerMm"], "yStepsPerMm", 94.139704);
+    zStepsPerMm = doubleCheck(
+            config["zStepsPerMm"], "zStepsPerMm", 400.0);
+    aStepsPerMm = doubleCheck(
+            config["aStepsPerMm"], "aStepsPerMm", 96.275201870333662);
+    bStepsPerMm = doubleCheck(
+            config["bStepsPerMm"], "bStepsPerMm", 96.275201870333662);
     scalingFactor = (doubleCheck(
             config["feedScalingFactor"], "feedScalingFactor", 60.0));
 
@@ -316,6 +392,27 @@ void GrueConfig::loadGantryParams(const Configuration& config) {
     startingFeed = 0;
     centerX = (doubleCheck(config["centerX"], "centerX", 0));
     centerY = (doubleCheck(config["centerX"], "centerX", 0));
+    //copies of the part, sliced once
+    instances.clear();
+    const Json::Value& placements = config["instances"];
+    if(!placements.isNull() && !placements.isArray()) {
+        ConfigException mixup("\"instances\" must be an array of [x, y] "
+                "offsets in configuration file");
+        throw mixup;
+    }
+    for(Json::Value::ArrayIndex i = 0; i < placements.size(); ++i) {
+        const Json::Value& placement = placements[i];
+        if(!placement.isArray() || placement.size() != 2 ||
+                !placement[0u].isNumeric() || !placement[1u].isNumeric()) {
+            stringstream ss;
+            ss << "Instance " << i << " must be an [x, y] offset in "
+                    "configuration file";
+            ConfigException mixup(ss.str().c_str());
+            throw mixup;
+        }
+        instances.push_back(Point2Type(placement[0u].asDouble(),
+                placement[1u].asDouble()));
+    }
 }
 void GrueConfig::loadGcodeParams(const Configuration& config) {
     defaultExtruder = uintCheck(config["defaultExtruder"],
@@ -350,8 +447,38 @@ void GrueConfig::loadGcodeParams(const Configuration& config) {
     minSpeedMultiplier = doubleCheck(
             config["minSpeedMultiplier"], 
             "minSpeedMultiplier", 1.0);
+    gcodeDecimals = uintCheck(
+            config["gcodeDecimals"], 
+            "gcodeDecimals", 3);
+    commentLevel = commentLevelCheck(
+            config["commentLevel"], 
+            "commentLevel", COMMENT_MOVE);
+    outputFormat = outputFormatCheck(
+            config["outputFormat"], 
+            "outputFormat", OUTPUT_GCODE);
+    gcodeThreads = uintCheck(
+            config["gcodeThreads"], 
+            "gcodeThreads", threads);
+    doStreaming = boolCheck(config["doStreaming"], 
+            "doStreaming", false);
+    streamQueueLayers = uintCheck(
+            config["streamQueueLayers"], 
+            "streamQueueLayers", 8);
+    timingReport = stringCheck(config["timingReport"], 
+            "timingReport", "");
+    traceFile = stringCheck(config["traceFile"], "traceFile", "");
+    progressModelFile = pathCheck(config["progressModelFile"], 
+            "progressModelFile", "");
     useEaxis = (boolCheck(config["useEAxis"],
             "useEAxis", false));
+    doModalMoves = boolCheck(config["doModalMoves"], 
+            "doModalMoves", false);
+    doRelativeE = boolCheck(config["doRelativeE"], 
+            "doRelativeE", false);
+    doArcFitting = boolCheck(config["doArcFitting"], 
+            "doArcFitting", false);
+    arcTolerance = doubleCheck(config["arcTolerance"], 
+            "arcTolerance", 0.01);
     commentOpen = (stringCheck(config["commentOpen"],
                                "commentOpen", "("));
     commentClose = (stringCheck(config["commentClose"],
@@ -382,7 +509,12 @@ void GrueConfig::loadSupportParams(const Configuration& config) {
     supportDensity = doubleCheck(
             config["supportDensity"], "supportDensity");
 }
-void GrueConfig::loadPathingParams(const Configuration& config) {}
+void GrueConfig::loadPathingParams(const Configuration& config) {
+    iterativeEffort = uintCheck(
+            config["iterativeEffort"], "iterativeEffort", 2);
+    iterativeTimeLimit = doubleCheck(
+            config["iterativeTimeLimit"], "iterativeTimeLimit", 0);
+}
 void GrueConfig::loadProfileParams(const Configuration& config) {
     loadExtruderParams(config);
     loadExtrusionParams(config);
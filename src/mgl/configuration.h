@@ -148,6 +148,19 @@ public:
     
     typedef std::map<std::string, Extrusion> profileNameMap;
     typedef std::vector<Extruder> extruderVector;
+    typedef std::vector<Point2Type> pointVector;
+    /// how much explanation is written into gcode as comments
+    enum CommentLevel {
+        COMMENT_NONE,   ///< no comments at all
+        COMMENT_LAYER,  ///< file header, layer headers and time estimates
+        COMMENT_PATH,   ///< also travel, retraction and Z moves
+        COMMENT_MOVE    ///< also the length of every extruding move
+    };
+    /// what the gcoder writes
+    enum OutputFormat {
+        OUTPUT_GCODE,   ///< gcode text
+        OUTPUT_X3G      ///< binary s3g commands, as in .x3g files
+    };
 private:
     static const Scalar INVALID_SCALAR;// = std::numeric_limits<Scalar>::min();
     static const unsigned int INVALID_UINT = -1;
@@ -188,6 +201,26 @@ private:
     GRUECONFIG_PUBLIC_CONST_ACCESSOR(bool, doPrintProgress)
     GRUECONFIG_PUBLIC_CONST_ACCESSOR(Scalar, minLayerDuration)
     GRUECONFIG_PUBLIC_CONST_ACCESSOR(Scalar, minSpeedMultiplier)
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(unsigned, gcodeDecimals)
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(CommentLevel, commentLevel)
+    /// true if comments of @a level are written to gcode
+    bool doComments(CommentLevel level) const { 
+        return commentLevel >= level; 
+    }
+    /// @a text if comments of @a level are written to gcode, else NULL
+    const char* comment(CommentLevel level, const char* text) const {
+        return doComments(level) ? text : NULL;
+    }
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(OutputFormat, outputFormat)
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(unsigned, threads)
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(unsigned, maxConcurrentJobs)
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(unsigned, jobMemoryBudget)
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(unsigned, gcodeThreads)
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(bool, doStreaming)
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(unsigned, streamQueueLayers)
+    GRUECONFIG_PUBLIC_CONSTREF_ACCESSOR(std::string, timingReport)
+    GRUECONFIG_PUBLIC_CONSTREF_ACCESSOR(std::string, traceFile)
+    GRUECONFIG_PUBLIC_CONSTREF_ACCESSOR(std::string, progressModelFile)
     GRUECONFIG_PUBLIC_CONST_ACCESSOR(Scalar, coarseness)
     GRUECONFIG_PUBLIC_CONST_ACCESSOR(Scalar, preCoarseness)
     GRUECONFIG_PUBLIC_CONST_ACCESSOR(Scalar, directionWeight)
@@ -227,10 +260,25 @@ private:
     //pather
     GRUECONFIG_PUBLIC_CONST_ACCESSOR(bool, doGraphOptimization)
     GRUECONFIG_PUBLIC_CONST_ACCESSOR(bool, doFixedLayerStart);
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(unsigned, pathingThreads)
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(unsigned, iterativeEffort)
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(Scalar, iterativeTimeLimit)
     //gantry
     GRUECONFIG_PUBLIC_CONST_ACCESSOR(Scalar, rapidMoveFeedRateXY)
     GRUECONFIG_PUBLIC_CONST_ACCESSOR(Scalar, rapidMoveFeedRateZ)
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(Scalar, maxAcceleration)
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(Scalar, junctionDeviation)
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(bool, doCornerLinks)
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(Scalar, xStepsPerMm)
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(Scalar, yStepsPerMm)
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(Scalar, zStepsPerMm)
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(Scalar, aStepsPerMm)
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(Scalar, bStepsPerMm)
     GRUECONFIG_PUBLIC_CONST_ACCESSOR(bool, useEaxis)
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(bool, doModalMoves)
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(bool, doRelativeE)
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(bool, doArcFitting)
+    GRUECONFIG_PUBLIC_CONST_ACCESSOR(Scalar, arcTolerance)
     GRUECONFIG_PUBLIC_CONSTREF_ACCESSOR(std::string, commentOpen)
     GRUECONFIG_PUBLIC_CONSTREF_ACCESSOR(std::string, commentClose)
     GRUECONFIG_PUBLIC_CONST_ACCESSOR(int, weightedFanCommand)
@@ -243,6 +291,8 @@ private:
     GRUECONFIG_PUBLIC_CONST_ACCESSOR(Scalar, startingFeed)
     GRUECONFIG_PUBLIC_CONST_ACCESSOR(Scalar, centerX)
     GRUECONFIG_PUBLIC_CONST_ACCESSOR(Scalar, centerY)
+    /// where copies of the part go, from where it is sliced, none for one
+    GRUECONFIG_PUBLIC_CONSTREF_ACCESSOR(pointVector, instances)
     
 #undef GRUECONFIG_PUBLIC_CONST_ACCESSOR
 #undef GRUECONFIG_PUBLIC_CONSTREF_ACCESSOR
@@ -0,0 +1,189 @@
+#include "container_sizes.h"
+
+namespace mgl {
+
+//what std::list adds to each element
+static const size_t LIST_NODE_BYTES = 2 * sizeof(void*);
+//a loop keeps each point, its normal, and both together
+static const size_t LOOP_POINT_BYTES = 2 * sizeof(Point2Type) +
+        sizeof(Loop::PointNormal);
+
+/// counts for one layer, added up over the layers
+class Tally {
+public:
+    Tally() : loops(0), points(0), paths(0), ranges(0), bytes(0) {}
+    void addLoops(const std::list<Loop>& list) {
+        for(std::list<Loop>::const_iterator loop = list.begin();
+                loop != list.end(); ++loop) {
+            ++loops;
+            points += loop->size();
+            bytes += LIST_NODE_BYTES + sizeof(Loop) +
+                    loop->size() * LOOP_POINT_BYTES;
+        }
+    }
+    void addLoops(const std::list<LoopList>& lists) {
+        for(std::list<LoopList>::const_iterator list = lists.begin();
+                list != lists.end(); ++list) {
+            bytes += LIST_NODE_BYTES + sizeof(LoopList);
+            addLoops(*list);
+        }
+    }
+    void addPath(const OpenPath& path, size_t pathBytes) {
+        ++paths;
+        points += path.size();
+        bytes += LIST_NODE_BYTES + pathBytes +
+                path.size() * sizeof(Point2Type);
+    }
+    void addPaths(const std::list<OpenPath>& list) {
+        for(std::list<OpenPath>::const_iterator path = list.begin();
+                path != list.end(); ++path)
+            addPath(*path, sizeof(OpenPath));
+    }
+    void addRanges(const GridRanges& grid) {
+        for(size_t line = 0; line < grid.xRays.size(); ++line)
+            ranges += grid.xRays[line].size();
+        for(size_t line = 0; line < grid.yRays.size(); ++line)
+            ranges += grid.yRays[line].size();
+        bytes += (grid.xRays.size() + grid.yRays.size()) *
+                sizeof(std::vector<ScalarRange>);
+        bytes += grid.raysCount() * sizeof(ScalarRange);
+    }
+    void add(const Tally& other) {
+        loops += other.loops;
+        points += other.points;
+        paths += other.paths;
+        ranges += other.ranges;
+        bytes += other.bytes;
+    }
+
+    size_t loops;
+    size_t points;
+    size_t paths;
+    size_t ranges;
+    size_t bytes;
+};
+
+/// append the counts of one layer to the arrays in @a out
+static void appendLayer(const Tally& layer, bool withLoops, bool withPaths,
+        bool withRanges, Json::Value& out) {
+    if(withLoops)
+        out["loopsPerLayer"].append(Json::UInt(layer.loops));
+    if(withPaths)
+        out["pathsPerLayer"].append(Json::UInt(layer.paths));
+    if(withLoops || withPaths)
+        out["pointsPerLayer"].append(Json::UInt(layer.points));
+    if(withRanges)
+        out["rangesPerLayer"].append(Json::UInt(layer.ranges));
+}
+
+/// write the totals of every layer to @a out
+static void writeTotals(const Tally& total, size_t layers, bool withLoops,
+        bool withPaths, bool withRanges, Json::Value& out) {
+    out["layers"] = Json::UInt(layers);
+    if(withLoops)
+        out["loops"] = Json::UInt(total.loops);
+    if(withPaths)
+        out["paths"] = Json::UInt(total.paths);
+    if(withLoops || withPaths)
+        out["points"] = Json::UInt(total.points);
+    if(withRanges)
+        out["ranges"] = Json::UInt(total.ranges);
+    //may not fit in 32 bits
+    out["bytes"] = double(total.bytes);
+}
+
+void containerSizes(const Segmenter& segmenter, Json::Value& out) {
+    const std::vector<Triangle3Type>& triangles =
+            segmenter.readAllTriangles();
+    const SliceTable& table = segmenter.readSliceTable();
+    size_t entries = 0;
+    for(SliceTable::const_iterator slice = table.begin();
+            slice != table.end(); ++slice) {
+        entries += slice->size();
+        out["trianglesPerLayer"].append(Json::UInt(slice->size()));
+    }
+    out["layers"] = Json::UInt(table.size());
+    out["triangles"] = Json::UInt(triangles.size());
+    out["sliceEntries"] = Json::UInt(entries);
+    out["bytes"] = double(triangles.size() * sizeof(Triangle3Type) +
+            table.size() * sizeof(TriangleIndices) +
+            entries * sizeof(index_t));
+}
+
+void containerSizes(const LayerLoops& layerloops, Json::Value& out) {
+    Tally total;
+    size_t layers = 0;
+    for(LayerLoops::const_layer_iterator layer = layerloops.begin();
+            layer != layerloops.end(); ++layer, ++layers) {
+        Tally current;
+        current.bytes += LIST_NODE_BYTES + sizeof(LayerLoops::Layer);
+        current.addLoops(layer->readLoops());
+        appendLayer(current, true, false, false, out);
+        total.add(current);
+    }
+    writeTotals(total, layers, true, false, false, out);
+}
+
+void containerSizes(const RegionList& regions, Json::Value& out) {
+    Tally total;
+    for(RegionList::const_iterator region = regions.begin();
+            region != regions.end(); ++region) {
+        Tally current;
+        current.bytes += sizeof(LayerRegions);
+        current.addLoops(region->outlines);
+        current.addLoops(region->insetLoops);
+        current.addLoops(region->spurLoops);
+        current.addLoops(region->supportLoops);
+        current.addLoops(region->interiorLoops);
+        current.addLoops(region->floorLoops);
+        current.addLoops(region->roofLoops);
+        for(std::list<OpenPathList>::const_iterator spurs =
+                region->spurs.begin(); spurs != region->spurs.end();
+                ++spurs)
+            current.addPaths(*spurs);
+        current.addRanges(region->flatSurface);
+        current.addRanges(region->supportSurface);
+        current.addRanges(region->roofing);
+        current.addRanges(region->flooring);
+        current.addRanges(region->support);
+        current.addRanges(region->infill);
+        current.addRanges(region->solid);
+        current.addRanges(region->sparse);
+        appendLayer(current, true, false, true, out);
+        total.add(current);
+    }
+    writeTotals(total, regions.size(), true, false, true, out);
+}
+
+void containerSizes(const LayerPaths& layerpaths, Json::Value& out) {
+    typedef LayerPaths::Layer::ExtruderLayer ExtruderLayer;
+    Tally total;
+    size_t layers = 0;
+    for(LayerPaths::const_layer_iterator layer = layerpaths.begin();
+            layer != layerpaths.end(); ++layer, ++layers) {
+        Tally current;
+        current.bytes += LIST_NODE_BYTES + sizeof(LayerPaths::Layer);
+        for(LayerPaths::Layer::const_extruder_iterator extruder =
+                layer->extruders.begin();
+                extruder != layer->extruders.end(); ++extruder) {
+            current.bytes += LIST_NODE_BYTES + sizeof(ExtruderLayer);
+            for(ExtruderLayer::const_inset_iterator insets =
+                    extruder->insetPaths.begin();
+                    insets != extruder->insetPaths.end(); ++insets)
+                current.addPaths(*insets);
+            current.addPaths(extruder->infillPaths);
+            current.addPaths(extruder->supportPaths);
+            current.addPaths(extruder->outlinePaths);
+            for(ExtruderLayer::const_path_iterator path =
+                    extruder->paths.begin();
+                    path != extruder->paths.end(); ++path)
+                current.addPath(path->myPath, sizeof(LabeledOpenPath));
+        }
+        appendLayer(current, false, true, false, out);
+        total.add(current);
+    }
+    writeTotals(total, layers, false, true, false, out);
+}
+
+}
+
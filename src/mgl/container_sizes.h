@@ -0,0 +1,36 @@
+/*
+ * File:   container_sizes.h
+ *
+ * Rough sizes of the containers the pipeline builds, layer by layer
+ */
+
+#ifndef MGL_CONTAINER_SIZES_H
+#define	MGL_CONTAINER_SIZES_H
+
+#include "pather.h"
+#include "segmenter.h"
+#include "slicer_loops.h"
+#include <jsoncpp/json/value.h>
+
+namespace mgl {
+
+/*
+ Each writes what it counts per layer as arrays, the totals, and bytes,
+ an estimate of the memory held. Bytes count the elements and the list
+ nodes holding them, but not spare vector capacity or what the
+ allocator adds.
+ */
+
+/// triangles, and the triangles each slice refers to
+void containerSizes(const Segmenter& segmenter, Json::Value& out);
+/// loops and their points
+void containerSizes(const LayerLoops& layerloops, Json::Value& out);
+/// loops and points of every kind, and the ranges of every grid
+void containerSizes(const RegionList& regions, Json::Value& out);
+/// paths and their points
+void containerSizes(const LayerPaths& layerpaths, Json::Value& out);
+
+}
+
+#endif	/* MGL_CONTAINER_SIZES_H */
+
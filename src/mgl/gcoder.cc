@@ -12,12 +12,14 @@
 #include "gcoder.h"
 
 #include "log.h"
+#include "task_scheduler.h"
 #include <math.h>
 #include <string>
 #include <list>
 #include <map>
 #include <vector>
 #include <sstream>
+#include <algorithm>
 
 namespace mgl {
 
@@ -25,6 +27,27 @@ using namespace std;
 
 
 
+//layers each thread formats in one go when writing gcode in parallel
+static const size_t GCODE_CHUNK_LAYERS = 16;
+
+// points in all paths of @a layer, which is what progress counts
+
+static unsigned int layerPointCount(const LayerPaths::Layer& layer) {
+    unsigned int count = 0;
+    for(LayerPaths::Layer::const_extruder_iterator exit = 
+            layer.extruders.begin(); 
+            exit != layer.extruders.end(); 
+            ++exit) {
+        for(LayerPaths::Layer::ExtruderLayer::const_path_iterator pathiter = 
+                exit->paths.begin(); 
+                pathiter != exit->paths.end(); 
+                ++pathiter) {
+            count += pathiter->myPath.size();
+        }
+    }
+    return count;
+}
+
 // function that adds an s to a noun if count is more than 1
 
 std::string plural(const char*noun, int count, const char* ending = "s") {
@@ -73,17 +96,34 @@ void polygonLeadInAndLeadOut(const mgl::Polygon &polygon, const Extruder &extrud
 GCoder::GCoder(const GrueConfig& grueConf, ProgressBar* progress)
         : Progressive(progress), grueCfg(grueConf), gantry(grueCfg), 
         progressTotal(0), progressCurrent(0), 
-        progressPercent(0) {
+        progressPercent(0), printDuration(0), 
+        arcFitter(grueConf.get_arcTolerance()), binary(NULL), 
+        streamLayerCount(0), streamLayersWritten(0) {
     gantry.init_to_start();
 }
 
+GCoder::~GCoder() {
+    delete binary;
+}
+
+/// throw unless @a in, opened from @a file, starts with a command of 
+/// the ids x3g files hold, so text gcode is never copied into x3g output
+static void checkX3g(std::istream& in, const string& file) {
+    const int first = in.peek();
+    if (first == char_traits<char>::eof())
+        return;
+    if (first < 128 || first >= 160)
+        throw GcoderException((string("Not an x3g file, so it can't be "
+                "copied into x3g output [") + file + "]").c_str());
+}
+
 /**
  * Writes intial gcode data to start of the gcode file, including setup & startup info
  * @param gout - output stream for the gcode text
  * @param sourceName - source of this gcode (usually the origional stl file)
  */
 void GCoder::writeStartDotGCode(std::ostream &gout, const char* sourceName) {
-    gout.precision(3);
+    gout.precision(grueCfg.get_gcodeDecimals());
     gout.setf(ios::fixed);
 
     writeGCodeConfig(gout, sourceName);
@@ -91,15 +131,19 @@ void GCoder::writeStartDotGCode(std::ostream &gout, const char* sourceName) {
     const string &header_file = grueCfg.get_header();
 
     if (header_file.length() > 0) {
-        ifstream header_in(header_file.c_str(), ifstream::in);
+        ifstream header_in(header_file.c_str(), 
+                binary ? ifstream::in | ifstream::binary : ifstream::in);
 
         if (header_in.fail())
             throw GcoderException((string("Unable to open gcode header file [") +
                 header_file + "]").c_str());
+        if (binary)
+            checkX3g(header_in, header_file);
 
-        gout << grueCfg.get_commentOpen()
-             << "header [" << header_file << "] begin"
-             << grueCfg.get_commentClose() << endl;
+        if (doComments(GrueConfig::COMMENT_LAYER))
+            gout << grueCfg.get_commentOpen()
+                 << "header [" << header_file << "] begin"
+                 << grueCfg.get_commentClose() << '\n';
 
         while (header_in.good()) {
             char buf[1024];
@@ -112,9 +156,12 @@ void GCoder::writeStartDotGCode(std::ostream &gout, const char* sourceName) {
             throw GcoderException((string("Error reading gcode header file [") +
                 header_file + "]").c_str());
 
-        gout << grueCfg.get_commentOpen()
-             << "header [" << header_file << "] end"
-             << grueCfg.get_commentClose() <<endl << endl;
+        if (doComments(GrueConfig::COMMENT_LAYER))
+            gout << grueCfg.get_commentOpen()
+                 << "header [" << header_file << "] end"
+                 << grueCfg.get_commentClose() << '\n';
+        if (!binary)
+            gout << '\n';
     }
 }
 
@@ -123,15 +170,19 @@ void GCoder::writeEndDotGCode(std::ostream &ss) const {
 
 
     if (footer_file.length() > 0) {
-        ifstream footer_in(footer_file.c_str(), ifstream::in);
+        ifstream footer_in(footer_file.c_str(), 
+                binary ? ifstream::in | ifstream::binary : ifstream::in);
 
         if (footer_in.fail())
             throw GcoderException((string("Unable to open footer file [") +
                 footer_file + "]").c_str());
+        if (binary)
+            checkX3g(footer_in, footer_file);
 
-        ss << grueCfg.get_commentOpen()
-           << "footer [" << footer_file << "] begin"
-           << grueCfg.get_commentClose() << endl;
+        if (doComments(GrueConfig::COMMENT_LAYER))
+            ss << grueCfg.get_commentOpen()
+               << "footer [" << footer_file << "] begin"
+               << grueCfg.get_commentClose() << '\n';
 
         while (footer_in.good()) {
             char buf[1024];
@@ -144,9 +195,12 @@ void GCoder::writeEndDotGCode(std::ostream &ss) const {
             throw GcoderException((string("Error reading footer file [") +
                 footer_file + "]").c_str());
 
-        ss << grueCfg.get_commentOpen()
-           << "footer [" << footer_file << "] end"
-           << grueCfg.get_commentClose() << endl << endl;
+        if (doComments(GrueConfig::COMMENT_LAYER))
+            ss << grueCfg.get_commentOpen()
+               << "footer [" << footer_file << "] end"
+               << grueCfg.get_commentClose() << '\n';
+        if (!binary)
+            ss << '\n';
     }
 }
 
@@ -154,12 +208,21 @@ void GCoder::writeProgressPercent(std::ostream& ss, unsigned int current,
         unsigned int total) {
     if(!grueCfg.get_doPrintProgress())
         return;
-    unsigned int curPercent = (current--*100)/total;
+    //in floating point, so large prints don't overflow
+    unsigned int curPercent = static_cast<unsigned int>(
+            Scalar(current--) * 100 / total);
     if(curPercent != progressPercent) {
-        ss << "M73 P" << curPercent << " " << grueCfg.get_commentOpen()
-           << "progress (" << curPercent << "%): " << current 
-                << "/" << total << 
-            grueCfg.get_commentClose() << std::endl;
+        if(binary) {
+            binary->setBuildPercentage(curPercent);
+        } else {
+            ss << "M73 P" << curPercent;
+            if (doComments(GrueConfig::COMMENT_LAYER))
+                ss << " " << grueCfg.get_commentOpen()
+                   << "progress (" << curPercent << "%): " << current 
+                        << "/" << total << 
+                    grueCfg.get_commentClose();
+            ss << '\n';
+        }
         progressPercent = curPercent;
     }
 }
@@ -173,7 +236,8 @@ void GCoder::moveZ(ostream & ss, Scalar z, unsigned int, Scalar zFeedrate) {
 
 
     gantry.g1Motion(ss, 0, 0, z, 0, zFeedrate, 0, 0,
-            "move Z", doX, doY, doZ, doE, doFeed);
+            comment(GrueConfig::COMMENT_PATH, "move Z"), 
+            doX, doY, doZ, doE, doFeed);
 
 }
 bool GCoder::calcExtrusion(unsigned int extruderId, 
@@ -239,86 +303,298 @@ void GCoder::writeGcodeFile(LayerPaths& layerpaths,
         const std::string& title,
         LayerPaths::layer_iterator begin,
         LayerPaths::layer_iterator end) {
-    writeStartDotGCode(gout, title.c_str());
     size_t sliceCount = 0;
-    progressTotal = 1;
-    progressCurrent = 0;
-    progressPercent = 0;
+    unsigned int pointCount = 0;
     for (LayerPaths::const_layer_iterator it = begin;
             it != end;
             ++it, ++sliceCount){
-        for(LayerPaths::Layer::const_extruder_iterator exit = 
-                it->extruders.begin(); 
-                exit != it->extruders.end(); 
-                ++exit) {
-            for(LayerPaths::Layer::ExtruderLayer::const_path_iterator pathiter = 
-                    exit->paths.begin(); 
-                    pathiter != exit->paths.end(); 
-                    ++pathiter) {
-                progressTotal += pathiter->myPath.size();
-            }
-        }
+        pointCount += layerPointCount(*it);
     }
-    initProgress("gcode", sliceCount);
-    size_t layerSequence = 0;
-    for (LayerPaths::layer_iterator it = begin;
-            it != end; ++it, ++layerSequence) {
-        tick();
-        //Scalar z = layerMeasure.sliceIndexToHeight(codeSlice);
-        if(grueCfg.get_doAnchor() && layerSequence == 0) {
-            Extrusion strusion;
-            PathLabel slabel(PathLabel::TYP_CONNECTION, PathLabel::OWN_MODEL, 0);
-            const Extruder& struder = grueCfg.get_extruders()[
-                    it->extruders.front().extruderId];
-            calcExtrusion(struder.id, 0, slabel, strusion);
-            gantry.set_current_extruder_index(struder.code);
-            Point2Type startPoint;
-            if(!it->extruders.empty() && 
-                    !it->extruders.front().paths.empty() && 
-                    !it->extruders.front().paths.front().myPath.empty()) {
-                startPoint = *(it->extruders.front().paths.front().myPath.fromStart());
-            }
-            gantry.snort(gout, struder, 
-                    strusion);
-            //Apply firstLayerZ to anchor too!
-            const Scalar currentZ = it->layerZ + it->layerHeight + 
-                    grueCfg.get_firstLayerZ();
-            const Scalar currentH = it->layerHeight;
-            Scalar currentW = it->layerW;
-            if(!grueCfg.get_doRaft()) {
-                currentW *= 2.0;
-            }
-            gantry.g1(gout, struder, 
-                    strusion, grueCfg.get_startingX(), 
-                    grueCfg.get_startingY(), currentZ, 
-                    strusion.feedrate, 
-                    currentH, currentW, "Anchor Start");
-            gantry.squirt(gout, struder, 
-                    strusion);
-            gantry.g1(gout, struder, 
-                    strusion, grueCfg.get_startingX(), 
-                    grueCfg.get_startingY(), currentZ, 
-                    strusion.feedrate, 
-                    currentH, currentW, "Anchor Start");
-            gantry.g1(gout, struder, 
-                    strusion, startPoint.x, startPoint.y, currentZ, 
-                    strusion.feedrate, 
-                    currentH, currentW, "Anchor End");
+    beginGcodeFile(gout, title, sliceCount);
+    progressTotal += pointCount;
+    TaskScheduler scheduler(grueCfg.get_gcodeThreads());
+    /* Guessing where each chunk starts costs rewriting the layers that 
+     guessed wrong, only worth it when the chunks really run at once */
+    if(scheduler.parallel() && !binary) {
+        if(grueCfg.get_doAnchor() && begin != end)
+            writeAnchor(gout, *begin);
+        writeSlicesInParallel(gout, layerpaths, begin, end, scheduler);
+    } else {
+        size_t layerSequence = 0;
+        for (LayerPaths::layer_iterator it = begin;
+                it != end; ++it, ++layerSequence) {
+            tick();
+            if(grueCfg.get_doAnchor() && layerSequence == 0)
+                writeAnchor(gout, *it);
+            writeSlice(gout, layerpaths, it, layerSequence);
         }
-        writeSlice(gout, layerpaths, it, layerSequence);
     }
+    endGcodeFile(gout);
+}
+
+void GCoder::beginGcodeFile(std::ostream& gout, const std::string& title, 
+        size_t layerCount) {
+    if(grueCfg.get_outputFormat() == GrueConfig::OUTPUT_X3G) {
+        const Scalar stepsPerMm[S3gWriter::AXES] = {
+            grueCfg.get_xStepsPerMm(), grueCfg.get_yStepsPerMm(), 
+            grueCfg.get_zStepsPerMm(), grueCfg.get_aStepsPerMm(), 
+            grueCfg.get_bStepsPerMm()};
+        delete binary;
+        binary = new S3gWriter(gout, stepsPerMm);
+    }
+    gantry.setBinary(binary);
+    writeStartDotGCode(gout, title.c_str());
+    if(grueCfg.get_doRelativeE())
+        writeExtrusionMode(gout, true);
+    progressTotal = 1;
+    progressCurrent = 0;
+    progressPercent = 0;
+    initProgress("gcode", layerCount);
+    layerDurations.clear();
+    printDuration = 0;
+    arcFitter.reset();
+    streamLayerCount = layerCount;
+    streamLayersWritten = 0;
+}
+
+void GCoder::writeLayer(std::ostream& gout, LayerPaths& layerpaths, 
+        LayerPaths::layer_iterator layer) {
+    tick();
+    //whole layers give the progress, the points of this one how far 
+    //into it we are
+    const unsigned int points = std::max(1u, layerPointCount(*layer));
+    progressTotal = std::max<size_t>(1, streamLayerCount) * points;
+    progressCurrent = streamLayersWritten * points;
+    if(grueCfg.get_doAnchor() && streamLayersWritten == 0)
+        writeAnchor(gout, *layer);
+    writeSlice(gout, layerpaths, layer, streamLayersWritten);
+    ++streamLayersWritten;
+    //whoever reads the file sees each layer as soon as it is written
+    gout.flush();
+}
+
+void GCoder::endGcodeFile(std::ostream& gout) {
+    writePrintDuration(gout);
+    if(grueCfg.get_doArcFitting() && !binary)
+        writeArcFitting(gout);
     if(grueCfg.get_doFanCommand()) {
         //print command to disable fan
-        if (grueCfg.get_weightedFanCommand() != -1)
-            gout << "M106 S0";
-        else 
-            gout << "M127 T" << grueCfg.get_defaultExtruder();
-        
-        gout << " " << grueCfg.get_commentOpen()
-             << "Turn off the fan"
-             << grueCfg.get_commentClose() << endl;
+        if (binary) {
+            binary->setFan(grueCfg.get_defaultExtruder(), false);
+        } else {
+            if (grueCfg.get_weightedFanCommand() != -1)
+                gout << "M106 S0";
+            else 
+                gout << "M127 T" << grueCfg.get_defaultExtruder();
+            
+            if (doComments(GrueConfig::COMMENT_LAYER))
+                gout << " " << grueCfg.get_commentOpen()
+                     << "Turn off the fan"
+                     << grueCfg.get_commentClose();
+            gout << '\n';
+        }
     }
+    if(grueCfg.get_doRelativeE())
+        writeExtrusionMode(gout, false);
     writeEndDotGCode(gout);
+    delete binary;
+    binary = NULL;
+    gantry.setBinary(NULL);
+}
+
+void GCoder::writeAnchor(std::ostream& gout, const LayerPaths::Layer& layer) {
+    Extrusion strusion;
+    PathLabel slabel(PathLabel::TYP_CONNECTION, PathLabel::OWN_MODEL, 0);
+    const Extruder& struder = grueCfg.get_extruders()[
+            layer.extruders.front().extruderId];
+    calcExtrusion(struder.id, 0, slabel, strusion);
+    gantry.set_current_extruder_index(struder.code);
+    Point2Type startPoint;
+    if(!layer.extruders.empty() && 
+            !layer.extruders.front().paths.empty() && 
+            !layer.extruders.front().paths.front().myPath.empty()) {
+        startPoint = *(layer.extruders.front().paths.front().myPath.fromStart());
+    }
+    gantry.snort(gout, struder, 
+            strusion);
+    //Apply firstLayerZ to anchor too!
+    const Scalar currentZ = layer.layerZ + layer.layerHeight + 
+            grueCfg.get_firstLayerZ();
+    const Scalar currentH = layer.layerHeight;
+    Scalar currentW = layer.layerW;
+    if(!grueCfg.get_doRaft()) {
+        currentW *= 2.0;
+    }
+    gantry.g1(gout, struder, 
+            strusion, grueCfg.get_startingX(), 
+            grueCfg.get_startingY(), currentZ, 
+            strusion.feedrate, 
+            currentH, currentW, 
+            comment(GrueConfig::COMMENT_PATH, "Anchor Start"));
+    gantry.squirt(gout, struder, 
+            strusion);
+    gantry.g1(gout, struder, 
+            strusion, grueCfg.get_startingX(), 
+            grueCfg.get_startingY(), currentZ, 
+            strusion.feedrate, 
+            currentH, currentW, 
+            comment(GrueConfig::COMMENT_PATH, "Anchor Start"));
+    gantry.g1(gout, struder, 
+            strusion, startPoint.x, startPoint.y, currentZ, 
+            strusion.feedrate, 
+            currentH, currentW, 
+            comment(GrueConfig::COMMENT_PATH, "Anchor End"));
+}
+
+/// one layer of gcode formatted ahead of time by writeSlicesInParallel
+class FormattedLayer {
+public:
+    FormattedLayer() : ready(false), entryPercent(0), exitCurrent(0), 
+            exitPercent(0), duration(0) {}
+    bool ready;
+    Gantry::State entry;
+    unsigned int entryPercent;
+    Gantry::State exit;
+    unsigned int exitCurrent;
+    unsigned int exitPercent;
+    std::string text;
+    Gantry::DeferredE extrusion;
+    Scalar duration;
+    ArcFitter arcs;
+};
+
+/* Layers are formatted by a GCoder of their own starting from the state 
+ of the wave, with extruder positions left out. The first layer of a 
+ chunk other than the first guesses where the gantry will be by 
+ formatting the layer below it once more and throwing the text away. */
+class GCoder::ChunkFormatter {
+public:
+    ChunkFormatter(const GCoder& owner, const std::ostream& format, 
+            LayerPaths& paths, 
+            const std::vector<LayerPaths::layer_iterator>& waveLayers, 
+            const std::vector<unsigned int>& points, size_t first, 
+            std::vector<FormattedLayer>& results) 
+            : gcoder(owner), gout(format), layerpaths(paths), 
+            layers(waveLayers), pointsBefore(points), waveBegin(first), 
+            formatted(results), waveState(owner.gantry.getState()), 
+            wavePercent(owner.progressPercent) {}
+    void operator()(size_t chunkBegin, size_t chunkEnd, size_t) {
+        GCoder worker(gcoder.grueCfg);
+        worker.progressTotal = gcoder.progressTotal;
+        worker.progressPercent = wavePercent;
+        worker.gantry.setState(waveState);
+        Gantry::DeferredE scratchExtrusion;
+        worker.gantry.deferE(&scratchExtrusion);
+        try {
+            if (chunkBegin > waveBegin) {
+                std::ostringstream scratch;
+                scratch.copyfmt(gout);
+                worker.progressCurrent = pointsBefore[chunkBegin - 1];
+                worker.writeSlice(scratch, layerpaths, 
+                        layers[chunkBegin - 1], chunkBegin - 1);
+            }
+            for (size_t layer = chunkBegin; layer < chunkEnd; ++layer) {
+                FormattedLayer& result = formatted[layer - waveBegin];
+                result.entry = worker.gantry.getState();
+                result.entryPercent = worker.progressPercent;
+                worker.progressCurrent = pointsBefore[layer];
+                worker.layerDurations.clear();
+                worker.arcFitter.reset();
+                worker.gantry.deferE(&result.extrusion);
+                std::ostringstream text;
+                text.copyfmt(gout);
+                worker.writeSlice(text, layerpaths, layers[layer], layer);
+                result.text = text.str();
+                result.exit = worker.gantry.getState();
+                result.exitCurrent = worker.progressCurrent;
+                result.exitPercent = worker.progressPercent;
+                result.duration = worker.layerDurations.back();
+                result.arcs = worker.arcFitter;
+                result.ready = true;
+            }
+        } catch (const std::exception&) {
+            //the layers left unformatted are written again when joined, 
+            //where the error surfaces as it would without threads
+        }
+    }
+private:
+    const GCoder& gcoder;
+    const std::ostream& gout;
+    LayerPaths& layerpaths;
+    const std::vector<LayerPaths::layer_iterator>& layers;
+    const std::vector<unsigned int>& pointsBefore;
+    size_t waveBegin;
+    std::vector<FormattedLayer>& formatted;
+    Gantry::State waveState;
+    unsigned int wavePercent;
+};
+
+void GCoder::writeSlicesInParallel(std::ostream& gout, 
+        LayerPaths& layerpaths, 
+        LayerPaths::layer_iterator begin, 
+        LayerPaths::layer_iterator end, 
+        TaskScheduler& scheduler) {
+    std::vector<LayerPaths::layer_iterator> layers;
+    //progressCurrent when each layer starts
+    std::vector<unsigned int> pointsBefore;
+    unsigned int points = progressCurrent;
+    for (LayerPaths::layer_iterator it = begin; it != end; ++it) {
+        layers.push_back(it);
+        pointsBefore.push_back(points);
+        points += layerPointCount(*it);
+    }
+    const size_t layerCount = layers.size();
+    const size_t waveLayers = scheduler.threadCount() * GCODE_CHUNK_LAYERS;
+    size_t rewritten = 0;
+    /* Layers are formatted a wave at a time, in contiguous chunks. Inside 
+     a chunk every layer starts where the previous one ended, like the 
+     serial case. Joining in order checks each guess, fills in the 
+     extruder positions, and writes any layer that guessed wrong again. */
+    for (size_t waveBegin = 0; waveBegin < layerCount; 
+            waveBegin += waveLayers) {
+        const size_t waveEnd = std::min(layerCount, waveBegin + waveLayers);
+        const size_t chunkCount = (waveEnd - waveBegin + 
+                GCODE_CHUNK_LAYERS - 1) / GCODE_CHUNK_LAYERS;
+        std::vector<FormattedLayer> formatted(waveEnd - waveBegin);
+        ChunkFormatter formatter(*this, gout, layerpaths, layers, 
+                pointsBefore, waveBegin, formatted);
+        scheduler.parallelFor(waveBegin, waveEnd, chunkCount, formatter);
+        for (size_t layer = waveBegin; layer < waveEnd; ++layer) {
+            tick();
+            const FormattedLayer& result = formatted[layer - waveBegin];
+            if (!result.ready || result.entryPercent != progressPercent || 
+                    !result.entry.sameMotion(gantry.getState())) {
+                ++rewritten;
+                writeSlice(gout, layerpaths, layers[layer], layer);
+                continue;
+            }
+            gantry.writeDeferred(gout, result.text, result.extrusion);
+            Gantry::State exit = result.exit;
+            exit.a = gantry.get_a();
+            exit.b = gantry.get_b();
+            gantry.setState(exit);
+            progressCurrent = result.exitCurrent;
+            progressPercent = result.exitPercent;
+            layerDurations.push_back(result.duration);
+            printDuration += result.duration;
+            arcFitter.merge(result.arcs);
+        }
+    }
+    Log::fine() << "Gcode: " << layerCount << " layers on " << 
+            scheduler.threadCount() << " threads, " << rewritten << 
+            " written again" << endl;
+}
+
+void GCoder::writeExtrusionMode(std::ostream& ss, bool relative) {
+    //x3g positions are always absolute
+    if (binary)
+        return;
+    ss << (relative ? "M83" : "M82");
+    if (doComments(GrueConfig::COMMENT_LAYER))
+        ss << " " << grueCfg.get_commentOpen()
+           << (relative ? "relative" : "absolute") << " extrusion"
+           << grueCfg.get_commentClose();
+    ss << '\n';
 }
 
 Point2Type GCoder::startPoint(const SliceData& sliceData) {
@@ -344,39 +620,51 @@ void GCoder::writeSlice(std::ostream& ss,
         LayerPaths& layerpaths,
         LayerPaths::layer_iterator layerIter,
         size_t layerSequence) {
+    StageTimer::Event layerTrace("layer", int(layerSequence));
     LayerPaths::Layer& currentLayer = *layerIter;
     unsigned int extruderCount = currentLayer.extruders.size();
 
-    ss << grueCfg.get_commentOpen()
-       << "Slice " << layerSequence << ", " << extruderCount
-       << " " << plural("Extruder", extruderCount)
-       << grueCfg.get_commentClose() << endl;
+    if (doComments(GrueConfig::COMMENT_LAYER)) {
+        ss << grueCfg.get_commentOpen()
+           << "Slice " << layerSequence << ", " << extruderCount
+           << " " << plural("Extruder", extruderCount)
+           << grueCfg.get_commentClose() << '\n';
 
-    ss << grueCfg.get_commentOpen()
-       << "Layer Height: \t" << layerIter->layerHeight
-       << grueCfg.get_commentClose() << endl;
+        ss << grueCfg.get_commentOpen()
+           << "Layer Height: \t" << layerIter->layerHeight
+           << grueCfg.get_commentClose() << '\n';
 
-    ss << grueCfg.get_commentOpen()
-       << "Layer Width: \t" << layerIter->layerW
-       << grueCfg.get_commentClose() << endl;
+        ss << grueCfg.get_commentOpen()
+           << "Layer Width: \t" << layerIter->layerW
+           << grueCfg.get_commentClose() << '\n';
+    }
 
-    if (grueCfg.get_doPrintLayerMessages()) {
+    if (grueCfg.get_doPrintLayerMessages() && !binary) {
         //print layer message to printer screen if config enabled
         ss << "M70 P20 " << grueCfg.get_commentOpen()
            << "Layer: " << layerSequence 
-           << grueCfg.get_commentClose() << endl;
+           << grueCfg.get_commentClose() << '\n';
     }
     if (grueCfg.get_doFanCommand()&& layerSequence == grueCfg.get_fanLayer()) {
         //print command to enable fan
-        if (grueCfg.get_weightedFanCommand() != -1)
-            ss << "M106 S" << grueCfg.get_weightedFanCommand();
-        else 
-            ss << "M126 T" << grueCfg.get_defaultExtruder();
-        
-        ss << " " << grueCfg.get_commentOpen()
-           << "Turn on the fan"
-           << grueCfg.get_commentClose() << endl;
+        if (binary) {
+            //x3g fans are on or off
+            binary->setFan(grueCfg.get_defaultExtruder(), 
+                    grueCfg.get_weightedFanCommand() != 0);
+        } else {
+            if (grueCfg.get_weightedFanCommand() != -1)
+                ss << "M106 S" << grueCfg.get_weightedFanCommand();
+            else 
+                ss << "M126 T" << grueCfg.get_defaultExtruder();
+            
+            if (doComments(GrueConfig::COMMENT_LAYER))
+                ss << " " << grueCfg.get_commentOpen()
+                   << "Turn on the fan"
+                   << grueCfg.get_commentClose();
+            ss << '\n';
+        }
     }
+    Scalar layerDuration = 0;
     //iterate over all extruders invoked in this layer
     for (LayerPaths::Layer::const_extruder_iterator it =
             currentLayer.extruders.begin();
@@ -384,6 +672,9 @@ void GCoder::writeSlice(std::ostream& ss,
             ++it) {
         //this is the current extruder
         const Extruder& currentExtruder = grueCfg.get_extruders()[it->extruderId];
+        if (binary && 
+                currentExtruder.code != gantry.get_current_extruder_code())
+            binary->changeTool(currentExtruder.id);
         gantry.set_current_extruder_index(currentExtruder.code);
         //this is the current extruder's zFeedrate
         Scalar zFeedrate = grueCfg.get_scalingFactor() *
@@ -393,6 +684,8 @@ void GCoder::writeSlice(std::ostream& ss,
                 + grueCfg.get_firstLayerZ();
         const Scalar currentH = currentLayer.layerHeight;
         const Scalar currentW = currentLayer.layerW;
+        layerDuration += fabs(currentZ - gantry.get_z()) / 
+                grueCfg.get_rapidMoveFeedRateZ();
         try {
             moveZ(ss, currentZ, currentExtruder.id, zFeedrate);
         } catch (GcoderException& mixup) {
@@ -401,22 +694,75 @@ void GCoder::writeSlice(std::ostream& ss,
                     " : " << mixup.error << endl;
         }
         Scalar feedScale = 1.0;
+        Scalar duration = calcPaths(layerSequence, currentExtruder, it->paths);
         bool calculateSlowing = !grueCfg.get_doRaft() || 
                 layerSequence >= grueCfg.get_raftLayers();
         if(calculateSlowing) {
-            Scalar duration = calcPaths(layerSequence, currentExtruder, it->paths);
             if(duration < grueCfg.get_minLayerDuration()) {
-                feedScale = duration / grueCfg.get_minLayerDuration();
-                feedScale = std::max(feedScale, grueCfg.get_minSpeedMultiplier());
+                feedScale = calcSlowing(layerSequence, currentExtruder, 
+                        it->paths, duration);
                 int speedDecrease(feedScale * 100);
-                ss << grueCfg.get_commentOpen()
-                   << "Slowing to " << speedDecrease << "% of nominal speeds" 
-                   << grueCfg.get_commentClose() << std::endl;
+                if (doComments(GrueConfig::COMMENT_LAYER))
+                    ss << grueCfg.get_commentOpen()
+                       << "Slowing to " << speedDecrease 
+                       << "% of nominal speeds" 
+                       << grueCfg.get_commentClose() << '\n';
+                duration = calcPaths(layerSequence, currentExtruder, 
+                        it->paths, feedScale);
             }
         }
+        layerDuration += duration;
         writePaths(ss, currentZ, currentH, currentW, layerSequence,
                 currentExtruder, it->paths, feedScale);
     }
+    if (doComments(GrueConfig::COMMENT_LAYER))
+        ss << grueCfg.get_commentOpen()
+           << "Estimated layer time: " << layerDuration << "s"
+           << grueCfg.get_commentClose() << '\n';
+    layerDurations.push_back(layerDuration);
+    printDuration += layerDuration;
+}
+
+void GCoder::writePrintDuration(std::ostream& ss) {
+    if (doComments(GrueConfig::COMMENT_LAYER))
+        ss << grueCfg.get_commentOpen()
+           << "Estimated print time: " << printDuration << "s"
+           << grueCfg.get_commentClose() << '\n';
+    Log::info() << "Estimated print time: " << printDuration << "s over " 
+            << layerDurations.size() << " layers" << endl;
+    Json::Value msg(Json::objectValue);
+    msg["type"] = "printTime";
+    msg["totalSeconds"] = printDuration;
+    Json::Value layers(Json::arrayValue);
+    for(std::vector<Scalar>::const_iterator iter = layerDurations.begin(); 
+            iter != layerDurations.end(); 
+            ++iter) {
+        layers.append(*iter);
+    }
+    msg["layerSeconds"] = layers;
+    report(msg);
+}
+
+void GCoder::writeArcFitting(std::ostream& ss) {
+    if (doComments(GrueConfig::COMMENT_LAYER))
+        ss << grueCfg.get_commentOpen()
+           << "Arc fitting: " << arcFitter.movesIn() << " moves written as " 
+           << arcFitter.movesOut() << ", max deviation " 
+           << arcFitter.maxDeviation() << "mm"
+           << grueCfg.get_commentClose() << '\n';
+    Log::info() << "Arc fitting: " << arcFitter.arcs() << " arcs, " 
+            << arcFitter.movesIn() << " moves written as " 
+            << arcFitter.movesOut() << " (" << arcFitter.compression() 
+            << ":1), max deviation " << arcFitter.maxDeviation() << "mm" 
+            << endl;
+    Json::Value msg(Json::objectValue);
+    msg["type"] = "arcFitting";
+    msg["arcs"] = static_cast<Json::UInt>(arcFitter.arcs());
+    msg["movesIn"] = static_cast<Json::UInt>(arcFitter.movesIn());
+    msg["movesOut"] = static_cast<Json::UInt>(arcFitter.movesOut());
+    msg["compression"] = arcFitter.compression();
+    msg["maxDeviation"] = arcFitter.maxDeviation();
+    report(msg);
 }
 
 Scalar Extrusion::crossSectionArea(Scalar height, Scalar width) const {
@@ -441,58 +787,60 @@ Scalar Extruder::feedCrossSectionArea() const {
  * @param sourceName - Name of source of this model. Usually the original .stl filename
  */
 void GCoder::writeGCodeConfig(std::ostream &ss, const char* title = "unknown source") const {
+    if (!doComments(GrueConfig::COMMENT_LAYER))
+        return;
     std::string indent = "* ";
-    ss << endl;
+    ss << '\n';
 
     ss << grueCfg.get_commentOpen()
        << "Makerbot Industries"
-       << grueCfg.get_commentClose() << endl;
+       << grueCfg.get_commentClose() << '\n';
 
     ss << grueCfg.get_commentOpen()
        << "This file contains digital fabrication directives in gcode format"
-       << grueCfg.get_commentClose() << endl;
+       << grueCfg.get_commentClose() << '\n';
 
     ss << grueCfg.get_commentOpen()
        << "For your 3D printer"
-       << grueCfg.get_commentClose() << endl;
+       << grueCfg.get_commentClose() << '\n';
 
     ss << grueCfg.get_commentOpen()
        << "http://wiki.makerbot.com/gcode"
-       << grueCfg.get_commentClose() << endl;
+       << grueCfg.get_commentClose() << '\n';
 
     MyComputer hal9000;
 
     ss << grueCfg.get_commentOpen()
        << indent << "Generated by " << getMiracleGrueProgramName()
        << " " << getMiracleGrueVersionStr()
-       << grueCfg.get_commentClose() << endl;
+       << grueCfg.get_commentClose() << '\n';
 
     ss << grueCfg.get_commentOpen()
        << indent << hal9000.clock.now()
-       << grueCfg.get_commentClose() << endl;
+       << grueCfg.get_commentClose() << '\n';
 
     ss << grueCfg.get_commentOpen()
        << indent << title
-       << grueCfg.get_commentClose() << endl;
+       << grueCfg.get_commentClose() << '\n';
 
     std::string plurial = grueCfg.get_extruders().size() ? "" : "s";
 
     ss << grueCfg.get_commentOpen()
        << indent << grueCfg.get_extruders().size() << " extruder" << plurial
-       << grueCfg.get_commentClose() << endl;
+       << grueCfg.get_commentClose() << '\n';
 
     ss << grueCfg.get_commentOpen()
        << indent << "Extrude infills: " << grueCfg.get_doInfills()
-       << grueCfg.get_commentClose() << endl;
+       << grueCfg.get_commentClose() << '\n';
 
     ss << grueCfg.get_commentOpen()
        << indent << "Extrude insets: " << grueCfg.get_doInsets()
-       << grueCfg.get_commentClose() << endl;
+       << grueCfg.get_commentClose() << '\n';
 
     ss << grueCfg.get_commentOpen()
        << indent << "Extrude outlines: " << grueCfg.get_doOutlines()
-       << grueCfg.get_commentClose() << endl;
-    ss << endl;
+       << grueCfg.get_commentClose() << '\n';
+    ss << '\n';
 }
 
 }
@@ -14,16 +14,23 @@
 #define GCODER_H_
 
 #include <map>
+#include <cstring>
 #include "configuration.h"
 #include "mgl.h"
 #include "pather.h"
 
 
+#include "arc_fitter.h"
 #include "gcoder_gantry.h"
+#include "gcoder_writer.h"
+#include "motion_model.h"
+#include "s3g_writer.h"
 #include "log.h"
 
 namespace mgl {
 
+class TaskScheduler;
+
 class GcoderException : public Exception {
 public:
     template <typename T>
@@ -90,6 +97,7 @@ public:
     unsigned int progressPercent;
 
     GCoder(const GrueConfig& grueConf, ProgressBar* progress = NULL);
+    ~GCoder();
 
     /// shortcut for doing a G1 that only move Z
     void moveZ(std::ostream & ss, Scalar z,
@@ -114,6 +122,21 @@ public:
             LayerPaths::layer_iterator begin,
             LayerPaths::layer_iterator end);
     
+    /**
+     @brief Write a file one layer at a time, as layers become available.
+     
+     beginGcodeFile writes the start of the file, writeLayer each layer 
+     in order, and endGcodeFile the end. Progress goes by layers, so 
+     @a layerCount layers must be written in between.
+     */
+    void beginGcodeFile(std::ostream& gout, const std::string& title, 
+            size_t layerCount);
+    /// write @a layer, the next one after those already written
+    void writeLayer(std::ostream& gout, LayerPaths& layerpaths, 
+            LayerPaths::layer_iterator layer);
+    /// see beginGcodeFile
+    void endGcodeFile(std::ostream& gout);
+    
     /**
      @brief Calculate a profile given all parameters, and indicate if this 
      path should be printed
@@ -139,6 +162,8 @@ public:
     
     void writeProgressPercent(std::ostream& ss, unsigned int current, 
             unsigned int total);
+    /// switch the printer between relative and absolute extrusion
+    void writeExtrusionMode(std::ostream& ss, bool relative);
 
 
     // todo: return the gCoderCfg instead
@@ -150,8 +175,27 @@ public:
             LayerPaths& layerpaths,
             LayerPaths::layer_iterator layerIter,
             size_t layerSequence);
+    
+    /// true if comments of @a level should be written
+    bool doComments(GrueConfig::CommentLevel level) const {
+        return !binary && grueCfg.doComments(level);
+    }
+    /// @a text if comments of @a level should be written, else NULL
+    const char* comment(GrueConfig::CommentLevel level, 
+            const char* text) const {
+        return binary ? NULL : grueCfg.comment(level, text);
+    }
+    
+    /// estimated time in seconds of each layer written so far
+    const std::vector<Scalar>& getLayerDurations() const {
+        return layerDurations;
+    }
+    /// estimated time in seconds of everything written so far
+    Scalar getPrintDuration() const { return printDuration; }
 
 private:
+    GCoder(const GCoder&);
+    GCoder& operator =(const GCoder&);
 
     void writeGCodeConfig(std::ostream & ss, const char* filename) const;
     template <typename PATH>
@@ -169,31 +213,84 @@ private:
             const LABELEDPATHS<LabeledOpenPath, ALLOC>& labeledPaths, 
             Scalar feedScale = 1.0);
     /**
-     @brief approximate how long it would take to extrude this path using 
-     the extrusion profile given
+     @brief queue the moves writePath would make for this path 
+     in @a planner, including the travel and retractions to reach it
      @param PATH the type of path
+     @param planner accumulates the moves
+     @param extruder the current extruder
      @param extrusion the profile
      @param path the path
-     @return Approximate time in seconds for this path
+     @param feedScale what writePath would scale the feedrate by
      */
     template <typename PATH>
-    Scalar calcPath(const Extrusion& extrusion, 
-            const PATH& path);
+    void calcPath(MotionPlanner& planner, 
+            const Extruder& extruder, 
+            const Extrusion& extrusion, 
+            const PATH& path, 
+            Scalar feedScale = 1.0);
     /**
-     @brief invoke calcPath on each element in @a labeledPaths and return 
-     the sum of the results
+     @brief invoke calcPath on each element in @a labeledPaths, skipping 
+     the same paths as writePaths, and plan the resulting moves
      @param LABELEDPATHS the type of collection we're using (STL collections)
      @param ALLOC the type of allocator @a LABELEDPATHS uses
      @param layerSequence the number of the current layer
      @param extruder the current extruder to use
      @param labeledPaths the paths for which to calculate things
+     @param feedScale what writePaths would scale the feedrate by
+     @return Approximate time in seconds to print @a labeledPaths 
+     starting from the current gantry position
      */
     template <template <class, class> class LABELEDPATHS, class ALLOC>
     Scalar calcPaths(size_t layerSequence, 
             const Extruder& extruder, 
-            const LABELEDPATHS<LabeledOpenPath, ALLOC>& labeledPaths);
+            const LABELEDPATHS<LabeledOpenPath, ALLOC>& labeledPaths, 
+            Scalar feedScale = 1.0);
+    /**
+     @brief find the feedrate scale that makes @a labeledPaths take at 
+     least minLayerDuration, but no less than minSpeedMultiplier
+     @param duration the time of @a labeledPaths at full speed
+     @return the scale to pass to writePaths
+     */
+    template <template <class, class> class LABELEDPATHS, class ALLOC>
+    Scalar calcSlowing(size_t layerSequence, 
+            const Extruder& extruder, 
+            const LABELEDPATHS<LabeledOpenPath, ALLOC>& labeledPaths, 
+            Scalar duration);
+    
+    /// prime the nozzle along a line at the start of @a layer
+    void writeAnchor(std::ostream& gout, const LayerPaths::Layer& layer);
+    /**
+     @brief writeSlice for each layer from @a begin to @a end, formatting 
+     them on the threads of @a scheduler
+     
+     The file comes out the same as writing the layers one by one.
+     */
+    void writeSlicesInParallel(std::ostream& gout, 
+            LayerPaths& layerpaths, 
+            LayerPaths::layer_iterator begin, 
+            LayerPaths::layer_iterator end, 
+            TaskScheduler& scheduler);
+    /// formats a run of layers for writeSlicesInParallel
+    class ChunkFormatter;
+    
+    /// write the time estimates as a comment, the log, and a report
+    void writePrintDuration(std::ostream& ss);
+    /// write what arc fitting saved as a comment, the log, and a report
+    void writeArcFitting(std::ostream& ss);
 
     Point2Type startPoint(const SliceData &sliceData);
+    
+    std::vector<Scalar> layerDurations;
+    Scalar printDuration;
+    ArcFitter arcFitter;
+    //scratch space for fitting arcs to a path
+    std::vector<Point2Type> arcPoints;
+    std::vector<ArcFitter::Piece> arcPieces;
+    //where commands go while writing x3g, NULL while writing gcode
+    S3gWriter* binary;
+    //layers announced to beginGcodeFile, and how many are written
+    size_t streamLayerCount;
+    size_t streamLayersWritten;
     // void writeWipeExtruder(std::ostream& ss, int extruderId) const {};
 };
 
@@ -220,18 +317,84 @@ void GCoder::writePath(std::ostream& ss,
                 grueCfg.get_rapidMoveFeedRateXY() *
                 grueCfg.get_scalingFactor(),
                 0, 0,
-                "move into position");
+                comment(GrueConfig::COMMENT_PATH, "move into position"));
     }
     gantry.squirt(ss, extruder, extrusion);
+    const bool moveComments = doComments(GrueConfig::COMMENT_MOVE);
+    char comment[40];
+    if (grueCfg.get_doArcFitting() && !binary) {
+        arcPoints.clear();
+        for (typename PATH::const_iterator point = path.fromStart(); 
+                point != path.end(); 
+                ++point)
+            arcPoints.push_back(*point);
+        arcFitter.fit(arcPoints, arcPieces);
+        size_t start = 0;
+        for (std::vector<ArcFitter::Piece>::const_iterator piece = 
+                arcPieces.begin(); 
+                piece != arcPieces.end(); 
+                start = piece->end, ++piece) {
+            const Point2Type& to = arcPoints[piece->end];
+            if (piece->isArc && 
+                    !gantry.arcFits(to.x, to.y, piece->center)) {
+                //the gantry is off the arc's start, so its I and J would 
+                //give another radius than its end; keep the segments
+                for (size_t i = start + 1; i <= piece->end; ++i) {
+                    const Point2Type& point = arcPoints[i];
+                    if(moveComments) {
+                        Scalar distance = (point - last).magnitude();
+                        strcpy(comment, "d: ");
+                        comment[3 + formatScalar(comment + 3, 
+                                sizeof(comment) - 4, distance, 6, 
+                                false)] = '\0';
+                    }
+                    gantry.g1(ss, extruder, extrusion,
+                            point.x, point.y, z,
+                            extrusion.feedrate * feedScale, h, w, 
+                            moveComments ? comment : NULL);
+                    last = point;
+                }
+            } else if (piece->isArc) {
+                if(moveComments) {
+                    Scalar radius = (to - piece->center).magnitude();
+                    strcpy(comment, "r: ");
+                    comment[3 + formatScalar(comment + 3, 
+                            sizeof(comment) - 4, radius, 6, false)] = '\0';
+                }
+                gantry.arc(ss, extruder, extrusion, to.x, to.y, z, 
+                        piece->center, piece->clockwise, 
+                        extrusion.feedrate * feedScale, h, w, 
+                        moveComments ? comment : NULL);
+            } else {
+                if(moveComments) {
+                    Scalar distance = (to - last).magnitude();
+                    strcpy(comment, "d: ");
+                    comment[3 + formatScalar(comment + 3, 
+                            sizeof(comment) - 4, distance, 6, false)] = '\0';
+                }
+                gantry.g1(ss, extruder, extrusion,
+                        to.x, to.y, z,
+                        extrusion.feedrate * feedScale, h, w, 
+                        moveComments ? comment : NULL);
+            }
+            last = to;
+        }
+        return;
+    }
     for (; current != path.end(); ++current) {
         Point2Type relative = (*current) - last;
 
-        std::stringstream comment;
-        Scalar distance = relative.magnitude();
-        comment << "d: " << distance;
+        if(moveComments) {
+            //formatted like a default stream, without allocating one
+            Scalar distance = relative.magnitude();
+            strcpy(comment, "d: ");
+            comment[3 + formatScalar(comment + 3, sizeof(comment) - 4, 
+                    distance, 6, false)] = '\0';
+        }
         gantry.g1(ss, extruder, extrusion,
                 current->x, current->y, z,
-                extrusion.feedrate * feedScale, h, w, comment.str().c_str());
+                extrusion.feedrate * feedScale, h, w, 
+                moveComments ? comment : NULL);
         last = *current;
     }
 }
@@ -270,46 +433,85 @@ void GCoder::writePaths(std::ostream& ss,
         }
     }
     gantry.snort(ss, extruder, fluidstrusion);
-    ss << std::endl << std::endl;
+    if (!binary)
+        ss << '\n' << '\n';
 }
 
 template <typename PATH>
-Scalar GCoder::calcPath(const Extrusion& extrusion, const PATH& path) {
+void GCoder::calcPath(MotionPlanner& planner, const Extruder& extruder, 
+        const Extrusion& extrusion, const PATH& path, Scalar feedScale) {
     typedef typename PATH::const_iterator const_iterator;
-    if(path.empty())
-        return 0;
+    if(path.size() < 2)
+        return;
     const_iterator current = path.fromStart();
-    Point2Type lastPoint = *current;
-    Scalar accum = 0;
+    //travel moves retract, so they start and end at rest
+    if((planner.position() - *current).magnitude() >= 
+            grueCfg.get_coarseness()) {
+        Scalar retractTime = extruder.retractDistance / extruder.retractRate;
+        planner.dwell(retractTime);
+        planner.stop();
+        planner.moveTo(*current, grueCfg.get_rapidMoveFeedRateXY());
+        planner.stop();
+        planner.dwell(retractTime + extruder.restartExtraDistance / 
+                extruder.retractRate);
+    }
+    //feedrates are scaled for the gcode, the planner works in mm/s
+    Scalar speed = extrusion.feedrate * feedScale / 
+            grueCfg.get_scalingFactor();
     for(++current; current != path.end(); ++current) {
-        //distance in mm
-        Scalar distance = Point2Type((*current) - lastPoint).magnitude();
-        lastPoint = *current;
-        //time in seconds
-        Scalar time = (distance / extrusion.feedrate) * grueCfg.get_scalingFactor();
-        accum += time;
+        planner.moveTo(*current, speed);
     }
-    return accum;
 }
 
 template <template <class, class> class LABELEDPATHS, class ALLOC>
 Scalar GCoder::calcPaths(size_t layerSequence, const Extruder& extruder, 
-        const LABELEDPATHS<LabeledOpenPath,ALLOC>& labeledPaths) {
+        const LABELEDPATHS<LabeledOpenPath,ALLOC>& labeledPaths, 
+        Scalar feedScale) {
     typedef typename LABELEDPATHS<LabeledOpenPath, ALLOC>::const_iterator 
             const_iterator;
-    Scalar accum = 0;
+    MotionPlanner planner((MotionModel(grueCfg)));
+    planner.reset(Point2Type(gantry.get_x(), gantry.get_y()));
+    bool didLastPath = true;
     for(const_iterator iter = labeledPaths.begin(); 
             iter != labeledPaths.end(); 
             ++iter) {
         Extrusion extrusion;
-        if(calcExtrusion(extruder.id, layerSequence, iter->myLabel, 
-                extrusion)) {
-            accum += calcPath(extrusion, iter->myPath);
+        bool doCurrentPath = calcExtrusion(extruder.id, layerSequence, 
+                iter->myLabel, extrusion);
+        if(iter->myLabel.isConnection() && !didLastPath)
+            continue;
+        didLastPath = doCurrentPath;
+        if(doCurrentPath) {
+            calcPath(planner, extruder, extrusion, iter->myPath, feedScale);
         }
     }
-    return accum;
+    return planner.plan();
 }
 
+template <template <class, class> class LABELEDPATHS, class ALLOC>
+Scalar GCoder::calcSlowing(size_t layerSequence, const Extruder& extruder, 
+        const LABELEDPATHS<LabeledOpenPath,ALLOC>& labeledPaths, 
+        Scalar duration) {
+    static const unsigned int SEARCH_STEPS = 8;
+    const Scalar target = grueCfg.get_minLayerDuration();
+    Scalar low = grueCfg.get_minSpeedMultiplier();
+    //scaling a move's feedrate by s makes it take at most 1/s as long, 
+    //so no scale above duration / target can be slow enough
+    Scalar high = std::min(Scalar(1.0), duration / target);
+    if(high <= low || 
+            calcPaths(layerSequence, extruder, labeledPaths, low) <= target)
+        return low;
+    //travel and acceleration do not scale, so search for the fastest 
+    //scale that still takes at least the target
+    for(unsigned int step = 0; step < SEARCH_STEPS; ++step) {
+        Scalar middle = 0.5 * (low + high);
+        if(calcPaths(layerSequence, extruder, labeledPaths, middle) < target)
+            high = middle;
+        else
+            low = middle;
+    }
+    return low;
+}
 
 }
 #endif
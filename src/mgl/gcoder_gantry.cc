@@ -1,5 +1,7 @@
 #include "gcoder_gantry.h"
 #include "gcoder.h"
+#include "gcoder_writer.h"
+#include "s3g_writer.h"
 #include <cmath>
 #include <iostream>
 #include <sstream>
@@ -7,11 +9,19 @@
 namespace mgl {
 
 using std::ostream;
-using std::endl;
 using std::string;
 using std::stringstream;
 
-Gantry::Gantry(const GrueConfig& gCfg) : grueCfg(gCfg) {
+/// @a value rounded to the digits @a format would print it with
+static Scalar roundLikeStream(Scalar value, const std::ios_base& format) {
+	if ((format.flags() & std::ios_base::floatfield) != std::ios_base::fixed)
+		return value;
+	Scalar scale = pow(10.0, static_cast<Scalar>(format.precision()));
+	return floor(value * scale + 0.5) / scale;
+}
+
+Gantry::Gantry(const GrueConfig& gCfg) : grueCfg(gCfg), binary(NULL), 
+		deferred(NULL) {
 	set_current_extruder_index('A');
 	set_extruding(false);
 	init_to_start();
@@ -82,6 +92,7 @@ void Gantry::set_current_extruder_index(unsigned char nab) {
 }
 
 void Gantry::init_to_start() {
+	synced = false;
 	set_x(grueCfg.get_startingX());
 	set_y(grueCfg.get_startingY());
 	set_z(grueCfg.get_startingZ());
@@ -132,23 +143,31 @@ void Gantry::setCurrentE(Scalar e) {
 }
 
 void Gantry::writeSwitchExtruder(ostream& ss, Extruder &extruder) {
+	ab = extruder.code;
+	if (!grueCfg.doComments(GrueConfig::COMMENT_PATH))
+		return;
 	ss << grueCfg.get_commentOpen()
        << " extruder " << extruder.id << " "
-       << grueCfg.get_commentClose() << endl;
+       << grueCfg.get_commentClose() << '\n';
 	ss << grueCfg.get_commentOpen()
        << " GSWITCH T" << extruder.id << " "
-       << grueCfg.get_commentClose() << endl;
+       << grueCfg.get_commentClose() << '\n';
 	ss << grueCfg.get_commentOpen()
        << " TODO: add offset management to Gantry "
-       << grueCfg.get_commentClose() << endl;
-	ab = extruder.code;
-	ss << endl;
+       << grueCfg.get_commentClose() << '\n';
+	ss << '\n';
 }
 
 Scalar Gantry::volumetricE(const Extruder &extruder,
 		const Extrusion &extrusion,
 		Scalar vx, Scalar vy, Scalar /*vz*/,
 		Scalar h, Scalar w) const {
+	return feedLength(extruder, extrusion, vx, vy, h, w) + getCurrentE();
+}
+
+Scalar Gantry::feedLength(const Extruder &extruder,
+		const Extrusion &extrusion,
+		Scalar vx, Scalar vy, Scalar h, Scalar w) const {
 	//There isn't yet a LineSegment3, so for now I'm assuming that only 2d
 	//segments get extruded
 	Segment2Type seg(Point2Type(get_x(), get_y()), Point2Type(vx, vy));
@@ -156,9 +175,7 @@ Scalar Gantry::volumetricE(const Extruder &extruder,
 
 	Scalar feed_cross_area = extruder.feedCrossSectionArea();
 
-	Scalar feed_len = seg_volume / feed_cross_area;
-
-	return feed_len + getCurrentE();
+	return seg_volume / feed_cross_area;
 }
 
 /*if extruder and extrusion are null we don't extrude*/
@@ -168,37 +185,32 @@ void Gantry::g1(std::ostream &ss,
 		Scalar h, Scalar w,
 		const char *comment = NULL) {
 
-	bool doX = true;
-	bool doY = true;
-	bool doZ = true;
-	bool doFeed = true;
+	//in modal mode, only what changed is written
+	bool modal = grueCfg.get_doModalMoves() && synced;
+	bool doX = !modal || !tequals(get_x(), gx, SAMESAME_TOL);
+	bool doY = !modal || !tequals(get_y(), gy, SAMESAME_TOL);
+	bool doZ = !modal || !tequals(get_z(), gz, SAMESAME_TOL);
+	bool doFeed = !modal || !tequals(get_feed(), gfeed, SAMESAME_TOL);
 	bool doE = false;
 	Scalar me = getCurrentE();
+	Scalar feed_len = 0;
 	
 	Point2Type relativeVector(gx - get_x(), gy - get_y());
 
-	if (!tequals(get_x(), gx, SAMESAME_TOL)) {
-		doX = true;
-	}
-	if (!tequals(get_y(), gy, SAMESAME_TOL)) {
-		doY = true;
-	}
-	if (!tequals(get_z(), gz, SAMESAME_TOL)) {
-		doZ = true;
-	}
-	if (!tequals(get_feed(), gfeed, SAMESAME_TOL)) {
-		doFeed = true;
-	}
 	if (get_extruding() && extruder && extrusion &&
 			extruder->isVolumetric()) {
 		doE = true;
-		me = volumetricE(*extruder, *extrusion, gx, gy, gz, h, w);
+		feed_len = feedLength(*extruder, *extrusion, gx, gy, h, w);
+		me = feed_len + getCurrentE();
 		if(tequals(me, getCurrentE(), 0.0) || 
 				relativeVector.magnitude() <= grueCfg.get_coarseness())
 			return;
 	}
+	if (!(doX || doY || doZ || doE || doFeed))
+		return;
 	g1Motion(ss, gx, gy, gz, me, gfeed, h, w, comment,
-			doX, doY, doZ, doE, doFeed);
+			doX, doY, doZ, doE, doFeed, &feed_len, 1);
+	synced = true;
 }
 
 void Gantry::squirt(std::ostream &ss, 
@@ -208,12 +220,16 @@ void Gantry::squirt(std::ostream &ss,
 	if(get_extruding())
 		return;
 	if (extruder.isVolumetric()) {
+		const Scalar addends[] = {
+			extruder.retractDistance, extruder.restartExtraDistance};
 		g1Motion(ss, get_x(), get_y(), get_z(),
 				getCurrentE() + extruder.retractDistance
 				+ extruder.restartExtraDistance, 
                 extruder.retractRate * grueCfg.get_scalingFactor(),
 				FLUID_H, FLUID_W,
-				"squirt", false, false, false, true, true); //only E and F
+				grueCfg.comment(GrueConfig::COMMENT_PATH, "squirt"), 
+				false, false, false, true, true, //only E and F
+				addends, 2);
 	} else {
 		//we don't support RPM anymore
 	}
@@ -228,11 +244,14 @@ void Gantry::snort(std::ostream &ss,
 	if(!get_extruding())
 		return;
 	if (extruder.isVolumetric()) {
+		const Scalar addend = -extruder.retractDistance;
 		g1Motion(ss, get_x(), get_y(), get_z(),
 				getCurrentE() - extruder.retractDistance,
 				extruder.retractRate * grueCfg.get_scalingFactor(), 
-                FLUID_H, FLUID_W, "snort",
-				false, false, false, true, true); //only E and F
+                FLUID_H, FLUID_W, 
+				grueCfg.comment(GrueConfig::COMMENT_PATH, "snort"),
+				false, false, false, true, true, //only E and F
+				&addend, 1);
 	} else {
 		//we don't support RPM anymore
 	}
@@ -243,7 +262,8 @@ void Gantry::snort(std::ostream &ss,
 void Gantry::g1Motion(std::ostream &ss, Scalar mx, Scalar my, Scalar mz,
 		Scalar me, Scalar mfeed, Scalar /*h*/, Scalar /*w*/,
 		const char *g1Comment, bool doX,
-		bool doY, bool doZ, bool doE, bool doFeed) {
+		bool doY, bool doZ, bool doE, bool doFeed, 
+		const Scalar *addends, unsigned int addendCount) {
 
 	// not do something is not an option .. under certain conditions
 #ifdef STRONG_CHECKING
@@ -269,19 +289,22 @@ void Gantry::g1Motion(std::ostream &ss, Scalar mx, Scalar my, Scalar mz,
 		throw mixup;
 	}
 
-	unsigned char ss_axis =
-			(grueCfg.get_useEaxis() ? 'E' :
-			get_current_extruder_code());
+	if (binary) {
+		binaryMotion(mx, my, mz, me, mfeed, doX, doY, doZ, doE);
+		if (doFeed) set_feed(mfeed);
+		return;
+	}
 
-	ss << "G1";
-	if (doX) ss << " X" << mx;
-	if (doY) ss << " Y" << my;
-	if (doZ) ss << " Z" << mz;
-	if (doFeed) ss << " F" << mfeed;
-	if (doE) ss << " " << ss_axis << me;
-	if (g1Comment) ss << " " << grueCfg.get_commentOpen()
+	GCodeLine line(ss);
+	line << "G1";
+	if (doX) line << " X" << mx;
+	if (doY) line << " Y" << my;
+	if (doZ) line << " Z" << mz;
+	if (doFeed) line << " F" << mfeed;
+	if (doE) writeE(line, ss, me, addends, addendCount);
+	if (g1Comment) line << " " << grueCfg.get_commentOpen()
                       << g1Comment << grueCfg.get_commentClose();
-	ss << endl;
+	line.end();
 
 	// if(feed >= 5000) assert(0);
 
@@ -293,6 +316,189 @@ void Gantry::g1Motion(std::ostream &ss, Scalar mx, Scalar my, Scalar mz,
 	if (doE) setCurrentE(me);
 }
 
+bool Gantry::arcFits(Scalar gx, Scalar gy, const Point2Type &center) const {
+	Scalar startRadius = Point2Type(get_x() - center.x, 
+			get_y() - center.y).magnitude();
+	Scalar endRadius = Point2Type(gx - center.x, gy - center.y).magnitude();
+	return fabs(startRadius - endRadius) <= grueCfg.get_arcTolerance();
+}
+
+void Gantry::arc(std::ostream &ss,
+		const Extruder &extruder, const Extrusion &extrusion,
+		Scalar gx, Scalar gy, Scalar gz, const Point2Type &center, 
+		bool clockwise, Scalar gfeed, Scalar h, Scalar w,
+		const char *comment) {
+	if (binary) {
+		GcoderException mixup("Arcs can't be written as x3g");
+		throw mixup;
+	}
+	// the same checks as g1Motion, and the center too
+	bool bad = false;
+	if (fabs(gx) > MUCH_LARGER_THAN_THE_BUILD_PLATFORM_MM) bad = true;
+	if (fabs(gy) > MUCH_LARGER_THAN_THE_BUILD_PLATFORM_MM) bad = true;
+	if (fabs(gz) > MUCH_LARGER_THAN_THE_BUILD_PLATFORM_MM) bad = true;
+	if (fabs(center.x) > MUCH_LARGER_THAN_THE_BUILD_PLATFORM_MM) bad = true;
+	if (fabs(center.y) > MUCH_LARGER_THAN_THE_BUILD_PLATFORM_MM) bad = true;
+	if (gfeed <= 0 || gfeed > 100000) bad = true;
+	if (bad) {
+		stringstream msg;
+		msg << "Illegal arc move where x=" << gx << ", y=" << gy << 
+				", z=" << gz << ", i=" << center.x << ", j=" << center.y << 
+				", feed=" << gfeed;
+		GcoderException mixup(msg.str().c_str());
+		throw mixup;
+	}
+	if (!arcFits(gx, gy, center)) {
+		//strict firmware rejects an arc whose ends are off its circle
+		g1(ss, &extruder, &extrusion, gx, gy, gz, gfeed, h, w, comment);
+		return;
+	}
+	//the angle swept, measured in the direction of travel
+	Point2Type from(get_x() - center.x, get_y() - center.y);
+	Point2Type to(gx - center.x, gy - center.y);
+	Scalar sweep = atan2(from.crossProduct(to), from.dotProduct(to));
+	if (clockwise)
+		sweep = -sweep;
+	if (sweep <= 0)
+		sweep += M_TAU;
+	Scalar length = from.magnitude() * sweep;
+
+	bool modal = grueCfg.get_doModalMoves() && synced;
+	bool doZ = !modal || !tequals(get_z(), gz, SAMESAME_TOL);
+	bool doFeed = !modal || !tequals(get_feed(), gfeed, SAMESAME_TOL);
+	bool doE = get_extruding() && extruder.isVolumetric();
+	Scalar me = getCurrentE();
+	Scalar feed_len = extrusion.crossSectionArea(h, w) * length / 
+			extruder.feedCrossSectionArea();
+	if (doE)
+		me += feed_len;
+
+	GCodeLine line(ss);
+	line << (clockwise ? "G2" : "G3");
+	line << " X" << gx << " Y" << gy;
+	if (doZ) line << " Z" << gz;
+	//the center is given relative to where the arc starts
+	line << " I" << center.x - get_x() << " J" << center.y - get_y();
+	if (doFeed) line << " F" << gfeed;
+	if (doE) writeE(line, ss, me, &feed_len, 1);
+	if (comment) line << " " << grueCfg.get_commentOpen()
+					  << comment << grueCfg.get_commentClose();
+	line.end();
+
+	set_x(gx);
+	set_y(gy);
+	if (doZ) set_z(gz);
+	if (doFeed) set_feed(gfeed);
+	if (doE) setCurrentE(me);
+	synced = true;
+}
+
+void Gantry::binaryMotion(Scalar mx, Scalar my, Scalar mz, Scalar me,
+		Scalar mfeed, bool doX, bool doY, bool doZ, bool doE) {
+	//x3g moves give every axis, in absolute steps
+	Scalar position[S3gWriter::AXES] = {
+		doX ? mx : get_x(), doY ? my : get_y(), doZ ? mz : get_z(), 
+		get_a(), get_b()};
+	if (doE)
+		position[get_current_extruder_code() == 'B' ? 4 : 3] = me;
+	Scalar dx = position[0] - get_x();
+	Scalar dy = position[1] - get_y();
+	Scalar dz = position[2] - get_z();
+	Scalar distance = sqrt(dx * dx + dy * dy + dz * dz);
+	//moves of the extruder alone take as long as the filament travels
+	if (distance == 0)
+		distance = fabs(position[3] - get_a()) + fabs(position[4] - get_b());
+	if (distance == 0)
+		return;
+	binary->queuePoint(position, 
+			distance * grueCfg.get_scalingFactor() / mfeed);
+	set_x(position[0]);
+	set_y(position[1]);
+	set_z(position[2]);
+	if (doE) setCurrentE(me);
+}
+
+void Gantry::writeE(GCodeLine &line, std::ostream &format, Scalar me, 
+		const Scalar *addends, unsigned int addendCount) {
+	char axis = static_cast<char>(grueCfg.get_useEaxis() ? 'E' :
+			get_current_extruder_code());
+	if (deferred) {
+		if (!addends || addendCount > 2) {
+			GcoderException mixup("Extruder move can't be deferred");
+			throw mixup;
+		}
+		line << ' ' << axis;
+		DeferredE::Field field;
+		field.offset = line.position();
+		field.ab = get_current_extruder_code();
+		field.count = static_cast<unsigned char>(addendCount);
+		for (unsigned int i = 0; i < addendCount; ++i)
+			field.addends[i] = addends[i];
+		deferred->fields.push_back(field);
+	} else if (grueCfg.get_doRelativeE()) {
+		//difference of the absolute values as they would be printed, 
+		//so rounding doesn't add up over the print
+		line << ' ' << axis << (roundLikeStream(me, format) - 
+				roundLikeStream(getCurrentE(), format));
+	} else {
+		line << ' ' << axis << me;
+	}
+}
+
+void Gantry::writeDeferred(std::ostream &ss, const std::string &text, 
+		const DeferredE &record) {
+	size_t written = 0;
+	for (std::vector<DeferredE::Field>::const_iterator field = 
+			record.fields.begin(); 
+			field != record.fields.end(); 
+			++field) {
+		ss.write(text.data() + written, field->offset - written);
+		written = field->offset;
+		Scalar &e = field->ab == 'B' ? b : a;
+		Scalar previous = e;
+		for (unsigned int i = 0; i < field->count; ++i)
+			e = e + field->addends[i];
+		GCodeLine line(ss);
+		if (grueCfg.get_doRelativeE())
+			line << (roundLikeStream(e, ss) - roundLikeStream(previous, ss));
+		else
+			line << e;
+	}
+	ss.write(text.data() + written, text.size() - written);
+}
+
+Gantry::State Gantry::getState() const {
+	State state;
+	state.x = x;
+	state.y = y;
+	state.z = z;
+	state.a = a;
+	state.b = b;
+	state.feed = feed;
+	state.ab = ab;
+	state.extruding = extruding;
+	state.synced = synced;
+	return state;
+}
+
+void Gantry::setState(const State &state) {
+	x = state.x;
+	y = state.y;
+	z = state.z;
+	a = state.a;
+	b = state.b;
+	feed = state.feed;
+	ab = state.ab;
+	extruding = state.extruding;
+	synced = state.synced;
+}
+
+bool Gantry::State::sameMotion(const State &other) const {
+	return x == other.x && y == other.y && z == other.z && 
+			feed == other.feed && ab == other.ab && 
+			extruding == other.extruding && synced == other.synced;
+}
+
 GantryConfig::GantryConfig() {
 	set_start_x(MUCH_LARGER_THAN_THE_BUILD_PLATFORM_MM);
 	set_start_y(MUCH_LARGER_THAN_THE_BUILD_PLATFORM_MM);
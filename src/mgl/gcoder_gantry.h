@@ -9,6 +9,8 @@
 #define	GCODER_GANTRY_H
 
 #include "mgl.h"
+#include <string>
+#include <vector>
 
 namespace mgl{
 
@@ -19,6 +21,8 @@ static const Scalar MUCH_LARGER_THAN_THE_BUILD_PLATFORM_MM = 100000000;
 
 class Extruder;
 class Extrusion;
+class GCodeLine;
+class S3gWriter;
 
 class GantryConfig
 {
@@ -77,8 +81,50 @@ public:
 	static const Scalar FLUID_H = 0.3;
 	static const Scalar FLUID_W = 0.5;
 	
+	/// everything the next move depends on, to carry it between gantries
+	class State {
+	public:
+		Scalar x, y, z, a, b, feed;
+		unsigned char ab;
+		bool extruding;
+		bool synced;
+		/// true if moves from here and from @a other come out the same, 
+		/// apart from extruder positions
+		bool sameMotion(const State &other) const;
+	};
+	
+	/**
+	 @brief Extruder positions left out of gcode text, to be filled in 
+	 once the positions it starts from are known.
+	 
+	 Each field keeps the amounts added to the position, in the order 
+	 they were added, so filling in gives the same values to the last 
+	 bit as writing them straight away.
+	 */
+	class DeferredE {
+	public:
+		class Field {
+		public:
+			size_t offset;			///< where the value goes in the text
+			unsigned char ab;		///< axis it moves, A or B
+			unsigned char count;	///< how many addends
+			Scalar addends[2];
+		};
+		std::vector<Field> fields;
+	};
+	
 	Gantry(const GrueConfig& gCfg);
 	
+	State getState() const;
+	void setState(const State &state);
+	/// leave extruder positions out of the text, recording them in 
+	/// @a record, or write them again if it is NULL
+	void deferE(DeferredE *record) { deferred = record; }
+	/// write @a text, filling in the extruder positions of @a record 
+	/// as if its moves continued from this gantry's
+	void writeDeferred(std::ostream &ss, const std::string &text, 
+			const DeferredE &record);
+	
 	Scalar get_x() const;
 	Scalar get_y() const;
 	Scalar get_z() const;
@@ -109,7 +155,9 @@ public:
 				  const char *comment,
 				  bool doX, bool doY, bool doZ,
 				  bool doE,
-				  bool doFeed);
+				  bool doFeed, 
+				  const Scalar *addends = NULL, 
+				  unsigned int addendCount = 0);
 
 public:
 	void squirt(std::ostream &ss, const Point2Type &lineStart,
@@ -131,6 +179,11 @@ public:
 
     void writeSwitchExtruder(std::ostream& ss, Extruder &extruder);
 
+	/// send moves to @a writer as binary commands instead of writing 
+	/// gcode text to the stream, or back to text if it is NULL
+	void setBinary(S3gWriter *writer) { binary = writer; }
+	S3gWriter *getBinary() const { return binary; }
+
 	/// public method emits a g1 command to the stream,
     /// only writing the parameters that have changed since the last g1.
 	void g1(std::ostream &ss,
@@ -170,6 +223,28 @@ public:
 		g1(ss, &extruder, &extrusion, gx, gy, gz, gfeed, h, w, comment);
 	};
 	
+	/// whether an arc from the current position to (gx, gy) around 
+	/// @a center starts and ends on radii within arcTolerance of each 
+	/// other, as firmware checks before it accepts a G2/G3
+	bool arcFits(Scalar gx, Scalar gy, const Point2Type &center) const;
+	
+	/// emits a G2 (clockwise) or G3 arc from the current position to 
+	/// (gx, gy) around @a center, extruding for the length of the arc 
+	/// like g1 does for a line. The arc must sweep less than a full turn.
+	/// Where arcFits fails it moves to (gx, gy) in a straight line.
+	void arc(std::ostream &ss,
+			const Extruder &extruder,
+			const Extrusion &extrusion,
+			Scalar gx,
+			Scalar gy,
+			Scalar gz,
+			const Point2Type &center,
+			bool clockwise,
+			Scalar gfeed,
+			Scalar h, 
+			Scalar w, 
+			const char *comment);
+	
 	Scalar volumetricE(const Extruder &extruder, const Extrusion &extrusion,
 			Scalar vx, Scalar vy, Scalar vz, Scalar h, Scalar w) const;
 
@@ -184,10 +259,26 @@ public:
     const GrueConfig& grueCfg;
 
 private:
+	/// appends the extruder axis moving to @a me, relative or absolute
+	/// addends are what was added to the current E to get @a me, 
+	/// see DeferredE
+	void writeE(GCodeLine &line, std::ostream &ss, Scalar me, 
+			const Scalar *addends, unsigned int addendCount);
+	/// extruder feed for a line from here to (@a vx, @a vy)
+	Scalar feedLength(const Extruder &extruder, const Extrusion &extrusion,
+			Scalar vx, Scalar vy, Scalar h, Scalar w) const;
+	/// g1Motion for binary output
+	void binaryMotion(Scalar mx, Scalar my, Scalar mz, Scalar me,
+			Scalar mfeed, bool doX, bool doY, bool doZ, bool doE);
 	
 	Scalar x,y,z,a,b,feed;     // current position and feed
 	unsigned char ab;
 	bool extruding;
+	// true once a move gave every axis, so the printer agrees with x, y, z 
+	// and feed and modal moves may leave out the ones that didn't change
+	bool synced;
+	S3gWriter *binary;
+	DeferredE *deferred;
 };
 
 }
@@ -0,0 +1,137 @@
+#include "gcoder_writer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace mgl {
+
+//largest number of decimals formatted without snprintf
+static const unsigned int FAST_DECIMALS = 9;
+static const Scalar POWERS_OF_TEN[FAST_DECIMALS + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9
+};
+//beyond this, the scaled value no longer fits exactly in a double
+static const Scalar FAST_LIMIT = 4503599627370496.0; // 2^52
+
+//true for negative numbers and negative zero, which streams print as -0
+static bool isNegative(Scalar value) {
+    return value < 0 || (value == 0 && 1.0 / value < 0);
+}
+
+static size_t formatPrintf(char* buffer, size_t size, Scalar value,
+        unsigned int decimals, char conversion) {
+    char format[8] = "%.*";
+    format[3] = conversion;
+    format[4] = '\0';
+    int written = snprintf(buffer, size, format,
+            static_cast<int>(decimals), value);
+    if(written < 0)
+        return 0;
+    return std::min(static_cast<size_t>(written), size - 1);
+}
+
+size_t formatScalar(char* buffer, size_t size, Scalar value,
+        unsigned int decimals, bool fixed) {
+    if(!fixed)
+        return formatPrintf(buffer, size, value, decimals, 'g');
+    if(decimals > FAST_DECIMALS || !(std::fabs(value) < FAST_LIMIT /
+            POWERS_OF_TEN[decimals]))
+        return formatPrintf(buffer, size, value, decimals, 'f');
+    Scalar scaled = std::fabs(value) * POWERS_OF_TEN[decimals];
+    Scalar whole = std::floor(scaled);
+    Scalar fraction = scaled - whole;
+    //the multiplication above may have rounded, which only matters when
+    //the result is too close to a tie to tell which way to go
+    if(std::fabs(fraction - 0.5) <= scaled * 1e-15)
+        return formatPrintf(buffer, size, value, decimals, 'f');
+    unsigned long long digits = static_cast<unsigned long long>(whole);
+    if(fraction > 0.5)
+        ++digits;
+    //build backwards, then copy out
+    char reversed[32];
+    size_t count = 0;
+    for(unsigned int place = 0; place < decimals; ++place) {
+        reversed[count++] = static_cast<char>('0' + digits % 10);
+        digits /= 10;
+    }
+    if(decimals)
+        reversed[count++] = '.';
+    do {
+        reversed[count++] = static_cast<char>('0' + digits % 10);
+        digits /= 10;
+    } while(digits);
+    if(isNegative(value))
+        reversed[count++] = '-';
+    if(count > size)
+        return formatPrintf(buffer, size, value, decimals, 'f');
+    for(size_t i = 0; i < count; ++i)
+        buffer[i] = reversed[count - 1 - i];
+    return count;
+}
+
+size_t formatScalar(char* buffer, size_t size, Scalar value,
+        const std::ios_base& format) {
+    std::ios_base::fmtflags notation =
+            format.flags() & std::ios_base::floatfield;
+    unsigned int decimals = static_cast<unsigned int>(format.precision());
+    if(notation == std::ios_base::fixed)
+        return formatScalar(buffer, size, value, decimals, true);
+    if(notation == std::ios_base::scientific)
+        return formatPrintf(buffer, size, value, decimals, 'e');
+    return formatScalar(buffer, size, value, decimals, false);
+}
+
+GCodeLine& GCodeLine::operator <<(const char* text) {
+    append(text, strlen(text));
+    return *this;
+}
+GCodeLine& GCodeLine::operator <<(const std::string& text) {
+    append(text.c_str(), text.size());
+    return *this;
+}
+GCodeLine& GCodeLine::operator <<(char c) {
+    append(&c, 1);
+    return *this;
+}
+GCodeLine& GCodeLine::operator <<(Scalar value) {
+    char number[64];
+    append(number, formatScalar(number, sizeof(number), value, m_out));
+    return *this;
+}
+void GCodeLine::end() {
+    append("\n", 1);
+    flush();
+}
+size_t GCodeLine::position() {
+    flush();
+    return static_cast<size_t>(m_out.tellp());
+}
+void GCodeLine::append(const char* text, size_t length) {
+    while(length) {
+        if(m_size == LINE_SIZE)
+            flush();
+        size_t chunk = std::min(length, LINE_SIZE - m_size);
+        memcpy(m_buffer + m_size, text, chunk);
+        m_size += chunk;
+        text += chunk;
+        length -= chunk;
+    }
+}
+void GCodeLine::flush() {
+    if(m_size)
+        m_out.write(m_buffer, m_size);
+    m_size = 0;
+}
+
+GCodeFile::GCodeFile() : m_buffer(BUFFER_SIZE) {
+    //must happen before opening for the buffer to be used
+    rdbuf()->pubsetbuf(&m_buffer[0], m_buffer.size());
+}
+GCodeFile::~GCodeFile() {
+    if(is_open())
+        close();
+}
+
+}
+
@@ -0,0 +1,89 @@
+/*
+ * File:   gcoder_writer.h
+ *
+ * Fast text output for gcode
+ */
+
+#ifndef GCODER_WRITER_H
+#define	GCODER_WRITER_H
+
+#include "mgl.h"
+#include <fstream>
+#include <ostream>
+#include <vector>
+
+namespace mgl {
+
+/**
+ @brief Format @a value the way an ostream with @a format's flags and
+ precision would, without touching the heap.
+
+ Fixed notation, which is what gcode files use, is formatted directly.
+ Values whose rounding can't be decided in double precision, and other
+ notations, go through snprintf, which rounds the same way streams do.
+ @param buffer receives the text, no terminating null is written
+ @param size bytes available in @a buffer
+ @return number of characters written
+ */
+size_t formatScalar(char* buffer, size_t size, Scalar value,
+        const std::ios_base& format);
+/**
+ @brief as above, for fixed notation with @a decimals digits after the
+ point when @a fixed is true, or general notation with @a decimals
+ significant digits when it is false
+ */
+size_t formatScalar(char* buffer, size_t size, Scalar value,
+        unsigned int decimals, bool fixed);
+
+/**
+ @brief Assembles one line of gcode on the stack and writes it to
+ the stream in one call, with a newline and no flush.
+
+ Numbers are formatted with the precision and notation of the stream.
+ Lines longer than the buffer are written in pieces.
+ */
+class GCodeLine {
+public:
+    explicit GCodeLine(std::ostream& out) : m_out(out), m_size(0) {}
+    ~GCodeLine() { flush(); }
+
+    GCodeLine& operator <<(const char* text);
+    GCodeLine& operator <<(const std::string& text);
+    GCodeLine& operator <<(char c);
+    GCodeLine& operator <<(Scalar value);
+    /// write what was assembled so far, ending it with a newline
+    void end();
+    /// stream position of the next character, after writing out what 
+    /// was assembled so far
+    size_t position();
+private:
+    GCodeLine(const GCodeLine&);
+    GCodeLine& operator =(const GCodeLine&);
+    void append(const char* text, size_t length);
+    void flush();
+
+    static const size_t LINE_SIZE = 256;
+    std::ostream& m_out;
+    size_t m_size;
+    char m_buffer[LINE_SIZE];
+};
+
+/**
+ @brief An output file for gcode with a large buffer, so lines reach
+ the disk in big blocks rather than one system call at a time.
+ */
+class GCodeFile : public std::ofstream {
+public:
+    static const size_t BUFFER_SIZE = 1 << 20;
+
+    GCodeFile();
+    /// closes the file while the buffer still exists
+    ~GCodeFile();
+private:
+    std::vector<char> m_buffer;
+};
+
+}
+
+#endif	/* GCODER_WRITER_H */
+
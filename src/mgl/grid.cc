@@ -14,6 +14,9 @@
 
 #include "grid.h"
 #include "log.h"
+#include "spacial_data.h"
+#include "stage_timer.h"
+#include <cmath>
 #include <limits>
 #include <list>
 #include <vector>
@@ -92,6 +95,7 @@ void rayCastAlongX(const std::list<Loop>& outlineLoops,
 		Scalar xMin,
 		Scalar xMax,
 		std::vector<ScalarRange> &ranges) {
+	StageTimer::count(StageTimer::RAY_CASTS);
 	std::vector<Scalar> lineCuts;
 
 	//iterate over every loop
@@ -138,6 +142,7 @@ void rayCastAlongY(const std::list<Loop>& outlineLoops,
 		Scalar yMin,
 		Scalar yMax,
 		std::vector<ScalarRange> &ranges) {
+	StageTimer::count(StageTimer::RAY_CASTS);
 	std::vector<Scalar> lineCuts;
 
 	// iterate over every loop
@@ -183,11 +188,32 @@ void castRaysOnSliceAlongX(const std::list<Loop> &outlineLoops,
 		Scalar xMin,
 		Scalar xMax,
 		ScalarRangeTable &rangeTable) {
+	castRaysOnSliceAlongX(outlineLoops, yValues, 0, yValues.size(), 
+			xMin, xMax, rangeTable);
+}
+
+void castRaysOnSliceAlongY(const std::list<Loop> &outlineLoops,
+		const std::vector<Scalar> &values, // x
+		Scalar min,
+		Scalar max,
+		ScalarRangeTable &rangeTable) {
+	castRaysOnSliceAlongY(outlineLoops, values, 0, values.size(), 
+			min, max, rangeTable);
+}
+
+void castRaysOnSliceAlongX(const std::list<Loop> &outlineLoops,
+		const std::vector<Scalar> &yValues,
+		size_t first,
+		size_t last,
+		Scalar xMin,
+		Scalar xMax,
+		ScalarRangeTable &rangeTable) {
 	assert(rangeTable.size() == 0);
-	rangeTable.resize(yValues.size());
+	assert(first <= last && last <= yValues.size());
+	rangeTable.resize(last - first);
 
 	for (size_t i = 0; i < rangeTable.size(); i++) {
-		Scalar y = yValues[i];
+		Scalar y = yValues[first + i];
 		std::vector<ScalarRange> &ranges = rangeTable[i];
 		rayCastAlongX(outlineLoops, y, xMin, xMax, ranges);
 	}
@@ -195,14 +221,17 @@ void castRaysOnSliceAlongX(const std::list<Loop> &outlineLoops,
 
 void castRaysOnSliceAlongY(const std::list<Loop> &outlineLoops,
 		const std::vector<Scalar> &values, // x
+		size_t first,
+		size_t last,
 		Scalar min,
 		Scalar max,
 		ScalarRangeTable &rangeTable) {
 	assert(rangeTable.size() == 0);
-	rangeTable.resize(values.size());
+	assert(first <= last && last <= values.size());
+	rangeTable.resize(last - first);
 
 	for (size_t i = 0; i < rangeTable.size(); i++) {
-		Scalar value = values[i];
+		Scalar value = values[first + i];
 		std::vector<ScalarRange> &ranges = rangeTable[i];
 		rayCastAlongY(outlineLoops, value, min, max, ranges);
 	}
@@ -231,9 +260,12 @@ bool crossesOutlines(const Segment2Type &seg,
 void Grid::gridRangesToOpenPaths(const ScalarRangeTable &rays,
 								 const std::vector<Scalar> &values,
 								 const axis_e axis,
-								 OpenPathList &paths) const {
+								 OpenPathList &paths, 
+								 size_t firstValue) const {
+	if (firstValue >= values.size())
+		return;
 
-	std::vector<Scalar>::const_iterator value = values.begin();
+	std::vector<Scalar>::const_iterator value = values.begin() + firstValue;
 	ScalarRangeTable::const_iterator ray = rays.begin();
 
 	for (;
@@ -256,6 +288,18 @@ void Grid::gridRangesToOpenPaths(const ScalarRangeTable &rays,
 	}
 }
 
+void Grid::gridRangesToOpenPaths(const GridRanges &gridRanges,
+								 const axis_e axis,
+								 OpenPathList &paths) const {
+	if (axis == X_AXIS) {
+		gridRangesToOpenPaths(gridRanges.xRays, yValues, X_AXIS, paths, 
+				gridRanges.xRaysOffset);
+	} else {
+		gridRangesToOpenPaths(gridRanges.yRays, xValues, Y_AXIS, paths, 
+				gridRanges.yRaysOffset);
+	}
+}
+
 
 typedef map<int, int> PointMap;
 typedef PointMap::iterator PointIter;
@@ -652,6 +696,15 @@ void rangeTableDifference(const ScalarRangeTable &src,
 		ScalarRangeTable &diff) {
 
 	size_t lineCount = src.size();
+	// windowed tables may be empty, nothing is taken from or left of them
+	if (del.size() == 0) {
+		diff = src;
+		return;
+	}
+	else if (lineCount == 0) {
+		diff.clear();
+		return;
+	}
 	if (lineCount != del.size()) {
 		size_t delSize = del.size();
 		assert(lineCount == delSize);
@@ -726,7 +779,7 @@ void rangeTableUnion(const ScalarRangeTable &a,
 
 // Grid class implementation
 
-Grid::Grid() {
+Grid::Grid() : gridSpacing(0) {
 }
 
 Grid::Grid(const Limits &limits, Scalar gridSpacing) {
@@ -734,6 +787,7 @@ Grid::Grid(const Limits &limits, Scalar gridSpacing) {
 }
 
 void Grid::init(const Limits &limits, Scalar gridSpacing) {
+	this->gridSpacing = gridSpacing;
 
 	Scalar deltaY = limits.yMax - limits.yMin;
 	Scalar deltaX = limits.xMax - limits.xMin;
@@ -769,15 +823,93 @@ void Grid::init(const Limits &limits, Scalar gridSpacing) {
 //	castRaysOnSliceAlongY(loops, xValues, yMin, yMax, outGridRanges.yRays);
 //}
 
+/// Index span [begin, end) of the evenly spaced @a values that fall inside
+/// [lo, hi], padded by one line on each side
+static void valueSpan(const std::vector<Scalar> &values, Scalar spacing, 
+		Scalar lo, Scalar hi, size_t &begin, size_t &end) {
+	begin = end = 0;
+	if (values.empty() || hi < lo)
+		return;
+	const Scalar count = Scalar(values.size());
+	Scalar first = floor((lo - values.front()) / spacing) - 1;
+	Scalar last = ceil((hi - values.front()) / spacing) + 2;
+	if (first < 0)
+		first = 0;
+	if (last > count)
+		last = count;
+	if (first >= last)
+		return;
+	begin = size_t(first);
+	end = size_t(last);
+}
+
+GridWindow Grid::fullWindow() const {
+	return GridWindow(0, xValues.size(), 0, yValues.size());
+}
+
+GridWindow Grid::windowForLoops(const std::list<Loop>& loops) const {
+	if (gridSpacing <= 0)
+		return fullWindow();
+	bool found = false;
+	AABBox bounds;
+	for (std::list<Loop>::const_iterator loop = loops.begin(); 
+			loop != loops.end(); 
+			++loop) {
+		for (Loop::const_finite_cw_iterator point = loop->clockwiseFinite(); 
+				point != loop->clockwiseEnd(); 
+				++point) {
+			if (found) {
+				bounds.expandTo(*point);
+			} else {
+				bounds.reset(*point);
+				found = true;
+			}
+		}
+	}
+	GridWindow window;
+	if (!found)
+		return window;
+	valueSpan(xValues, gridSpacing, bounds.left(), bounds.right(), 
+			window.xBegin, window.xEnd);
+	valueSpan(yValues, gridSpacing, bounds.bottom(), bounds.top(), 
+			window.yBegin, window.yEnd);
+	return window;
+}
+
 void Grid::createGridRanges(const std::list<Loop>& loops,
 		GridRanges& outGridRanges) const {
+	createGridRanges(loops, windowForLoops(loops), outGridRanges);
+}
+
+void Grid::createGridRanges(const std::list<Loop>& loops,
+		const GridWindow& window, 
+		GridRanges& outGridRanges) const {
+	outGridRanges.xRaysOffset = window.yBegin;
+	outGridRanges.yRaysOffset = window.xBegin;
+	if (window.empty())
+		return;
+
 	Scalar xMin = xValues[0];
 	Scalar xMax = xValues.back();
-	castRaysOnSliceAlongX(loops, yValues, xMin, xMax, outGridRanges.xRays);
+	castRaysOnSliceAlongX(loops, yValues, window.yBegin, window.yEnd, 
+			xMin, xMax, outGridRanges.xRays);
 
 	Scalar yMin = yValues[0];
 	Scalar yMax = yValues.back();
-	castRaysOnSliceAlongY(loops, xValues, yMin, yMax, outGridRanges.yRays);
+	castRaysOnSliceAlongY(loops, xValues, window.xBegin, window.xEnd, 
+			yMin, yMax, outGridRanges.yRays);
+}
+
+/// Copy every (skipCount + 1)th line of @a src, counting from global line 0
+static void subSampleTable(const ScalarRangeTable &src, size_t offset, 
+		size_t skipCount, ScalarRangeTable &result) {
+	const size_t stride = skipCount + 1;
+	result.resize(src.size());
+	for (size_t i = (stride - offset % stride) % stride; 
+			i < src.size(); 
+			i += stride) {
+		result[i] = src[i]; // deep copy of the ranges for the selected lines
+	}
 }
 
 void Grid::subSample(const GridRanges &gridRanges, 
@@ -786,18 +918,13 @@ void Grid::subSample(const GridRanges &gridRanges,
 	assert(result.xRays.size() == 0);
 	assert(result.yRays.size() == 0);
 
-	result.xRays.resize(gridRanges.xRays.size());
-	result.yRays.resize(gridRanges.yRays.size());
-
-	for (size_t i = 0; i < gridRanges.xRays.size(); i++) {
-		result.xRays[i] = gridRanges.xRays[i]; // deep copy of the ranges for the selected lines
-		i += skipCount; // skip lines depending on selected infill density
-	}
-
-	for (size_t i = 0; i < gridRanges.yRays.size(); i++) {
-		result.yRays[i] = gridRanges.yRays[i]; // deep copy of the ranges for the selected lines
-		i += skipCount; // skip lines depending on selected infill density
-	}
+	result.xRaysOffset = gridRanges.xRaysOffset;
+	result.yRaysOffset = gridRanges.yRaysOffset;
+	// skip lines depending on selected infill density
+	subSampleTable(gridRanges.xRays, gridRanges.xRaysOffset, skipCount, 
+			result.xRays);
+	subSampleTable(gridRanges.yRays, gridRanges.yRaysOffset, skipCount, 
+			result.yRays);
 }
 
 void Grid::pathsFromRanges(const GridRanges &gridRanges,
@@ -817,26 +944,74 @@ void Grid::pathsFromRanges(const GridRanges &gridRanges,
 	}
 }
 
+/// Copy the lines of @a src (starting at global line @a srcOffset) that fall
+/// in [dstOffset, dstOffset + dstSize) into @a dst, padding with empty lines
+static void rewindowTable(const ScalarRangeTable &src, size_t srcOffset, 
+		size_t dstOffset, size_t dstSize, ScalarRangeTable &dst) {
+	dst.clear();
+	dst.resize(dstSize);
+	for (size_t i = 0; i < src.size(); ++i) {
+		size_t line = srcOffset + i;
+		if (line >= dstOffset && line < dstOffset + dstSize)
+			dst[line - dstOffset] = src[i];
+	}
+}
+
+typedef void (*RangeTableOperation)(const ScalarRangeTable&, 
+		const ScalarRangeTable&, ScalarRangeTable&);
+
+/// Apply @a operation to two tables that may cover different windows of
+/// lines. Tables already sharing a window (the usual case) are used as is.
+static void windowedTableOperation(RangeTableOperation operation, 
+		const ScalarRangeTable &a, size_t aOffset, 
+		const ScalarRangeTable &b, size_t bOffset, 
+		ScalarRangeTable &result, size_t &resultOffset) {
+	if (b.empty() || (aOffset == bOffset && a.size() == b.size())) {
+		resultOffset = aOffset;
+		operation(a, b, result);
+		return;
+	}
+	if (a.empty()) {
+		// a union takes b's lines, what is left of an empty table is empty
+		operation(a, b, result);
+		resultOffset = result.empty() ? aOffset : bOffset;
+		return;
+	}
+	size_t begin = std::min(aOffset, bOffset);
+	size_t end = std::max(aOffset + a.size(), bOffset + b.size());
+	ScalarRangeTable alignedA, alignedB;
+	rewindowTable(a, aOffset, begin, end - begin, alignedA);
+	rewindowTable(b, bOffset, begin, end - begin, alignedB);
+	resultOffset = begin;
+	operation(alignedA, alignedB, result);
+}
+
 void Grid::gridRangeUnion(const GridRanges& a, 
 		const GridRanges &b, 
 		GridRanges &result) const {
-	rangeTableUnion(a.xRays, b.xRays, result.xRays);
-	rangeTableUnion(a.yRays, b.yRays, result.yRays);
+	windowedTableOperation(rangeTableUnion, a.xRays, a.xRaysOffset, 
+			b.xRays, b.xRaysOffset, result.xRays, result.xRaysOffset);
+	windowedTableOperation(rangeTableUnion, a.yRays, a.yRaysOffset, 
+			b.yRays, b.yRaysOffset, result.yRays, result.yRaysOffset);
 }
 
 void Grid::gridRangeDifference(const GridRanges& src, 
 		const GridRanges &del, 
 		GridRanges &result) const {
-	rangeTableDifference(src.xRays, del.xRays, result.xRays);
-	rangeTableDifference(src.yRays, del.yRays, result.yRays);
+	windowedTableOperation(rangeTableDifference, src.xRays, src.xRaysOffset, 
+			del.xRays, del.xRaysOffset, result.xRays, result.xRaysOffset);
+	windowedTableOperation(rangeTableDifference, src.yRays, src.yRaysOffset, 
+			del.yRays, del.yRaysOffset, result.yRays, result.yRaysOffset);
 
 }
 
 void Grid::gridRangeIntersection(const GridRanges& a, 
 		const GridRanges &b, 
 		GridRanges &result) const {
-	rangeTableIntersection(a.xRays, b.xRays, result.xRays);
-	rangeTableIntersection(a.yRays, b.yRays, result.yRays);
+	windowedTableOperation(rangeTableIntersection, a.xRays, a.xRaysOffset, 
+			b.xRays, b.xRaysOffset, result.xRays, result.xRaysOffset);
+	windowedTableOperation(rangeTableIntersection, a.yRays, a.yRaysOffset, 
+			b.yRays, b.yRaysOffset, result.yRays, result.yRaysOffset);
 }
 
 void rangeTrim(const vector<ScalarRange> &src, 
@@ -880,6 +1055,8 @@ void dumpRangeTable(const ScalarRangeTable &table) {
 void Grid::trimGridRange(const GridRanges& src, 
 		Scalar cutOff, 
 		GridRanges &result) const {
+	result.xRaysOffset = src.xRaysOffset;
+	result.yRaysOffset = src.yRaysOffset;
 	rangeTableTrim(src.xRays, cutOff, result.xRays);
 	rangeTableTrim(src.yRays, cutOff, result.yRays);
 
@@ -52,8 +52,13 @@ typedef std::vector<std::vector<ScalarRange> > ScalarRangeTable;
 
 class GridRanges {
 public:
+	GridRanges() : xRaysOffset(0), yRaysOffset(0) {}
     ScalarRangeTable xRays;
     ScalarRangeTable yRays;
+	/// global index (into Grid::getYValues()) of the line xRays[0] lies on
+	size_t xRaysOffset;
+	/// global index (into Grid::getXValues()) of the line yRays[0] lies on
+	size_t yRaysOffset;
 	size_t xRaysCount() const {
 		size_t accum = 0;
 		for(size_t i=0; i<xRays.size(); ++i)
@@ -71,6 +76,22 @@ public:
 	}
 };
 
+/// A rectangular span of grid line indices that can touch material on one
+/// layer. Indices are global to the Grid, so ranges computed inside a window
+/// stay aligned with the infill of every other layer.
+class GridWindow {
+public:
+	GridWindow(size_t xb = 0, size_t xe = 0, size_t yb = 0, size_t ye = 0)
+			: xBegin(xb), xEnd(xe), yBegin(yb), yEnd(ye) {}
+	size_t xBegin; ///< first index into Grid::getXValues()
+	size_t xEnd; ///< one past the last index into Grid::getXValues()
+	size_t yBegin; ///< first index into Grid::getYValues()
+	size_t yEnd; ///< one past the last index into Grid::getYValues()
+	size_t xCount() const { return xEnd > xBegin ? xEnd - xBegin : 0; }
+	size_t yCount() const { return yEnd > yBegin ? yEnd - yBegin : 0; }
+	bool empty() const { return xCount() == 0 || yCount() == 0; }
+};
+
 bool intersectRange(Scalar a, Scalar b, Scalar c, 
 		Scalar d, Scalar &begin, Scalar &end);
 std::vector< ScalarRange >::const_iterator  subRangeTersect( 
@@ -131,6 +152,21 @@ void castRaysOnSliceAlongY(const std::list<Loop>& outlineLoops,
 		Scalar min,
 		Scalar max,
 		ScalarRangeTable &rangeTable);
+/// cast rays only along the lines values[first] to values[last - 1]
+void castRaysOnSliceAlongX(const std::list<Loop>& outlineLoops,
+		const std::vector<Scalar> &yValues,
+		size_t first,
+		size_t last,
+		Scalar xMin,
+		Scalar xMax,
+		ScalarRangeTable &rangeTable);
+void castRaysOnSliceAlongY(const std::list<Loop>& outlineLoops,
+		const std::vector<Scalar> &values, // x
+		size_t first,
+		size_t last,
+		Scalar min,
+		Scalar max,
+		ScalarRangeTable &rangeTable);
 bool crossesOutline(const Segment2Type &seg,
 		const SegmentTable &outline);
 
@@ -144,6 +180,7 @@ class Grid
     std::vector<Scalar> xValues; ///< list of spacing between lines along y axis(mm)
     std::vector<Scalar> yValues; ///< list of spacing between lines along x axis(mm)
     Point2Type gridOrigin; ///< origin of our grid system
+    Scalar gridSpacing; ///< distance between two neighboring lines (mm)
 
 public:
     Grid();
@@ -164,16 +201,31 @@ public:
 
     const std::vector<Scalar>& getYValues() const{return yValues;}
 
+    /// The window spanning every line of the grid
+    GridWindow fullWindow() const;
+
+    /// Smallest window holding every grid line that can cross @a loops.
+    /// An empty list of loops gives an empty window.
+    GridWindow windowForLoops(const std::list<Loop>& loops) const;
+
     /// Creates range of beginning to end of gridlines
     /// @param returns a list of GridRanges 'cut out' of the underlying
     /// idealized grid based on our segments in segments.
     /// @param loops: a SegmentTable containing segments specifying
     ///		exactly one layer outline to use to 'cookie cutter' out gridlines
+    /// Only the lines in windowForLoops(loops) are cast.
 	void createGridRanges(const std::list<Loop>& loops, 
 			GridRanges& outGridRanges) const;
 
+    /// Same as above, but casts exactly the lines inside @a window. Use this
+    /// to give several GridRanges of a layer the same line layout.
+	void createGridRanges(const std::list<Loop>& loops, 
+			const GridWindow& window, 
+			GridRanges& outGridRanges) const;
+
     /// The grid starts out at 100% infill, this function selectlviy removes filament
-    /// based on a skip count to reduce density
+    /// based on a skip count to reduce density. Lines are picked by their
+    /// global index, so windowed ranges subsample in step with each other.
     /// @param srcGridRanges: input grid range to sub-sample
     /// @param skipCount : number if infill lines to skip. infill_ration = (1/skipCount) -1
     /// @param result: returned grid post-subsampling
@@ -205,6 +257,13 @@ public:
 
 	void gridRangesToOpenPaths(const ScalarRangeTable &rays,
 							   const std::vector<Scalar> &values,
+							   const axis_e axis,
+							   OpenPathList &paths, 
+							   size_t firstValue = 0) const;
+
+	/// Converts the rays of @a gridRanges along @a axis to paths, looking up
+	/// the line positions from the windowed offsets
+	void gridRangesToOpenPaths(const GridRanges &gridRanges,
 							   const axis_e axis,
 							   OpenPathList &paths) const;
 };
@@ -13,6 +13,7 @@
 #include "insets.h"
 #include "shrinky.h"
 #include "clipper.h"
+#include "stage_timer.h"
 #include "log.h"
 
 using namespace std;
@@ -136,6 +137,7 @@ void ClipperInsetter::inset( const SegmentVector &inputPolys,
 
 	mglToClipper  (inputPolys, in_polys);
 	//dumpClipperPolys(in_polys);
+	StageTimer::count(StageTimer::CLIPPER_CALLS);
 	ClipperLib::OffsetPolygons(in_polys, out_polys, delta, jointype, miterLimit);
 	//dumpClipperPolys(out_polys);
 	clipperToMgl(out_polys, outputPolys);
@@ -0,0 +1,73 @@
+#include "instancer.h"
+#include "segment.h"
+
+namespace mgl {
+
+typedef LayerPaths::Layer::ExtruderLayer::LabeledPathList LabeledPathList;
+
+Instancer::Instancer(const std::vector<Point2Type>& offsets, 
+        const Point2Type& start, LayerSink* next) 
+        : m_offsets(offsets), m_next(next), m_position(start) {}
+
+void Instancer::replicate(LayerPaths& layers) {
+    for(LayerPaths::layer_iterator layer = layers.begin(); 
+            layer != layers.end(); ++layer)
+        replicate(*layer);
+}
+
+void Instancer::replicate(LayerPaths::Layer& layer) {
+    if(m_offsets.empty())
+        return;
+    for(LayerPaths::Layer::extruder_iterator extruder = 
+            layer.extruders.begin(); 
+            extruder != layer.extruders.end(); ++extruder) {
+        LabeledPathList& part = extruder->paths;
+        LabeledPathList::const_iterator first = part.begin();
+        while(first != part.end() && first->myPath.empty())
+            ++first;
+        if(first == part.end())
+            continue;
+        LabeledPathList::const_reverse_iterator last = part.rbegin();
+        while(last->myPath.empty())
+            ++last;
+        const Point2Type partStart = *first->myPath.fromStart();
+        const Point2Type partEnd = *last->myPath.fromEnd();
+        
+        LabeledPathList copies;
+        std::vector<bool> placed(m_offsets.size(), false);
+        for(size_t count = 0; count < m_offsets.size(); ++count) {
+            size_t nearest = m_offsets.size();
+            Scalar nearestDistance = 0;
+            for(size_t i = 0; i < m_offsets.size(); ++i) {
+                if(placed[i])
+                    continue;
+                Scalar distance = (partStart + m_offsets[i] - 
+                        m_position).squaredMagnitude();
+                if(nearest == m_offsets.size() || distance < nearestDistance) {
+                    nearest = i;
+                    nearestDistance = distance;
+                }
+            }
+            placed[nearest] = true;
+            //the last copy takes the part's own paths
+            LabeledPathList copy;
+            if(count + 1 < m_offsets.size())
+                copy = part;
+            else
+                copy.swap(part);
+            translateOpenPaths(copy, m_offsets[nearest]);
+            copies.splice(copies.end(), copy);
+            m_position = partEnd + m_offsets[nearest];
+        }
+        part.swap(copies);
+    }
+}
+
+void Instancer::layerReady(LayerPaths& from, 
+        LayerPaths::layer_iterator layer) {
+    replicate(*layer);
+    if(m_next)
+        m_next->layerReady(from, layer);
+}
+
+}
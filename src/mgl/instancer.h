@@ -0,0 +1,53 @@
+/*
+ * File:   instancer.h
+ *
+ * Prints copies of a part from the paths planned for one
+ */
+
+#ifndef MGL_INSTANCER_H
+#define	MGL_INSTANCER_H
+
+#include "pather.h"
+
+#include <vector>
+
+namespace mgl {
+
+/**
+ @brief Copies the planned paths of one part to several places on the
+ plate, so the part is sliced, regioned and planned only once.
+
+ Each layer's paths are copied to every offset and moved by it. A copy
+ keeps the order the pather gave the part's paths. Only the order of the
+ copies is chosen here, layer by layer: the next copy is the one whose
+ first path starts nearest to where the last one ended.
+
+ It copies whole LayerPaths, or sits between a streaming pather and the
+ sink that writes its layers, copying each layer as it arrives.
+ */
+class Instancer : public LayerSink {
+public:
+    /**
+     @param offsets where each copy goes, from where the part was planned
+     @param start where the nozzle is before the first layer
+     @param next receives each layer once it is copied, when streaming
+     */
+    Instancer(const std::vector<Point2Type>& offsets, 
+            const Point2Type& start, LayerSink* next = NULL);
+    
+    /// copy every layer of @a layers in place
+    void replicate(LayerPaths& layers);
+    /// copy @a layer in place, the layer after those copied before
+    void replicate(LayerPaths::Layer& layer);
+    void layerReady(LayerPaths& from, LayerPaths::layer_iterator layer);
+    
+private:
+    std::vector<Point2Type> m_offsets;
+    LayerSink* m_next;
+    /// where the last copy ended
+    Point2Type m_position;
+};
+
+}
+
+#endif	/* MGL_INSTANCER_H */
@@ -0,0 +1,65 @@
+#include "job_scheduler.h"
+#include "abstractable.h"
+
+namespace mgl {
+
+/* Bytes for each term of JobFeatures::terms, from the peak resident
+ memory of miracle_grue on the bundled models less that of an idle run.
+ Triangles dominate small models, the layers of region and path data
+ large ones, and support adds to the latter. */
+static const Scalar MEMORY_COEFFICIENTS[JobFeatures::TERM_COUNT] = {
+    1e6, 1000, 0, 18, 32
+};
+
+JobScheduler::JobScheduler(size_t maxRunningJobs, size_t memoryBudget)
+        : maxRunning(maxRunningJobs ? maxRunningJobs : 1),
+        budget(memoryBudget), reserved(0) {}
+
+void JobScheduler::add(JobId id, int priority, Scalar seconds,
+        size_t bytes, double now) {
+    waiting.push_back(Entry(id, priority, seconds, bytes, now));
+}
+
+bool JobScheduler::admit(double now, JobId& id) {
+    if(waiting.empty() || running.size() >= maxRunning)
+        return false;
+    size_t best = 0;
+    for(size_t i = 1; i < waiting.size(); ++i) {
+        const Entry& entry = waiting[i];
+        const Entry& leader = waiting[best];
+        if(entry.priority != leader.priority) {
+            if(entry.priority > leader.priority)
+                best = i;
+        } else if(entry.seconds - (now - entry.since) <
+                leader.seconds - (now - leader.since)) {
+            best = i;
+        }
+    }
+    const Entry& chosen = waiting[best];
+    if(budget && !running.empty() && reserved + chosen.bytes > budget)
+        return false;
+    id = chosen.id;
+    running[id] = chosen.bytes;
+    reserved += chosen.bytes;
+    waiting.erase(waiting.begin() + best);
+    return true;
+}
+
+void JobScheduler::finish(JobId id) {
+    std::map<JobId, size_t>::iterator job = running.find(id);
+    if(job == running.end())
+        return;
+    reserved -= job->second;
+    running.erase(job);
+}
+
+size_t JobScheduler::predictBytes(const JobFeatures& features) {
+    Scalar row[JobFeatures::TERM_COUNT];
+    features.terms(row);
+    Scalar bytes = 0;
+    for(unsigned int j = 0; j < JobFeatures::TERM_COUNT; ++j)
+        bytes += MEMORY_COEFFICIENTS[j] * row[j];
+    return static_cast<size_t>(bytes);
+}
+
+}
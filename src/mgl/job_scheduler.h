@@ -0,0 +1,90 @@
+/*
+ * File:   job_scheduler.h
+ *
+ * Decides which of several waiting slicing jobs starts next, by their
+ * priorities, predicted seconds and predicted memory
+ */
+
+#ifndef MGL_JOB_SCHEDULER_H
+#define	MGL_JOB_SCHEDULER_H
+
+#include "mgl.h"
+
+#include <map>
+#include <vector>
+
+namespace mgl {
+
+class JobFeatures;
+
+/**
+ @brief Admits waiting jobs to run, at most maxRunning at once, and only
+ while their predicted memory fits in a budget.
+
+ Higher priorities go first. Within a priority the job predicted to
+ finish soonest goes first, counting the seconds each has waited off its
+ predicted seconds. A short job passes a long one, and a long job is
+ passed only until it has waited about as long as the short ones take.
+
+ The first job in that order waits for a free slot and for its memory
+ to fit beside the running jobs. The ones behind it wait too, so it is
+ never passed for want of memory. A job predicted to need more than the
+ whole budget runs once nothing else does.
+ */
+class JobScheduler {
+public:
+    typedef unsigned int JobId;
+
+    /**
+     @param maxRunning how many jobs run at once, 0 is the same as 1
+     @param memoryBudget bytes the running jobs may be predicted to
+     need together, 0 for no limit
+     */
+    JobScheduler(size_t maxRunning, size_t memoryBudget);
+
+    /// @param now seconds on StageTimer::now(), when the job began waiting
+    void add(JobId id, int priority, Scalar seconds, size_t bytes,
+            double now);
+    /// the job to start at @a now, false if none may start yet
+    bool admit(double now, JobId& id);
+    /// job @a id has finished, freeing its slot and memory
+    void finish(JobId id);
+
+    size_t waitingCount() const { return waiting.size(); }
+    size_t runningCount() const { return running.size(); }
+    size_t maxRunningCount() const { return maxRunning; }
+    /// bytes the running jobs are predicted to need
+    size_t reservedBytes() const { return reserved; }
+    /// whether the running jobs need more than the budget, so none can join
+    bool overBudget() const { return budget && reserved > budget; }
+
+    /**
+     @brief bytes a job is predicted to need above what the process
+     needs anyway, from the peak resident memory of the bundled models
+     */
+    static size_t predictBytes(const JobFeatures& features);
+
+private:
+    class Entry {
+    public:
+        Entry(JobId jobId, int jobPriority, Scalar jobSeconds,
+                size_t jobBytes, double jobSince) : id(jobId),
+                priority(jobPriority), seconds(jobSeconds), bytes(jobBytes),
+                since(jobSince) {}
+        JobId id;
+        int priority;
+        Scalar seconds;
+        size_t bytes;
+        double since;
+    };
+
+    size_t maxRunning;
+    size_t budget;
+    size_t reserved;
+    std::vector<Entry> waiting;
+    std::map<JobId, size_t> running;
+};
+
+}
+
+#endif	/* MGL_JOB_SCHEDULER_H */
@@ -0,0 +1,88 @@
+#include "layer_stream.h"
+#include "thread_lock.h"
+#include <algorithm>
+
+namespace mgl {
+
+/// microseconds to give the other side of the queue
+static const unsigned int QUEUE_NAP = 200;
+
+LayerQueue::LayerQueue(size_t capacity) 
+        : m_size(0), m_capacity(std::max<size_t>(capacity, 1)), m_peak(0), 
+        m_closed(false) {
+#ifdef OMPFF
+    omp_init_lock(&m_lock);
+#endif
+}
+
+LayerQueue::~LayerQueue() {
+#ifdef OMPFF
+    omp_destroy_lock(&m_lock);
+#endif
+}
+
+void LayerQueue::layerReady(LayerPaths& from, 
+        LayerPaths::layer_iterator layer) {
+    for(;;) {
+        {
+#ifdef OMPFF
+            OmpGuard guard(m_lock);
+#endif
+            if(m_closed) {
+                from.erase(layer);
+                return;
+            }
+#ifdef OMPFF
+            if(m_size < m_capacity) 
+#endif
+            {
+                m_layers.splice(m_layers.end(), from, layer);
+                ++m_size;
+                m_peak = std::max(m_peak, m_size);
+                return;
+            }
+        }
+#ifdef OMPFF
+        nap(QUEUE_NAP);
+#endif
+    }
+}
+
+bool LayerQueue::pop(LayerPaths& into) {
+    for(;;) {
+        {
+#ifdef OMPFF
+            OmpGuard guard(m_lock);
+#endif
+            if(m_size) {
+                into.splice(into.end(), m_layers, m_layers.begin());
+                --m_size;
+                return true;
+            }
+            if(m_closed)
+                return false;
+        }
+#ifdef OMPFF
+        nap(QUEUE_NAP);
+#else
+        //no other thread could fill it
+        return false;
+#endif
+    }
+}
+
+void LayerQueue::close() {
+#ifdef OMPFF
+    OmpGuard guard(m_lock);
+#endif
+    m_closed = true;
+}
+
+void LayerWriter::layerReady(LayerPaths& from, 
+        LayerPaths::layer_iterator layer) {
+    m_gcoder.writeLayer(m_gout, from, layer);
+    from.erase(layer);
+}
+
+}
+
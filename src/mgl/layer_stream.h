@@ -0,0 +1,74 @@
+/*
+ * File:   layer_stream.h
+ *
+ * Hands layers from the pather to the gcoder as they are finished
+ */
+
+#ifndef MGL_LAYER_STREAM_H
+#define	MGL_LAYER_STREAM_H
+
+#include "pather.h"
+#include "gcoder.h"
+#include <ostream>
+
+#ifdef OMPFF
+#include <omp.h>
+#endif
+
+namespace mgl {
+
+/**
+ @brief A bounded queue of finished layers between a thread running 
+ Pather::generatePaths and one writing gcode.
+ 
+ Layers are spliced in and out, never copied. layerReady waits while 
+ the queue is full, so planning can't run further ahead of writing than 
+ the capacity allows, and pop waits while it is empty.
+ 
+ After close, pop returns what is left and then false, and layers that 
+ still arrive are dropped, so either side can stop the other by closing. 
+ Without OpenMP there is nothing to wait for, and the queue never fills.
+ */
+class LayerQueue : public LayerSink {
+public:
+    explicit LayerQueue(size_t capacity);
+    ~LayerQueue();
+    
+    void layerReady(LayerPaths& from, LayerPaths::layer_iterator layer);
+    /// move the oldest layer to the end of @a into, waiting for one
+    /// @return false once the queue is closed and empty
+    bool pop(LayerPaths& into);
+    /// no more layers will be added or taken
+    void close();
+    /// most layers that were waiting at once
+    size_t peak() const { return m_peak; }
+    
+private:
+    LayerQueue(const LayerQueue&);
+    LayerQueue& operator =(const LayerQueue&);
+    
+    LayerPaths m_layers;
+    size_t m_size;
+    size_t m_capacity;
+    size_t m_peak;
+    bool m_closed;
+#ifdef OMPFF
+    omp_lock_t m_lock;
+#endif
+};
+
+/// Writes each layer with a GCoder as soon as it arrives, then frees it
+class LayerWriter : public LayerSink {
+public:
+    LayerWriter(GCoder& gcoder, std::ostream& gout) 
+            : m_gcoder(gcoder), m_gout(gout) {}
+    void layerReady(LayerPaths& from, LayerPaths::layer_iterator layer);
+private:
+    GCoder& m_gcoder;
+    std::ostream& m_gout;
+};
+
+}
+
+#endif	/* MGL_LAYER_STREAM_H */
+
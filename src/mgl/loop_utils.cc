@@ -3,6 +3,7 @@
 
 #include "loop_utils.h"
 #include "clipper.h"
+#include "stage_timer.h"
 
 namespace mgl {
 
@@ -74,6 +75,8 @@ void ClPolygonToLoop(const ClipperLib::Polygons &clpolys,
 
 void runClipper(LoopList &dest, const LoopList &subject, const LoopList &apply,
 				const ClipperLib::ClipType type) {
+	StageTimer::count(StageTimer::CLIPPER_CALLS);
+	StageTimer::Event trace("runClipper");
 	ClipperLib::Clipper clip;
 
 	ClipperLib::Polygons clsubject;
@@ -132,6 +135,8 @@ void loopsXOR(LoopList &subject, const LoopList &apply) {
 
 void loopsOffset(LoopList& dest, const LoopList& subject, Scalar distance,
 				 bool square) {
+	StageTimer::count(StageTimer::CLIPPER_CALLS);
+	StageTimer::Event trace("loopsOffset");
 	ClipperLib::Polygons subjectPolys, destPolys;
 	loopToClPolygon(subject, subjectPolys);
 	ClipperLib::OffsetPolygons(subjectPolys, destPolys, distance * DBLTOINT, 
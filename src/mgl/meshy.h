@@ -27,6 +27,7 @@
 #include "abstractable.h"
 #include "mgl.h"
 #include "configuration.h"
+#include "thread_lock.h"
 
 
 
@@ -130,38 +131,6 @@ size_t readStlFile(mgl::Meshy &meshy, const char* filename);
 
 
 
-// compile time enabled
-// Multi threaded stuff
-//
-#ifdef OMPFF
-// a lock class for multithreaded sync
-
-class OmpGuard {
-public:
-	//Acquire the lock and store a pointer to it
-
-	OmpGuard(omp_lock_t &lock)
-	: lock_(&lock) {
-		acquire();
-	}
-
-	void acquire() {
-		omp_set_lock(lock_);
-	}
-
-	void release() {
-		omp_unset_lock(lock_);
-	}
-
-	~OmpGuard() {
-		release();
-	}
-
-private:
-	omp_lock_t *lock_; // pointer to our lock
-
-};
-#endif
 
 } // namespace
 
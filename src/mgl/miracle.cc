@@ -6,6 +6,13 @@
 // #include "abstractable.h"
 #include "miracle.h"
 #include "dump_restore.h"
+#include "instancer.h"
+#include "layer_stream.h"
+#include "container_sizes.h"
+
+#ifdef OMPFF
+#include <omp.h>
+#endif
 
 using namespace std;
 using namespace mgl;
@@ -13,6 +20,101 @@ using namespace Json;
 
 
 
+/// show how big @a container is in the timing report, when timing
+template <typename CONTAINER>
+static void recordSizes(const char* name, const CONTAINER& container) {
+	if(!StageTimer::enabled())
+		return;
+	Json::Value sizes;
+	containerSizes(container, sizes);
+	StageTimer::recordSizes(name, sizes);
+}
+
+/// plan the paths of each layer and write its gcode straight away, 
+/// on two threads in a multithreaded build that grants them
+static void streamGcode(const GrueConfig& grueCfg, 
+		const char *modelFile,
+		ostream& gcodeFile,
+		const RegionList &regions,
+		const LayerMeasure& layerMeasure,
+		const Grid& grid,
+		Pather& pather,
+		ProgressBar *progress) {
+	//the pather's progress covers both, the gcoder only adds its reports
+	GCoder gcoder(grueCfg);
+	LayerPaths layers;
+	gcoder.beginGcodeFile(gcodeFile, modelFile, regions.size());
+	const Point2Type start(grueCfg.get_startingX(), grueCfg.get_startingY());
+	bool streamed = false;
+#ifdef OMPFF
+	StageTimer::Stage* stage = StageTimer::current();
+	LayerQueue queue(grueCfg.get_streamQueueLayers());
+	//copies of the part are made as each layer passes to the writer
+	Instancer instancer(grueCfg.get_instances(), start, &queue);
+	LayerSink* sink = grueCfg.get_instances().empty() ? 
+			static_cast<LayerSink*>(&queue) : &instancer;
+	string error;
+	#pragma omp parallel num_threads(2)
+	{
+		//on one thread the planner would fill the queue and wait forever
+		const bool together = omp_get_num_threads() == 2;
+		if(omp_get_thread_num() == 0)
+			streamed = together;
+		if(together && omp_get_thread_num() == 0) {
+			StageTimer::Scope timing("planning", stage);
+			try {
+				pather.generatePaths(grueCfg, regions, layerMeasure, grid, 
+						layers, -1, -1, sink);
+			} catch (const std::exception& failure) {
+				#pragma omp critical (stream_error)
+				error = failure.what();
+			}
+			queue.close();
+		} else if(together) {
+			StageTimer::Scope timing("writing", stage);
+			LayerPaths ready;
+			try {
+				while(queue.pop(ready)) {
+					gcoder.writeLayer(gcodeFile, ready, ready.begin());
+					ready.pop_front();
+				}
+			} catch (const std::exception& failure) {
+				#pragma omp critical (stream_error)
+				error = failure.what();
+			}
+			//stops the pather if writing failed
+			queue.close();
+		}
+	}
+	if(!error.empty()) {
+		mgl::Exception failure(error);
+		throw failure;
+	}
+	if(streamed) {
+		Log::fine() << "Streaming: at most " << queue.peak() << 
+				" layers waited to be written" << endl;
+	}
+#endif
+	if(!streamed) {
+		//each layer is written as soon as it is planned, on this thread
+		LayerWriter writer(gcoder, gcodeFile);
+		Instancer writing(grueCfg.get_instances(), start, &writer);
+		pather.generatePaths(grueCfg, regions, layerMeasure, grid, layers, 
+				-1, -1, &writing);
+	}
+	gcoder.setProgress(progress);
+	gcoder.endGcodeFile(gcodeFile);
+}
+
+JobFeatures mgl::jobFeatures(const GrueConfig& grueCfg, 
+		const Segmenter& segmenter, 
+		const Limits& limits) {
+	return JobFeatures(segmenter.readAllTriangles().size(), 
+			segmenter.readSliceTable().size(), 
+			(limits.xMax - limits.xMin) * (limits.yMax - limits.yMin), 
+			grueCfg.get_doSupport());
+}
+
 //// @param slices list of output slice (output )
 
 void mgl::miracleGrue(const GrueConfig& grueCfg, 
@@ -25,16 +127,48 @@ void mgl::miracleGrue(const GrueConfig& grueCfg,
 		std::vector< SliceData >&, // slices,
 		ProgressBar *progress) {
 
+	const std::string& timingReport = grueCfg.get_timingReport();
+	const std::string& traceFile = grueCfg.get_traceFile();
+	const bool timed = !timingReport.empty() || !traceFile.empty();
+	if(timed)
+		StageTimer::enable(!traceFile.empty());
+	StageTimer::Task stage;
+
+	stage.start("load");
 	Meshy mesh(grueCfg);
 	mesh.readStlFile(modelFile);
 	mesh.alignToPlate();
 	
 	Limits limits = mesh.readLimits();
-	Grid grid;
 
+	stage.start("segment");
 	Segmenter segmenter(grueCfg);
 	segmenter.tablaturize(mesh);
+	recordSizes("sliceTable", segmenter);
+	stage.stop();
+
+	miracleGrueSegmented(grueCfg, modelFile, segmenter, limits, gcodeFile, 
+			regions, progress);
+
+	if(timed) {
+		StageTimer::disable();
+		if(!timingReport.empty())
+			StageTimer::writeReport(timingReport);
+		if(!traceFile.empty())
+			StageTimer::writeTrace(traceFile);
+	}
+}
 
+/// slice a segmented model, process its loops and find its regions
+static void regionsFromSegmenter(const GrueConfig& grueCfg, 
+		const Segmenter& segmenter,
+		const Limits& limits,
+		StageTimer::Task& stage,
+		LayerLoops& processedLoops,
+		RegionList& regions,
+		Grid& grid,
+		ProgressBar *progress) {
+	stage.start("slice");
 	Slicer slicer(grueCfg, progress);
 	LayerLoops layerloops(0.0, grueCfg.get_layerH());
 
@@ -42,43 +176,96 @@ void mgl::miracleGrue(const GrueConfig& grueCfg,
 	//slicer.tomographyze(segmenter, tomograph);
 	//new interface
 	slicer.generateLoops(segmenter, layerloops);
+	recordSizes("layerLoops", layerloops);
     
-    LayerLoops processedLoops;
-    
+    stage.start("loops");
     LoopProcessor processor(grueCfg, progress);
     processor.processLoops(layerloops, processedLoops);
-    
-    LayerMeasure& layerMeasure = processedLoops.layerMeasure;
-
 
+	stage.start("regions");
 	Regioner regioner(grueCfg, progress);
 
 	//old interface
 	//regioner.generateSkeleton(tomograph, regions);
 	//new interface
-	regioner.generateSkeleton(processedLoops, layerMeasure, regions ,
-			limits, grid);
-
-	Pather pather(grueCfg, progress);
-
-	LayerPaths layers;
-	pather.generatePaths(grueCfg, regions,
-						 layerMeasure, grid, layers);
-
-	// pather.writeGcode(gcodeFileStr, modelFile, slices);
-	//std::ofstream gout(gcodeFile);
+	//the regioner grows the limits, a kept segmenter's stay as they were
+	Limits gridLimits = limits;
+	regioner.generateSkeleton(processedLoops, processedLoops.layerMeasure, 
+			regions, gridLimits, grid);
+	recordSizes("regionList", regions);
+}
 
-	GCoder gcoder(grueCfg, progress);
+void mgl::miracleGrueSegmented(const GrueConfig& grueCfg, 
+		const char *modelFile,
+		const Segmenter& segmenter,
+		const Limits& limits,
+		ostream& gcodeFile,
+		RegionList &regions,
+		ProgressBar *progress) {
+	if(progress)
+		progress->onFeatures(jobFeatures(grueCfg, segmenter, limits));
+
+	if(!grueCfg.get_doStreaming()) {
+		LayerMeasure layerMeasure(0.0, grueCfg.get_layerH());
+		LayerPaths layers;
+		miracleGruePaths(grueCfg, segmenter, limits, regions, layerMeasure, 
+				layers, progress);
+
+		// pather.writeGcode(gcodeFileStr, modelFile, slices);
+		//std::ofstream gout(gcodeFile);
+
+		StageTimer::Task stage;
+		stage.start("gcode");
+		GCoder gcoder(grueCfg, progress);
+
+		//old interface
+		//	gcoder.writeGcodeFile(slices, layerloops.layerMeasure, gcodeFile, 
+		//			modelFile, firstSliceIdx, lastSliceIdx);
+		//new interface
+		gcoder.writeGcodeFile(layers, layerMeasure, 
+				gcodeFile, modelFile);
+
+		//gout.close();
+		return;
+	}
+
+	StageTimer::Task stage;
+	Grid grid;
+	LayerLoops processedLoops;
+	regionsFromSegmenter(grueCfg, segmenter, limits, stage, processedLoops, 
+			regions, grid, progress);
 
-	//old interface
-	//	gcoder.writeGcodeFile(slices, layerloops.layerMeasure, gcodeFile, 
-	//			modelFile, firstSliceIdx, lastSliceIdx);
-	//new interface
-	gcoder.writeGcodeFile(layers, layerMeasure, 
-			gcodeFile, modelFile);
+	Pather pather(grueCfg, progress);
+	stage.start("stream");
+	streamGcode(grueCfg, modelFile, gcodeFile, regions, 
+			processedLoops.layerMeasure, grid, pather, progress);
+}
 
-	//gout.close();
+void mgl::miracleGruePaths(const GrueConfig& grueCfg, 
+		const Segmenter& segmenter,
+		const Limits& limits,
+		RegionList &regions,
+		LayerMeasure& layerMeasure,
+		LayerPaths& layers,
+		ProgressBar *progress) {
+	StageTimer::Task stage;
+	Grid grid;
+	LayerLoops processedLoops;
+	regionsFromSegmenter(grueCfg, segmenter, limits, stage, processedLoops, 
+			regions, grid, progress);
 
+	stage.start("paths");
+	Pather pather(grueCfg, progress);
+	pather.generatePaths(grueCfg, regions,
+						 processedLoops.layerMeasure, grid, layers);
+	if(!grueCfg.get_instances().empty()) {
+		stage.start("instances");
+		Instancer instancer(grueCfg.get_instances(), 
+				Point2Type(grueCfg.get_startingX(), grueCfg.get_startingY()));
+		instancer.replicate(layers);
+	}
+	recordSizes("layerPaths", layers);
+	layerMeasure = processedLoops.layerMeasure;
 }
 
 
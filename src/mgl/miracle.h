@@ -34,6 +34,38 @@ void miracleGrue(const GrueConfig& grueCfg,
 		std::vector< SliceData > &slices,
 		ProgressBar* progress = NULL);
 
+/**
+ @brief the rest of miracleGrue, from a model already loaded and
+ segmented, so a segmenter can be kept for another job on the same model
+ with the same layer height, width ratio and placement
+ */
+void miracleGrueSegmented(const GrueConfig& grueCfg,
+		const char *modelFile,
+		const Segmenter& segmenter,
+		const Limits& limits,
+		std::ostream& gcodeFile,
+		RegionList &regions,
+		ProgressBar* progress = NULL);
+
+/**
+ @brief slice, region and plan the paths of a model already segmented,
+ and copy them to each of the config's instances, without writing them,
+ so several gcoders can write the same paths
+ @param layerMeasure receives the measure the paths were planned with
+ */
+void miracleGruePaths(const GrueConfig& grueCfg,
+		const Segmenter& segmenter,
+		const Limits& limits,
+		RegionList &regions,
+		LayerMeasure& layerMeasure,
+		LayerPaths& layers,
+		ProgressBar* progress = NULL);
+
+/// what the progress of a job is predicted from, once it is segmented
+JobFeatures jobFeatures(const GrueConfig& grueCfg,
+		const Segmenter& segmenter,
+		const Limits& limits);
+
 void slicesFromSlicerAndMesh(
 		std::vector< SliceData > &slices,
 		const SlicerConfig &slicer,
@@ -0,0 +1,234 @@
+#include "motion_model.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace mgl {
+
+MotionModel::MotionModel(const GrueConfig& grueConf) 
+        : m_acceleration(grueConf.get_maxAcceleration()), 
+        m_junctionDeviation(grueConf.get_junctionDeviation()) {}
+Scalar MotionModel::junctionSpeed(const Point2Type& inUnit, 
+        const Point2Type& outUnit, Scalar speed) const {
+    if(!isAccelerated())
+        return speed;
+    //cosine of the angle between the two moves, as seen from the corner
+    Scalar cosTheta = -inUnit.dotProduct(outUnit);
+    if(cosTheta < -0.999999)
+        return speed;   //straight ahead
+    if(cosTheta > 0.999999)
+        return 0;       //full reversal
+    Scalar sinHalf = std::sqrt(0.5 * (1.0 - cosTheta));
+    Scalar limit = std::sqrt(m_acceleration * m_junctionDeviation * 
+            sinHalf / (1.0 - sinHalf));
+    return std::min(limit, speed);
+}
+Scalar MotionModel::reachableSpeed(Scalar speed, Scalar length) const {
+    if(!isAccelerated())
+        return std::numeric_limits<Scalar>::max();
+    return std::sqrt(speed * speed + 2.0 * m_acceleration * length);
+}
+Scalar MotionModel::moveTime(Scalar length, Scalar entrySpeed, 
+        Scalar cruiseSpeed, Scalar exitSpeed) const {
+    if(length <= 0 || cruiseSpeed <= 0)
+        return 0;
+    if(!isAccelerated())
+        return length / cruiseSpeed;
+    const Scalar a = m_acceleration;
+    Scalar v0 = std::min(std::max(entrySpeed, Scalar(0)), cruiseSpeed);
+    Scalar v1 = std::min(std::max(exitSpeed, Scalar(0)), cruiseSpeed);
+    Scalar accelDistance = (cruiseSpeed * cruiseSpeed - v0 * v0) / (2 * a);
+    Scalar decelDistance = (cruiseSpeed * cruiseSpeed - v1 * v1) / (2 * a);
+    if(accelDistance + decelDistance <= length) {
+        //full trapezoid
+        return (cruiseSpeed - v0) / a + (cruiseSpeed - v1) / a + 
+                (length - accelDistance - decelDistance) / cruiseSpeed;
+    }
+    //triangle, peak where the acceleration and deceleration ramps meet
+    Scalar peakSquared = a * length + 0.5 * (v0 * v0 + v1 * v1);
+    Scalar peak = std::sqrt(peakSquared);
+    if(peak >= std::max(v0, v1))
+        return (peak - v0) / a + (peak - v1) / a;
+    //too short to reach the requested exit speed, ramp all the way
+    Scalar from = std::max(v0, v1);
+    Scalar to = std::sqrt(std::max(Scalar(0), from * from - 2 * a * length));
+    return (from - to) / a;
+}
+
+MotionEstimate::MotionEstimate(const MotionModel& model) 
+        : m_model(model), m_hasPosition(false), m_total(0), 
+        m_pending(false), m_pendingLength(0), m_pendingSpeed(0), 
+        m_pendingEntry(0) {}
+void MotionEstimate::reset(const Point2Type& position) {
+    m_position = position;
+    m_hasPosition = true;
+    m_total = 0;
+    m_pending = false;
+}
+void MotionEstimate::moveTo(const Point2Type& point, Scalar speed) {
+    if(!m_hasPosition) {
+        m_position = point;
+        m_hasPosition = true;
+        return;
+    }
+    Point2Type delta = point - m_position;
+    Scalar length = delta.magnitude();
+    if(length <= 0 || speed <= 0)
+        return;
+    Point2Type unit = delta * (1.0 / length);
+    Scalar entry = 0;
+    if(m_pending) {
+        Scalar corner = m_model.junctionSpeed(m_pendingUnit, unit, 
+                std::min(m_pendingSpeed, speed));
+        corner = std::min(corner, 
+                m_model.reachableSpeed(m_pendingEntry, m_pendingLength));
+        flush(corner);
+        entry = corner;
+    }
+    m_pending = true;
+    m_pendingLength = length;
+    m_pendingSpeed = speed;
+    m_pendingEntry = entry;
+    m_pendingUnit = unit;
+    m_position = point;
+}
+void MotionEstimate::stop() {
+    if(m_pending)
+        flush(0);
+}
+Scalar MotionEstimate::total() const {
+    if(!m_pending)
+        return m_total;
+    return m_total + m_model.moveTime(m_pendingLength, m_pendingEntry, 
+            m_pendingSpeed, 0);
+}
+void MotionEstimate::flush(Scalar exitSpeed) {
+    m_total += m_model.moveTime(m_pendingLength, m_pendingEntry, 
+            m_pendingSpeed, exitSpeed);
+    m_pending = false;
+}
+
+MotionPlanner::MotionPlanner(const MotionModel& model) 
+        : m_model(model), m_hasPosition(false), m_stopped(true), 
+        m_dwell(0) {}
+void MotionPlanner::reset(const Point2Type& position) {
+    m_position = position;
+    m_hasPosition = true;
+    m_stopped = true;
+    m_dwell = 0;
+    m_blocks.clear();
+}
+void MotionPlanner::moveTo(const Point2Type& point, Scalar speed) {
+    if(!m_hasPosition) {
+        m_position = point;
+        m_hasPosition = true;
+        return;
+    }
+    Point2Type delta = point - m_position;
+    Scalar length = delta.magnitude();
+    if(length <= 0 || speed <= 0)
+        return;
+    Point2Type unit = delta * (1.0 / length);
+    Scalar maxEntry = 0;
+    if(!m_stopped && !m_blocks.empty()) {
+        const block& last = m_blocks.back();
+        maxEntry = m_model.junctionSpeed(last.m_unit, unit, 
+                std::min(last.m_speed, speed));
+    }
+    m_blocks.push_back(block(length, speed, maxEntry, unit));
+    m_position = point;
+    m_stopped = false;
+}
+void MotionPlanner::stop() {
+    m_stopped = true;
+}
+void MotionPlanner::dwell(Scalar seconds) {
+    if(seconds > 0)
+        m_dwell += seconds;
+}
+Scalar MotionPlanner::plan() {
+    //backward pass, every move must be able to stop at the end
+    Scalar exit = 0;
+    for(block_list::reverse_iterator iter = m_blocks.rbegin(); 
+            iter != m_blocks.rend(); 
+            ++iter) {
+        iter->m_entry = std::min(iter->m_maxEntry, 
+                m_model.reachableSpeed(exit, iter->m_length));
+        exit = iter->m_entry;
+    }
+    //forward pass, and time each move once its exit is known
+    Scalar total = m_dwell;
+    for(block_list::iterator iter = m_blocks.begin(); 
+            iter != m_blocks.end(); 
+            ++iter) {
+        block_list::iterator next = iter;
+        ++next;
+        Scalar exitSpeed = 0;
+        if(next != m_blocks.end()) {
+            next->m_entry = std::min(next->m_entry, 
+                    m_model.reachableSpeed(iter->m_entry, iter->m_length));
+            exitSpeed = next->m_entry;
+        }
+        total += m_model.moveTime(iter->m_length, iter->m_entry, 
+                iter->m_speed, exitSpeed);
+    }
+    return total;
+}
+
+static Scalar profileSpeed(const GrueConfig& grueConf, 
+        const std::string& profile, Scalar fallback) {
+    GrueConfig::profileNameMap::const_iterator found = 
+            grueConf.get_extrusionProfiles().find(profile);
+    if(found == grueConf.get_extrusionProfiles().end())
+        return fallback;
+    return found->second.feedrate;
+}
+LabelSpeeds::LabelSpeeds(const GrueConfig& grueConf) 
+        : m_travel(grueConf.get_rapidMoveFeedRateXY()) {
+    m_inset = m_infill = m_outline = m_travel;
+    if(grueConf.get_defaultExtruder() < grueConf.get_extruders().size()) {
+        const Extruder& extruder = 
+                grueConf.get_extruders()[grueConf.get_defaultExtruder()];
+        m_inset = profileSpeed(grueConf, extruder.insetsExtrusionProfile, 
+                m_travel);
+        m_infill = profileSpeed(grueConf, extruder.infillsExtrusionProfile, 
+                m_travel);
+        m_outline = profileSpeed(grueConf, extruder.outlinesExtrusionProfile, 
+                m_travel);
+    }
+}
+Scalar LabelSpeeds::speed(const PathLabel& label) const {
+    if(label.isInset())
+        return m_inset;
+    if(label.isOutline())
+        return m_outline;
+    return m_infill;
+}
+
+void estimatePathTime(MotionEstimate& estimate, const LabelSpeeds& speeds, 
+        const OpenPath& path, const PathLabel& label) {
+    if(path.empty())
+        return;
+    OpenPath::const_iterator point = path.fromStart();
+    if(estimate.hasPosition() && *point != estimate.position()) {
+        estimate.stop();
+        estimate.moveTo(*point, speeds.travel());
+        estimate.stop();
+    } else {
+        estimate.moveTo(*point, speeds.travel());
+    }
+    Scalar speed = speeds.speed(label);
+    for(++point; point != path.end(); ++point) {
+        estimate.moveTo(*point, speed);
+    }
+}
+void estimatePathTime(MotionEstimate& estimate, const LabelSpeeds& speeds, 
+        const std::list<LabeledOpenPath>& paths) {
+    for(std::list<LabeledOpenPath>::const_iterator iter = paths.begin(); 
+            iter != paths.end(); 
+            ++iter) {
+        estimatePathTime(estimate, speeds, iter->myPath, iter->myLabel);
+    }
+}
+
+}
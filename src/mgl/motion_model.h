@@ -0,0 +1,191 @@
+/* 
+ * File:   motion_model.h
+ *
+ * Estimates of how long the gantry takes to follow a toolpath
+ */
+
+#ifndef MGL_MOTION_MODEL_H
+#define	MGL_MOTION_MODEL_H
+
+#include "mgl.h"
+#include "labeled_path.h"
+#include "configuration.h"
+#include <list>
+#include <vector>
+
+namespace mgl {
+
+/**
+ @brief Kinematic limits of the gantry in the XY plane.
+ 
+ Moves follow a trapezoidal velocity profile: accelerate at a constant 
+ rate, cruise, decelerate. Corners are taken at the speed that keeps 
+ the toolhead within a junction deviation of the ideal path, like 
+ grbl derived firmwares do. An acceleration of zero or less means 
+ instant speed changes, and all times become distance over speed.
+ */
+class MotionModel {
+public:
+    MotionModel(Scalar acceleration = 0, Scalar junctionDeviation = 0) 
+            : m_acceleration(acceleration), 
+            m_junctionDeviation(junctionDeviation) {}
+    /// limits from maxAcceleration and junctionDeviation
+    MotionModel(const GrueConfig& grueConf);
+    
+    bool isAccelerated() const { return m_acceleration > 0; }
+    Scalar acceleration() const { return m_acceleration; }
+    Scalar junctionDeviation() const { return m_junctionDeviation; }
+    
+    /**
+     @brief highest speed at which a corner can be taken
+     @param inUnit direction of travel into the corner
+     @param outUnit direction of travel out of the corner
+     @param speed the speed of the moves on either side
+     @return a speed between 0 and @a speed
+     */
+    Scalar junctionSpeed(const Point2Type& inUnit, 
+            const Point2Type& outUnit, Scalar speed) const;
+    /**
+     @brief time to cover a straight move
+     @param length length of the move
+     @param entrySpeed speed at the start of the move
+     @param cruiseSpeed the speed to reach if there is room
+     @param exitSpeed speed at the end of the move
+     @return the time in seconds. If the move is too short to go from 
+     @a entrySpeed to @a exitSpeed, it ends at whatever speed it can
+     */
+    Scalar moveTime(Scalar length, Scalar entrySpeed, Scalar cruiseSpeed, 
+            Scalar exitSpeed) const;
+    /**
+     @brief highest speed that can be reached from @a speed over @a length
+     */
+    Scalar reachableSpeed(Scalar speed, Scalar length) const;
+private:
+    Scalar m_acceleration;
+    Scalar m_junctionDeviation;
+};
+
+/**
+ @brief Adds up the time of a sequence of moves, one at a time.
+ 
+ Each move is timed once the next one is known, so the corner between 
+ them can be taken into account. This looks ahead only one move, so 
+ it is a fast estimate rather than an exact plan.
+ */
+class MotionEstimate {
+public:
+    MotionEstimate(const MotionModel& model = MotionModel());
+    
+    /// forget everything and start over at @a position
+    void reset(const Point2Type& position);
+    /// move in a straight line to @a point at most at @a speed
+    void moveTo(const Point2Type& point, Scalar speed);
+    /// come to a full stop, as for a retraction
+    void stop();
+    /// the time of all moves so far, including one still being planned
+    Scalar total() const;
+    const Point2Type& position() const { return m_position; }
+    bool hasPosition() const { return m_hasPosition; }
+private:
+    void flush(Scalar exitSpeed);
+    
+    MotionModel m_model;
+    Point2Type m_position;
+    bool m_hasPosition;
+    Scalar m_total;
+    //the last move, waiting for the next one
+    bool m_pending;
+    Scalar m_pendingLength;
+    Scalar m_pendingSpeed;
+    Scalar m_pendingEntry;
+    Point2Type m_pendingUnit;
+};
+
+/**
+ @brief Plans a sequence of moves the way the firmware does.
+ 
+ Moves are queued with their feedrates, and the corner speed between 
+ each pair is limited by junction deviation. Planning then makes a 
+ backward pass, so each move can slow down in time for what follows, 
+ and a forward pass, so each move only reaches speeds it can 
+ accelerate to. Each move is then timed with its trapezoidal profile. 
+ Unlike MotionEstimate, this looks ahead over all queued moves.
+ */
+class MotionPlanner {
+public:
+    MotionPlanner(const MotionModel& model = MotionModel());
+    
+    /// forget all moves and start over at @a position
+    void reset(const Point2Type& position);
+    /// queue a straight move to @a point at most at @a speed
+    void moveTo(const Point2Type& point, Scalar speed);
+    /// the next move starts at rest, as after a retraction
+    void stop();
+    /// add time spent without moving in XY, like retractions or Z moves
+    void dwell(Scalar seconds);
+    /// plan all queued moves and return their time in seconds
+    Scalar plan();
+    
+    const Point2Type& position() const { return m_position; }
+    bool hasPosition() const { return m_hasPosition; }
+    size_t size() const { return m_blocks.size(); }
+private:
+    class block {
+    public:
+        block(Scalar length, Scalar speed, Scalar maxEntry, 
+                const Point2Type& unit) 
+                : m_length(length), m_speed(speed), m_maxEntry(maxEntry), 
+                m_entry(maxEntry), m_unit(unit) {}
+        Scalar m_length;
+        Scalar m_speed;
+        Scalar m_maxEntry;
+        Scalar m_entry;
+        Point2Type m_unit;
+    };
+    typedef std::vector<block> block_list;
+    
+    MotionModel m_model;
+    Point2Type m_position;
+    bool m_hasPosition;
+    bool m_stopped;
+    Scalar m_dwell;
+    block_list m_blocks;
+};
+
+/**
+ @brief Feedrates used when estimating the time of labeled paths, 
+ taken from the extrusion profiles of the default extruder.
+ */
+class LabelSpeeds {
+public:
+    LabelSpeeds(const GrueConfig& grueConf);
+    /// speed of extruding a path with @a label
+    Scalar speed(const PathLabel& label) const;
+    /// speed of moving without extruding
+    Scalar travel() const { return m_travel; }
+private:
+    Scalar m_inset;
+    Scalar m_infill;
+    Scalar m_outline;
+    Scalar m_travel;
+};
+
+/**
+ @brief Add the time to print @a path to @a estimate. If the path does 
+ not start where the estimate is, it is reached by a travel move that 
+ starts and ends at rest.
+ @param estimate accumulates the time, and holds the current position
+ @param speeds the feedrate of each kind of path
+ @param path the path to time
+ @param label decides the feedrate of @a path
+ */
+void estimatePathTime(MotionEstimate& estimate, const LabelSpeeds& speeds, 
+        const OpenPath& path, const PathLabel& label);
+/// as above, for each of @a paths in order
+void estimatePathTime(MotionEstimate& estimate, const LabelSpeeds& speeds, 
+        const std::list<LabeledOpenPath>& paths);
+
+}
+
+#endif	/* MGL_MOTION_MODEL_H */
+
@@ -27,16 +27,78 @@
 
 #include <list>
 #include <vector>
+#include <limits>
+#include <algorithm>
 
 #include "pather.h"
 #include "limits.h"
 #include "pather_optimizer_graph.h"
 #include "pather_optimizer_fastgraph.h"
 #include "dump_restore.h"
+#include "task_scheduler.h"
 
 namespace mgl {
 using namespace std;
 
+/* More chunks than threads keeps the workers busy when layers differ 
+ in cost, fewer chunks means fewer layers with a guessed entry point */
+static const size_t PATHING_CHUNKS_PER_THREAD = 4;
+
+/* The first layer of a chunk other than the first guesses its entry 
+ point by planning the layer below it once more and throwing the result 
+ away. Inside a chunk every layer starts where the previous one ended, 
+ just like the serial case. */
+class Pather::ChunkPlanner {
+public:
+    ChunkPlanner(Pather& owner, const GrueConfig& config, 
+            const Grid& layerGrid, 
+            const std::vector<const LayerRegions*>& regions, 
+            const std::vector<bool>& directions, 
+            const std::vector<LayerPaths::Layer::ExtruderLayer*>& layers, 
+            std::vector<Point2Type>& entries) 
+            : pather(owner), grueCfg(config), grid(layerGrid), 
+            jobRegions(regions), jobDirections(directions), 
+            jobLayers(layers), predictedEntries(entries) {}
+    void operator()(size_t chunkBegin, size_t chunkEnd, size_t chunk) {
+        abstract_optimizer* optimizer = NULL;
+        if(grueCfg.get_doGraphOptimization()) {
+            optimizer = new pather_optimizer_fastgraph(grueCfg);
+        } else {
+            optimizer = new pather_optimizer();
+        }
+        if(chunkBegin > 0) {
+            LayerPaths::Layer::ExtruderLayer scratch;
+            pather.generateLayerPaths(grueCfg, *jobRegions[chunkBegin - 1], 
+                    grid, jobDirections[chunkBegin - 1], *optimizer, 
+                    scratch, chunkBegin - 1);
+            if(!scratch.paths.empty() && 
+                    !scratch.paths.back().myPath.empty()) {
+                predictedEntries[chunk] = 
+                        *scratch.paths.back().myPath.fromEnd();
+            }
+        }
+        for(size_t layer = chunkBegin; layer < chunkEnd; ++layer) {
+#ifdef OMPFF
+            #pragma omp critical (pather_progress)
+#endif
+            pather.tick();
+            pather.pathingReport.layers[layer] = pather.generateLayerPaths(
+                    grueCfg, *jobRegions[layer], grid, 
+                    jobDirections[layer], *optimizer, *jobLayers[layer], 
+                    layer);
+        }
+        delete optimizer;
+    }
+private:
+    Pather& pather;
+    const GrueConfig& grueCfg;
+    const Grid& grid;
+    const std::vector<const LayerRegions*>& jobRegions;
+    const std::vector<bool>& jobDirections;
+    const std::vector<LayerPaths::Layer::ExtruderLayer*>& jobLayers;
+    std::vector<Point2Type>& predictedEntries;
+};
+
 Pather::Pather(const PatherConfig& pCfg, ProgressBar* progress) 
 		: Progressive(progress), patherCfg(pCfg) {}
 Pather::Pather(const GrueConfig& grueConf, ProgressBar* progress)
@@ -52,7 +114,8 @@ void Pather::generatePaths(const GrueConfig& grueCfg,
 		const Grid &grid,
 		LayerPaths &layerpaths,
 		int sfirstSliceIdx, // =-1
-		int slastSliceIdx) //
+		int slastSliceIdx, // =-1
+		LayerSink* sink) // =NULL
 {
 	size_t firstSliceIdx = 0;
 	size_t lastSliceIdx = INT_MAX;
@@ -70,17 +133,15 @@ void Pather::generatePaths(const GrueConfig& grueCfg,
 
 	initProgress("Path generation", skeleton.size());
     
-    abstract_optimizer* optimizer = NULL;
-    if(grueCfg.get_doGraphOptimization()) {
-        optimizer = new pather_optimizer_fastgraph(grueCfg);
-    } else {
-        optimizer = new pather_optimizer();
-    }
+    /* Decide the direction of every layer and create its output up front, 
+     so that the layers themselves can be planned in any order */
+    std::vector<const LayerRegions*> jobRegions;
+    std::vector<bool> jobDirections;
+    std::vector<LayerPaths::Layer::ExtruderLayer*> jobLayers;
+    std::vector<LayerPaths::layer_iterator> jobIterators;
 
 	for (RegionList::const_iterator layerRegions = skeleton.begin();
-			layerRegions != skeleton.end(); ++layerRegions) {
-		tick();
-        try {
+			layerRegions != skeleton.end(); ++layerRegions, ++currentSlice) {
 		if (currentSlice < firstSliceIdx) continue;
 		if (currentSlice > lastSliceIdx) break;
         if(grueCfg.get_doRaft() && currentSlice > 1 && 
@@ -106,27 +167,167 @@ void Pather::generatePaths(const GrueConfig& grueCfg,
 		// it does not handle a dualstrusion print
 		lp_layer.extruders.push_back(
 				LayerPaths::Layer::ExtruderLayer(grueCfg.get_defaultExtruder()));
-		LayerPaths::Layer::ExtruderLayer& extruderlayer =
-				lp_layer.extruders.back();
-		
+        
+        jobRegions.push_back(&*layerRegions);
+        jobDirections.push_back(direction);
+        jobLayers.push_back(&lp_layer.extruders.back());
+        jobIterators.push_back(--layerpaths.end());
+	}
+    
+    const size_t layerCount = jobLayers.size();
+    TaskScheduler scheduler(grueCfg.get_pathingThreads());
+    /* Chunks cost travel and an extra layer of planning each, only worth 
+     it when they really run at the same time */
+    const size_t threadCount = scheduler.parallel() ? 
+            scheduler.threadCount() : 1;
+    
+    pathingReport = PathingReport();
+    pathingReport.layerCount = layerCount;
+    pathingReport.threadCount = threadCount;
+    pathingReport.layers.assign(layerCount, OptimizerReport());
+    
+    //layers handed to the sink are gone by the time travel is measured
+    Point2Type lastExit;
+    bool haveExit = false;
+    
+    if(threadCount < 2 || layerCount < 2 || sink) {
+        abstract_optimizer* optimizer = NULL;
+        if(grueCfg.get_doGraphOptimization()) {
+            optimizer = new pather_optimizer_fastgraph(grueCfg);
+        } else {
+            optimizer = new pather_optimizer();
+        }
+        for(size_t layer = 0; layer < layerCount; ++layer) {
+            tick();
+            pathingReport.layers[layer] = generateLayerPaths(grueCfg, 
+                    *jobRegions[layer], grid, jobDirections[layer], 
+                    *optimizer, *jobLayers[layer], layer);
+            if(sink) {
+                const LabeledOpenPaths& current = jobLayers[layer]->paths;
+                if(!current.empty() && !current.front().myPath.empty() && 
+                        haveExit) {
+                    pathingReport.entryTravel += 
+                            (*current.front().myPath.fromStart() - 
+                            lastExit).magnitude();
+                }
+                if(!current.empty() && !current.back().myPath.empty()) {
+                    lastExit = *current.back().myPath.fromEnd();
+                    haveExit = true;
+                } else {
+                    haveExit = false;
+                }
+                sink->layerReady(layerpaths, jobIterators[layer]);
+            }
+        }
+        delete optimizer;
+    } else {
+        /* Layers are split into contiguous chunks, planned on their own. 
+         Only the first layer of each chunk has to guess its entry point. */
+        const size_t chunkCount = std::min(layerCount, 
+                threadCount * PATHING_CHUNKS_PER_THREAD);
+        std::vector<Point2Type> predictedEntries(chunkCount);
+        ChunkPlanner planner(*this, grueCfg, grid, jobRegions, 
+                jobDirections, jobLayers, predictedEntries);
+        scheduler.parallelFor(0, layerCount, chunkCount, planner);
+        /* Sequential fix-up: now that the real exit point of every layer 
+         is known, start each predicted layer as close to it as we can */
+        for(size_t chunk = 1; chunk < chunkCount; ++chunk) {
+            const size_t layer = layerCount * chunk / chunkCount;
+            const LabeledOpenPaths& below = jobLayers[layer - 1]->paths;
+            LabeledOpenPaths& current = jobLayers[layer]->paths;
+            if(below.empty() || below.back().myPath.empty() || 
+                    current.empty() || current.front().myPath.empty())
+                continue;
+            const Point2Type exitPoint = *below.back().myPath.fromEnd();
+            Scalar before = (*current.front().myPath.fromStart() - 
+                    exitPoint).magnitude();
+            fixLayerEntry(grueCfg, exitPoint, *jobLayers[layer]);
+            Scalar after = (*current.front().myPath.fromStart() - 
+                    exitPoint).magnitude();
+            ++pathingReport.predictedLayers;
+            pathingReport.predictionError += 
+                    (predictedEntries[chunk] - exitPoint).magnitude();
+            pathingReport.fixupSavings += before - after;
+        }
+    }
+    
+    for(size_t layer = 1; layer < layerCount && !sink; ++layer) {
+        const LabeledOpenPaths& below = jobLayers[layer - 1]->paths;
+        const LabeledOpenPaths& current = jobLayers[layer]->paths;
+        if(below.empty() || below.back().myPath.empty() || 
+                current.empty() || current.front().myPath.empty())
+            continue;
+        pathingReport.entryTravel += (*current.front().myPath.fromStart() - 
+                *below.back().myPath.fromEnd()).magnitude();
+    }
+    
+    if(pathingReport.predictedLayers) {
+        Log::info() << "Path generation: " << layerCount << 
+                " layers on " << threadCount << " threads, " << 
+                pathingReport.predictedLayers << 
+                " planned from a predicted entry (mean error " << 
+                pathingReport.predictionError / 
+                pathingReport.predictedLayers << "mm)" << std::endl;
+        Log::info() << "Path generation: layer entry travel " << 
+                pathingReport.entryTravel << "mm, fix-up recovered " << 
+                pathingReport.fixupSavings << "mm" << std::endl;
+    }
+    for(size_t layer = 0; layer < layerCount; ++layer) {
+        const OptimizerReport& layerReport = pathingReport.layers[layer];
+        pathingReport.iterativeSavings += layerReport.travelSaved;
+        pathingReport.timeBefore += layerReport.timeBefore;
+        pathingReport.timeAfter += layerReport.timeAfter;
+        if(layerReport.travelSaved > 0) {
+            Log::fine() << "Path generation: layer " << layer << 
+                    " travel shortened by " << 
+                    layerReport.travelSaved << "mm" << std::endl;
+        }
+        if(layerReport.timeAfter > 0) {
+            Log::fine() << "Path generation: layer " << layer << 
+                    " estimated " << layerReport.timeBefore << 
+                    "s before optimization, " << layerReport.timeAfter << 
+                    "s after" << std::endl;
+        }
+    }
+    if(pathingReport.iterativeSavings > 0) {
+        Log::info() << "Path generation: travel shortened by " << 
+                pathingReport.iterativeSavings << "mm" << std::endl;
+    }
+    if(pathingReport.timeAfter > 0) {
+        Log::info() << "Path generation: estimated print time " << 
+                pathingReport.timeBefore << "s before optimization, " << 
+                pathingReport.timeAfter << "s after" << std::endl;
+    }
+}
+
+OptimizerReport Pather::generateLayerPaths(const GrueConfig& grueCfg, 
+        const LayerRegions& layerRegions, 
+        const Grid& grid, 
+        bool direction, 
+        abstract_optimizer& optimizer, 
+        LayerPaths::Layer::ExtruderLayer& extruderlayer, 
+        size_t layerIndex) {
+        StageTimer::Event layerTrace("layer", int(layerIndex));
+        OptimizerReport optimizerReport;
+        try {
 //        Json::Value spurLoops;
 //        for(std::list<LoopList>::const_iterator depthIter = 
-//                layerRegions->spurLoops.begin(); 
-//                depthIter != layerRegions->spurLoops.end(); 
+//                layerRegions.spurLoops.begin(); 
+//                depthIter != layerRegions.spurLoops.end(); 
 //                ++depthIter) {
 //            dumpLoopList(*depthIter, spurLoops);
 //        }
 //        std::cerr << Json::FastWriter().write(spurLoops);
 		
-		optimizer->clearBoundaries();
-        optimizer->clearPaths();
+		optimizer.clearBoundaries();
+        optimizer.clearPaths();
 
-		const std::list<LoopList>& insetLoops = layerRegions->insetLoops;
-		const std::list<OpenPathList>& spurPaths = layerRegions->spurs;
+		const std::list<LoopList>& insetLoops = layerRegions.insetLoops;
+		const std::list<OpenPathList>& spurPaths = layerRegions.spurs;
 		
         if(grueCfg.get_doOutlines()) {
-            for(LoopList::const_iterator iter = layerRegions->outlines.begin(); 
-                    iter != layerRegions->outlines.end(); 
+            for(LoopList::const_iterator iter = layerRegions.outlines.begin(); 
+                    iter != layerRegions.outlines.end(); 
                     ++iter) {
                 const LoopPath outlinePath(*iter, iter->clockwise(), 
                         iter->counterClockwise());
@@ -139,8 +340,8 @@ void Pather::generatePaths(const GrueConfig& grueCfg,
                     path.appendPoint(*pointIter);
                 }
             }
-            for(LoopList::const_iterator iter = layerRegions->supportLoops.begin(); 
-                    iter != layerRegions->supportLoops.end(); 
+            for(LoopList::const_iterator iter = layerRegions.supportLoops.begin(); 
+                    iter != layerRegions.supportLoops.end(); 
                     ++iter) {
                 const LoopPath outlinePath(*iter, iter->clockwise(), 
                         iter->counterClockwise());
@@ -155,7 +356,7 @@ void Pather::generatePaths(const GrueConfig& grueCfg,
             }
         }
 		
-		optimizer->addBoundaries(layerRegions->outlines);	
+		optimizer.addBoundaries(layerRegions.outlines);	
         
         bool hasInfill = grueCfg.get_doInfills() && 
                 grueCfg.get_infillDensity() > 0;
@@ -163,29 +364,23 @@ void Pather::generatePaths(const GrueConfig& grueCfg,
                 grueCfg.get_floorLayerCount() > 0;
         
         if(!hasInfill && !hasSolidLayers) {
-            optimizer->addBoundaries(layerRegions->interiorLoops);
+            optimizer.addBoundaries(layerRegions.interiorLoops);
         }
         
-        const GridRanges& infillRanges = layerRegions->infill;
+        const GridRanges& infillRanges = layerRegions.infill;
 
-		const std::vector<Scalar>& values = 
-				!direction ? grid.getXValues() : grid.getYValues();
 		axis_e axis = direction ? X_AXIS : Y_AXIS;
         
         if(grueCfg.get_doRaft() || grueCfg.get_doSupport()) {
             LoopList outsetSupportLoops;
-            loopsOffset(outsetSupportLoops, layerRegions->supportLoops, 
+            loopsOffset(outsetSupportLoops, layerRegions.supportLoops, 
                     0.01);
-            optimizer->addBoundaries(outsetSupportLoops);
+            optimizer.addBoundaries(outsetSupportLoops);
             
-            const GridRanges& supportRanges = layerRegions->support;
+            const GridRanges& supportRanges = layerRegions.support;
             OpenPathList supportPaths;
-            grid.gridRangesToOpenPaths(
-                    direction ? supportRanges.xRays : supportRanges.yRays, 
-                    values, 
-                    axis, 
-                    supportPaths);
-            optimizer->addPaths(supportPaths, PathLabel(PathLabel::TYP_INFILL, 
+            grid.gridRangesToOpenPaths(supportRanges, axis, supportPaths);
+            optimizer.addPaths(supportPaths, PathLabel(PathLabel::TYP_INFILL, 
                     PathLabel::OWN_SUPPORT, 0));
         }
 		if(grueCfg.get_doInsets()) {
@@ -194,7 +389,7 @@ void Pather::generatePaths(const GrueConfig& grueCfg,
                     listIter != insetLoops.end(); 
                     ++listIter) {
                 int shellVal = currentShell;
-                optimizer->addPaths(*listIter, 
+                optimizer.addPaths(*listIter, 
                         PathLabel(PathLabel::TYP_INSET, 
                         PathLabel::OWN_MODEL, shellVal));
                 ++currentShell;
@@ -205,7 +400,7 @@ void Pather::generatePaths(const GrueConfig& grueCfg,
                 spurIter != spurPaths.end(); 
                     ++spurIter) {
                 int shellVal = currentShell;
-                optimizer->addPaths(*spurIter, 
+                optimizer.addPaths(*spurIter, 
                         PathLabel(PathLabel::TYP_INSET, 
                         PathLabel::OWN_MODEL, shellVal));
                 ++currentShell;
@@ -213,20 +408,17 @@ void Pather::generatePaths(const GrueConfig& grueCfg,
         }
 
 		OpenPathList infillPaths;
-		grid.gridRangesToOpenPaths(
-				direction ? infillRanges.xRays : infillRanges.yRays,  
-				values, 
-				axis, 
-				infillPaths);
+		grid.gridRangesToOpenPaths(infillRanges, axis, infillPaths);
 		
 		LabeledOpenPaths preoptimized;
 		
         if(grueCfg.get_doInfills()) {
-            optimizer->addPaths(infillPaths, PathLabel(PathLabel::TYP_INFILL, 
+            optimizer.addPaths(infillPaths, PathLabel(PathLabel::TYP_INFILL, 
                     PathLabel::OWN_MODEL, 
                     LayerPaths::Layer::ExtruderLayer::INFILL_LABEL_VALUE));
         }
-        optimizer->optimize(preoptimized);
+        optimizer.optimize(preoptimized);
+        optimizerReport = optimizer.report();
 //        smoothCollection(preoptimized, grueCfg.get_coarseness(), 
 //                grueCfg.get_directionWeight());
         cleanPaths(preoptimized);
@@ -236,12 +428,72 @@ void Pather::generatePaths(const GrueConfig& grueCfg,
         extruderlayer.paths.insert(extruderlayer.paths.end(), 
                 preoptimized.begin(), preoptimized.end());
         } catch (const std::exception& our) {
+#ifdef OMPFF
+            #pragma omp critical (pather_errors)
+#endif
             std::cout << "Error " << our.what() << " on layer " << 
-                    currentSlice << std::endl;
+                    layerIndex << std::endl;
         }
-		++currentSlice;
-	}
-    delete optimizer;
+        return optimizerReport;
+}
+
+void Pather::fixLayerEntry(const GrueConfig& grueCfg, 
+        const Point2Type& exitPoint, 
+        LayerPaths::Layer::ExtruderLayer& extruderlayer) {
+    LabeledOpenPaths& paths = extruderlayer.paths;
+    if(paths.empty())
+        return;
+    LabeledOpenPaths::iterator first = paths.begin();
+    LabeledOpenPaths::iterator next = first;
+    ++next;
+    OpenPath& path = first->myPath;
+    if(path.size() < 2)
+        return;
+    const Point2Type start = *path.fromStart();
+    const Point2Type end = *path.fromEnd();
+    std::vector<Point2Type> points;
+    points.reserve(path.size());
+    for(OpenPath::iterator iter = path.fromStart(); 
+            iter != path.end(); 
+            ++iter) {
+        points.push_back(*iter);
+    }
+    if(start == end && points.size() > 2) {
+        //seams were deliberately aligned, leave them be
+        if(grueCfg.get_doFixedLayerStart())
+            return;
+        points.pop_back();
+        size_t best = 0;
+        Scalar bestDistance = std::numeric_limits<Scalar>::max();
+        for(size_t i = 0; i < points.size(); ++i) {
+            Scalar distance = (points[i] - exitPoint).squaredMagnitude();
+            if(distance < bestDistance) {
+                bestDistance = distance;
+                best = i;
+            }
+        }
+        if(best == 0)
+            return;
+        path.clear();
+        for(size_t i = 0; i <= points.size(); ++i) {
+            path.appendPoint(points[(best + i) % points.size()]);
+        }
+        //the connection leaving the old seam now starts in the wrong place
+        if(next != paths.end() && next->myLabel.isConnection()) {
+            paths.erase(next);
+        }
+    } else {
+        //reversing would break the chain into the next path
+        if(next != paths.end() && !next->myPath.empty() && 
+                (*next->myPath.fromStart() - end).squaredMagnitude() <= 
+                patherCfg.coarseness * patherCfg.coarseness)
+            return;
+        if((end - exitPoint).squaredMagnitude() >= 
+                (start - exitPoint).squaredMagnitude())
+            return;
+        path.clear();
+        path.appendPoints(points.rbegin(), points.rend());
+    }
 }
 
 void Pather::cleanPaths(LabeledOpenPaths& result) {
@@ -18,6 +18,7 @@
 #include "regioner.h"
 #include "loop_path.h"
 #include "labeled_path.h"
+#include "pather_optimizer.h"
 
 #include <list>
 
@@ -114,6 +115,8 @@ public:
 	layer_iterator insert(layer_iterator at, const Layer& value);
 	layer_iterator erase(layer_iterator at);
 	layer_iterator erase(layer_iterator from, layer_iterator to);
+	/// move @a layer of @a other before @a at, without copying it
+	void splice(layer_iterator at, LayerPaths& other, layer_iterator layer);
 	bool empty() const;
 	size_t layerCount() const;
 	Layer& back();
@@ -121,6 +124,20 @@ private:
 	LayerList layers;
 };
 
+/**
+ @brief Receives layers from Pather::generatePaths as soon as each one 
+ is finished, in order.
+ 
+ The layer is left in the LayerPaths it came from, and the sink may 
+ erase it or splice it elsewhere. Pather doesn't touch it again.
+ */
+class LayerSink {
+public:
+	virtual ~LayerSink() {}
+	virtual void layerReady(LayerPaths& from, 
+			LayerPaths::layer_iterator layer) = 0;
+};
+
 ::std::ostream& operator<<(::std::ostream& os, const ExtruderSlice& x);
 
 typedef std::vector<ExtruderSlice > ExtruderSlices;
@@ -160,10 +177,44 @@ public:
 ::std::ostream& operator<<(::std::ostream& os, const SliceData& x);
 
 
+/**
+ @brief Travel statistics gathered by the last call to 
+ Pather::generatePaths. 
+ 
+ When layers are planned in parallel, some layers start from a predicted 
+ entry point instead of the real exit point of the layer below. These 
+ numbers describe how much layer-to-layer travel that costs.
+ */
+class PathingReport {
+public:
+	PathingReport() : layerCount(0), threadCount(1), predictedLayers(0), 
+			predictionError(0), entryTravel(0), fixupSavings(0), 
+			iterativeSavings(0), timeBefore(0), timeAfter(0) {}
+	size_t layerCount;
+	size_t threadCount;
+	/// layers planned from a predicted entry point
+	size_t predictedLayers;
+	/// summed distance between predicted and real entry points
+	Scalar predictionError;
+	/// summed distance from each layer's exit to the next layer's start
+	Scalar entryTravel;
+	/// travel removed from entryTravel by the sequential fix-up pass
+	Scalar fixupSavings;
+	/// travel removed inside layers by the optimizer's iterative passes
+	Scalar iterativeSavings;
+	/// estimated print time of the paths in the order they were generated
+	Scalar timeBefore;
+	/// estimated print time of the optimized paths
+	Scalar timeAfter;
+	/// the optimizer's figures for each layer
+	std::vector<OptimizerReport> layers;
+};
+
 class Pather : public Progressive
 {
 private:
 	PatherConfig patherCfg;
+	PathingReport pathingReport;
 
 public:
     typedef LayerPaths::Layer::ExtruderLayer::LabeledPathList LabeledOpenPaths;
@@ -171,14 +222,19 @@ public:
 	Pather(const PatherConfig& pCfg, ProgressBar * progress = NULL);
     Pather(const GrueConfig& grueConf, ProgressBar* progress = NULL);
 
-
+    /**
+     @brief Plan the paths of every layer of @a skeleton into @a slices
+     @param sink if not NULL, each layer is handed to it as soon as it 
+     is planned, in order, and layers are planned on one thread
+     */
 	void generatePaths(const GrueConfig& grueCfg,
 					   const RegionList &skeleton,
 					   const LayerMeasure &layerMeasure,
 					   const Grid &grid,
 					   LayerPaths &slices,
 					   int sfirstSliceIdx=-1,
-					   int slastSliceIdx=-1);
+					   int slastSliceIdx=-1,
+					   LayerSink* sink = NULL);
     /**
      @brief Drop non-printable paths and join spurs
      @param result the output of optimization that contains discrete 
@@ -193,6 +249,40 @@ public:
      middle of it.
      */
 	void cleanPaths(LabeledOpenPaths& result);
+    /**
+     @brief Travel statistics from the last call to generatePaths
+     */
+    const PathingReport& report() const { return pathingReport; }
+    /**
+     @brief Rotate or reverse the first path of @a extruderlayer so that 
+     it starts as close as possible to @a exitPoint. Paths that are 
+     chained to what follows them are left alone. Every path is kept 
+     but the connection leaving a rotated loop's old seam.
+     */
+    void fixLayerEntry(const GrueConfig& grueCfg, 
+            const Point2Type& exitPoint, 
+            LayerPaths::Layer::ExtruderLayer& extruderlayer);
+private:
+    /// plans a run of layers, for the TaskScheduler
+    class ChunkPlanner;
+    
+    /**
+     @brief Generate all paths of a single layer with @a optimizer
+     @param layerRegions regions of the layer to plan
+     @param direction infill direction of this layer
+     @param optimizer optimizer to use, its entry point carries over 
+     from whatever layer it optimized before
+     @param extruderlayer where the resulting paths are appended
+     @param layerIndex used only for error messages
+     @return what the optimizer reported about this layer
+     */
+    OptimizerReport generateLayerPaths(const GrueConfig& grueCfg, 
+            const LayerRegions& layerRegions, 
+            const Grid& grid, 
+            bool direction, 
+            abstract_optimizer& optimizer, 
+            LayerPaths::Layer::ExtruderLayer& extruderlayer, 
+            size_t layerIndex);
 };
 
 
@@ -38,6 +38,10 @@ LayerPaths::layer_iterator LayerPaths::erase(layer_iterator from,
 		layer_iterator to){
 	return layers.erase(from, to);
 }
+void LayerPaths::splice(layer_iterator at, LayerPaths& other, 
+		layer_iterator layer){
+	layers.splice(at, other.layers, layer);
+}
 bool LayerPaths::empty() const { return layers.empty(); }
 
 size_t LayerPaths::layerCount() const { return layers.size(); }
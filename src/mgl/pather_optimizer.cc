@@ -34,7 +34,7 @@ void pather_optimizer::addBoundary(const OpenPath& path) {
 		for(OpenPath::const_iterator iter = path.fromStart(); 
 				iter != path.end(); 
 				++iter) {
-			boundaries.push_back(path.segmentAfterPoint(iter));
+			boundaries.insert(path.segmentAfterPoint(iter));
 		}
 	} else {
 		Exception mixup("Attempted to add degenerate path to optimizer boundary");
@@ -48,7 +48,7 @@ void pather_optimizer::addBoundary(const Loop& loop) {
 		for(Loop::const_finite_cw_iterator iter = loop.clockwiseFinite(); 
 				iter != loop.clockwiseEnd(); 
 				++iter) {
-			boundaries.push_back(loop.segmentAfterPoint(iter));
+			boundaries.insert(loop.segmentAfterPoint(iter));
 		}
 	} else {
 		Exception mixup("Attempted to add degenerate loop to optimizer boundary");
@@ -57,12 +57,14 @@ void pather_optimizer::addBoundary(const Loop& loop) {
 }
 
 void pather_optimizer::clearBoundaries() {
-	boundaries.clear();
+	BoundaryList().swap(boundaries);
 }
 
 void pather_optimizer::clearPaths() {
 	myLoops.clear();
 	myPaths.clear();
+	myLoopIndex.clear();
+	myPathIndex.clear();
 }
 
 void pather_optimizer::optimizeInternal(
@@ -73,6 +75,8 @@ void pather_optimizer::optimizeInternal(
 		lastPoint = *(myLoops.begin()->myPath.entryBegin());
 	else if(!myPaths.empty())
 		lastPoint = *(myPaths.begin()->myPath.entryBegin());
+	myLoopIndex.build(myLoops);
+	myPathIndex.build(myPaths);
 	while(!myLoops.empty() || !myPaths.empty()) {
 		try {
 			while(closest(lastPoint, currentClosest)) {
@@ -153,105 +157,40 @@ LabeledOpenPath pather_optimizer::closestPath(
 	return retLabeled;
 }
 
-void pather_optimizer::findClosestLoop(const Point2Type& point, 
-		LabeledLoopList::iterator& loopIter, 
-		Loop::entry_iterator& entryIter) {
-	
-	if(myLoops.empty()) {
-		loopIter = myLoops.end();
-		return;
-	}
-	loopIter = myLoops.begin();
-	entryIter = loopIter->myPath.entryBegin();
-	Scalar closestDistance = (point - *entryIter).magnitude();
-	int closestValue = loopIter->myLabel.myValue;
-	
-	for(LabeledLoopList::iterator currentIter = myLoops.begin(); 
-			currentIter != myLoops.end(); 
-			++currentIter) {
-		for(Loop::entry_iterator currentEntry = 
-				currentIter->myPath.entryBegin(); 
-				currentEntry != currentIter->myPath.entryEnd(); 
-				++currentEntry) {
-			Scalar distance = (point - 
-					*(currentEntry)).magnitude();
-			int value = currentIter->myLabel.myValue;
-			if(value > closestValue || 
-					(value == closestValue && 
-					tlower(distance, closestDistance, 
-					DISTANCE_THRESHOLD))) {
-				closestDistance = distance;
-				entryIter = currentEntry;
-				loopIter = currentIter;
-				closestValue = value;
-			}
-		}
-	}
-}
-
-void pather_optimizer::findClosestPath(const Point2Type& point, 
-		LabeledPathList::iterator& pathIter, 
-		OpenPath::entry_iterator& entryIter) {
-	if(myPaths.empty()) {
-		pathIter = myPaths.end();
-		return;
-	}
-	pathIter = myPaths.begin();
-	entryIter = pathIter->myPath.entryBegin();
-	Scalar closestDistance = (point - *entryIter).magnitude();
-	int closestValue = pathIter->myLabel.myValue;
-	
-	for(LabeledPathList::iterator currentIter = myPaths.begin(); 
-			currentIter != myPaths.end(); 
-			++currentIter) {
-		for(OpenPath::entry_iterator currentEntry = 
-				currentIter->myPath.entryBegin(); 
-				currentEntry != currentIter->myPath.entryEnd(); 
-				++currentEntry) {
-			Scalar distance = (point - 
-					*(currentEntry)).magnitude();
-			int value = currentIter->myLabel.myValue;
-			if(value > closestValue || 
-					(value == closestValue && 
-					tlower(distance, closestDistance, 
-					DISTANCE_THRESHOLD))) {
-				closestDistance = distance;
-				entryIter = currentEntry;
-				pathIter = currentIter;
-			}
-		}
-	}
-}
-
 bool pather_optimizer::closest(const Point2Type& point, LabeledOpenPath& result) {
-	LabeledLoopList::iterator loopIter;
-	Loop::entry_iterator loopEntry;
-	LabeledPathList::iterator pathIter;
-	OpenPath::entry_iterator pathEntry;
+	size_t loopId = 0;
+	size_t pathId = 0;
+	bool haveLoop = myLoopIndex.findClosest(point, loopId);
+	bool havePath = myPathIndex.findClosest(point, pathId);
 	
-	findClosestLoop(point, loopIter, loopEntry);
-	findClosestPath(point, pathIter, pathEntry);
-	
-	int loopVal = loopIter->myLabel.myValue;
-	int pathVal = pathIter->myLabel.myValue;
-	
-	if(loopIter != myLoops.end() && pathIter != myPaths.end()) {
+	if(haveLoop && havePath) {
 		//pick best
-		Scalar loopDistance = (point - *loopEntry).magnitude();
-		Scalar pathDistance = (point - *pathEntry).magnitude();
+		LabeledLoopList::iterator loopIter = myLoopIndex.path(loopId);
+		LabeledPathList::iterator pathIter = myPathIndex.path(pathId);
+		int loopVal = loopIter->myLabel.myValue;
+		int pathVal = pathIter->myLabel.myValue;
+		Scalar loopDistance = (point - *myLoopIndex.entry(loopId)).magnitude();
+		Scalar pathDistance = (point - *myPathIndex.entry(pathId)).magnitude();
 		if(loopVal > pathVal || (loopVal == pathVal && 
 				tlower(loopDistance, pathDistance, 
 				DISTANCE_THRESHOLD))) {
 			//loop wins
-			result = closestLoop(loopIter, loopEntry);
+			havePath = false;
 		} else {
-			result = closestPath(pathIter, pathEntry);
+			haveLoop = false;
 		}
-	} else if(loopIter != myLoops.end()) {
+	}
+	if(haveLoop) {
 		//pick loop
+		LabeledLoopList::iterator loopIter = myLoopIndex.path(loopId);
+		Loop::entry_iterator loopEntry = myLoopIndex.entry(loopId);
+		myLoopIndex.remove(loopId);
 		result = closestLoop(loopIter, loopEntry);
-	} else if(pathIter != myPaths.end()) {
+	} else if(havePath) {
 		//pick path
+		LabeledPathList::iterator pathIter = myPathIndex.path(pathId);
+		OpenPath::entry_iterator pathEntry = myPathIndex.entry(pathId);
+		myPathIndex.remove(pathId);
 		result = closestPath(pathIter, pathEntry);
 	} else {
 		return false;
@@ -261,15 +200,7 @@ bool pather_optimizer::closest(const Point2Type& point, LabeledOpenPath& result)
 
 bool pather_optimizer::crossesBoundaries(const Segment2Type& seg) {
 	//test if this linesegment crosses any boundaries
-	for(BoundaryList::const_iterator iter = 
-			boundaries.begin(); 
-			iter != boundaries.end(); 
-			++iter) {
-		const Segment2Type& currentBoundary = *iter;
-		if(seg.intersects(currentBoundary))
-			return true;
-	}
-	return false;
+	return boundaries.intersects(seg);
 }
 
 void pather_optimizer::link(
@@ -317,7 +248,60 @@ void pather_optimizer::link(
 	}
 }
 
+template <typename LIST>
+void pather_optimizer::candidate_index<LIST>::build(LIST& paths) {
+	clear();
+	typedef std::map<int, std::vector<tree_type::point_value> > point_groups;
+	point_groups points;
+	for(list_iterator pathIter = paths.begin(); 
+			pathIter != paths.end(); 
+			++pathIter) {
+		size_t first = m_candidates.size();
+		for(entry_iterator entryIter = pathIter->myPath.entryBegin(); 
+				entryIter != pathIter->myPath.entryEnd(); 
+				++entryIter) {
+			points[pathIter->myLabel.myValue].push_back(
+					tree_type::point_value(*entryIter, m_candidates.size()));
+			m_candidates.push_back(candidate(pathIter, entryIter, first));
+		}
+		for(size_t id = first; id < m_candidates.size(); ++id) {
+			m_candidates[id].last = m_candidates.size();
+		}
+	}
+	for(typename point_groups::const_iterator groupIter = points.begin(); 
+			groupIter != points.end(); 
+			++groupIter) {
+		m_groups[groupIter->first].build(groupIter->second.begin(), 
+				groupIter->second.end());
+	}
 }
 
+template <typename LIST>
+void pather_optimizer::candidate_index<LIST>::clear() {
+	m_candidates.clear();
+	m_groups.clear();
+}
+
+template <typename LIST>
+bool pather_optimizer::candidate_index<LIST>::findClosest(
+		const Point2Type& point, size_t& id) const {
+	if(m_groups.empty())
+		return false;
+	return m_groups.begin()->second.nearest(point, id);
+}
 
+template <typename LIST>
+void pather_optimizer::candidate_index<LIST>::remove(size_t id) {
+	const candidate& found = m_candidates[id];
+	typename group_map::iterator groupIter = 
+			m_groups.find(found.path->myLabel.myValue);
+	if(groupIter == m_groups.end())
+		return;
+	for(size_t other = found.first; other < found.last; ++other) {
+		groupIter->second.erase(*m_candidates[other].entry, other);
+	}
+	if(groupIter->second.empty())
+		m_groups.erase(groupIter);
+}
 
+}
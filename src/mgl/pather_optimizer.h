@@ -12,11 +12,27 @@
 #include "loop_path.h"
 #include "labeled_path.h"
 #include "log.h"
+#include "basic_kdtree.h"
+#include "segment_grid_index.h"
+#include <functional>
 #include <list>
+#include <map>
 #include <vector>
 
 namespace mgl {
 
+/// Figures about the last call to abstract_optimizer::optimize
+class OptimizerReport {
+public:
+	OptimizerReport() : travelSaved(0), timeBefore(0), timeAfter(0) {}
+	/// travel distance removed by extra passes over the result
+	Scalar travelSaved;
+	/// estimated print time of the paths in the order they were added
+	Scalar timeBefore;
+	/// estimated print time of the optimized paths
+	Scalar timeAfter;
+};
+
 class abstract_optimizer {
 public:
     abstract_optimizer(bool j = true) : jsonErrors(j) {}
@@ -115,6 +131,8 @@ public:
 	//clear internal containers
 	virtual void clearBoundaries() = 0;
 	virtual void clearPaths() = 0;
+	//statistics of the last optimize, if the optimizer keeps any
+	virtual OptimizerReport report() const { return OptimizerReport(); }
 protected:
 	
 	//labeledpaths is the output of optimization
@@ -128,7 +146,7 @@ public:
 	
 	static Scalar DISTANCE_THRESHOLD;
 
-	typedef std::list<Segment2Type> BoundaryList;
+	typedef segment_grid_index BoundaryList;
 	typedef std::list<LabeledOpenPath> LabeledPathList;
 	typedef std::list<LabeledLoop> LabeledLoopList;
 	
@@ -145,22 +163,60 @@ public:
 protected:
 	void optimizeInternal(abstract_optimizer::LabeledOpenPaths& labeledpaths);
 private:
+	/* Entry points of the loops or paths not yet placed, grouped by 
+	 label value, highest value first. Each group is a k-d tree, so 
+	 the nearest entry point of the best group is found without 
+	 scanning everything that is left. */
+	template <typename LIST>
+	class candidate_index {
+	public:
+		typedef typename LIST::iterator list_iterator;
+		typedef typename LIST::value_type::value_type::entry_iterator 
+				entry_iterator;
+		
+		void build(LIST& paths);
+		void clear();
+		/**
+		 @brief find the nearest entry point with the highest value
+		 @param point where we are now
+		 @param id where the id of the found entry point is written
+		 @return false if no candidates are left
+		 */
+		bool findClosest(const Point2Type& point, size_t& id) const;
+		list_iterator path(size_t id) const { return m_candidates[id].path; }
+		entry_iterator entry(size_t id) const { return m_candidates[id].entry; }
+		//forget all entry points of the path owning id
+		void remove(size_t id);
+	private:
+		class candidate {
+		public:
+			candidate(list_iterator p, entry_iterator e, size_t f) 
+					: path(p), entry(e), first(f), last(f) {}
+			list_iterator path;
+			entry_iterator entry;
+			//all candidates of one path are in [first, last)
+			size_t first;
+			size_t last;
+		};
+		typedef basic_kdtree<size_t> tree_type;
+		typedef std::map<int, tree_type, std::greater<int> > group_map;
+		
+		std::vector<candidate> m_candidates;
+		group_map m_groups;
+	};
+	
 	LabeledOpenPath closestLoop(std::list<LabeledLoop>::iterator loopIter, 
 			Loop::entry_iterator entryIter);
 	LabeledOpenPath closestPath(std::list<LabeledOpenPath>::iterator pathIter, 
 			OpenPath::entry_iterator entryIter);
-	void findClosestLoop(const Point2Type& point, 
-			std::list<LabeledLoop>::iterator& loopIter, 
-			Loop::entry_iterator& entryIter);
-	void findClosestPath(const Point2Type& point, 
-			std::list<LabeledOpenPath>::iterator& pathIter, 
-			OpenPath::entry_iterator& entryIter);
 	bool closest(const Point2Type& point, LabeledOpenPath& result);
 	void link(abstract_optimizer::LabeledOpenPaths& labeledpaths);
 	bool crossesBoundaries(const Segment2Type& seg);
 	BoundaryList boundaries;
 	LabeledLoopList myLoops;
 	LabeledPathList myPaths;
+	candidate_index<LabeledLoopList> myLoopIndex;
+	candidate_index<LabeledPathList> myPathIndex;
 };
 
 }
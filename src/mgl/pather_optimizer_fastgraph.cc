@@ -9,6 +9,7 @@ namespace mgl {
 void pather_optimizer_fastgraph::addPath(const OpenPath& path, 
         const PathLabel& label) {
     node_index last = -1;
+    estimatePathTime(m_naiveEstimate, m_linkCosts.speeds, path, label);
     Point2Type testPoint = *path.fromStart();
     bucket_list::iterator bucketIter = pickBucket(testPoint);
     bucket* currentBucketPtr = NULL;
@@ -61,6 +62,15 @@ void pather_optimizer_fastgraph::addPath(const OpenPath& path,
 }
 void pather_optimizer_fastgraph::addPath(const Loop& loop, 
         const PathLabel& label) {
+    OpenPath loopPath;
+    for(Loop::const_finite_cw_iterator iter = loop.clockwiseFinite(); 
+            iter != loop.clockwiseEnd(); 
+            ++iter) {
+        loopPath.appendPoint(*iter);
+    }
+    if(!loopPath.empty())
+        loopPath.appendPoint(*loopPath.fromStart());
+    estimatePathTime(m_naiveEstimate, m_linkCosts.speeds, loopPath, label);
     Point2Type testPoint = *loop.clockwise();
     bucket_list::iterator bucketIter = pickBucket(testPoint);
     bucket* currentBucketPtr = NULL;
@@ -133,6 +143,14 @@ void pather_optimizer_fastgraph::clearPaths() {
         iter->m_graph.clear();
     }
     unifiedBucketHack.m_graph.clear();
+    m_naiveEstimate.reset(historyPoint);
+}
+OptimizerReport pather_optimizer_fastgraph::report() const {
+    OptimizerReport ret;
+    ret.travelSaved = m_travelSaved;
+    ret.timeBefore = m_naiveEstimate.total();
+    ret.timeAfter = m_timeAfter;
+    return ret;
 }
 pather_optimizer_fastgraph::entry_iterator& 
         pather_optimizer_fastgraph::entry_iterator::operator ++() {
@@ -187,17 +205,7 @@ Scalar pather_optimizer_fastgraph::splitPaths(multipath_type& destionation,
 }
 size_t pather_optimizer_fastgraph::countIntersections(Segment2Type& line, 
         const boundary_container& boundContainer) {
-    typedef std::vector<Segment2Type> result_type;
-    result_type result;
-    size_t count = 0;
-    boundContainer.search(result, LineSegmentFilter(line));
-    for(result_type::const_iterator iter = result.begin(); 
-            iter != result.end(); 
-            ++iter) {
-        if(iter->intersects(line))
-            ++count;
-    }
-    return count;
+    return boundContainer.countIntersections(line);
 }
 
 pather_optimizer_fastgraph::bucket_list::iterator 
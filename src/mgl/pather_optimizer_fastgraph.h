@@ -12,6 +12,9 @@
 #include "simple_topology.h"
 #include "predicate.h"
 #include "basic_boxlist.h"
+#include "basic_kdtree.h"
+#include "segment_grid_index.h"
+#include "motion_model.h"
 #include "intersection_index.h"
 #include "Exception.h"
 #include "configuration.h"
@@ -49,7 +52,11 @@ class pather_optimizer_fastgraph : public abstract_optimizer {
 public:
     pather_optimizer_fastgraph(const GrueConfig& grueConf)
             : grueCfg(grueConf),  
-            historyPoint(grueConf.get_startingX(), grueConf.get_startingY()) {}
+            historyPoint(grueConf.get_startingX(), grueConf.get_startingY()), 
+            m_travelSaved(0), m_linkCosts(grueConf), 
+            m_naiveEstimate(MotionModel(grueConf)), m_timeAfter(0) {
+        m_naiveEstimate.reset(historyPoint);
+    }
     //addPath builds up the correct interior graph (the correct bucket)
     void addPath(const OpenPath& path, const PathLabel& label);
     void addPath(const Loop& loop, const PathLabel& label);
@@ -61,6 +68,8 @@ public:
 	void clearPaths();
     //debugging: Make a nice svg of this graph
     void repr_svg(std::ostream& out);
+    //travel saved and time estimates of the last optimize
+    OptimizerReport report() const;
     
     
     // HACK FOR UNIT TESTS TO TOUCH PRIVATES
@@ -101,9 +110,6 @@ FASTGRAPH_PRIVATE:
      start a new layer where the previous layer ended.
      */
     void optimizeBuckets(multipath_type& output, Point2Type& entryPoint);
-    ///Run v-opt on results of above function, not used currently
-    bool optimizeIterative(LabeledOpenPaths& labeledopenpaths, 
-            LabeledOpenPaths& intermediate);
     /**
      @brief a PathLabel that also stores precomputed distance and normal.
      */
@@ -145,7 +151,7 @@ FASTGRAPH_PRIVATE:
         bool m_isentry;
     };
     
-    typedef basic_boxlist<Segment2Type> boundary_container;
+    typedef segment_grid_index boundary_container;
     typedef topo::simple_graph<NodeData, Cost> graph_type;
     typedef graph_type::node node;
     typedef graph_type::node_index node_index;
@@ -153,6 +159,7 @@ FASTGRAPH_PRIVATE:
     
     class LoopHierarchyBaseComparator;
     class LoopHierarchyStrictComparator;
+    class LinkCosts;
     
     /**
      @brief a description of the extents of a region and all regions 
@@ -230,20 +237,20 @@ FASTGRAPH_PRIVATE:
              */
             void optimize(LabeledOpenPaths& output, Point2Type& entryPoint, 
                     boundary_container& bounds, const GrueConfig& grueConf, 
-                    bool first = false);
+                    const LinkCosts& costs, bool first = false);
             /**
              @brief called by a parent hierarchy on its valid children
              */
             void optimizeInner(LabeledOpenPaths& output, Point2Type& entryPoint, 
                     boundary_container& bounds, const GrueConfig& grueConf, 
-                    bool first);
+                    const LinkCosts& costs, bool first);
             /**
              @brief optimize the contents of this object only. Called from 
              optimizeInner
              */
             void optimizeMyself(LabeledOpenPaths& output, Point2Type& entryPoint, 
                     boundary_container& bounds, const GrueConfig& grueConf, 
-                    bool first);
+                    const LinkCosts& costs, bool first);
             void swap(LoopHierarchy& other);
             void repr(std::ostream& out, size_t level = 0);
             PathLabel m_label;
@@ -304,7 +311,7 @@ FASTGRAPH_PRIVATE:
          all things stored in this bucket's graph
          */
         void optimize(LabeledOpenPaths& output, Point2Type& entryPoint, 
-                const GrueConfig& grueConf);
+                const GrueConfig& grueConf, const LinkCosts& costs);
         /// Fast swap implementation, no memory allocation or deallocation
         void swap(bucket& other);
         /// use for iterating over the extents of this bucket
@@ -388,15 +395,33 @@ FASTGRAPH_PRIVATE:
     protected:
         LabelComparator m_labelCompare;
     };
+    /**
+     @brief what ranking links needs, made once for each optimizer. Links 
+     are ranked by the time lost to their corner only with doCornerLinks, 
+     otherwise by their direction alone.
+     */
+    class LinkCosts {
+    public:
+        LinkCosts(const GrueConfig& grueConf) 
+                : nodeCompare(grueConf), model(grueConf), speeds(grueConf), 
+                cornered(grueConf.get_doCornerLinks() && 
+                model.isAccelerated()) {}
+        NodeComparator nodeCompare;
+        MotionModel model;
+        LabelSpeeds speeds;
+        bool cornered;
+    };
     class NodeConnectionComparator : public abstract_predicate<node::connection> {
     public:
-        NodeConnectionComparator(const GrueConfig& grueConf, 
+        NodeConnectionComparator(const LinkCosts& costs, 
                 Point2Type unit = Point2Type()) 
-                : m_nodeCompare(grueConf), m_unit(unit) {}
+                : m_costs(costs), m_unit(unit) {}
         typedef abstract_predicate<node::connection>::value_type value_type;
         int compare(const value_type& lhs, const value_type& rhs) const;
     protected:
-        NodeComparator m_nodeCompare;
+        /// time lost to slowing down for the corner into @a link
+        Scalar cornerLoss(const value_type& link) const;
+        const LinkCosts& m_costs;
         Point2Type m_unit;
     };
     
@@ -456,6 +481,47 @@ FASTGRAPH_PRIVATE:
     /// get the entry_iterator for graph
     static entry_iterator entryEnd(graph_type& graph);
     
+    /**
+     @brief Spacial index of the entry points of a graph that are still 
+     alive. 
+     
+     Entry points are grouped by label, with the groups ordered best 
+     first the way LinkBuildingSortComparator orders their nodes. 
+     Inside a group they are kept 
+     in a basic_kdtree, so candidates can be visited in exactly the order 
+     a full sort by label, then distance, would produce, without 
+     sorting everything.
+     Nodes must be erased from here before they are destroyed.
+     */
+    class entry_index {
+    public:
+        typedef basic_kdtree<node_index> tree_type;
+        class label_group {
+        public:
+            label_group(const PathLabel& l) : label(l) {}
+            PathLabel label;
+            tree_type entries;
+        };
+        typedef std::vector<label_group> group_list;
+        typedef group_list::iterator iterator;
+        
+        entry_index(graph_type& graph, const GrueConfig& grueConf);
+        /// stop considering @a n, call this before destroying it
+        void erase(node& n);
+        /**
+         @brief find the best entry point to start from when at @a point
+         @return the index of the entry node, or -1 if there are none left
+         Same result as std::min_element with nodeComparator
+         */
+        node_index best(const Point2Type& point);
+        
+        iterator begin() { return m_groups.begin(); }
+        iterator end() { return m_groups.end(); }
+    private:
+        group_list m_groups;
+        LabelComparator m_compare;
+    };
+    
     /**
      @brief adapt a predicate for use when building up links
      */
@@ -478,14 +544,17 @@ FASTGRAPH_PRIVATE:
      @param from a node reference
      @param graph the owner of @a from
      @param boundaries that which should not be crossed
+     @param liveEntries index of the entry points still in @a graph
      @param grueConf a const GrueConfig reference
+     @param costs ranks the links
      @param unit optionally provide a unit normal
      @return an iterator to the best link to follow, or from.forwardEnd() 
      if no such links can be constructed
      Considers all entry points in @a graph when building new links
      */
     static node::forward_link_iterator bestLink(node& from, graph_type& graph, 
-            boundary_container& boundaries, const GrueConfig& grueConf, 
+            boundary_container& boundaries, entry_index& liveEntries, 
+            const GrueConfig& grueConf, const LinkCosts& costs, 
             Point2Type unit = Point2Type());
     /**
      @brief find or construct the best outgoing link from a node
@@ -494,6 +563,7 @@ FASTGRAPH_PRIVATE:
      @param boundaries that which should not be crossed
      @param entries a vector of node_indexes to consider
      @param grueConf a const GrueConfig reference
+     @param costs ranks the links
      @param unit optionally provide a unit normal
      @return an iterator to the best link to follow, or from.forwardEnd() 
      if no such links can be constructed
@@ -504,20 +574,23 @@ FASTGRAPH_PRIVATE:
     static node::forward_link_iterator bestLink(node& from, graph_type& graph, 
             boundary_container& boundaries, 
             bucket::LoopHierarchy::entryIndexVector& entries, 
-            const GrueConfig& grueConf, 
+            const GrueConfig& grueConf, const LinkCosts& costs, 
             Point2Type unit = Point2Type());
     /**
      @brief construct outgoing connection links from a node
      @param from node from which to construct links
      @param graph the owner of @a from
      @param boundaries that should not be crossed
+     @param liveEntries index of the entry points still in @a graph
      @param grueConf a const GrueConfig reference
      This function considers all valid entry points in @a graph, 
      and constructs the best connection from node @a from to one entry point
-     if one can be constructed.
+     if one can be constructed. Candidates are pulled from @a liveEntries 
+     nearest first and only as many as needed are looked at.
      */
     static void buildLinks(node& from, graph_type& graph, 
-            boundary_container& boundaries, const GrueConfig& grueConf);
+            boundary_container& boundaries, entry_index& liveEntries, 
+            const GrueConfig& grueConf);
     /**
      @brief construct outgoing connection links from a node
      @param from node from which to construct links
@@ -584,6 +657,27 @@ FASTGRAPH_PRIVATE:
     static bool crossesBounds(const Segment2Type& line, 
             boundary_container& boundaries);
     
+    class travel_chain;
+    class travel_run;
+    /**
+     @brief Shorten the travel between the paths a bucket produced by 
+     reordering and reversing chains of connected paths (2-opt and Or-opt 
+     moves). Chains are only exchanged with chains of the same label, and 
+     moves may not add travel that crosses @a bounds.
+     @param labeledopenpaths output of one bucket, improved in place
+     @param entryPoint where the toolhead was before @a labeledopenpaths
+     @param bounds the boundaries of the bucket
+     @param deadline give up once StageTimer::now() passes this, 0 for 
+     never
+     @return the travel distance saved
+     */
+    Scalar optimizeIterative(LabeledOpenPaths& labeledopenpaths, 
+            const Point2Type& entryPoint, boundary_container& bounds, 
+            double deadline);
+    /// summed length of the moves between paths, starting at entryPoint
+    static Scalar travelLength(const LabeledOpenPaths& labeledopenpaths, 
+            Point2Type entryPoint);
+    
     static void smartAppendPoint(Point2Type point, PathLabel label, 
             LabeledOpenPaths& labeledpaths, LabeledOpenPath& path, 
             Point2Type& entryPoint);
@@ -597,9 +691,10 @@ FASTGRAPH_PRIVATE:
      @param bounds that which should not be crossed
      @param entryPoint decides where to start. At the end contains the final point
      @param grueConf
+     @param costs ranks the links to follow
      */
     static void optimizeGraph(LabeledOpenPaths& labeledpaths, graph_type& graph, boundary_container& bounds, Point2Type& entryPoint, 
-            const GrueConfig& grueConf);
+            const GrueConfig& grueConf, const LinkCosts& costs);
     
     Scalar splitPaths(multipath_type& destionation, const LabeledOpenPaths& source);
     bucket_list::iterator pickBucket(Point2Type point);
@@ -613,6 +708,12 @@ FASTGRAPH_PRIVATE:
      */
     bucket unifiedBucketHack;
     Point2Type historyPoint;
+    Scalar m_travelSaved;
+    /// also holds the speeds the estimates use
+    LinkCosts m_linkCosts;
+    /// time of the paths in the order they were added
+    MotionEstimate m_naiveEstimate;
+    Scalar m_timeAfter;
     
 };
 
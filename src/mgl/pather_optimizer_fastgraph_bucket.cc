@@ -108,7 +108,7 @@ BUCKET& BUCKET::select(Point2Type point) {
     return *this;
 }
 void BUCKET::optimize(LabeledOpenPaths& output, Point2Type& entryPoint, 
-        const GrueConfig& grueConf) {
+        const GrueConfig& grueConf, const LinkCosts& costs) {
     buildNoCross();
     Scalar myDistance = std::numeric_limits<Scalar>::max();
     for(edge_iterator edge = edgeBegin(); 
@@ -124,17 +124,18 @@ void BUCKET::optimize(LabeledOpenPaths& output, Point2Type& entryPoint,
             m_children.end(), entryPoint, bestDistance)) != m_children.end()) {
         if(bestDistance > myDistance)
             break;
-        bestRecursiveChoice->optimize(output, entryPoint, grueConf);
+        bestRecursiveChoice->optimize(output, entryPoint, grueConf, costs);
         m_children.erase(bestRecursiveChoice);
     }
 //    m_hierarchy.repr(std::cerr);
 //    std::cout << "That was it for this bucket!" << std::endl;
     m_hierarchy.optimize(output, entryPoint, 
-            m_noCrossing, grueConf, true);
-    optimizeGraph(output, m_graph, m_noCrossing, entryPoint, grueConf);
+            m_noCrossing, grueConf, costs, true);
+    optimizeGraph(output, m_graph, m_noCrossing, entryPoint, grueConf, 
+            costs);
     while((bestRecursiveChoice = pickBestChild(m_children.begin(), 
             m_children.end(), entryPoint)) != m_children.end()) {
-        bestRecursiveChoice->optimize(output, entryPoint, grueConf);
+        bestRecursiveChoice->optimize(output, entryPoint, grueConf, costs);
         m_children.erase(bestRecursiveChoice);
     }
 }
@@ -291,25 +292,25 @@ const HIERARCHY& HIERARCHY::select(Point2Type point) const {
 }
 void HIERARCHY::optimize(LabeledOpenPaths& output, Point2Type& entryPoint, 
         boundary_container& bounds, const GrueConfig& grueConf, 
-        bool first) {
+        const LinkCosts& costs, bool first) {
     if(m_loop.empty()) {
         LoopHierarchyStrictComparator compare(entryPoint, grueConf);
         hierarchy_list::iterator bestChoice;
         while((bestChoice = bestChild(compare)) != m_children.end()) {
             bestChoice->optimize(output, entryPoint, bounds, grueConf, 
-                    first);
+                    costs, first);
             first = false;
             m_children.erase(bestChoice);
         }
-        optimizeGraph(output, m_graph, bounds, entryPoint, grueConf);
+        optimizeGraph(output, m_graph, bounds, entryPoint, grueConf, costs);
         return;
     } else {
-        optimizeInner(output, entryPoint, bounds, grueConf, first);
+        optimizeInner(output, entryPoint, bounds, grueConf, costs, first);
     }
 }
 void HIERARCHY::optimizeInner(LabeledOpenPaths& output, 
         Point2Type& entryPoint, boundary_container& bounds, 
-        const GrueConfig& grueConf, bool first) {
+        const GrueConfig& grueConf, const LinkCosts& costs, bool first) {
     LoopHierarchyStrictComparator typeDistComparator(entryPoint, grueConf);
     LoopHierarchyBaseComparator typeComparator(entryPoint, grueConf);
     hierarchy_list::iterator bestChoice;
@@ -325,13 +326,14 @@ void HIERARCHY::optimizeInner(LabeledOpenPaths& output,
 //           std::cout << bestChoice->m_label.myValue << " Good to recurse " << 
 //                   m_label.myValue << std::endl;
        }
-       bestChoice->optimize(output, entryPoint, bounds, grueConf, first);
+       bestChoice->optimize(output, entryPoint, bounds, grueConf, costs, 
+               first);
        first = false;
        m_children.erase(bestChoice);
     }
 //    std::cout << "Optimizing priority " << m_label.myValue << 
 //            " count " << m_loop.size() << std::endl;
-    optimizeMyself(output, entryPoint, bounds, grueConf, first);
+    optimizeMyself(output, entryPoint, bounds, grueConf, costs, first);
     first = false;
     
     if(bestChoice != m_children.end()) {
@@ -339,7 +341,7 @@ void HIERARCHY::optimizeInner(LabeledOpenPaths& output,
 //            std::cout << "Tail recursion into priority " << 
 //                    bestChoice->m_label.myValue << std::endl;
             bestChoice->optimize(output, entryPoint, bounds, grueConf, 
-                    false);
+                    costs, false);
             m_children.erase(bestChoice);
         } while((bestChoice = bestChild(typeDistComparator)) 
                 != m_children.end());
@@ -351,6 +353,7 @@ void HIERARCHY::optimizeMyself(LabeledOpenPaths& output,
         Point2Type& entryPoint, 
         boundary_container& bounds, 
         const GrueConfig& grueConf, 
+        const LinkCosts& costs, 
         bool first) {
     LabelPriorityComparator compare(grueConf);
     bool doneGraph = false;
@@ -358,7 +361,8 @@ void HIERARCHY::optimizeMyself(LabeledOpenPaths& output,
     if(nodeSample != entryEnd(m_graph)) {
         if(compare.compare(nodeSample->data().getLabel(), m_label) == BETTER) {
             doneGraph = true;
-            optimizeGraph(output, m_graph, bounds, entryPoint, grueConf);
+            optimizeGraph(output, m_graph, bounds, entryPoint, grueConf, 
+                    costs);
         }
     }
     if(!m_loop.empty()) {
@@ -398,7 +402,7 @@ void HIERARCHY::optimizeMyself(LabeledOpenPaths& output,
         output.push_back(thisLoop);
     }
     if(!doneGraph) {
-        optimizeGraph(output, m_graph, bounds, entryPoint, grueConf);
+        optimizeGraph(output, m_graph, bounds, entryPoint, grueConf, costs);
     }
 }
 void HIERARCHY::swap(LoopHierarchy& other) {
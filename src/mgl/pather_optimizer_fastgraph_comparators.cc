@@ -41,15 +41,34 @@ int pather_optimizer_fastgraph::NodeComparator::compare(const value_type& lhs,
 }
 int pather_optimizer_fastgraph::NodeConnectionComparator::compare(
         const value_type& lhs, const value_type& rhs) const {
-    int nc = m_nodeCompare(*lhs.first, *rhs.first);
+    int nc = m_costs.nodeCompare(*lhs.first, *rhs.first);
     if(nc)
         return nc;
+    if(m_costs.cornered) {
+        if(m_unit == Point2Type())
+            return SAME;
+        Scalar lloss = cornerLoss(lhs);
+        Scalar rloss = cornerLoss(rhs);
+        return (lloss < rloss ? 
+            BETTER : (rloss < lloss ? 
+                WORSE : SAME));
+    }
     Scalar lunit = m_unit.dotProduct(lhs.second->normal());
     Scalar runit = m_unit.dotProduct(rhs.second->normal());
     return (lunit > runit ? 
         BETTER : (runit < lunit ? 
             WORSE : SAME));
 }
+Scalar pather_optimizer_fastgraph::NodeConnectionComparator::cornerLoss(
+        const value_type& link) const {
+    const MotionModel& model = m_costs.model;
+    Scalar speed = m_costs.speeds.speed(*link.second);
+    Scalar corner = model.junctionSpeed(m_unit, link.second->normal(), 
+            speed);
+    Scalar length = link.second->distance();
+    return model.moveTime(length, corner, speed, 0) - 
+            model.moveTime(length, speed, speed, 0);
+}
 int pather_optimizer_fastgraph::LoopHierarchyBaseComparator::compare(
         const value_type& lhs, const value_type& rhs) const {
     return m_compare.compare(lhs.m_label, rhs.m_label);
@@ -1,6 +1,7 @@
 #include "pather_optimizer_fastgraph.h"
 #include "intersection_index.h"
 #include "pather.h"
+#include "stage_timer.h"
 #include <algorithm>
 #include <list>
 #include <vector>
@@ -10,57 +11,123 @@ namespace mgl {
 bool pather_optimizer_fastgraph::crossesBounds(
         const Segment2Type& line, 
         boundary_container& boundaries) {
-    std::vector<Segment2Type> filtered;
-    boundaries.search(filtered, LineSegmentFilter(line));
-    for(std::vector<Segment2Type>::const_iterator iter = 
-            filtered.begin(); 
-            iter != filtered.end(); 
+    StageTimer::count(StageTimer::LINK_PROBES);
+    return boundaries.intersects(line);
+}
+pather_optimizer_fastgraph::entry_index::entry_index(graph_type& graph, 
+        const GrueConfig& grueConf) 
+        : m_compare(LabelTypeComparator(grueConf), 
+        LabelPriorityComparator(grueConf)) {
+    typedef std::vector<std::vector<tree_type::point_value> > point_groups;
+    point_groups points;
+    for(entry_iterator iter = entryBegin(graph); 
+            iter != entryEnd(graph); 
             ++iter) {
-        if(iter->intersects(line))
-            return true;
+        const PathLabel& label = iter->data().getLabel();
+        //keep groups sorted best first, there are only ever a few
+        size_t group = 0;
+        while(group < m_groups.size() && 
+                m_compare.compare(m_groups[group].label, label) == BETTER) {
+            ++group;
+        }
+        if(group == m_groups.size() || 
+                m_compare.compare(m_groups[group].label, label) != SAME) {
+            m_groups.insert(m_groups.begin() + group, label_group(label));
+            points.insert(points.begin() + group, 
+                    point_groups::value_type());
+        }
+        points[group].push_back(tree_type::point_value(
+                iter->data().getPosition(), iter->getIndex()));
+    }
+    for(size_t group = 0; group < m_groups.size(); ++group) {
+        m_groups[group].entries.build(points[group].begin(), 
+                points[group].end());
+    }
+}
+void pather_optimizer_fastgraph::entry_index::erase(node& n) {
+    if(!n.data().isEntry())
+        return;
+    for(iterator iter = begin(); iter != end(); ++iter) {
+        if(m_compare.compare(iter->label, n.data().getLabel()) == SAME) {
+            iter->entries.erase(n.data().getPosition(), n.getIndex());
+            return;
+        }
+    }
+}
+pather_optimizer_fastgraph::node_index 
+        pather_optimizer_fastgraph::entry_index::best(
+        const Point2Type& point) {
+    for(iterator iter = begin(); iter != end(); ++iter) {
+        node_index found;
+        if(iter->entries.nearest(point, found))
+            return found;
     }
-    return false;
+    return -1;
 }
 pather_optimizer_fastgraph::node::forward_link_iterator
         pather_optimizer_fastgraph::bestLink(node& from, 
         graph_type& graph, boundary_container& boundaries, 
-        const GrueConfig& grueConf, 
-        Point2Type unit) {
+        entry_index& liveEntries, const GrueConfig& grueConf, 
+        const LinkCosts& costs, Point2Type unit) {
     if(from.forwardEmpty()) {
         //return from.forwardEnd();
-        buildLinks(from, graph, boundaries, grueConf);
+        buildLinks(from, graph, boundaries, liveEntries, grueConf);
     }
     return std::min_element(from.forwardBegin(), 
-            from.forwardEnd(), NodeConnectionComparator(grueConf, unit));
+            from.forwardEnd(), NodeConnectionComparator(costs, unit));
 }
 pather_optimizer_fastgraph::node::forward_link_iterator
         pather_optimizer_fastgraph::bestLink(node& from, 
         graph_type& graph, boundary_container& boundaries, 
         bucket::LoopHierarchy::entryIndexVector& entries, 
-        const GrueConfig& grueConf, 
+        const GrueConfig& grueConf, const LinkCosts& costs, 
         Point2Type unit) {
     if(from.forwardEmpty()) {
         //return from.forwardEnd();
         buildLinks(from, graph, boundaries, entries, grueConf);
     }
     return std::min_element(from.forwardBegin(), 
-            from.forwardEnd(), NodeConnectionComparator(grueConf, unit));
+            from.forwardEnd(), NodeConnectionComparator(costs, unit));
 }
 void pather_optimizer_fastgraph::buildLinks(node& from, graph_type& graph, 
-        boundary_container& boundaries, const GrueConfig& grueConf) {
-    std::vector<probe_link_type> probes;
-    for(entry_iterator iter = entryBegin(graph); 
-            iter != entryEnd(graph); 
-            ++iter) {
-        if(*iter == from)
-            continue;
-        probes.push_back(probe_link_type(iter->getIndex(), 
-                (from.data().getPosition() - 
-                iter->data().getPosition()).magnitude()));
+        boundary_container& boundaries, entry_index& liveEntries, 
+        const GrueConfig& grueConf) {
+    LinkBuildingConnectionCutoffComparator connectCompare(grueConf);
+    const PathLabel* frontLabel = NULL;
+    for(entry_index::iterator group = liveEntries.begin(); 
+            group != liveEntries.end(); 
+            ++group) {
+        if(frontLabel && connectCompare(*frontLabel, group->label))
+            break;  //make no connections to things of lower priority
+        entry_index::tree_type::nearest_query candidates(group->entries, 
+                from.data().getPosition());
+        node_index candidate;
+        Scalar squaredDistance;
+        while(candidates.next(candidate, squaredDistance)) {
+            if(candidate == from.getIndex())
+                continue;
+            if(!frontLabel)
+                frontLabel = &group->label;
+            node& to = graph[candidate];
+            Segment2Type probeline(from.data().getPosition(), 
+                    to.data().getPosition());
+            if(crossesBounds(probeline, boundaries))
+                continue;
+            Point2Type unit;
+            try {
+                unit = (to.data().getPosition() - 
+                        from.data().getPosition()).unit();
+            } catch (const GeometryException& le) {}
+            from.connect(to, 
+                    Cost(PathLabel(PathLabel::TYP_CONNECTION, 
+                    PathLabel::OWN_MODEL, -1), 
+                    (from.data().getPosition() - 
+                    to.data().getPosition()).magnitude(), 
+                    unit
+                    ));
+            return;
+        }
     }
-    std::sort(probes.begin(), probes.end(), 
-            probeCompare(from.getIndex(), graph, grueConf));
-    buildLinks(from, graph, boundaries, probes, grueConf);
 }
 void pather_optimizer_fastgraph::buildLinks(node& from, graph_type& graph, 
         boundary_container& boundaries, 
@@ -112,7 +179,8 @@ void pather_optimizer_fastgraph::buildLinks(node& from, graph_type& graph,
 }
 void pather_optimizer_fastgraph::optimizeInternal(LabeledOpenPaths& labeledpaths) {
     multipath_type firstPass;
-    //LabeledOpenPaths innerIntermediate;
+    MotionEstimate estimate = MotionEstimate(MotionModel(grueCfg));
+    estimate.reset(historyPoint);
     optimizeBuckets(firstPass, historyPoint);
     for(multipath_type::iterator iter = firstPass.begin(); 
             iter != firstPass.end(); 
@@ -129,32 +197,35 @@ void pather_optimizer_fastgraph::optimizeInternal(LabeledOpenPaths& labeledpaths
             toClear.pop_back();
         }
     }
-//    for(multipath_type::iterator iter = firstPass.begin(); 
-//            iter != firstPass.end(); 
-//            ++iter) {
-//        unsigned iteration = 1;
-//        do {
-//            innerIntermediate.clear();
-//            innerIntermediate.swap(*iter);
-//        } while (optimize2(*iter, innerIntermediate) && 
-//                ++iteration < grueCfg.get_iterativeEffort());
-//    }
     for(multipath_type::iterator iter = firstPass.begin(); 
             iter != firstPass.end(); 
             ++iter) {
+        estimatePathTime(estimate, m_linkCosts.speeds, *iter);
         labeledpaths.splice(labeledpaths.end(), 
                 *iter);
     }
+    m_timeAfter = estimate.total();
 }
 void pather_optimizer_fastgraph::optimizeBuckets(multipath_type& output, 
         Point2Type& entryPoint) {
+    StageTimer::Event trace("optimizeBuckets");
+    m_travelSaved = 0;
+    double deadline = 0;
+    if(grueCfg.get_iterativeTimeLimit() > 0)
+        deadline = StageTimer::now() + grueCfg.get_iterativeTimeLimit();
     while(!buckets.empty()) {
         bucket_list::iterator currentNearest = buckets.begin();
         currentNearest = bucket::pickBestChild(buckets.begin(), 
                 buckets.end(), entryPoint);
         LabeledOpenPaths currentResult;
+        Point2Type bucketEntry = entryPoint;
         //optimize1Inner(currentResult, currentNearest, entryPoint);
-        currentNearest->optimize(currentResult, entryPoint, grueCfg);
+        currentNearest->optimize(currentResult, entryPoint, grueCfg, 
+                m_linkCosts);
+        m_travelSaved += optimizeIterative(currentResult, bucketEntry, 
+                currentNearest->m_noCrossing, deadline);
+        if(!currentResult.empty() && !currentResult.back().myPath.empty())
+            entryPoint = *currentResult.back().myPath.fromEnd();
         
         output.push_back(LabeledOpenPaths());
         
@@ -163,114 +234,21 @@ void pather_optimizer_fastgraph::optimizeBuckets(multipath_type& output,
     }
     //hack bucket to optimize
     LabeledOpenPaths hackResult;
-    unifiedBucketHack.optimize(hackResult, entryPoint, grueCfg);
+    Point2Type hackEntry = entryPoint;
+    unifiedBucketHack.optimize(hackResult, entryPoint, grueCfg, m_linkCosts);
+    m_travelSaved += optimizeIterative(hackResult, hackEntry, 
+            unifiedBucketHack.m_noCrossing, deadline);
+    if(!hackResult.empty() && !hackResult.back().myPath.empty())
+        entryPoint = *hackResult.back().myPath.fromEnd();
     output.push_back(LabeledOpenPaths());
     output.back().splice(output.back().end(), hackResult);
     bucket emptyBucket;
     unifiedBucketHack.swap(emptyBucket);
 }
-bool pather_optimizer_fastgraph::optimizeIterative(LabeledOpenPaths&, // labeledopenpaths, 
-        LabeledOpenPaths& // intermediate
-        ) {
-    return false;
-//    multipath_type split;
-//    Scalar waste1, waste2;
-//    waste1 = splitPaths(split, intermediate);
-//    waste2 = 0;
-//    //split.sort(comparePathLists);
-////    std::cout << "Size of split: " << split.size() << std::endl;;
-//    if(split.empty())
-//        return false;
-//    multipath_type::iterator current = split.begin();
-//    multipath_type::iterator other;
-//    multipath_type::iterator nearest;
-//    multipath_type::iterator connected;
-//    while(!split.empty()) {
-//        bool foundConnected = false;
-//        Segment2Type joint;
-//        Scalar length = std::numeric_limits<Scalar>::max();
-//        Scalar connectedLength = std::numeric_limits<Scalar>::max();
-//        other = current;
-//        ++other;
-//        if(other == split.end()) {
-//            if(current == split.begin()) {
-//                //current is last
-//                if(!labeledopenpaths.empty()) {
-//                    waste2 += (*labeledopenpaths.back().myPath.fromEnd() - 
-//                        *(current->front().myPath.fromStart())).magnitude();
-//                }
-//                labeledopenpaths.splice(labeledopenpaths.end(), 
-//                        *current);
-//                split.erase(current);
-//                return waste2 < waste1;
-//            } else {
-//                other = split.begin();
-//            }
-//        }
-//        nearest = other;
-//        LabeledOpenPaths& currentList = *current;
-//        for(; other != split.end(); ++other) {
-//            if(other == current)
-//                continue;
-//            LabeledOpenPaths& otherList = *other;
-//            LabeledOpenPath& currentBack = currentList.back();
-//            LabeledOpenPath& otherFront = otherList.front();
-//            Point2Type currentPoint = *(currentBack.myPath.fromEnd());
-//            Point2Type otherPoint = *(otherFront.myPath.fromStart());
-//            Segment2Type testJoint(currentPoint, 
-//                    otherPoint);
-//            Scalar curLength = testJoint.length();
-//            bool closer = curLength < length;
-//            bool connects = !crossesBounds(testJoint, m_boundaries);
-//            int otherValue = other->front().myLabel.myValue;
-//            int nearestValue = nearest->front().myLabel.myValue;
-//            if(connects) {
-//                if(!foundConnected || (otherValue > nearestValue)) {
-//                    foundConnected = true;
-//                    joint = testJoint;
-//                    connected = other;
-//                    connectedLength = curLength;
-//                }
-//            }
-//            if((otherValue > nearestValue) || closer) {
-//                nearest = other;
-//                length = testJoint.length();
-//            }
-//        }
-//        //current goes to output
-//        LabeledOpenPaths& currentRef = *current;
-//        labeledopenpaths.splice(labeledopenpaths.end(), 
-//                currentRef);
-//        if(foundConnected && connected->front().myLabel.myValue >= 
-//                nearest->front().myLabel.myValue) {
-//            LabeledOpenPath connectingPath(PathLabel(PathLabel::TYP_CONNECTION, 
-//                    PathLabel::OWN_MODEL));
-//            connectingPath.myPath.appendPoint(joint.a);
-//            connectingPath.myPath.appendPoint(joint.b);
-//            //connection goes to output
-//            labeledopenpaths.push_back(connectingPath);
-//            //erase current
-//            split.erase(current);
-//            //search from the one you picked
-//            current = connected;
-////            std::cout << "Connection made!" << std::endl;
-//        } else {
-//            //erase current
-//            split.erase(current);
-//            //search from the nearest one
-//            current = nearest;
-////            std::cout << "No connection!" << std::endl;
-//            waste2 += (*labeledopenpaths.back().myPath.fromEnd() - 
-//                    *(current->front().myPath.fromStart())).magnitude();
-//        }
-//    }
-//    return waste2 < waste1;
-}
-
 void pather_optimizer_fastgraph::optimizeGraph(
         LabeledOpenPaths& labeledpaths, graph_type& graph, 
         boundary_container& bounds, Point2Type& entryPoint, 
-        const GrueConfig& grueConf) {
+        const GrueConfig& grueConf, const LinkCosts& costs) {
     node_index currentIndex = -1;
     node::forward_link_iterator next;
     Point2Type currentUnit;
@@ -279,10 +257,12 @@ void pather_optimizer_fastgraph::optimizeGraph(
     boundary_container& currentBounds = bounds;
     LabeledOpenPaths& output = labeledpaths;
     
+    entry_index liveEntries(currentGraph, grueConf);
+    
     while(!currentGraph.empty()) {
-        currentIndex = std::min_element(entryBegin(currentGraph), 
-                entryEnd(currentGraph), 
-                nodeComparator(grueConf, currentGraph, entryPoint))->getIndex();
+        currentIndex = liveEntries.best(entryPoint);
+        if(currentIndex == node_index(-1))
+            break;
         LabeledOpenPath activePath;
         if(!currentGraph[currentIndex].forwardEmpty()) {
             //can a connection be made from the last entry to here?
@@ -299,7 +279,8 @@ void pather_optimizer_fastgraph::optimizeGraph(
                     output, activePath, entryPoint);
         }
         while((next = bestLink(currentGraph[currentIndex], 
-                currentGraph, currentBounds, grueConf, currentUnit)) != 
+                currentGraph, currentBounds, liveEntries, grueConf, costs, 
+                currentUnit)) != 
                 currentGraph[currentIndex].forwardEnd()) {
             node::connection nextConnection = *next;
             currentUnit = nextConnection.second->normal();
@@ -310,12 +291,14 @@ void pather_optimizer_fastgraph::optimizeGraph(
             nextConnection.first->disconnect(currentGraph[currentIndex]);
             if(currentGraph[currentIndex].forwardEmpty() && 
                     currentGraph[currentIndex].reverseEmpty()) {
+                liveEntries.erase(currentGraph[currentIndex]);
                 currentGraph.destroyNode(currentGraph[currentIndex]);
             }
             currentIndex = nextConnection.first->getIndex();
         }
         if(currentGraph[currentIndex].forwardEmpty() && 
                 currentGraph[currentIndex].reverseEmpty()) {
+            liveEntries.erase(currentGraph[currentIndex]);
             currentGraph.destroyNode(currentGraph[currentIndex]);
         }
         //recover from corners here
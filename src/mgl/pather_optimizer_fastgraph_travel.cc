@@ -0,0 +1,301 @@
+#include "pather_optimizer_fastgraph.h"
+#include "stage_timer.h"
+#include <algorithm>
+#include <list>
+#include <vector>
+
+namespace mgl {
+
+/* A chain is a run of paths from the output of a bucket where each one 
+ starts where the previous one ended, usually joined by connections. 
+ Chains are never broken up, so no extrusion changes. Only the travel 
+ between them does. */
+class pather_optimizer_fastgraph::travel_chain {
+public:
+    travel_chain() : uniform(true), reversible(true), reversed(false), 
+            hasLabel(false) {}
+    Point2Type start() const { return reversed ? m_last : m_first; }
+    Point2Type end() const { return reversed ? m_first : m_last; }
+    /// can this chain swap places with other
+    bool sameKind(const travel_chain& other) const {
+        return uniform && other.uniform && hasLabel && other.hasLabel && 
+                label.myType == other.label.myType && 
+                label.myOwner == other.label.myOwner && 
+                label.myValue == other.label.myValue;
+    }
+    void append(LabeledOpenPaths& source, LabeledOpenPaths::iterator path);
+    /// move the paths to the end of destination, in the chosen direction
+    void spliceInto(LabeledOpenPaths& destination);
+    
+    LabeledOpenPaths paths;
+    PathLabel label;
+    /// all paths other than connections share label
+    bool uniform;
+    /// no closed loops, so the chain can run backwards
+    bool reversible;
+    bool reversed;
+    bool hasLabel;
+private:
+    Point2Type m_first;
+    Point2Type m_last;
+};
+
+void pather_optimizer_fastgraph::travel_chain::append(
+        LabeledOpenPaths& source, LabeledOpenPaths::iterator path) {
+    if(paths.empty())
+        m_first = *path->myPath.fromStart();
+    m_last = *path->myPath.fromEnd();
+    if(path->myPath.size() > 2 && 
+            *path->myPath.fromStart() == *path->myPath.fromEnd())
+        reversible = false;
+    if(!path->myLabel.isConnection()) {
+        if(!hasLabel) {
+            label = path->myLabel;
+            hasLabel = true;
+        } else if(label.myType != path->myLabel.myType || 
+                label.myOwner != path->myLabel.myOwner || 
+                label.myValue != path->myLabel.myValue) {
+            uniform = false;
+        }
+    }
+    paths.splice(paths.end(), source, path);
+}
+void pather_optimizer_fastgraph::travel_chain::spliceInto(
+        LabeledOpenPaths& destination) {
+    if(reversed) {
+        paths.reverse();
+        for(LabeledOpenPaths::iterator iter = paths.begin(); 
+                iter != paths.end(); 
+                ++iter) {
+            OpenPath backwards;
+            backwards.appendPoints(iter->myPath.fromEnd(), 
+                    iter->myPath.rend());
+            iter->myPath = backwards;
+        }
+    }
+    destination.splice(destination.end(), paths);
+}
+
+/* A run of chains of the same kind that may be freely reordered, with 
+ the fixed points before and (optionally) after it. */
+class pather_optimizer_fastgraph::travel_run {
+public:
+    typedef std::vector<travel_chain*> chain_vector;
+    
+    travel_run(chain_vector& chains, const Point2Type& before, 
+            const Point2Type* after, boundary_container& bounds) 
+            : m_chains(chains), m_before(before), 
+            m_hasAfter(after != NULL), m_bounds(bounds) {
+        if(after)
+            m_after = *after;
+    }
+    /**
+     @brief one sweep of 2-opt (reverse a range of chains) and Or-opt 
+     (move one chain elsewhere) moves
+     @return true if anything improved
+     */
+    bool improve(double deadline);
+private:
+    Point2Type pointBefore(size_t index) const {
+        return index ? m_chains[index - 1]->end() : m_before;
+    }
+    bool pointAfter(size_t index, Point2Type& point) const {
+        if(index + 1 < m_chains.size()) {
+            point = m_chains[index + 1]->start();
+            return true;
+        }
+        point = m_after;
+        return m_hasAfter;
+    }
+    static Scalar distance(const Point2Type& from, const Point2Type& to) {
+        return (to - from).magnitude();
+    }
+    /// travel to an optional point, nothing if it is absent
+    static Scalar distance(const Point2Type& from, const Point2Type& to, 
+            bool present) {
+        return present ? distance(from, to) : 0;
+    }
+    size_t crossings(const Point2Type& from, const Point2Type& to, 
+            bool present = true) const {
+        return present && from != to && 
+                crossesBounds(Segment2Type(from, to), m_bounds) ? 1 : 0;
+    }
+    bool tryReverse(size_t first, size_t last);
+    bool tryMove(size_t index);
+    
+    static const Scalar MIN_GAIN;
+    
+    chain_vector& m_chains;
+    Point2Type m_before;
+    Point2Type m_after;
+    bool m_hasAfter;
+    boundary_container& m_bounds;
+};
+
+const Scalar pather_optimizer_fastgraph::travel_run::MIN_GAIN = 1e-2;
+
+bool pather_optimizer_fastgraph::travel_run::tryReverse(size_t first, 
+        size_t last) {
+    Point2Type before = pointBefore(first);
+    Point2Type after;
+    bool hasAfter = pointAfter(last, after);
+    const Point2Type& oldStart = m_chains[first]->start();
+    const Point2Type& oldEnd = m_chains[last]->end();
+    Scalar gain = distance(before, oldStart) + 
+            distance(oldEnd, after, hasAfter) - 
+            distance(before, oldEnd) - 
+            distance(oldStart, after, hasAfter);
+    if(gain <= MIN_GAIN)
+        return false;
+    //travel inside the range is only mirrored, so only the ends matter
+    if(crossings(before, oldEnd) + crossings(oldStart, after, hasAfter) > 
+            crossings(before, oldStart) + crossings(oldEnd, after, hasAfter))
+        return false;
+    std::reverse(m_chains.begin() + first, m_chains.begin() + last + 1);
+    for(size_t index = first; index <= last; ++index) {
+        m_chains[index]->reversed = !m_chains[index]->reversed;
+    }
+    return true;
+}
+bool pather_optimizer_fastgraph::travel_run::tryMove(size_t index) {
+    travel_chain& moving = *m_chains[index];
+    Point2Type before = pointBefore(index);
+    Point2Type after;
+    bool hasAfter = pointAfter(index, after);
+    Scalar removeGain = distance(before, moving.start()) + 
+            distance(moving.end(), after, hasAfter) - 
+            distance(before, after, hasAfter);
+    if(removeGain <= MIN_GAIN)
+        return false;
+    Scalar bestGain = MIN_GAIN;
+    size_t bestSlot = 0;
+    bool bestReversed = false;
+    //slot k is the gap in front of m_chains[k], m_chains.size() is the end
+    for(size_t slot = 0; slot <= m_chains.size(); ++slot) {
+        if(slot == index || slot == index + 1)
+            continue;
+        Point2Type from = pointBefore(slot);
+        Point2Type to;
+        bool hasTo = slot < m_chains.size() ? 
+                (to = m_chains[slot]->start(), true) : 
+                (to = m_after, m_hasAfter);
+        Scalar gap = distance(from, to, hasTo);
+        for(int direction = 0; direction < 2; ++direction) {
+            if(direction == 1 && !moving.reversible)
+                break;
+            bool reversed = moving.reversed != (direction == 1);
+            Point2Type start = direction ? moving.end() : moving.start();
+            Point2Type end = direction ? moving.start() : moving.end();
+            Scalar gain = removeGain + gap - distance(from, start) - 
+                    distance(end, to, hasTo);
+            if(gain <= bestGain)
+                continue;
+            if(crossings(from, start) + crossings(end, to, hasTo) + 
+                    crossings(before, after, hasAfter) > 
+                    crossings(before, moving.start()) + 
+                    crossings(moving.end(), after, hasAfter) + 
+                    crossings(from, to, hasTo))
+                continue;
+            bestGain = gain;
+            bestSlot = slot;
+            bestReversed = reversed;
+        }
+    }
+    if(bestGain <= MIN_GAIN)
+        return false;
+    travel_chain* chain = m_chains[index];
+    chain->reversed = bestReversed;
+    m_chains.erase(m_chains.begin() + index);
+    if(bestSlot > index)
+        --bestSlot;
+    m_chains.insert(m_chains.begin() + bestSlot, chain);
+    return true;
+}
+bool pather_optimizer_fastgraph::travel_run::improve(double deadline) {
+    bool improved = false;
+    for(size_t first = 0; first < m_chains.size(); ++first) {
+        if(deadline > 0 && StageTimer::now() > deadline)
+            return false;
+        for(size_t last = first; last < m_chains.size(); ++last) {
+            if(!m_chains[last]->reversible)
+                break;
+            improved = tryReverse(first, last) || improved;
+        }
+    }
+    for(size_t index = 0; index < m_chains.size(); ++index) {
+        if(deadline > 0 && StageTimer::now() > deadline)
+            return false;
+        improved = tryMove(index) || improved;
+    }
+    return improved;
+}
+
+Scalar pather_optimizer_fastgraph::travelLength(
+        const LabeledOpenPaths& labeledopenpaths, Point2Type entryPoint) {
+    Scalar length = 0;
+    for(LabeledOpenPaths::const_iterator iter = labeledopenpaths.begin(); 
+            iter != labeledopenpaths.end(); 
+            ++iter) {
+        if(iter->myPath.empty())
+            continue;
+        length += (*iter->myPath.fromStart() - entryPoint).magnitude();
+        entryPoint = *iter->myPath.fromEnd();
+    }
+    return length;
+}
+Scalar pather_optimizer_fastgraph::optimizeIterative(
+        LabeledOpenPaths& labeledopenpaths, const Point2Type& entryPoint, 
+        boundary_container& bounds, double deadline) {
+    unsigned effort = grueCfg.get_iterativeEffort();
+    if(!effort || labeledopenpaths.size() < 2)
+        return 0;
+    Scalar before = travelLength(labeledopenpaths, entryPoint);
+    std::list<travel_chain> storage;
+    while(!labeledopenpaths.empty()) {
+        LabeledOpenPaths::iterator current = labeledopenpaths.begin();
+        if(current->myPath.empty()) {
+            labeledopenpaths.erase(current);
+            continue;
+        }
+        if(storage.empty() || 
+                storage.back().end() != *current->myPath.fromStart())
+            storage.push_back(travel_chain());
+        storage.back().append(labeledopenpaths, current);
+    }
+    travel_run::chain_vector order;
+    for(std::list<travel_chain>::iterator iter = storage.begin(); 
+            iter != storage.end(); 
+            ++iter) {
+        order.push_back(&*iter);
+    }
+    for(size_t first = 0; first < order.size(); ) {
+        size_t last = first + 1;
+        while(last < order.size() && order[first]->sameKind(*order[last]))
+            ++last;
+        if(last - first > 1 && order[first]->sameKind(*order[first])) {
+            travel_run::chain_vector chains(order.begin() + first, 
+                    order.begin() + last);
+            Point2Type runBefore = first ? order[first - 1]->end() : 
+                    entryPoint;
+            Point2Type runAfter;
+            if(last < order.size())
+                runAfter = order[last]->start();
+            travel_run run(chains, runBefore, 
+                    last < order.size() ? &runAfter : NULL, bounds);
+            for(unsigned pass = 0; pass < effort; ++pass) {
+                if(!run.improve(deadline))
+                    break;
+            }
+            std::copy(chains.begin(), chains.end(), order.begin() + first);
+        }
+        first = last;
+    }
+    for(travel_run::chain_vector::iterator iter = order.begin(); 
+            iter != order.end(); 
+            ++iter) {
+        (*iter)->spliceInto(labeledopenpaths);
+    }
+    return before - travelLength(labeledopenpaths, entryPoint);
+}
+
+}
@@ -392,8 +392,6 @@ void Regioner::flatSurfaces(RegionList::iterator regionsBegin,
 
 //		gridRangesForSlice(regionsBegin->insetLoops, grid,
 //				regionsBegin->flatSurface);
-        regionsBegin->flatSurface.yRays.resize(grid.getXValues().size());
-        regionsBegin->flatSurface.xRays.resize(grid.getYValues().size());
 		//inset supportloops by a fraction of supportmargin
 		LoopList insetSupportLoops;
 		loopsOffset(insetSupportLoops, regionsBegin->supportLoops, 
@@ -571,8 +569,8 @@ void Regioner::infills(RegionList::iterator regionsBegin,
 	for (RegionList::iterator current = regionsBegin;
 			current != regionsEnd; ++current, ++sequenceNumber) {
 
-		const GridRanges &surface = current->flatSurface;
 		tick();
+		StageTimer::Event layerTrace("layer", int(sequenceNumber));
 
 		// Solids
 		//GridRanges combinedSolid;
@@ -632,8 +630,11 @@ void Regioner::infills(RegionList::iterator regionsBegin,
 		// TODO: move me to the slicer
 		GridRanges sparseInfill, sparsePreInfill, solidInfill;
         
-        gridRangesForSlice(combinedLoops, grid, solidInfill);
-        gridRangesForSlice(sparseLoops, grid, sparsePreInfill);
+        //only cast the grid lines that can reach this layer's interior, 
+        //solid and sparse share the window so their lines match up
+        const GridWindow window = grid.windowForLoops(current->interiorLoops);
+        grid.createGridRanges(combinedLoops, window, solidInfill);
+        grid.createGridRanges(sparseLoops, window, sparsePreInfill);
         
 		size_t infillSkipCount = (int) (1 / grueCfg.get_infillDensity()) - 1;
 
@@ -653,10 +654,12 @@ void Regioner::infills(RegionList::iterator regionsBegin,
         }
 
 		//grid.gridRangeUnion(current->solid, sparseInfill, current->infill);
-        current->infill.xRays.resize(surface.xRays.size());
-        current->infill.yRays.resize(surface.yRays.size());
+        current->infill.xRaysOffset = solidInfill.xRaysOffset;
+        current->infill.yRaysOffset = solidInfill.yRaysOffset;
+        current->infill.xRays.resize(solidInfill.xRays.size());
+        current->infill.yRays.resize(solidInfill.yRays.size());
         
-        for(size_t x = 0; x < surface.xRays.size(); ++x) {
+        for(size_t x = 0; x < solidInfill.xRays.size(); ++x) {
             current->infill.xRays[x].insert(
                     current->infill.xRays[x].end(), 
                     sparseInfill.xRays[x].begin(), 
@@ -666,7 +669,7 @@ void Regioner::infills(RegionList::iterator regionsBegin,
                     solidInfill.xRays[x].begin(), 
                     solidInfill.xRays[x].end());
         }
-        for(size_t y = 0; y < surface.yRays.size(); ++y) {
+        for(size_t y = 0; y < solidInfill.yRays.size(); ++y) {
             current->infill.yRays[y].insert(
                     current->infill.yRays[y].end(), 
                     sparseInfill.yRays[y].begin(), 
@@ -0,0 +1,131 @@
+#include "s3g_writer.h"
+#include <cmath>
+
+namespace mgl {
+
+/// one command, assembled in place
+class S3gWriter::Packet {
+public:
+    Packet() : m_size(0) {}
+    Packet& u8(unsigned int value) {
+        m_data[m_size++] = static_cast<char>(value & 0xff);
+        return *this;
+    }
+    Packet& u16(unsigned int value) {
+        return u8(value).u8(value >> 8);
+    }
+    Packet& u32(uint32_t value) {
+        return u16(value & 0xffff).u16(value >> 16);
+    }
+    Packet& i32(int32_t value) {
+        return u32(static_cast<uint32_t>(value));
+    }
+    Packet& bytes(const Packet& other) {
+        for(size_t i = 0; i < other.m_size; ++i)
+            m_data[m_size++] = other.m_data[i];
+        return *this;
+    }
+    size_t size() const { return m_size; }
+    void write(std::ostream& out) const { out.write(m_data, m_size); }
+private:
+    //the longest command, queue point, takes 27 bytes
+    char m_data[32];
+    size_t m_size;
+};
+
+/// @a value rounded and clamped to what fits in @a limit
+static uint32_t clampRound(Scalar value, uint32_t limit) {
+    if(!(value > 0))
+        return 0;
+    if(value >= limit)
+        return limit;
+    return static_cast<uint32_t>(value + 0.5);
+}
+
+S3gWriter::S3gWriter(std::ostream& out, const Scalar stepsPerMm[AXES])
+        : m_out(out) {
+    for(unsigned int axis = 0; axis < AXES; ++axis)
+        m_stepsPerMm[axis] = stepsPerMm[axis];
+}
+
+int32_t S3gWriter::steps(unsigned int axis, Scalar mm) const {
+    int32_t rounded = static_cast<int32_t>(
+            floor(mm * m_stepsPerMm[axis] + 0.5));
+    //filament is fed by counting the extruder steps down, as GPX and
+    //ReplicatorG write them
+    return axis >= EXTRUDER_AXIS ? -rounded : rounded;
+}
+
+void S3gWriter::queuePoint(const Scalar position[AXES], Scalar seconds) {
+    Packet packet;
+    packet.u8(CMD_QUEUE_POINT);
+    for(unsigned int axis = 0; axis < AXES; ++axis)
+        packet.i32(steps(axis, position[axis]));
+    packet.u32(clampRound(seconds * 1e6, 0xffffffffu));
+    packet.u8(0); //no axis is relative
+    packet.write(m_out);
+}
+
+void S3gWriter::setPosition(const Scalar position[AXES]) {
+    Packet packet;
+    packet.u8(CMD_SET_POSITION);
+    for(unsigned int axis = 0; axis < AXES; ++axis)
+        packet.i32(steps(axis, position[axis]));
+    packet.write(m_out);
+}
+
+void S3gWriter::changeTool(unsigned int tool) {
+    Packet packet;
+    packet.u8(CMD_CHANGE_TOOL).u8(tool);
+    packet.write(m_out);
+}
+
+void S3gWriter::waitForTool(unsigned int tool, unsigned int timeout) {
+    static const unsigned int PING_MILLISECONDS = 100;
+    Packet packet;
+    packet.u8(CMD_WAIT_FOR_TOOL).u8(tool).u16(PING_MILLISECONDS);
+    packet.u16(clampRound(timeout, 0xffff));
+    packet.write(m_out);
+}
+
+void S3gWriter::setTemperature(unsigned int tool, unsigned int celsius) {
+    Packet payload;
+    payload.u16(clampRound(celsius, 0xffff));
+    toolAction(tool, TOOL_SET_TEMPERATURE, payload);
+}
+
+void S3gWriter::setPlatformTemperature(unsigned int tool,
+        unsigned int celsius) {
+    Packet payload;
+    payload.u16(clampRound(celsius, 0xffff));
+    toolAction(tool, TOOL_SET_PLATFORM_TEMPERATURE, payload);
+}
+
+void S3gWriter::setFan(unsigned int tool, bool on) {
+    Packet payload;
+    payload.u8(on ? 1 : 0);
+    toolAction(tool, TOOL_FAN, payload);
+}
+
+void S3gWriter::setBuildPercentage(unsigned int percent) {
+    Packet packet;
+    packet.u8(CMD_BUILD_PERCENTAGE).u8(clampRound(percent, 100)).u8(0);
+    packet.write(m_out);
+}
+
+void S3gWriter::delay(Scalar seconds) {
+    Packet packet;
+    packet.u8(CMD_DELAY).u32(clampRound(seconds * 1e3, 0xffffffffu));
+    packet.write(m_out);
+}
+
+void S3gWriter::toolAction(unsigned int tool, ToolAction action,
+        const Packet& payload) {
+    Packet packet;
+    packet.u8(CMD_TOOL_ACTION).u8(tool).u8(action).u8(payload.size());
+    packet.bytes(payload);
+    packet.write(m_out);
+}
+
+}
+
@@ -0,0 +1,87 @@
+/*
+ * File:   s3g_writer.h
+ *
+ * Binary s3g commands, as stored in .x3g files
+ */
+
+#ifndef MGL_S3G_WRITER_H
+#define	MGL_S3G_WRITER_H
+
+#include "mgl.h"
+#include <ostream>
+#include <stdint.h>
+
+namespace mgl {
+
+/**
+ @brief Writes the binary command stream MakerBot firmware plays from
+ .x3g files.
+
+ Each command is its id byte followed by its arguments, little endian,
+ without the framing and checksum used on a serial line. Positions are
+ absolute step counts for the X, Y, Z, A and B axes, converted from mm
+ with the machine's steps per mm and rounded from the absolute position
+ every time, so rounding never adds up over a print. The extruders' A and
+ B steps count down as filament is fed, the sign the firmware expects.
+
+ Every command is assembled in a small buffer and written to the stream
+ in a single call.
+ */
+class S3gWriter {
+public:
+    static const unsigned int AXES = 5;
+    /// the first extruder axis, A, and B after it
+    static const unsigned int EXTRUDER_AXIS = 3;
+
+    /// command ids from the s3g protocol
+    enum Command {
+        CMD_DELAY = 133,
+        CMD_CHANGE_TOOL = 134,
+        CMD_WAIT_FOR_TOOL = 135,
+        CMD_TOOL_ACTION = 136,
+        CMD_SET_POSITION = 140,
+        CMD_QUEUE_POINT = 142,
+        CMD_BUILD_PERCENTAGE = 150
+    };
+    /// subcommands of CMD_TOOL_ACTION
+    enum ToolAction {
+        TOOL_SET_TEMPERATURE = 3,
+        TOOL_FAN = 12,
+        TOOL_SET_PLATFORM_TEMPERATURE = 31
+    };
+
+    /**
+     @param out where commands go, opened in binary mode
+     @param stepsPerMm steps per mm of X, Y, Z, A and B
+     */
+    S3gWriter(std::ostream& out, const Scalar stepsPerMm[AXES]);
+
+    /// steps that @a mm on @a axis is rounded to, negated on A and B
+    int32_t steps(unsigned int axis, Scalar mm) const;
+    /// queue a straight move to @a position, in mm, taking @a seconds
+    void queuePoint(const Scalar position[AXES], Scalar seconds);
+    /// tell the machine it is at @a position, in mm, without moving
+    void setPosition(const Scalar position[AXES]);
+    void changeTool(unsigned int tool);
+    /// wait until @a tool is at temperature, at most @a timeout seconds
+    void waitForTool(unsigned int tool, unsigned int timeout);
+    void setTemperature(unsigned int tool, unsigned int celsius);
+    /// the platform is heated through a tool, usually the first one
+    void setPlatformTemperature(unsigned int tool, unsigned int celsius);
+    void setFan(unsigned int tool, bool on);
+    void setBuildPercentage(unsigned int percent);
+    void delay(Scalar seconds);
+
+private:
+    class Packet;
+    void toolAction(unsigned int tool, ToolAction action,
+            const Packet& payload);
+
+    std::ostream& m_out;
+    Scalar m_stepsPerMm[AXES];
+};
+
+}
+
+#endif	/* MGL_S3G_WRITER_H */
+
@@ -514,6 +514,17 @@ void mgl::translateOpenPaths(OpenPathList &paths, Point2Type p) {
 	}
 }
 
+void mgl::translateOpenPaths(std::list<LabeledOpenPath> &paths, 
+		Point2Type p) {
+	for (std::list<LabeledOpenPath>::iterator path = paths.begin();
+		 path != paths.end(); ++path) {
+		for (OpenPath::iterator point = path->myPath.fromStart();
+			 point != path->myPath.end(); ++point) {
+			*point += p;
+		}
+	}
+}
+
 void mgl::translateLoops(SegmentTable &loops, Point2Type p)
 {
 	for(unsigned int i=0; i < loops.size(); ++i)
@@ -22,6 +22,7 @@
 
 
 #include "loop_path.h"
+#include "labeled_path.h"
 
 namespace mgl
 {
@@ -58,6 +59,7 @@ void translatePolygons(Polygons &polygons, Point2Type p);
 void rotateLoops(LoopList& loops, Scalar angle);
 void translateLoops(LoopList& loops, Point2Type p);
 void translateOpenPaths(OpenPathList &paths, Point2Type p);
+void translateOpenPaths(std::list<LabeledOpenPath> &paths, Point2Type p);
 void rotatePolygon(Polygon& polygon, Scalar angle);
 void rotatePolygons(Polygons& polygons, Scalar angle);
 
@@ -0,0 +1,198 @@
+#include "segment_grid_index.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace mgl {
+
+segment_grid_index::segment_grid_index() 
+        : m_dirty(true), m_cellSize(1), m_cellsX(0), m_cellsY(0), 
+        m_query(0) {}
+void segment_grid_index::insert(const value_type& value) {
+    m_segments.push_back(value);
+    m_dirty = true;
+}
+bool segment_grid_index::intersects(const Segment2Type& line) const {
+    return walk(line, true) != 0;
+}
+size_t segment_grid_index::countIntersections(
+        const Segment2Type& line) const {
+    return walk(line, false);
+}
+void segment_grid_index::swap(segment_grid_index& other) {
+    m_segments.swap(other.m_segments);
+    std::swap(m_dirty, other.m_dirty);
+    std::swap(m_origin, other.m_origin);
+    std::swap(m_cellSize, other.m_cellSize);
+    std::swap(m_cellsX, other.m_cellsX);
+    std::swap(m_cellsY, other.m_cellsY);
+    m_cellStart.swap(other.m_cellStart);
+    m_cellItems.swap(other.m_cellItems);
+    m_stamps.swap(other.m_stamps);
+    std::swap(m_query, other.m_query);
+}
+void segment_grid_index::build() const {
+    m_dirty = false;
+    m_cellStart.clear();
+    m_cellItems.clear();
+    m_stamps.assign(m_segments.size(), 0);
+    m_query = 0;
+    m_cellsX = m_cellsY = 0;
+    if(m_segments.empty())
+        return;
+    AABBox bounds = to_bbox<value_type>::bound(m_segments.front());
+    for(std::vector<value_type>::const_iterator iter = m_segments.begin(); 
+            iter != m_segments.end(); 
+            ++iter) {
+        bounds.expandTo(to_bbox<value_type>::bound(*iter));
+    }
+    //aim for about one segment per cell
+    Scalar area = bounds.size_x() * bounds.size_y();
+    Scalar longest = std::max(bounds.size_x(), bounds.size_y());
+    m_cellSize = area > 0 ? 
+        std::sqrt(area / m_segments.size()) : 
+        longest / m_segments.size();
+    m_cellSize = std::max(m_cellSize, longest / MAX_CELLS_PER_AXIS);
+    if(!(m_cellSize > 0))
+        m_cellSize = 1;
+    m_origin = bounds.bottom_left();
+    m_cellsX = std::min(MAX_CELLS_PER_AXIS, 
+            size_t(bounds.size_x() / m_cellSize) + 1);
+    m_cellsY = std::min(MAX_CELLS_PER_AXIS, 
+            size_t(bounds.size_y() / m_cellSize) + 1);
+    /* register segments in every cell their bounding box touches, 
+     grown a little so that crossings on cell borders are not missed */
+    const Scalar slack = m_cellSize * 1e-6;
+    std::vector<size_t> ranges(m_segments.size() * 4);
+    m_cellStart.assign(m_cellsX * m_cellsY + 1, 0);
+    for(size_t i = 0; i < m_segments.size(); ++i) {
+        const value_type& segment = m_segments[i];
+        Scalar coords[4] = {
+            std::min(segment.a.x, segment.b.x) - slack - m_origin.x, 
+            std::min(segment.a.y, segment.b.y) - slack - m_origin.y, 
+            std::max(segment.a.x, segment.b.x) + slack - m_origin.x, 
+            std::max(segment.a.y, segment.b.y) + slack - m_origin.y};
+        for(size_t c = 0; c < 4; ++c) {
+            size_t limit = (c % 2 ? m_cellsY : m_cellsX) - 1;
+            Scalar cell = std::floor(coords[c] / m_cellSize);
+            ranges[i * 4 + c] = cell < 0 ? 0 : 
+                std::min(limit, size_t(cell));
+        }
+        for(size_t y = ranges[i * 4 + 1]; y <= ranges[i * 4 + 3]; ++y) {
+            for(size_t x = ranges[i * 4]; x <= ranges[i * 4 + 2]; ++x) {
+                ++m_cellStart[cellIndex(x, y) + 1];
+            }
+        }
+    }
+    for(size_t cell = 1; cell < m_cellStart.size(); ++cell) {
+        m_cellStart[cell] += m_cellStart[cell - 1];
+    }
+    m_cellItems.resize(m_cellStart.back());
+    std::vector<size_t> fill(m_cellStart.begin(), m_cellStart.end() - 1);
+    for(size_t i = 0; i < m_segments.size(); ++i) {
+        for(size_t y = ranges[i * 4 + 1]; y <= ranges[i * 4 + 3]; ++y) {
+            for(size_t x = ranges[i * 4]; x <= ranges[i * 4 + 2]; ++x) {
+                m_cellItems[fill[cellIndex(x, y)]++] = i;
+            }
+        }
+    }
+}
+size_t segment_grid_index::testCell(size_t cell, const Segment2Type& line, 
+        bool stopAtFirst) const {
+    size_t found = 0;
+    for(size_t item = m_cellStart[cell]; item < m_cellStart[cell + 1]; 
+            ++item) {
+        size_t segment = m_cellItems[item];
+        if(m_stamps[segment] == m_query)
+            continue;
+        m_stamps[segment] = m_query;
+        if(m_segments[segment].intersects(line)) {
+            ++found;
+            if(stopAtFirst)
+                break;
+        }
+    }
+    return found;
+}
+size_t segment_grid_index::walk(const Segment2Type& line, 
+        bool stopAtFirst) const {
+    if(m_dirty)
+        build();
+    if(m_segments.empty())
+        return 0;
+    if(++m_query == 0) {
+        //stamps wrapped around, start over
+        std::fill(m_stamps.begin(), m_stamps.end(), 0);
+        m_query = 1;
+    }
+    //clip the line to the grid (Liang-Barsky)
+    const Point2Type delta = line.b - line.a;
+    const Scalar extent[2] = {m_cellsX * m_cellSize, m_cellsY * m_cellSize};
+    const Scalar start[2] = {line.a.x - m_origin.x, line.a.y - m_origin.y};
+    const Scalar direction[2] = {delta.x, delta.y};
+    Scalar t0 = 0;
+    Scalar t1 = 1;
+    for(size_t axis = 0; axis < 2; ++axis) {
+        if(direction[axis] == 0) {
+            if(start[axis] < 0 || start[axis] > extent[axis])
+                return 0;
+            continue;
+        }
+        Scalar ta = (0 - start[axis]) / direction[axis];
+        Scalar tb = (extent[axis] - start[axis]) / direction[axis];
+        if(ta > tb)
+            std::swap(ta, tb);
+        t0 = std::max(t0, ta);
+        t1 = std::min(t1, tb);
+        if(t0 > t1)
+            return 0;
+    }
+    //walk the cells from t0 to t1
+    const size_t limits[2] = {m_cellsX - 1, m_cellsY - 1};
+    size_t cell[2];
+    size_t last[2];
+    int step[2];
+    Scalar tMax[2];
+    Scalar tDelta[2];
+    for(size_t axis = 0; axis < 2; ++axis) {
+        Scalar from = std::floor((start[axis] + t0 * direction[axis]) / 
+                m_cellSize);
+        Scalar to = std::floor((start[axis] + t1 * direction[axis]) / 
+                m_cellSize);
+        cell[axis] = from < 0 ? 0 : std::min(limits[axis], size_t(from));
+        last[axis] = to < 0 ? 0 : std::min(limits[axis], size_t(to));
+        if(direction[axis] > 0) {
+            step[axis] = 1;
+            tMax[axis] = ((cell[axis] + 1) * m_cellSize - start[axis]) / 
+                    direction[axis];
+            tDelta[axis] = m_cellSize / direction[axis];
+        } else if(direction[axis] < 0) {
+            step[axis] = -1;
+            tMax[axis] = (cell[axis] * m_cellSize - start[axis]) / 
+                    direction[axis];
+            tDelta[axis] = -m_cellSize / direction[axis];
+        } else {
+            step[axis] = 0;
+            tMax[axis] = std::numeric_limits<Scalar>::max();
+            tDelta[axis] = 0;
+        }
+    }
+    size_t found = 0;
+    for(size_t guard = m_cellsX + m_cellsY + 2; guard > 0; --guard) {
+        found += testCell(cellIndex(cell[0], cell[1]), line, stopAtFirst);
+        if(found && stopAtFirst)
+            break;
+        if(cell[0] == last[0] && cell[1] == last[1])
+            break;
+        size_t axis = tMax[0] < tMax[1] ? 0 : 1;
+        if(tMax[axis] > t1 || 
+                (step[axis] < 0 && cell[axis] == 0) || 
+                (step[axis] > 0 && cell[axis] == limits[axis]))
+            break;
+        cell[axis] += step[axis];
+        tMax[axis] += tDelta[axis];
+    }
+    return found;
+}
+
+}
@@ -0,0 +1,117 @@
+/* 
+ * File:   segment_grid_index.h
+ *
+ * A uniform grid over line segments for fast crossing tests
+ */
+
+#ifndef MGL_SEGMENT_GRID_INDEX_H
+#define	MGL_SEGMENT_GRID_INDEX_H
+
+#include "mgl.h"
+#include "spacial_data.h"
+#include "intersection_index.h"
+#include <vector>
+
+namespace mgl {
+
+/*
+ segment_grid_index implements the interface for a spacial index 
+ (see basic_boxlist.h) for line segments, and adds fast queries for 
+ segments crossed by a line.
+ 
+ It is meant for sets of segments that are inserted up front and then 
+ queried many times, like the boundaries of a layer. The grid is built 
+ lazily on the first query after an insertion. Its cell size is chosen 
+ from the number of segments and the area they cover, so that a cell 
+ holds only a few segments on average.
+ 
+ Crossing queries walk only the cells the query line passes through 
+ (a DDA traversal), and test every stored segment at most once. Their 
+ cost grows with the length of the line in cells, not with the number 
+ of segments.
+ 
+ Queries keep some scratch state, so one index must not be queried from 
+ several threads at the same time.
+ 
+ Interface methods:
+ 
+ void insert(const value_type& value);  //store a copy of value in this index
+ template <typename CONTAINER, typename FILTER>
+ void search(CONTAINER& result, const FILTER& filt); //query container
+ bool intersects(const Segment2Type& line); //does anything cross line
+ size_t countIntersections(const Segment2Type& line); //how many do
+ void swap(segment_grid_index& other);   //fast swap implementation
+ 
+ */
+class segment_grid_index {
+public:
+    typedef Segment2Type value_type;
+    
+    segment_grid_index();
+    
+    /*!Insert a value into the spacial index
+     @value: a const reference of what should be inserted.
+     a copy of this will be stored.*/
+    void insert(const value_type& value);
+    /*!Search for values that meet criteria of filt.filter(AABBox)
+     @result: Object supporting push_back(...) where output is placed
+     @filter: object supporting filter(...) that defines the criteria
+     This is a full scan, use intersects or countIntersections for 
+     crossing tests.*/
+    template <typename COLLECTION, typename FILTER>
+    void search(COLLECTION& result, const FILTER& filt) const {
+        for(std::vector<value_type>::const_iterator iter = m_segments.begin(); 
+                iter != m_segments.end(); 
+                ++iter) {
+            if(filt.filter(to_bbox<value_type>::bound(*iter)))
+                result.push_back(*iter);
+        }
+    }
+    /*!Test if any stored segment intersects line*/
+    bool intersects(const Segment2Type& line) const;
+    /*!Count the stored segments that intersect line*/
+    size_t countIntersections(const Segment2Type& line) const;
+    /*!Swap contents of this object with that of another
+     @other: The object with which to swap contents*/
+    void swap(segment_grid_index& other);
+    
+    size_t size() const { return m_segments.size(); }
+    bool empty() const { return m_segments.empty(); }
+    
+private:
+    
+    static const size_t MAX_CELLS_PER_AXIS = 1024;
+    
+    void build() const;
+    size_t cellIndex(size_t x, size_t y) const { return y * m_cellsX + x; }
+    /**
+     @brief visit every stored segment that intersects line
+     @param stopAtFirst return as soon as one is found
+     @return the number of intersecting segments found
+     */
+    size_t walk(const Segment2Type& line, bool stopAtFirst) const;
+    size_t testCell(size_t cell, const Segment2Type& line, 
+            bool stopAtFirst) const;
+    
+    std::vector<value_type> m_segments;
+    
+    //below here is the grid, rebuilt on demand
+    mutable bool m_dirty;
+    mutable Point2Type m_origin;
+    mutable Scalar m_cellSize;
+    mutable size_t m_cellsX;
+    mutable size_t m_cellsY;
+    /* segments of cell i are m_cellItems[m_cellStart[i]] up to 
+     m_cellItems[m_cellStart[i + 1]] */
+    mutable std::vector<size_t> m_cellStart;
+    mutable std::vector<size_t> m_cellItems;
+    /* a segment was already tested in this query 
+     if its stamp equals m_query */
+    mutable std::vector<size_t> m_stamps;
+    mutable size_t m_query;
+};
+
+}
+
+#endif	/* MGL_SEGMENT_GRID_INDEX_H */
+
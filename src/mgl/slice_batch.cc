@@ -0,0 +1,274 @@
+#include "slice_batch.h"
+#include "abstractable.h"
+#include "gcoder_writer.h"
+#include "meshy.h"
+#include "miracle.h"
+#include "segmenter.h"
+#include "stage_timer.h"
+#include "Exception.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace mgl {
+
+/* Settings only the gcoder reads. The pather's motion model reads the
+ extruders, their profiles, the XY rapid rate, the acceleration and the
+ start XY, so those are not here. */
+static const char* GCODE_ONLY_KEYS[] = {
+    "startGcode", "endGcode", "doFanCommand", "fanLayer",
+    "weightedFanCommand", "printLayerMessages", "doPrintProgress",
+    "minLayerDuration", "minSpeedMultiplier", "gcodeDecimals",
+    "commentLevel", "commentOpen", "commentClose", "outputFormat",
+    "gcodeThreads", "doStreaming", "streamQueueLayers",
+    "rapidMoveFeedRateZ", "xStepsPerMm", "yStepsPerMm", "zStepsPerMm",
+    "aStepsPerMm", "bStepsPerMm", "useEAxis", "doModalMoves",
+    "doRelativeE", "doArcFitting", "arcTolerance", "feedScalingFactor",
+    "startZ", "timingReport", "traceFile", "progressModelFile",
+    "programName", "versionStr", "firmware", "machineName",
+    "outFilename", "jsonProgress"
+};
+
+/* Settings that time the whole batch, which entries may not set. */
+static const char* BATCH_KEYS[] = { "timingReport", "traceFile" };
+static const size_t BATCH_KEY_COUNT =
+        sizeof(BATCH_KEYS) / sizeof(BATCH_KEYS[0]);
+
+/// an entry, and the keys of the work it can share with others
+class BatchOrder {
+public:
+    BatchOrder() : index(0) {}
+    bool operator<(const BatchOrder& other) const {
+        if(segmentKey != other.segmentKey)
+            return segmentKey < other.segmentKey;
+        if(pathKey != other.pathKey)
+            return pathKey < other.pathKey;
+        return index < other.index;
+    }
+    std::string segmentKey;
+    std::string pathKey;
+    size_t index;
+};
+
+/// whether @a name ends in @a extension
+static bool hasExtension(const std::string& name, const std::string& extension) {
+    return name.size() > extension.size() && name.compare(
+            name.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+SliceBatch::SliceBatch(const Configuration& config) : base(config) {}
+
+void SliceBatch::readManifest(const std::string& file,
+        std::vector<Entry>& entries) {
+    std::ifstream in(file.c_str());
+    Json::Value manifest;
+    Json::Reader reader;
+    if(!in || !reader.parse(in, manifest) || !manifest.isArray()) {
+        std::string msg = "Batch manifest: \"";
+        msg += file;
+        msg += "\" is not a JSON array";
+        Exception mixup(msg.c_str());
+        throw mixup;
+    }
+    entries.clear();
+    for(Json::Value::ArrayIndex i = 0; i < manifest.size(); ++i) {
+        const Json::Value& item = manifest[i];
+        if(!item.isObject() || !item["model"].isString() ||
+                !(item["config"].isNull() || item["config"].isObject()) ||
+                !(item["output"].isNull() || item["output"].isString())) {
+            std::stringstream msg;
+            msg << "Batch manifest: entry " << i << " of \"" << file <<
+                    "\" needs a \"model\", and its \"config\" must be an "
+                    "object and its \"output\" a file name";
+            Exception mixup(msg.str());
+            throw mixup;
+        }
+        //one report and trace cover the whole batch
+        for(size_t k = 0; k < BATCH_KEY_COUNT; ++k) {
+            if(!item["config"].isMember(BATCH_KEYS[k]))
+                continue;
+            std::stringstream msg;
+            msg << "Batch manifest: entry " << i << " of \"" << file <<
+                    "\" sets " << BATCH_KEYS[k] << ", which only the base "
+                    "config or the command line may set for the batch";
+            Exception mixup(msg.str());
+            throw mixup;
+        }
+        Entry entry;
+        entry.model = item["model"].asString();
+        entry.overrides = item["config"];
+        entry.output = item["output"].asString();
+        entries.push_back(entry);
+    }
+}
+
+bool SliceBatch::gcodeOnly(const std::string& key) {
+    const size_t count = sizeof(GCODE_ONLY_KEYS) / sizeof(GCODE_ONLY_KEYS[0]);
+    for(size_t i = 0; i < count; ++i) {
+        if(key == GCODE_ONLY_KEYS[i])
+            return true;
+    }
+    return false;
+}
+
+Configuration SliceBatch::entryConfig(const Entry& entry) const {
+    Configuration config(base);
+    const Json::Value::Members keys = entry.overrides.isObject() ?
+            entry.overrides.getMemberNames() : Json::Value::Members();
+    for(size_t i = 0; i < keys.size(); ++i)
+        config[keys[i].c_str()] = entry.overrides[keys[i]];
+    //an .x3g output asks for x3g unless the config says otherwise
+    if(config["outputFormat"].isNull() && hasExtension(entry.output, ".x3g"))
+        config["outputFormat"] = "x3g";
+    return config;
+}
+
+void SliceBatch::run(const std::vector<Entry>& entries,
+        std::vector<Result>& results, std::ostream* log) const {
+    results.assign(entries.size(), Result());
+    std::vector<Configuration> configs(entries.size());
+    std::vector<BatchOrder> order;
+    FileSystemAbstractor fileSystem;
+    for(size_t i = 0; i < entries.size(); ++i) {
+        const Entry& entry = entries[i];
+        Result& result = results[i];
+        configs[i] = entryConfig(entry);
+        bool x3g = configs[i]["outputFormat"].asString() == "x3g";
+        result.output = entry.output;
+        if(result.output.empty()) {
+            result.output = fileSystem.ChangeExtension(
+                    fileSystem.ExtractFilename(entry.model.c_str()).c_str(),
+                    x3g ? ".x3g" : ".gcode");
+        }
+        BatchOrder ordered;
+        ordered.index = i;
+        try {
+            GrueConfig grueCfg;
+            grueCfg.loadFromFile(configs[i]);
+            std::ostringstream key;
+            key << std::setprecision(17) << entry.model << '\n' <<
+                    grueCfg.get_layerH() << ' ' <<
+                    grueCfg.get_layerWidthRatio() << ' ' <<
+                    grueCfg.get_doPutModelOnPlatform() << ' ' <<
+                    grueCfg.get_centerX() << ' ' << grueCfg.get_centerY();
+            ordered.segmentKey = key.str();
+        } catch (const std::exception& failure) {
+            result.error = failure.what();
+            if(log) {
+                *log << "Batch: " << entry.model << " to " << result.output <<
+                        " failed: " << result.error << std::endl;
+            }
+            continue;
+        }
+        Json::Value planned = configs[i].root;
+        const Json::Value::Members keys = planned.getMemberNames();
+        for(size_t k = 0; k < keys.size(); ++k) {
+            if(gcodeOnly(keys[k]))
+                planned.removeMember(keys[k]);
+        }
+        Json::FastWriter writer;
+        ordered.pathKey = entry.model + '\n' + writer.write(planned);
+        order.push_back(ordered);
+    }
+    std::sort(order.begin(), order.end());
+
+    //only the last segmenter and the last paths are kept
+    Segmenter* segmenter = NULL;
+    Limits limits;
+    std::string segmentKey;
+    std::string segmentError;
+    LayerMeasure layerMeasure(0.0, 0.0);
+    LayerPaths layers;
+    std::string pathKey;
+    std::string pathError;
+    for(size_t i = 0; i < order.size(); ++i) {
+        const BatchOrder& ordered = order[i];
+        const Entry& entry = entries[ordered.index];
+        Result& result = results[ordered.index];
+        const double began = StageTimer::now();
+        try {
+            GrueConfig grueCfg;
+            grueCfg.loadFromFile(configs[ordered.index]);
+            //named as miracleGrue names them, adding up over the entries
+            StageTimer::Task stage;
+            if(ordered.segmentKey != segmentKey) {
+                delete segmenter;
+                segmenter = NULL;
+                segmentKey = ordered.segmentKey;
+                segmentError.clear();
+                pathKey.clear();
+                layers.erase(layers.begin(), layers.end());
+                try {
+                    stage.start("load");
+                    Meshy mesh(grueCfg);
+                    mesh.readStlFile(entry.model.c_str());
+                    mesh.alignToPlate();
+                    limits = mesh.readLimits();
+                    stage.start("segment");
+                    segmenter = new Segmenter(grueCfg);
+                    segmenter->tablaturize(mesh);
+                    stage.stop();
+                    result.segmented = true;
+                } catch (const std::exception& failure) {
+                    segmentError = failure.what();
+                }
+            }
+            if(!segmentError.empty()) {
+                Exception mixup(segmentError);
+                throw mixup;
+            }
+            if(ordered.pathKey != pathKey) {
+                pathKey = ordered.pathKey;
+                pathError.clear();
+                layers.erase(layers.begin(), layers.end());
+                try {
+                    RegionList regions;
+                    miracleGruePaths(grueCfg, *segmenter, limits, regions,
+                            layerMeasure, layers);
+                    result.planned = true;
+                } catch (const std::exception& failure) {
+                    pathError = failure.what();
+                    layers.erase(layers.begin(), layers.end());
+                }
+            }
+            if(!pathError.empty()) {
+                Exception mixup(pathError);
+                throw mixup;
+            }
+            const bool x3g =
+                    grueCfg.get_outputFormat() == GrueConfig::OUTPUT_X3G;
+            GCodeFile gcodeFile;
+            gcodeFile.open(result.output.c_str(),
+                    x3g ? std::ios::out | std::ios::binary : std::ios::out);
+            if(!gcodeFile) {
+                Exception mixup(std::string("Bad output file: ") +
+                        result.output);
+                throw mixup;
+            }
+            stage.start("gcode");
+            GCoder gcoder(grueCfg);
+            gcoder.writeGcodeFile(layers, layerMeasure, gcodeFile,
+                    entry.model);
+            gcodeFile.close();
+            result.ok = true;
+        } catch (const std::exception& failure) {
+            result.error = failure.what();
+        }
+        result.seconds = StageTimer::now() - began;
+        if(log) {
+            *log << "Batch: " << entry.model << " to " << result.output;
+            if(result.ok) {
+                *log << " in " << result.seconds << "s" <<
+                        (result.segmented ? "" : ", segmenting shared") <<
+                        (result.planned ? "" : ", paths shared") << std::endl;
+            } else {
+                *log << " failed: " << result.error << std::endl;
+            }
+        }
+    }
+    delete segmenter;
+}
+
+}
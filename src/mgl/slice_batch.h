@@ -0,0 +1,83 @@
+/*
+ * File:   slice_batch.h
+ *
+ * Slices many models and config variants in one process, doing the work
+ * the entries have in common once
+ */
+
+#ifndef MGL_SLICE_BATCH_H
+#define	MGL_SLICE_BATCH_H
+
+#include "configuration.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace mgl {
+
+/**
+ @brief Runs a manifest of entries, each a model, changes to a base config
+ and an output file, one after another, each on all of the threads.
+
+ The entries run grouped by model, so what they share is done once.
+ Entries on the same model with the same layer height, layer width ratio
+ and placement share its loading and segmenting. Those whose configs
+ differ only in settings the gcoder alone reads, such as the start gcode,
+ the fan or the comments, share the planned paths as well, and only write
+ their own gcode.
+ */
+class SliceBatch {
+public:
+    class Entry {
+    public:
+        std::string model;
+        /// values to set over the base config, an object
+        Json::Value overrides;
+        /// the gcode file, the model's name with .gcode when empty
+        std::string output;
+    };
+    /// how an entry went
+    class Result {
+    public:
+        Result() : ok(false), segmented(false), planned(false), seconds(0) {}
+        bool ok;
+        bool segmented;     ///< its model was segmented for it, not shared
+        bool planned;       ///< its paths were planned for it, not shared
+        double seconds;
+        std::string output;
+        std::string error;
+    };
+
+    /// @param config what every entry starts from, copied
+    explicit SliceBatch(const Configuration& config);
+
+    /**
+     @brief read a manifest, a JSON array of objects each with a "model",
+     and maybe a "config" object of changes and an "output", throwing if
+     an entry's config sets timingReport or traceFile, which time the
+     whole batch
+     */
+    static void readManifest(const std::string& file,
+            std::vector<Entry>& entries);
+    /// whether only the gcoder reads config @a key
+    static bool gcodeOnly(const std::string& key);
+
+    /**
+     @brief slice every entry, in the order that shares the most
+     @param results receives how each went, in the order of @a entries
+     @param log receives a line for each entry as it ends, if given
+     */
+    void run(const std::vector<Entry>& entries, std::vector<Result>& results,
+            std::ostream* log = NULL) const;
+
+private:
+    /// the base config with the changes of @a entry
+    Configuration entryConfig(const Entry& entry) const;
+
+    Configuration base;
+};
+
+}
+
+#endif	/* MGL_SLICE_BATCH_H */
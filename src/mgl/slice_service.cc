@@ -0,0 +1,513 @@
+#include "slice_service.h"
+#include "abstractable.h"
+#include "meshy.h"
+#include "miracle.h"
+#include "segmenter.h"
+#include "stage_timer.h"
+#include "thread_lock.h"
+#include "Exception.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+namespace mgl {
+
+/// microseconds to wait for jobs to come
+static const unsigned int JOB_NAP = 20000;
+
+/* Settings naming files to read into the gcode or to write, which only
+ the base config may set. */
+static const char* FILE_KEYS[] = {
+    "startGcode", "endGcode", "timingReport", "traceFile",
+    "progressModelFile"
+};
+
+/// keeps the messages of a job for polling instead of printing them
+class SliceService::JobProgress : public ProgressJSONStreamTotal {
+public:
+    JobProgress(const GrueConfig& grueConf, ThreadLock& threadLock,
+            std::vector<std::string>& jobEvents)
+            : ProgressJSONStreamTotal(grueConf), lock(threadLock),
+            events(jobEvents) {}
+    void onReport(const Json::Value& msg) {
+        add(msg);
+    }
+protected:
+    void outputJson(const char* taskName, unsigned int percent) {
+        add(makeJson(taskName, percent));
+    }
+private:
+    void add(const Json::Value& msg) {
+        Json::FastWriter writer;
+        std::string line = writer.write(msg);
+        if(!line.empty() && line[line.size() - 1] == '\n')
+            line.erase(line.size() - 1);
+        ThreadGuard guard(lock);
+        events.push_back(line);
+    }
+    ThreadLock& lock;
+    std::vector<std::string>& events;
+};
+
+#ifdef _WIN32
+static DWORD WINAPI serviceThreadMain(LPVOID thread);
+#else
+static void* serviceThreadMain(void* thread);
+#endif
+
+/// a thread running jobs for a SliceService, joined when destroyed
+class ServiceThread {
+public:
+    explicit ServiceThread(SliceService& jobService) : service(jobService) {
+#ifdef _WIN32
+        handle = CreateThread(NULL, 0, serviceThreadMain, this, 0, NULL);
+#else
+        pthread_create(&thread, NULL, serviceThreadMain, this);
+#endif
+    }
+    ~ServiceThread() {
+#ifdef _WIN32
+        WaitForSingleObject(handle, INFINITE);
+        CloseHandle(handle);
+#else
+        pthread_join(thread, NULL);
+#endif
+    }
+    void work() {
+        service.work();
+    }
+private:
+    ServiceThread(const ServiceThread&);
+    ServiceThread& operator=(const ServiceThread&);
+    SliceService& service;
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t thread;
+#endif
+};
+
+#ifdef _WIN32
+static DWORD WINAPI serviceThreadMain(LPVOID thread) {
+    static_cast<ServiceThread*>(thread)->work();
+    return 0;
+}
+#else
+static void* serviceThreadMain(void* thread) {
+    static_cast<ServiceThread*>(thread)->work();
+    return NULL;
+}
+#endif
+
+SliceService::SliceService(const Configuration& config,
+        const std::string& spoolDir, size_t warmModels, size_t keptJobs)
+        : base(config), spool(spoolDir), maxWarm(warmModels),
+        maxJobs(keptJobs), poolThreads(1), nextId(1), scheduler(1, 0),
+        lock(new ThreadLock), cacheLock(new ThreadLock),
+        stopping(false) {
+    GrueConfig settings;
+    settings.loadFromFile(base);
+    poolThreads = std::max(settings.get_threads(), 1u);
+    scheduler = JobScheduler(settings.get_maxConcurrentJobs(),
+            size_t(settings.get_jobMemoryBudget()) << 20);
+}
+
+SliceService::~SliceService() {
+    stop();
+    for(JobMap::iterator job = jobs.begin(); job != jobs.end(); ++job) {
+        if(job->second->state == JOB_QUEUED)
+            remove(job->second->modelFile.c_str());
+        delete job->second;
+    }
+    for(WarmList::iterator model = warmModels.begin();
+            model != warmModels.end(); ++model)
+        delete model->segmenter;
+    delete cacheLock;
+    delete lock;
+}
+
+SliceService::JobId SliceService::submit(const std::string& stl,
+        const Json::Value& overrides, int priority) {
+    if(!overrides.isNull() && !overrides.isObject()) {
+        mgl::Exception mixup("Config changes for a job must be a JSON "
+                "object");
+        throw mixup;
+    }
+    JobId id;
+    {
+        ThreadGuard guard(*lock);
+        id = nextId++;
+    }
+    Job* job = new Job;
+    job->modelHash = modelHash(stl);
+    job->overrides = overrides;
+    job->priority = priority;
+    std::ostringstream name;
+    name << spool << "/job" << id << ".stl";
+    job->modelFile = name.str();
+    std::ofstream file(job->modelFile.c_str(),
+            std::ios::out | std::ios::binary);
+    file.write(stl.data(), stl.size());
+    file.close();
+    if(!file) {
+        delete job;
+        mgl::Exception mixup("Can't write the model of a job to \"" +
+                name.str() + "\"");
+        throw mixup;
+    }
+    ThreadGuard guard(*lock);
+    job->submitted = StageTimer::now();
+    jobs[id] = job;
+    unprepared.push_back(id);
+    return id;
+}
+
+void SliceService::start() {
+    if(!workers.empty())
+        return;
+    stopping = false;
+    for(size_t i = 0; i < scheduler.maxRunningCount(); ++i)
+        workers.push_back(new ServiceThread(*this));
+}
+
+void SliceService::stop() {
+    stopping = true;
+    for(size_t i = 0; i < workers.size(); ++i)
+        delete workers[i];
+    workers.clear();
+}
+
+void SliceService::work() {
+    while(!stopping) {
+        if(step() == STEP_IDLE)
+            nap(JOB_NAP);
+    }
+}
+
+bool SliceService::runNext() {
+    while(true) {
+        Step done = step();
+        if(done == STEP_ENDED)
+            return true;
+        if(done == STEP_IDLE)
+            return false;
+    }
+}
+
+SliceService::Step SliceService::step() {
+    JobId id = 0;
+    Job* job = NULL;
+    bool preparing = false;
+    {
+        ThreadGuard guard(*lock);
+        /* Every job is segmented before any more start, so the waiting
+         jobs are all ranked when a slot frees up. */
+        if(!unprepared.empty()) {
+            id = unprepared.front();
+            unprepared.pop_front();
+            job = jobs[id];
+            preparing = true;
+        } else if(scheduler.admit(StageTimer::now(), id)) {
+            job = jobs[id];
+            job->state = JOB_RUNNING;
+            job->started = StageTimer::now();
+            //an equal share of the slots, so together the jobs never
+            //take more than the threads, all of them once none can join
+            const size_t sharing = scheduler.overBudget() ? 1 :
+                    std::max<size_t>(scheduler.maxRunningCount(), 1);
+            job->threads = std::max(
+                    poolThreads / static_cast<unsigned int>(sharing), 1u);
+        } else {
+            return STEP_IDLE;
+        }
+    }
+    if(preparing) {
+        std::string error;
+        try {
+            prepare(*job);
+        } catch (const std::exception& failure) {
+            error = failure.what();
+        } catch (...) {
+            error = "Unknown error while segmenting";
+        }
+        ThreadGuard guard(*lock);
+        if(error.empty()) {
+            scheduler.add(id, job->priority, job->predictedSeconds,
+                    job->predictedBytes, job->submitted);
+            return STEP_PREPARED;
+        }
+        remove(job->modelFile.c_str());
+        end(id, *job, JOB_FAILED, error);
+        return STEP_ENDED;
+    }
+    run(id, *job);
+    return STEP_ENDED;
+}
+
+bool SliceService::namesFile(const std::string& key) {
+    const size_t count = sizeof(FILE_KEYS) / sizeof(FILE_KEYS[0]);
+    for(size_t i = 0; i < count; ++i) {
+        if(key == FILE_KEYS[i])
+            return true;
+    }
+    return false;
+}
+
+Configuration SliceService::jobConfig(const Job& job) const {
+    Configuration config(base);
+    const Json::Value::Members keys = job.overrides.isObject() ?
+            job.overrides.getMemberNames() : Json::Value::Members();
+    for(size_t i = 0; i < keys.size(); ++i) {
+        if(!namesFile(keys[i]))
+            config[keys[i].c_str()] = job.overrides[keys[i]];
+    }
+    if(!job.threads)
+        return config;
+    //its share of the threads, or fewer if the job asks for fewer
+    unsigned int share = job.threads;
+    if(job.overrides.isObject() && job.overrides["threads"].isIntegral())
+        share = std::min(share, job.overrides["threads"].asUInt());
+    config["threads"] = share;
+    const char* stages[] = { "pathingThreads", "gcodeThreads" };
+    for(size_t i = 0; i < sizeof(stages) / sizeof(stages[0]); ++i) {
+        if(config.isMember(stages[i]) && config[stages[i]].isIntegral() &&
+                config[stages[i]].asUInt() > share)
+            config[stages[i]] = share;
+    }
+    return config;
+}
+
+void SliceService::prepare(Job& job) {
+    GrueConfig grueCfg;
+    grueCfg.loadFromFile(jobConfig(job));
+    std::ostringstream key;
+    key << std::setprecision(17) << job.modelHash << ' ' <<
+            grueCfg.get_layerH() << ' ' <<
+            grueCfg.get_layerWidthRatio() << ' ' <<
+            grueCfg.get_doPutModelOnPlatform() << ' ' <<
+            grueCfg.get_centerX() << ' ' << grueCfg.get_centerY();
+    bool warm = false;
+    WarmModel& model = acquire(key.str(), job.modelFile, grueCfg, warm);
+    JobFeatures features = jobFeatures(grueCfg, *model.segmenter,
+            model.limits);
+    release(model);
+    ProgressModel progressModel;
+    if(!grueCfg.get_progressModelFile().empty())
+        progressModel.loadFile(grueCfg.get_progressModelFile());
+
+    ThreadGuard guard(*lock);
+    job.modelKey = key.str();
+    job.warm = warm;
+    job.predictedSeconds = progressModel.predictJob(features);
+    job.predictedBytes = JobScheduler::predictBytes(features);
+}
+
+void SliceService::run(JobId id, Job& job) {
+    //only this thread changes a running job's settings, they need no lock
+    JobState state = JOB_DONE;
+    std::string error;
+    std::string gcodeText;
+    try {
+        GrueConfig grueCfg;
+        grueCfg.loadFromFile(jobConfig(job));
+        bool warm = false;
+        WarmModel& model = acquire(job.modelKey, job.modelFile, grueCfg,
+                warm);
+        if(!warm) {
+            //dropped while the job waited
+            ThreadGuard guard(*lock);
+            job.warm = false;
+        }
+        try {
+            JobProgress progress(grueCfg, *lock, job.events);
+            std::ostringstream out;
+            RegionList regions;
+            miracleGrueSegmented(grueCfg, job.modelFile.c_str(),
+                    *model.segmenter, model.limits, out, regions, 
+                    &progress);
+            gcodeText = out.str();
+        } catch (...) {
+            release(model);
+            throw;
+        }
+        release(model);
+    } catch (const std::exception& failure) {
+        state = JOB_FAILED;
+        error = failure.what();
+    } catch (...) {
+        state = JOB_FAILED;
+        error = "Unknown error while slicing";
+    }
+    remove(job.modelFile.c_str());
+    ThreadGuard guard(*lock);
+    job.gcode.swap(gcodeText);
+    scheduler.finish(id);
+    end(id, job, state, error);
+}
+
+SliceService::WarmModel& SliceService::acquire(const std::string& key,
+        const std::string& modelFile, const GrueConfig& grueCfg,
+        bool& warm) {
+    ThreadGuard guard(*cacheLock);
+    for(WarmList::iterator model = warmModels.begin();
+            model != warmModels.end(); ++model) {
+        if(model->key == key) {
+            warmModels.splice(warmModels.begin(), warmModels, model);
+            warm = true;
+            ++warmModels.front().users;
+            return warmModels.front();
+        }
+    }
+    warm = false;
+    //segmenting under the lock keeps two jobs from doing the same model
+    Meshy mesh(grueCfg);
+    mesh.readStlFile(modelFile.c_str());
+    mesh.alignToPlate();
+    Segmenter* segmenter = new Segmenter(grueCfg);
+    try {
+        segmenter->tablaturize(mesh);
+    } catch (...) {
+        delete segmenter;
+        throw;
+    }
+    warmModels.push_front(WarmModel());
+    WarmModel& model = warmModels.front();
+    model.key = key;
+    model.segmenter = segmenter;
+    model.limits = mesh.readLimits();
+    model.users = 1;
+    //drop the least recently used that no job is using
+    WarmList::iterator unused = warmModels.end();
+    while(warmModels.size() > maxWarm && unused != warmModels.begin()) {
+        --unused;
+        if(unused->users)
+            continue;
+        delete unused->segmenter;
+        unused = warmModels.erase(unused);
+    }
+    return model;
+}
+
+void SliceService::release(WarmModel& model) {
+    ThreadGuard guard(*cacheLock);
+    --model.users;
+}
+
+void SliceService::end(JobId id, Job& job, JobState state,
+        const std::string& error) {
+    job.state = state;
+    job.error = error;
+    job.ended = StageTimer::now();
+    finished.push_back(id);
+    pruneJobs();
+}
+
+void SliceService::pruneJobs() {
+    while(finished.size() > maxJobs) {
+        JobMap::iterator job = jobs.find(finished.front());
+        finished.pop_front();
+        if(job != jobs.end()) {
+            delete job->second;
+            jobs.erase(job);
+        }
+    }
+}
+
+SliceService::JobState SliceService::poll(JobId id, size_t firstEvent,
+        std::vector<std::string>& events, std::string* error) const {
+    ThreadGuard guard(*lock);
+    JobMap::const_iterator found = jobs.find(id);
+    if(found == jobs.end())
+        return JOB_UNKNOWN;
+    const Job& job = *found->second;
+    for(size_t i = firstEvent; i < job.events.size(); ++i)
+        events.push_back(job.events[i]);
+    if(error)
+        *error = job.error;
+    return job.state;
+}
+
+bool SliceService::gcode(JobId id, std::string& out) const {
+    ThreadGuard guard(*lock);
+    JobMap::const_iterator found = jobs.find(id);
+    if(found == jobs.end() || found->second->state != JOB_DONE)
+        return false;
+    out = found->second->gcode;
+    return true;
+}
+
+bool SliceService::info(JobId id, JobInfo& out) const {
+    ThreadGuard guard(*lock);
+    JobMap::const_iterator found = jobs.find(id);
+    if(found == jobs.end())
+        return false;
+    const Job& job = *found->second;
+    const double now = StageTimer::now();
+    out.state = job.state;
+    out.priority = job.priority;
+    out.warm = job.warm;
+    out.threads = job.threads;
+    out.predictedSeconds = job.predictedSeconds;
+    out.predictedBytes = job.predictedBytes;
+    out.waitSeconds = (job.state == JOB_QUEUED ? now : job.started) -
+            job.submitted;
+    out.serviceSeconds = 0;
+    if(job.state == JOB_RUNNING)
+        out.serviceSeconds = now - job.started;
+    else if(job.state != JOB_QUEUED && job.started > 0)
+        out.serviceSeconds = job.ended - job.started;
+    out.events = job.events.size();
+    out.error = job.error;
+    return true;
+}
+
+bool SliceService::forget(JobId id) {
+    ThreadGuard guard(*lock);
+    JobMap::iterator found = jobs.find(id);
+    if(found == jobs.end() || found->second->state == JOB_QUEUED ||
+            found->second->state == JOB_RUNNING)
+        return false;
+    delete found->second;
+    jobs.erase(found);
+    finished.erase(std::find(finished.begin(), finished.end(), id));
+    return true;
+}
+
+const char* SliceService::stateName(JobState state) {
+    switch(state) {
+    case JOB_QUEUED:
+        return "queued";
+    case JOB_RUNNING:
+        return "running";
+    case JOB_DONE:
+        return "done";
+    case JOB_FAILED:
+        return "failed";
+    default:
+        return "unknown";
+    }
+}
+
+std::string SliceService::modelHash(const std::string& stl) {
+    //64 bit FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < stl.size(); ++i) {
+        hash ^= static_cast<unsigned char>(stl[i]);
+        hash *= 1099511628211ULL;
+    }
+    std::ostringstream hex;
+    hex << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return hex.str();
+}
+
+}
@@ -0,0 +1,224 @@
+/*
+ * File:   slice_service.h
+ *
+ * Slices models sent to a long-running process, several jobs at once,
+ * keeping recently segmented models for the next job on the same model
+ */
+
+#ifndef MGL_SLICE_SERVICE_H
+#define	MGL_SLICE_SERVICE_H
+
+#include "configuration.h"
+#include "job_scheduler.h"
+#include "obj_limits.h"
+
+#include <deque>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace mgl {
+
+class Segmenter;
+class ThreadLock;
+class ServiceThread;
+
+/**
+ @brief Queues slicing jobs, each a model and changes to a base config,
+ and keeps what each job reports and writes until it is asked for.
+
+ Jobs are submitted and polled from any thread, such as the threads of
+ a web server. They run on the threads start makes, maxConcurrentJobs
+ of them, or one at a time on the thread calling runNext. Each job gets
+ the threads of the base config divided by maxConcurrentJobs, at least
+ one, so the jobs running side by side never crowd the cores. A job too
+ large to run beside others gets all the threads. There is no pool the
+ jobs draw from: a job keeps its share to the end, though it runs alone,
+ and no job is preempted for one of higher priority.
+
+ Each job is first loaded and segmented, which tells how long it will
+ take and how much memory it will need. The JobScheduler starts the
+ waiting jobs in order of priority, then of how soon they will finish,
+ while their memory fits in jobMemoryBudget.
+
+ Loading and segmenting a model is done once for every model kept warm.
+ A job on the same bytes, with the same layer height, layer width ratio
+ and placement on the plate, starts from the kept segmenter. The least
+ recently used model no job is using is dropped once more than
+ warmModels are kept.
+
+ The config keys that name files, such as the start gcode or where the
+ timing report goes, keep their base values whatever a job asks for, as
+ jobs come from clients that may not read or write the server's files.
+ */
+class SliceService {
+public:
+    enum JobState {
+        JOB_UNKNOWN,    ///< never submitted, or forgotten
+        JOB_QUEUED,
+        JOB_RUNNING,
+        JOB_DONE,
+        JOB_FAILED
+    };
+    typedef JobScheduler::JobId JobId;
+
+    /// what a job is predicted to take, and has taken so far
+    class JobInfo {
+    public:
+        JobInfo() : state(JOB_UNKNOWN), priority(0), warm(false),
+                threads(0), predictedSeconds(0), predictedBytes(0),
+                waitSeconds(0), serviceSeconds(0), events(0) {}
+        JobState state;
+        int priority;
+        bool warm;      ///< started from a model kept warm
+        unsigned int threads;   ///< its share of the threads, once started
+        Scalar predictedSeconds;    ///< once segmented
+        size_t predictedBytes;      ///< once segmented
+        double waitSeconds;     ///< from submission to start, or to now
+        double serviceSeconds;  ///< from start to end, or to now
+        size_t events;  ///< progress messages so far
+        std::string error;
+    };
+
+    /**
+     @param config what every job starts from, copied, with the threads,
+     maxConcurrentJobs and jobMemoryBudget to share out
+     @param spoolDir where models wait as files until their job ends
+     @param warmModels how many segmented models to keep
+     @param keptJobs how many finished jobs to keep, oldest dropped first
+     */
+    SliceService(const Configuration& config, const std::string& spoolDir,
+            size_t warmModels = 4, size_t keptJobs = 64);
+    /// stops the threads, after their jobs finish
+    ~SliceService();
+
+    /**
+     @brief queue slicing a model
+     @param stl the bytes of an STL file, binary or text
+     @param overrides values to set over the base config, an object
+     @param priority jobs of higher priority start first
+     */
+    JobId submit(const std::string& stl, const Json::Value& overrides,
+            int priority = 0);
+    /// start threads that run jobs as they come, until stop
+    void start();
+    /// let the running jobs finish, then end the threads of start
+    void stop();
+    /**
+     @brief prepare and run jobs on this thread until one has ended, false
+     if none was waiting
+     */
+    bool runNext();
+
+    /**
+     @brief what job @a id has come to
+     @param firstEvent how many of its progress messages were seen before
+     @param events receives the JSON messages after those, each on one
+     line without a newline
+     @param error receives why the job failed, if it did
+     */
+    JobState poll(JobId id, size_t firstEvent,
+            std::vector<std::string>& events, std::string* error = NULL) const;
+    /// the gcode of job @a id, false unless it is done
+    bool gcode(JobId id, std::string& out) const;
+    /// what job @a id is predicted to take and took, false if unknown
+    bool info(JobId id, JobInfo& out) const;
+    /// drop job @a id and what it wrote, false if it is queued or running
+    bool forget(JobId id);
+
+    static const char* stateName(JobState state);
+    /// whether config @a key names a file, which jobs can't change
+    static bool namesFile(const std::string& key);
+    /// what the bytes of a model hash to, in hexadecimal
+    static std::string modelHash(const std::string& stl);
+
+private:
+    SliceService(const SliceService&);
+    SliceService& operator=(const SliceService&);
+    friend class ServiceThread;
+
+    class Job {
+    public:
+        Job() : priority(0), state(JOB_QUEUED), warm(false), threads(0),
+                predictedSeconds(0), predictedBytes(0), submitted(0),
+                started(0), ended(0) {}
+        std::string modelFile;
+        std::string modelHash;
+        /// which warm model it slices from, once segmented
+        std::string modelKey;
+        Json::Value overrides;
+        int priority;
+        JobState state;
+        bool warm;
+        unsigned int threads;
+        Scalar predictedSeconds;
+        size_t predictedBytes;
+        double submitted;
+        double started;
+        double ended;
+        std::vector<std::string> events;
+        std::string gcode;
+        std::string error;
+    };
+    /// a model as segmented for one layer height and placement
+    class WarmModel {
+    public:
+        WarmModel() : segmenter(NULL), users(0) {}
+        std::string key;
+        Segmenter* segmenter;
+        Limits limits;
+        /// jobs using it, which keep it from being dropped
+        size_t users;
+    };
+    class JobProgress;
+    typedef std::map<JobId, Job*> JobMap;
+    typedef std::list<WarmModel> WarmList;
+    enum Step { STEP_IDLE, STEP_PREPARED, STEP_ENDED };
+
+    /// prepare or run one job, whichever is due
+    Step step();
+    /// the threads of start each do this
+    void work();
+    /// segment the model of @a job, and predict what the job needs
+    void prepare(Job& job);
+    void run(JobId id, Job& job);
+    /**
+     @brief the base config with the overrides of @a job, but for the
+     keys that name files, and its threads
+     */
+    Configuration jobConfig(const Job& job) const;
+    /**
+     @brief the warm model for @a key, segmented from @a modelFile if
+     not kept, in use until released
+     */
+    WarmModel& acquire(const std::string& key, const std::string& modelFile,
+            const GrueConfig& grueCfg, bool& warm);
+    void release(WarmModel& model);
+    /// record how @a job ended, with the lock held
+    void end(JobId id, Job& job, JobState state, const std::string& error);
+    /// drop the oldest finished jobs beyond keptJobs
+    void pruneJobs();
+
+    Configuration base;
+    std::string spool;
+    size_t maxWarm;
+    size_t maxJobs;
+    unsigned int poolThreads;
+    JobId nextId;
+    JobMap jobs;
+    /// jobs not yet segmented, oldest first
+    std::deque<JobId> unprepared;
+    JobScheduler scheduler;
+    std::deque<JobId> finished;
+    /// most recently used first, guarded by the cache lock
+    WarmList warmModels;
+    ThreadLock* lock;
+    ThreadLock* cacheLock;
+    std::vector<ServiceThread*> workers;
+    volatile bool stopping;
+};
+
+}
+
+#endif	/* MGL_SLICE_SERVICE_H */
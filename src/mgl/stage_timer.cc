@@ -0,0 +1,543 @@
+#include "stage_timer.h"
+#include "thread_lock.h"
+#include "Exception.h"
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <vector>
+#include <jsoncpp/json/writer.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sys/resource.h>
+#endif
+
+#ifdef OMPFF
+#include <omp.h>
+#endif
+
+namespace mgl {
+
+bool StageTimer::s_enabled = false;
+bool StageTimer::s_tracing = false;
+
+static const char* const COUNTER_NAMES[StageTimer::COUNTER_COUNT] = {
+    "clipperCalls", "rayCasts", "linkProbes", "allocations",
+    "allocatedBytes"
+};
+
+/// seconds on a clock that never goes back
+static double wallClock() {
+#ifdef _WIN32
+#ifdef OMPFF
+    return omp_get_wtime();
+#else
+    return double(std::clock()) / CLOCKS_PER_SEC;
+#endif
+#else
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+#endif
+}
+
+/// CPU seconds of the calling thread, of the whole process on windows
+static double threadClock() {
+#ifdef _WIN32
+    return double(std::clock()) / CLOCKS_PER_SEC;
+#else
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+#endif
+}
+
+/// CPU seconds of the whole process
+static double processClock() {
+#ifdef _WIN32
+    return double(std::clock()) / CLOCKS_PER_SEC;
+#else
+    timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+#endif
+}
+
+/// the most memory the process has held so far, 0 where unknown
+static long peakRssKb() {
+#ifdef _WIN32
+    return 0;
+#else
+    rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage))
+        return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+/// what one thread spent in a stage
+class ThreadTimes {
+public:
+    ThreadTimes() : calls(0), wall(0), cpu(0) {}
+    size_t calls;
+    double wall;
+    double cpu;
+};
+
+class StageTimer::Stage {
+public:
+    Stage(const std::string& stageName, Stage* above)
+            : name(stageName), parent(above), handedCpu(0), peakRss(0),
+            rssGrowth(0) {
+        for(unsigned int counter = 0; counter < COUNTER_COUNT; ++counter)
+            counts[counter] = 0;
+    }
+    ~Stage() {
+        for(size_t index = 0; index < children.size(); ++index)
+            delete children[index];
+    }
+    /// the sub-stage called @a childName, added if new
+    Stage* child(const char* childName) {
+        for(size_t index = 0; index < children.size(); ++index) {
+            if(children[index]->name == childName)
+                return children[index];
+        }
+        children.push_back(new Stage(childName, this));
+        return children.back();
+    }
+    void toJson(Json::Value& out) const {
+        size_t calls = 0;
+        double wall = 0;
+        double cpu = handedCpu;
+        for(std::map<int, ThreadTimes>::const_iterator iter =
+                threads.begin(); iter != threads.end(); ++iter) {
+            calls += iter->second.calls;
+            wall += iter->second.wall;
+            cpu += iter->second.cpu;
+        }
+        out["name"] = name;
+        out["calls"] = Json::UInt(calls);
+        out["wallSeconds"] = wall;
+        out["cpuSeconds"] = cpu;
+        out["peakRssKb"] = Json::Int(peakRss);
+        out["peakRssGrowthKb"] = Json::Int(rssGrowth);
+        for(unsigned int counter = 0; counter < COUNTER_COUNT; ++counter) {
+            //byte counts may not fit in 32 bits
+            if(counts[counter])
+                out["counts"][COUNTER_NAMES[counter]] =
+                        double(counts[counter]);
+        }
+        if(threads.size() > 1) {
+            for(std::map<int, ThreadTimes>::const_iterator iter =
+                    threads.begin(); iter != threads.end(); ++iter) {
+                Json::Value thread;
+                thread["thread"] = iter->first;
+                thread["calls"] = Json::UInt(iter->second.calls);
+                thread["wallSeconds"] = iter->second.wall;
+                thread["cpuSeconds"] = iter->second.cpu;
+                out["threads"].append(thread);
+            }
+        }
+        for(size_t index = 0; index < children.size(); ++index)
+            children[index]->toJson(out["stages"][Json::UInt(index)]);
+    }
+
+    std::string name;
+    Stage* parent;
+    std::vector<Stage*> children;
+    std::map<int, ThreadTimes> threads;
+    /// CPU time of scopes handed to other threads, at any depth
+    double handedCpu;
+    /// peak resident memory as the stage last ended
+    long peakRss;
+    /// how much the stage raised the peak, over all its calls
+    long rssGrowth;
+    size_t counts[COUNTER_COUNT];
+};
+
+/// a span on the timeline
+class TraceRecord {
+public:
+    TraceRecord(const char* spanName, int spanLayer, bool isStage,
+            double spanStart, double spanEnd)
+            : name(spanName), layer(spanLayer), stage(isStage),
+            start(spanStart), end(spanEnd) {}
+    const char* name;
+    int layer;
+    bool stage;
+    double start;
+    double end;
+};
+
+/// one stage open on a thread
+class Frame {
+public:
+    size_t serial;
+    StageTimer::Stage* stage;
+    /// opened under a stage open on another thread
+    bool handed;
+    double wall;
+    double cpu;
+    long peakRss;
+    size_t counts[StageTimer::COUNTER_COUNT];
+};
+
+/// the stages open on a thread, and what it has counted
+class ThreadState {
+public:
+    ThreadState() : id(0), generation(0), ended(false) {
+        clear();
+    }
+    void clear() {
+        frames.clear();
+        trace.clear();
+        for(unsigned int counter = 0;
+                counter < StageTimer::COUNTER_COUNT; ++counter)
+            counts[counter] = 0;
+    }
+    bool isOpen(const StageTimer::Stage* stage) const {
+        for(size_t index = 0; index < frames.size(); ++index) {
+            if(frames[index].stage == stage)
+                return true;
+        }
+        return false;
+    }
+    int id;
+    unsigned int generation;
+    /// its thread has exited, so it is freed when timing restarts
+    bool ended;
+    std::vector<Frame> frames;
+    size_t counts[StageTimer::COUNTER_COUNT];
+    /// only appended to by its own thread
+    std::vector<TraceRecord> trace;
+};
+
+#ifdef _WIN32
+static VOID WINAPI threadEnded(PVOID state);
+#else
+static void threadEnded(void* state);
+#endif
+
+/// each thread's ThreadState, handed to threadEnded as the thread exits
+class ThreadSlot {
+public:
+    ThreadSlot() {
+#ifdef _WIN32
+        index = FlsAlloc(threadEnded);
+#else
+        pthread_key_create(&key, threadEnded);
+#endif
+    }
+    ThreadState* get() const {
+#ifdef _WIN32
+        return static_cast<ThreadState*>(FlsGetValue(index));
+#else
+        return static_cast<ThreadState*>(pthread_getspecific(key));
+#endif
+    }
+    void set(ThreadState* state) {
+#ifdef _WIN32
+        FlsSetValue(index, state);
+#else
+        pthread_setspecific(key, state);
+#endif
+    }
+private:
+    ThreadSlot(const ThreadSlot&);
+    ThreadSlot& operator=(const ThreadSlot&);
+#ifdef _WIN32
+    DWORD index;
+#else
+    pthread_key_t key;
+#endif
+};
+
+//shared, changed while holding s_lock, which threads ending after exit
+//may still take, so it is never destroyed
+static ThreadLock& s_lock = *new ThreadLock;
+static StageTimer::Stage* s_root = NULL;
+static size_t s_nextSerial = 0;
+static int s_nextThread = 0;
+static double s_startWall = 0;
+static double s_startCpu = 0;
+static double s_stopWall = 0;
+static double s_stopCpu = 0;
+static std::vector<ThreadState*> s_threads;
+static Json::Value s_sizes;
+//changed only by enable, while nothing is being timed
+static unsigned int s_generation = 0;
+
+//one per thread, made as it first times something
+static ThreadSlot s_slot;
+
+/// drop @a state from s_threads and free it, holding s_lock
+static void freeThread(ThreadState* state) {
+    s_threads.erase(std::find(s_threads.begin(), s_threads.end(), state));
+    delete state;
+}
+
+/* What an exiting thread timed is kept for the report and trace until
+ timing restarts, what it timed before that is freed at once. */
+#ifdef _WIN32
+static VOID WINAPI threadEnded(PVOID state) {
+#else
+static void threadEnded(void* state) {
+#endif
+    ThreadState* ended = static_cast<ThreadState*>(state);
+    ThreadGuard guard(s_lock);
+    if(ended->generation == s_generation)
+        ended->ended = true;
+    else
+        freeThread(ended);
+}
+
+/// the calling thread's state, emptied if timing restarted since its use
+static ThreadState& thisThread() {
+    ThreadState* state = s_slot.get();
+    if(!state) {
+        state = new ThreadState;
+        {
+            ThreadGuard guard(s_lock);
+            state->id = s_nextThread++;
+            s_threads.push_back(state);
+        }
+        s_slot.set(state);
+    }
+    if(state->generation != s_generation) {
+        state->clear();
+        state->generation = s_generation;
+    }
+    return *state;
+}
+
+void StageTimer::enable(bool trace) {
+    ThreadGuard guard(s_lock);
+    for(size_t index = s_threads.size(); index--; ) {
+        if(s_threads[index]->ended)
+            freeThread(s_threads[index]);
+    }
+    delete s_root;
+    s_root = new Stage("", NULL);
+    s_sizes = Json::Value(Json::objectValue);
+    ++s_generation;
+    s_startWall = wallClock();
+    s_startCpu = processClock();
+    s_enabled = true;
+    s_tracing = trace;
+}
+
+void StageTimer::disable() {
+    ThreadGuard guard(s_lock);
+    if(s_enabled) {
+        s_stopWall = wallClock();
+        s_stopCpu = processClock();
+    }
+    s_enabled = false;
+    s_tracing = false;
+}
+
+StageTimer::Stage* StageTimer::current() {
+    if(!s_enabled)
+        return NULL;
+    ThreadState& state = thisThread();
+    return state.frames.empty() ? NULL : state.frames.back().stage;
+}
+
+size_t StageTimer::begin(const char* name, Stage* parent) {
+    ThreadState& state = thisThread();
+    Frame frame;
+    frame.handed = parent && !state.isOpen(parent);
+    if(!parent && !state.frames.empty())
+        parent = state.frames.back().stage;
+    {
+        ThreadGuard guard(s_lock);
+        frame.stage = (parent ? parent : s_root)->child(name);
+        frame.serial = ++s_nextSerial;
+    }
+    for(unsigned int counter = 0; counter < COUNTER_COUNT; ++counter)
+        frame.counts[counter] = state.counts[counter];
+    frame.peakRss = peakRssKb();
+    frame.cpu = threadClock();
+    frame.wall = wallClock();
+    state.frames.push_back(frame);
+    return frame.serial;
+}
+
+void StageTimer::end(size_t serial) {
+    ThreadState& state = thisThread();
+    size_t depth = state.frames.size();
+    while(depth && state.frames[depth - 1].serial != serial)
+        --depth;
+    //already ended with the stage around it
+    if(!depth)
+        return;
+    const double wall = wallClock();
+    const double cpu = threadClock();
+    const long peakRss = peakRssKb();
+    //stages left open inside this one end with it
+    while(state.frames.size() >= depth) {
+        const Frame& frame = state.frames.back();
+        {
+            ThreadGuard guard(s_lock);
+            ThreadTimes& times = frame.stage->threads[state.id];
+            ++times.calls;
+            times.wall += wall - frame.wall;
+            times.cpu += cpu - frame.cpu;
+            frame.stage->peakRss = peakRss;
+            frame.stage->rssGrowth += peakRss - frame.peakRss;
+            for(unsigned int counter = 0; counter < COUNTER_COUNT;
+                    ++counter) {
+                size_t counted = state.counts[counter] -
+                        frame.counts[counter];
+                frame.stage->counts[counter] += counted;
+                if(!frame.handed)
+                    continue;
+                for(Stage* above = frame.stage->parent; above;
+                        above = above->parent)
+                    above->counts[counter] += counted;
+            }
+            if(frame.handed) {
+                for(Stage* above = frame.stage->parent; above;
+                        above = above->parent)
+                    above->handedCpu += cpu - frame.cpu;
+            }
+        }
+        if(s_tracing) {
+            state.trace.push_back(TraceRecord(frame.stage->name.c_str(),
+                    -1, true, frame.wall, wall));
+        }
+        state.frames.pop_back();
+    }
+}
+
+void StageTimer::addCount(Counter counter, size_t amount) {
+    thisThread().counts[counter] += amount;
+}
+
+void StageTimer::addAllocation(size_t bytes) {
+    //making the state allocates, so threads without one are left out
+    ThreadState* state = s_slot.get();
+    if(!state || state->generation != s_generation)
+        return;
+    ++state->counts[ALLOCATIONS];
+    state->counts[ALLOCATED_BYTES] += bytes;
+}
+
+size_t StageTimer::total(Counter counter) {
+    ThreadGuard guard(s_lock);
+    size_t sum = 0;
+    for(size_t index = 0; index < s_threads.size(); ++index) {
+        if(s_threads[index]->generation == s_generation)
+            sum += s_threads[index]->counts[counter];
+    }
+    return sum;
+}
+
+void StageTimer::recordSizes(const char* name, const Json::Value& sizes) {
+    ThreadGuard guard(s_lock);
+    s_sizes[name] = sizes;
+}
+
+double StageTimer::now() {
+    return wallClock();
+}
+
+void StageTimer::record(const char* name, int layer, double start) {
+    thisThread().trace.push_back(TraceRecord(name, layer, false, start,
+            wallClock()));
+}
+
+void StageTimer::report(Json::Value& out) {
+    out = Json::Value(Json::objectValue);
+    {
+        ThreadGuard guard(s_lock);
+        const double wall = s_enabled ? wallClock() : s_stopWall;
+        const double cpu = s_enabled ? processClock() : s_stopCpu;
+        out["wallSeconds"] = wall - s_startWall;
+        out["cpuSeconds"] = cpu - s_startCpu;
+        out["peakRssKb"] = Json::Int(peakRssKb());
+        out["stages"] = Json::Value(Json::arrayValue);
+        if(!s_sizes.empty())
+            out["sizes"] = s_sizes;
+        if(s_root) {
+            for(size_t index = 0; index < s_root->children.size(); ++index)
+                s_root->children[index]->toJson(
+                        out["stages"][Json::UInt(index)]);
+        }
+    }
+}
+
+void StageTimer::writeReport(const std::string& destination) {
+    Json::Value timing;
+    report(timing);
+    Json::StyledWriter writer;
+    if(destination == "-") {
+        std::cerr << writer.write(timing);
+        return;
+    }
+    std::ofstream out(destination.c_str());
+    if(!out) {
+        Exception mixup("Can't write timing report to " + destination);
+        throw mixup;
+    }
+    out << writer.write(timing);
+}
+
+void StageTimer::writeTrace(std::ostream& out) {
+    //microseconds since timing began
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out.setf(std::ios_base::fixed, std::ios_base::floatfield);
+    out.precision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    ThreadGuard guard(s_lock);
+    for(size_t index = 0; index < s_threads.size(); ++index) {
+        const ThreadState& thread = *s_threads[index];
+        if(thread.generation != s_generation || thread.trace.empty())
+            continue;
+        out << (first ? "\n" : ",\n");
+        first = false;
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                "\"tid\":" << thread.id << ",\"args\":{\"name\":\"thread "
+                << thread.id << "\"}}";
+        for(std::vector<TraceRecord>::const_iterator span =
+                thread.trace.begin(); span != thread.trace.end(); ++span) {
+            out << ",\n{\"name\":" << Json::valueToQuotedString(span->name)
+                    << ",\"cat\":\"" << (span->stage ? "stage" : "event")
+                    << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread.id
+                    << ",\"ts\":" << (span->start - s_startWall) * 1e6
+                    << ",\"dur\":" << (span->end - span->start) * 1e6;
+            if(span->layer >= 0)
+                out << ",\"args\":{\"layer\":" << span->layer << "}";
+            out << "}";
+        }
+    }
+    out << "\n]}\n";
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void StageTimer::writeTrace(const std::string& destination) {
+    if(destination == "-") {
+        writeTrace(std::cerr);
+        return;
+    }
+    std::ofstream out(destination.c_str());
+    if(!out) {
+        Exception mixup("Can't write trace to " + destination);
+        throw mixup;
+    }
+    writeTrace(out);
+}
+
+}
+
@@ -0,0 +1,201 @@
+/*
+ * File:   stage_timer.h
+ *
+ * Times the stages of a job and counts the costly operations and memory
+ * in them, optionally keeping a timeline of them to view as a Chrome trace
+ */
+
+#ifndef MGL_STAGE_TIMER_H
+#define	MGL_STAGE_TIMER_H
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <jsoncpp/json/value.h>
+
+namespace mgl {
+
+/**
+ @brief Wall and CPU time of the named stages of a job, as a tree.
+
+ A stage begun while another is open on the same thread is a sub-stage
+ of it. Work a stage hands to other threads is timed by scopes opened
+ there with the stage as their parent. Those scopes count towards the
+ CPU time and counts of the stage and everything above it, and are
+ broken down by thread in the report.
+
+ CPU time is that of the thread that ran a stage, plus what was handed
+ off. Wall time adds up every time a stage ran, so a sub-stage run on
+ several threads at once may take longer than its parent.
+
+ The peak resident memory of the process is read as each stage begins
+ and ends, which tells which stage raised it. Scopes running at once
+ on several threads each see the whole rise. Allocations are counted
+ only in programs linked with allocation_hook.cc.
+
+ Timing is off until enable is called. While off, each scope, task,
+ event and count costs a test of one flag.
+
+ Tracing also keeps when each stage and event began and ended on which
+ thread, in a buffer per thread, for a timeline in chrome://tracing or
+ Perfetto. A thread's buffers are kept after it exits, until timing is
+ enabled again. Any threads may be timed, not only OpenMP's.
+ */
+class StageTimer {
+public:
+    /// operations counted in whichever stage does them
+    enum Counter {
+        CLIPPER_CALLS,  ///< polygon clips and offsets
+        RAY_CASTS,      ///< grid lines cast across outlines
+        LINK_PROBES,    ///< straight moves tested against boundaries
+        ALLOCATIONS,    ///< calls to operator new
+        ALLOCATED_BYTES,    ///< bytes asked of operator new
+        COUNTER_COUNT
+    };
+
+    class Stage;
+
+    /// times a stage from construction to destruction
+    class Scope {
+    public:
+        /**
+         @param name names the stage among its siblings, calls of the
+         same name add up
+         @param parent a stage from current(), possibly open on another
+         thread, to hang this one under, NULL for the innermost stage
+         open on this thread
+         */
+        explicit Scope(const char* name, Stage* parent = NULL)
+                : m_frame(0) {
+            if(s_enabled)
+                m_frame = begin(name, parent);
+        }
+        ~Scope() {
+            if(m_frame)
+                end(m_frame);
+        }
+    private:
+        Scope(const Scope&);
+        Scope& operator=(const Scope&);
+        size_t m_frame;
+    };
+
+    /**
+     @brief times consecutive stages, each lasting until the next starts,
+     this task is destroyed, or the stage around it ends
+     */
+    class Task {
+    public:
+        Task() : m_frame(0) {}
+        /// copies start out idle
+        Task(const Task&) : m_frame(0) {}
+        Task& operator=(const Task&) { return *this; }
+        ~Task() {
+            stop();
+        }
+        /// end the stage before, then begin @a name
+        void start(const char* name) {
+            stop();
+            if(s_enabled)
+                m_frame = begin(name, NULL);
+        }
+        /// end the stage, if it is still open
+        void stop() {
+            if(m_frame)
+                end(m_frame);
+            m_frame = 0;
+        }
+    private:
+        size_t m_frame;
+    };
+
+    /**
+     @brief a span shown only in the trace, like one layer or one costly
+     call, that adds nothing to the stage tree
+     */
+    class Event {
+    public:
+        /**
+         @param name must last until the trace is written, a literal
+         @param layer shown with the span unless negative
+         */
+        explicit Event(const char* name, int layer = -1)
+                : m_name(name), m_layer(layer), m_start(-1) {
+            if(s_tracing)
+                m_start = now();
+        }
+        ~Event() {
+            if(m_start >= 0)
+                record(m_name, m_layer, m_start);
+        }
+    private:
+        Event(const Event&);
+        Event& operator=(const Event&);
+        const char* m_name;
+        int m_layer;
+        double m_start;
+    };
+
+    /**
+     @brief forget everything timed so far and start timing
+     @param trace also keep a timeline for writeTrace
+     */
+    static void enable(bool trace = false);
+    /// stop timing, what was timed stays for the report and trace
+    static void disable();
+    static bool enabled() { return s_enabled; }
+    static bool tracing() { return s_tracing; }
+    /// seconds on a clock that never steps back, for measuring spans
+    static double now();
+    /// the innermost stage open on this thread, or NULL
+    static Stage* current();
+    /// add @a amount to @a counter in the stage open on this thread
+    static void count(Counter counter, size_t amount = 1) {
+        if(s_enabled)
+            addCount(counter, amount);
+    }
+    /**
+     @brief what every thread that has opened a stage counted of
+     @a counter since timing was enabled, open stages included
+     */
+    static size_t total(Counter counter);
+    /**
+     @brief count an allocation in the stage open on this thread, only
+     on threads that have opened a stage, so it is safe in operator new
+     */
+    static void countAllocation(size_t bytes) {
+        if(s_enabled)
+            addAllocation(bytes);
+    }
+    /// show @a sizes, from containerSizes, under @a name in the report
+    static void recordSizes(const char* name, const Json::Value& sizes);
+    /// every stage timed so far, stages still open are left out
+    static void report(Json::Value& out);
+    /**
+     @brief write the report as JSON
+     @param destination a file name, or - for stderr
+     */
+    static void writeReport(const std::string& destination);
+    /**
+     @brief write the timeline as Chrome trace event JSON, only once
+     nothing is being timed
+     */
+    static void writeTrace(std::ostream& out);
+    /// @param destination a file name, or - for stderr
+    static void writeTrace(const std::string& destination);
+
+private:
+    static size_t begin(const char* name, Stage* parent);
+    static void end(size_t frame);
+    static void addCount(Counter counter, size_t amount);
+    static void addAllocation(size_t bytes);
+    static void record(const char* name, int layer, double start);
+
+    static bool s_enabled;
+    static bool s_tracing;
+};
+
+}
+
+#endif	/* MGL_STAGE_TIMER_H */
+
@@ -0,0 +1,236 @@
+#include "task_scheduler.h"
+#include "thread_lock.h"
+#include "stage_timer.h"
+#include "Exception.h"
+
+#include <deque>
+#include <exception>
+
+#ifdef OMPFF
+#include <omp.h>
+#endif
+
+namespace mgl {
+
+/// microseconds to wait for other threads to finish or free up tasks
+static const unsigned int TASK_NAP = 50;
+
+TaskGraph::~TaskGraph() {
+    for(size_t id = 0; id < nodes.size(); ++id)
+        delete nodes[id].task;
+}
+
+TaskGraph::TaskId TaskGraph::add(Task* task) {
+    nodes.push_back(Node(task));
+    return nodes.size() - 1;
+}
+
+void TaskGraph::depend(TaskId later, TaskId earlier) {
+    nodes[earlier].dependents.push_back(later);
+    ++nodes[later].prerequisites;
+}
+
+bool TaskGraph::acyclic() const {
+    std::vector<size_t> waiting;
+    std::vector<TaskId> ready;
+    for(TaskId id = 0; id < nodes.size(); ++id) {
+        waiting.push_back(nodes[id].prerequisites);
+        if(!waiting[id])
+            ready.push_back(id);
+    }
+    size_t reached = 0;
+    while(!ready.empty()) {
+        const std::vector<TaskId>& dependents = nodes[ready.back()].dependents;
+        ready.pop_back();
+        ++reached;
+        for(size_t i = 0; i < dependents.size(); ++i) {
+            if(--waiting[dependents[i]] == 0)
+                ready.push_back(dependents[i]);
+        }
+    }
+    return reached == nodes.size();
+}
+
+/// what the threads of one TaskScheduler::run share
+class TaskRun {
+public:
+    TaskRun(TaskGraph& taskGraph, unsigned int threads,
+            const char* name) : graph(taskGraph), queues(threads),
+            waiting(taskGraph.nodes.size()),
+            remaining(taskGraph.nodes.size()), failed(false),
+            stage(StageTimer::current()), timingName(name) {
+#ifdef OMPFF
+        locks.resize(threads + 1);
+        for(size_t i = 0; i < locks.size(); ++i)
+            omp_init_lock(&locks[i]);
+#endif
+    }
+    ~TaskRun() {
+#ifdef OMPFF
+        for(size_t i = 0; i < locks.size(); ++i)
+            omp_destroy_lock(&locks[i]);
+#endif
+    }
+
+    /// newest task on @a thread's own queue, or the oldest of another's
+    bool take(unsigned int thread, TaskGraph::TaskId& id) {
+        for(size_t i = 0; i < queues.size(); ++i) {
+            const size_t victim = (thread + i) % queues.size();
+#ifdef OMPFF
+            OmpGuard guard(locks[victim]);
+#endif
+            std::deque<TaskGraph::TaskId>& queue = queues[victim];
+            if(queue.empty())
+                continue;
+            if(i == 0) {
+                id = queue.back();
+                queue.pop_back();
+            } else {
+                id = queue.front();
+                queue.pop_front();
+            }
+            return true;
+        }
+        return false;
+    }
+    /// count @a id done, and queue on @a thread what it held back
+    void finish(unsigned int thread, TaskGraph::TaskId id) {
+        std::vector<TaskGraph::TaskId> ready;
+        {
+#ifdef OMPFF
+            OmpGuard guard(locks.back());
+#endif
+            const std::vector<TaskGraph::TaskId>& dependents =
+                    graph.nodes[id].dependents;
+            for(size_t i = 0; i < dependents.size(); ++i) {
+                if(--waiting[dependents[i]] == 0)
+                    ready.push_back(dependents[i]);
+            }
+            --remaining;
+        }
+        if(ready.empty())
+            return;
+#ifdef OMPFF
+        OmpGuard guard(locks[thread]);
+#endif
+        //the first made ready runs first
+        queues[thread].insert(queues[thread].end(), ready.rbegin(),
+                ready.rend());
+    }
+    bool done() {
+#ifdef OMPFF
+        OmpGuard guard(locks.back());
+#endif
+        return remaining == 0;
+    }
+    /// keep the first failure to rethrow
+    void fail(const char* what) {
+#ifdef OMPFF
+        OmpGuard guard(locks.back());
+#endif
+        if(!failed)
+            error = what;
+        failed = true;
+    }
+
+    TaskGraph& graph;
+    std::vector<std::deque<TaskGraph::TaskId> > queues;
+    std::vector<size_t> waiting;
+    size_t remaining;
+    bool failed;
+    std::string error;
+    StageTimer::Stage* stage;
+    const char* timingName;
+#ifdef OMPFF
+    /// one for each queue, and the last for the rest
+    std::vector<omp_lock_t> locks;
+#endif
+};
+
+TaskScheduler::TaskScheduler(unsigned int threads)
+        : m_threads(threads ? threads : 1), m_cancelled(false) {}
+
+bool TaskScheduler::parallel() const {
+#ifdef OMPFF
+    return m_threads > 1 && omp_get_thread_limit() > 1 &&
+            omp_get_active_level() < omp_get_max_active_levels();
+#else
+    return false;
+#endif
+}
+
+void TaskScheduler::run(TaskGraph& graph, const char* timingName) {
+    m_cancelled = false;
+    if(graph.nodes.empty())
+        return;
+    if(!graph.acyclic()) {
+        mgl::Exception mixup("Scheduled tasks depend on each other in a "
+                "cycle");
+        throw mixup;
+    }
+    TaskRun state(graph, m_threads, timingName);
+    /* Tasks ready from the start are dealt out in runs of neighbours,
+     so chunks of a loop next to each other go to the same thread. Each
+     queue is filled backwards, to run its own tasks in order. */
+    std::vector<TaskGraph::TaskId> ready;
+    for(TaskGraph::TaskId id = 0; id < graph.nodes.size(); ++id) {
+        state.waiting[id] = graph.nodes[id].prerequisites;
+        if(!state.waiting[id])
+            ready.push_back(id);
+    }
+    for(unsigned int thread = 0; thread < m_threads; ++thread) {
+        const size_t first = ready.size() * thread / m_threads;
+        const size_t last = ready.size() * (thread + 1) / m_threads;
+        for(size_t i = last; i-- > first; )
+            state.queues[thread].push_back(ready[i]);
+    }
+#ifdef OMPFF
+    if(m_threads > 1) {
+        #pragma omp parallel num_threads(m_threads)
+        work(state, omp_get_thread_num());
+    } else
+#endif
+    {
+        work(state, 0);
+    }
+    if(state.failed) {
+        mgl::Exception failure(state.error.c_str());
+        throw failure;
+    }
+}
+
+void TaskScheduler::work(TaskRun& state, unsigned int thread) {
+    /* A team smaller than asked for, as inside another parallel region,
+     leaves queues without a thread of their own. Their tasks are taken
+     by the threads there are. */
+    while(true) {
+        TaskGraph::TaskId id = 0;
+        if(!state.take(thread, id)) {
+            if(state.done())
+                break;
+#ifdef OMPFF
+            nap(TASK_NAP);
+            continue;
+#else
+            //there is no other thread to free up tasks
+            break;
+#endif
+        }
+        if(!m_cancelled) {
+            StageTimer::Scope timing(state.timingName, state.stage);
+            try {
+                state.graph.nodes[id].task->run();
+            } catch (const std::exception& failure) {
+                state.fail(failure.what());
+                cancel();
+            } catch (...) {
+                state.fail("Unknown error in a scheduled task");
+                cancel();
+            }
+        }
+        state.finish(thread, id);
+    }
+}
+
+}
+
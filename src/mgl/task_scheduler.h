@@ -0,0 +1,184 @@
+/*
+ * File:   task_scheduler.h
+ *
+ * Runs the work of a stage on several threads: graphs of tasks, and
+ * loops over ranges of layers split into chunks
+ */
+
+#ifndef MGL_TASK_SCHEDULER_H
+#define	MGL_TASK_SCHEDULER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace mgl {
+
+/// a piece of work for the TaskScheduler
+class Task {
+public:
+    virtual ~Task() {}
+    virtual void run() = 0;
+};
+
+/// tasks, and which of them must finish before which
+class TaskGraph {
+public:
+    typedef size_t TaskId;
+
+    TaskGraph() {}
+    ~TaskGraph();
+    /// add @a task, which the graph deletes
+    TaskId add(Task* task);
+    /// @a later starts only once @a earlier has finished, with no cycles
+    void depend(TaskId later, TaskId earlier);
+    size_t size() const { return nodes.size(); }
+
+private:
+    friend class TaskScheduler;
+    friend class TaskRun;
+    TaskGraph(const TaskGraph&);
+    TaskGraph& operator=(const TaskGraph&);
+    /// whether every task can become ready
+    bool acyclic() const;
+
+    class Node {
+    public:
+        Node(Task* work) : task(work), prerequisites(0) {}
+        Task* task;
+        std::vector<TaskId> dependents;
+        size_t prerequisites;
+    };
+    std::vector<Node> nodes;
+};
+
+class TaskRun;
+
+/**
+ @brief Runs tasks on a team of threads, each with its own queue of tasks
+ ready to run, taking from the others when its own is empty.
+
+ Each thread runs the newest task in its queue, so a task made ready by
+ the one just finished runs next on the same thread. Idle threads take
+ the oldest task of another. The threads are OpenMP's, so a scheduler is
+ cheap to make for each stage. Without --multi_thread, or inside another
+ parallel region, every task runs on the calling thread.
+
+ A task that throws cancels the tasks not yet started, and run rethrows
+ its message once the running ones finish.
+
+ Each task is timed by the StageTimer as a stage under the one open
+ where run was called.
+ */
+class TaskScheduler {
+public:
+    /// @param threads how many threads to run on, 0 is the same as 1
+    explicit TaskScheduler(unsigned int threads);
+
+    unsigned int threadCount() const { return m_threads; }
+    /**
+     @brief whether run gets more than one thread here: built with
+     --multi_thread, asked for more than one, outside another parallel
+     region and not held to one by OMP_THREAD_LIMIT
+     */
+    bool parallel() const;
+
+    /**
+     @brief run every task of @a graph, each after the ones it depends
+     on, returning once all have finished or been cancelled
+     @param timingName what each task is called in the timing report
+     */
+    void run(TaskGraph& graph, const char* timingName = "tasks");
+
+    /**
+     @brief call body(chunkBegin, chunkEnd, chunk) for @a chunkCount
+     contiguous chunks of [@a begin, @a end), all of them in parallel
+     */
+    template <typename BODY>
+    void parallelFor(size_t begin, size_t end, size_t chunkCount,
+            BODY& body) {
+        TaskGraph graph;
+        addChunks(graph, begin, end, chunkCount, body);
+        run(graph, "chunks");
+    }
+
+    /**
+     @brief combine what body(chunkBegin, chunkEnd, chunk) returns for
+     each chunk, as parallelFor splits them, in chunk order
+
+     The chunks depend only on @a chunkCount, so the result is the same
+     for any number of threads, even where the order of @a combine
+     matters, as in adding up floating point numbers.
+     */
+    template <typename VALUE, typename BODY, typename COMBINE>
+    VALUE parallelReduce(size_t begin, size_t end, size_t chunkCount,
+            const VALUE& identity, BODY& body, COMBINE combine) {
+        std::vector<VALUE> partial(chunkCount, identity);
+        ReduceBody<VALUE, BODY> reduce(body, partial);
+        parallelFor(begin, end, chunkCount, reduce);
+        VALUE result = identity;
+        for(size_t chunk = 0; chunk < partial.size(); ++chunk)
+            result = combine(result, partial[chunk]);
+        return result;
+    }
+
+    /**
+     @brief skip every task of the current run not yet started, running
+     ones can stop early by checking cancelled
+     */
+    void cancel() { m_cancelled = true; }
+    bool cancelled() const { return m_cancelled; }
+
+private:
+    TaskScheduler(const TaskScheduler&);
+    TaskScheduler& operator=(const TaskScheduler&);
+
+    template <typename BODY>
+    class ChunkTask : public Task {
+    public:
+        ChunkTask(BODY& chunkBody, size_t chunkBegin, size_t chunkEnd,
+                size_t chunkIndex) : body(chunkBody), begin(chunkBegin),
+                end(chunkEnd), chunk(chunkIndex) {}
+        void run() { body(begin, end, chunk); }
+    private:
+        BODY& body;
+        size_t begin;
+        size_t end;
+        size_t chunk;
+    };
+
+    template <typename VALUE, typename BODY>
+    class ReduceBody {
+    public:
+        ReduceBody(BODY& chunkBody, std::vector<VALUE>& results)
+                : body(chunkBody), partial(results) {}
+        void operator()(size_t begin, size_t end, size_t chunk) {
+            partial[chunk] = body(begin, end, chunk);
+        }
+    private:
+        BODY& body;
+        std::vector<VALUE>& partial;
+    };
+
+    template <typename BODY>
+    static void addChunks(TaskGraph& graph, size_t begin, size_t end,
+            size_t chunkCount, BODY& body) {
+        const size_t count = end - begin;
+        for(size_t chunk = 0; chunk < chunkCount; ++chunk) {
+            graph.add(new ChunkTask<BODY>(body,
+                    begin + count * chunk / chunkCount,
+                    begin + count * (chunk + 1) / chunkCount, chunk));
+        }
+    }
+
+    /// the work of one thread in run
+    void work(TaskRun& state, unsigned int thread);
+
+    unsigned int m_threads;
+    volatile bool m_cancelled;
+};
+
+}
+
+#endif	/* MGL_TASK_SCHEDULER_H */
+
@@ -0,0 +1,56 @@
+#include "thread_lock.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+namespace mgl {
+
+#ifdef _WIN32
+ThreadLock::ThreadLock() : handle(new CRITICAL_SECTION) {
+    InitializeCriticalSection(static_cast<CRITICAL_SECTION*>(handle));
+}
+
+ThreadLock::~ThreadLock() {
+    DeleteCriticalSection(static_cast<CRITICAL_SECTION*>(handle));
+    delete static_cast<CRITICAL_SECTION*>(handle);
+}
+
+void ThreadLock::lock() {
+    EnterCriticalSection(static_cast<CRITICAL_SECTION*>(handle));
+}
+
+void ThreadLock::unlock() {
+    LeaveCriticalSection(static_cast<CRITICAL_SECTION*>(handle));
+}
+
+void nap(unsigned int microseconds) {
+    Sleep(microseconds / 1000);
+}
+#else
+ThreadLock::ThreadLock() : handle(new pthread_mutex_t) {
+    pthread_mutex_init(static_cast<pthread_mutex_t*>(handle), NULL);
+}
+
+ThreadLock::~ThreadLock() {
+    pthread_mutex_destroy(static_cast<pthread_mutex_t*>(handle));
+    delete static_cast<pthread_mutex_t*>(handle);
+}
+
+void ThreadLock::lock() {
+    pthread_mutex_lock(static_cast<pthread_mutex_t*>(handle));
+}
+
+void ThreadLock::unlock() {
+    pthread_mutex_unlock(static_cast<pthread_mutex_t*>(handle));
+}
+
+void nap(unsigned int microseconds) {
+    usleep(microseconds);
+}
+#endif
+
+}
@@ -0,0 +1,87 @@
+/*
+ * File:   thread_lock.h
+ *
+ * Locks and waits shared by the code that runs on several threads
+ */
+
+#ifndef MGL_THREAD_LOCK_H
+#define	MGL_THREAD_LOCK_H
+
+#ifdef OMPFF
+#include <omp.h>
+#endif
+
+namespace mgl {
+
+#ifdef OMPFF
+// a lock class for multithreaded sync
+
+class OmpGuard {
+public:
+	//Acquire the lock and store a pointer to it
+
+	OmpGuard(omp_lock_t &lock)
+	: lock_(&lock) {
+		acquire();
+	}
+
+	void acquire() {
+		omp_set_lock(lock_);
+	}
+
+	void release() {
+		omp_unset_lock(lock_);
+	}
+
+	~OmpGuard() {
+		release();
+	}
+
+private:
+	omp_lock_t *lock_; // pointer to our lock
+
+};
+#endif
+
+/**
+ @brief a mutex for threads that need not be OpenMP's, such as those
+ polling a SliceService or timing stages, so it does not depend on OMPFF
+ */
+class ThreadLock {
+public:
+    ThreadLock();
+    ~ThreadLock();
+    void lock();
+    void unlock();
+private:
+    ThreadLock(const ThreadLock&);
+    ThreadLock& operator=(const ThreadLock&);
+    /// a pthread mutex or a critical section, kept out of this header
+    void* handle;
+};
+
+/// holds a ThreadLock for its lifetime
+class ThreadGuard {
+public:
+    explicit ThreadGuard(ThreadLock& threadLock) : held(threadLock) {
+        held.lock();
+    }
+    ~ThreadGuard() {
+        held.unlock();
+    }
+private:
+    ThreadGuard(const ThreadGuard&);
+    ThreadGuard& operator=(const ThreadGuard&);
+    ThreadLock& held;
+};
+
+/**
+ @brief sleep while waiting on other threads
+ @param microseconds how long, to the millisecond on Windows, where
+ less than one only gives up the rest of the time slice
+ */
+void nap(unsigned int microseconds);
+
+}
+
+#endif	/* MGL_THREAD_LOCK_H */
@@ -0,0 +1,59 @@
+/*
+ * File:   allocation_hook.cc
+ *
+ * Replaces the global operator new and delete so StageTimer can count
+ * the allocations of each stage. Linked only into the programs that
+ * report them, miracle_grue and mgl_bench, not into the mgl library.
+ */
+
+#include <cstdlib>
+#include <new>
+
+#include "mgl/stage_timer.h"
+
+#if __cplusplus >= 201103L
+#define MGL_THROWS_BAD_ALLOC
+#define MGL_NOTHROW noexcept
+#else
+#define MGL_THROWS_BAD_ALLOC throw(std::bad_alloc)
+#define MGL_NOTHROW throw()
+#endif
+
+void* operator new(size_t size) MGL_THROWS_BAD_ALLOC {
+    mgl::StageTimer::countAllocation(size);
+    void* memory = malloc(size ? size : 1);
+    if(!memory)
+        throw std::bad_alloc();
+    return memory;
+}
+void* operator new[](size_t size) MGL_THROWS_BAD_ALLOC {
+    return operator new(size);
+}
+void* operator new(size_t size, const std::nothrow_t&) MGL_NOTHROW {
+    mgl::StageTimer::countAllocation(size);
+    return malloc(size ? size : 1);
+}
+void* operator new[](size_t size, const std::nothrow_t& nothrow)
+        MGL_NOTHROW {
+    return operator new(size, nothrow);
+}
+void operator delete(void* memory) MGL_NOTHROW {
+    free(memory);
+}
+void operator delete[](void* memory) MGL_NOTHROW {
+    free(memory);
+}
+void operator delete(void* memory, const std::nothrow_t&) MGL_NOTHROW {
+    free(memory);
+}
+void operator delete[](void* memory, const std::nothrow_t&) MGL_NOTHROW {
+    free(memory);
+}
+#if __cplusplus >= 201402L
+void operator delete(void* memory, size_t) MGL_NOTHROW {
+    free(memory);
+}
+void operator delete[](void* memory, size_t) MGL_NOTHROW {
+    free(memory);
+}
+#endif
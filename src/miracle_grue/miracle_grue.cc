@@ -19,7 +19,10 @@
 
 #include "mgl/abstractable.h"
 #include "mgl/configuration.h"
+#include "mgl/gcoder_writer.h"
 #include "mgl/miracle.h"
+#include "mgl/slice_batch.h"
+#include "mgl/stage_timer.h"
 
 #include "optionparser.h"
 
@@ -80,11 +83,13 @@ enum optionIndex {
 	UNKNOWN, HELP, CONFIG, FIRST_Z, LAYER_H, LAYER_W, FILL_ANGLE,
 	FILL_DENSITY, N_SHELLS, BOTTOM_SLICE_IDX, TOP_SLICE_IDX,
 	DEBUG_ME, DEBUG_LAYER, START_GCODE, END_GCODE,
-	DEFAULT_EXTRUDER, OUT_FILENAME, JSON_PROGRESS
+	DEFAULT_EXTRUDER, OUT_FILENAME, JSON_PROGRESS, TIMING_REPORT, 
+	TRACE_FILE, THREADS, BATCH
 };
 // options descriptor table
 const option::Descriptor usageDescriptor[] ={
-	{UNKNOWN, 0, "", "", Arg::None, "miracle-grue [OPTIONS] FILE.STL \n\n"
+	{UNKNOWN, 0, "", "", Arg::None, "miracle-grue [OPTIONS] FILE.STL \n"
+		"miracle-grue [OPTIONS] --batch MANIFEST.JSON \n\n"
 		"Options:"},
 	{HELP, 0, "", "help", Arg::None, "  --help  \tPrint usage and exit."},
 	{CONFIG, 1, "c", "config", Arg::NonEmpty, "-c  \tconfig data in a config.json file."
@@ -116,9 +121,18 @@ const option::Descriptor usageDescriptor[] ={
 	{ DEFAULT_EXTRUDER, 14, "x", "defaultExtruder", Arg::Numeric,
 		"  -x \tindex of extruder to use on a single material print (1 is lowest)"},
 	{ OUT_FILENAME, 15, "o", "outFilename", Arg::NonEmpty,
-		"  -o \twrite gcode to specific filename (defaults to <model>.gcode)"},
+		"  -o \twrite gcode to specific filename (defaults to <model>.gcode), .x3g files get x3g"},
 	{ JSON_PROGRESS, 16, "j", "jsonProgress", Arg::None,
 	  "  -j \toutput progress as machine parsable JSON"},
+	{ TIMING_REPORT, 17, "T", "timingReport", Arg::NonEmpty,
+	  "  -T \twrite how long each stage took as JSON to a file, - for stderr"},
+	{ TRACE_FILE, 18, "", "traceFile", Arg::NonEmpty,
+	  "  --traceFile \twrite a Chrome trace of the job to a file, - for stderr"},
+	{ THREADS, 19, "J", "threads", Arg::Numeric,
+	  "  -J \tnumber of threads to plan paths and write gcode on"},
+	{ BATCH, 20, "", "batch", Arg::NonEmpty,
+	  "  --batch \tslice every entry of a JSON array of {\"model\", \"config\", "
+	  "\"output\"} in one run, sharing what entries on the same model have in common"},
 	{0, 0, 0, 0, 0, 0},
 };
 
@@ -144,6 +158,7 @@ void usage() {
 int newParseArgs(Configuration &config,
 		int argc, char *argv[],
 		string &modelFile,
+		string &manifestFile,
 		int &firstSliceIdx,
 		int &lastSliceIdx,
 		bool &jsonProgress) {
@@ -190,6 +205,7 @@ int newParseArgs(Configuration &config,
 		case FILL_DENSITY:
             break;
 		case N_SHELLS:
+		case THREADS:
 			config[opt.desc->longopt] = atoi(opt.arg);
 			break;
 		case BOTTOM_SLICE_IDX:
@@ -212,12 +228,17 @@ int newParseArgs(Configuration &config,
 			config[opt.desc->longopt] = atoi(opt.arg);
 			break;
 		case OUT_FILENAME:
+		case TIMING_REPORT:
+		case TRACE_FILE:
 			config[opt.desc->longopt] = opt.arg;
 			break;
 		case JSON_PROGRESS:
 			jsonProgress = true;
                         config[opt.desc->longopt] = true;
 			break;
+		case BATCH:
+			manifestFile = opt.arg;
+			break;
 		case CONFIG:
 			// handled above before other config values
 			break;
@@ -229,7 +250,9 @@ int newParseArgs(Configuration &config,
 	}
 
 	/// handle parameters (not options!)
-	if (parse.nonOptionsCount() == 0) {
+	if (parse.nonOptionsCount() == 0 && !manifestFile.empty()) {
+		// the models are in the manifest
+	} else if (parse.nonOptionsCount() == 0) {
 		usage();
 	} else if (parse.nonOptionsCount() != 1) {
 		Log::severe() << "too many parameters" << endl;
@@ -281,22 +304,68 @@ int newParseArgs(Configuration &config,
 	return 0;
 }
 
+/**
+ slice the entries of @a manifestFile and tell how fast it went, timing
+ the whole batch if the base config asks for a report or a trace
+ */
+int runBatch(const Configuration &config, const string &manifestFile) {
+	vector<SliceBatch::Entry> entries;
+	SliceBatch::readManifest(manifestFile, entries);
+	GrueConfig grueCfg;
+	grueCfg.loadFromFile(config);
+	const string& timingReport = grueCfg.get_timingReport();
+	const string& traceFile = grueCfg.get_traceFile();
+	const bool timed = !timingReport.empty() || !traceFile.empty();
+	if (timed)
+		StageTimer::enable(!traceFile.empty());
+	SliceBatch batch(config);
+	vector<SliceBatch::Result> results;
+	double began = StageTimer::now();
+	batch.run(entries, results, &cout);
+	double seconds = StageTimer::now() - began;
+	if (timed) {
+		StageTimer::disable();
+		if (!timingReport.empty())
+			StageTimer::writeReport(timingReport);
+		if (!traceFile.empty())
+			StageTimer::writeTrace(traceFile);
+	}
+
+	size_t done = 0, segmented = 0, planned = 0;
+	for (size_t i = 0; i < results.size(); ++i) {
+		done += results[i].ok;
+		segmented += results[i].segmented;
+		planned += results[i].planned;
+	}
+	cout << "Batch: " << done << " of " << results.size() << 
+			" entries done in " << seconds << "s, " << 
+			(seconds > 0 ? done * 3600 / seconds : 0) << " models/hour" << endl;
+	cout << "Batch: " << segmented << " models segmented and " << planned << 
+			" paths planned for " << results.size() << " entries" << endl;
+	return done == results.size() ? 0 : -1;
+}
+
 int main(int argc, char *argv[], char *[]) // envp
 {
 
 	string modelFile;
+	string manifestFile;
         bool jsonProgress = false;
 	Configuration config;
 	try {
 		int firstSliceIdx, lastSliceIdx;
 
-		int ret = newParseArgs(config, argc, argv, modelFile, firstSliceIdx, lastSliceIdx, jsonProgress);
+		int ret = newParseArgs(config, argc, argv, modelFile, manifestFile, 
+				firstSliceIdx, lastSliceIdx, jsonProgress);
 
 		if (ret != 0) {
 			usage();
 			exit(ret);
 		}
 
+		if (!manifestFile.empty())
+			return runBatch(config, manifestFile);
+
 		// cout << config.asJson() << endl;
 
 		MyComputer computer;
@@ -310,11 +379,21 @@ int main(int argc, char *argv[], char *[]) // envp
 
 
 		std::string gcodeFile = config["outFilename"].asString();
+		//an .x3g output file asks for x3g unless the config says otherwise
+		const std::string x3gExtension = ".x3g";
+		if (config["outputFormat"].isNull() && 
+				gcodeFile.size() > x3gExtension.size() && 
+				gcodeFile.compare(gcodeFile.size() - x3gExtension.size(), 
+				x3gExtension.size(), x3gExtension) == 0) {
+			config["outputFormat"] = "x3g";
+		}
+		bool x3g = config["outputFormat"].asString() == "x3g";
 
 		if (gcodeFile.empty()) {
 			gcodeFile = ".";
 			gcodeFile += computer.fileSystem.getPathSeparatorCharacter();
-			gcodeFile = computer.fileSystem.ChangeExtension(computer.fileSystem.ExtractFilename(modelFile.c_str()).c_str(), ".gcode");
+			gcodeFile = computer.fileSystem.ChangeExtension(computer.fileSystem.ExtractFilename(modelFile.c_str()).c_str(), 
+					x3g ? x3gExtension.c_str() : ".gcode");
 		}
 
 		Log::fine() << endl << endl;
@@ -331,8 +410,9 @@ int main(int argc, char *argv[], char *[]) // envp
 		RegionList regions;
 		std::vector<mgl::SliceData> slices;
 
-		std::ofstream gcodeFileStream;
-        gcodeFileStream.open(gcodeFile.c_str(), ios::out);
+		GCodeFile gcodeFileStream;
+        gcodeFileStream.open(gcodeFile.c_str(), 
+                x3g ? ios::out | ios::binary : ios::out);
         if(!gcodeFileStream) {
             Exception mixup(std::string("Bad output file: ") + 
                     gcodeFile);
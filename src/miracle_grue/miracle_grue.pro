@@ -46,7 +46,8 @@ include($$OPTIONPARSER_BASE/optionparser.pro.inc)
 //DEPENDPATH += src \
 //    submodule/clp-parser
 
-SOURCES +=  miracle_grue.cc
+SOURCES +=  miracle_grue.cc \
+    allocation_hook.cc
 LIBS += ../../lib/libmgl.a
 
 
@@ -1,4 +1,6 @@
 #include <stdio.h>
+#include <csignal>
+#include <cstdlib>
 #include <cstring>
 #include <string>
 #include <sstream>
@@ -6,11 +8,53 @@
 #include <fstream>
 
 #include "mongoose/mongoose.h"
+#include "mgl/configuration.h"
+#include "mgl/slice_service.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
 
 using namespace std;
+using namespace mgl;
+
+/* A slicing daemon. Models are sent to it with their config changes,
+ each becomes a job, and maxConcurrentJobs of them run at once on
+ threads sharing the config's threads. Recently segmented models are
+ kept warm between jobs.
+
+ POST /jobs?config={...}&priority=1  the STL as the body, answers
+                          {"id":...}, higher priorities start first
+ GET /jobs/<id>           the state of a job, with how long it waited,
+                          ran, and was predicted to take
+ GET /jobs/<id>/events    its progress messages as server-sent events
+ GET /jobs/<id>/gcode     its gcode once done
+ DELETE /jobs/<id>        forget a finished job
+
+ It listens on 127.0.0.1 unless given another address. Jobs can't set
+ the config keys that name files on the server, and models are limited
+ to MAX_MODEL_MB.
+ */
 
+/// the largest model accepted, in MB
+static const size_t MAX_MODEL_MB = 256;
 
+static volatile sig_atomic_t stopping = 0;
 
+static void stop(int) {
+	stopping = 1;
+}
+
+/// wait a moment for jobs or progress
+static void idle() {
+#ifdef _WIN32
+	Sleep(100);
+#else
+	usleep(100000);
+#endif
+}
 
 void serveFile( const char *filename, struct mg_connection *conn)
 {
@@ -27,7 +71,6 @@ void serveFile( const char *filename, struct mg_connection *conn)
 		{
 			getline (file,line);
 			mg_printf(conn, "%s\n",line.c_str());
-			cout << line << endl;
 		}
 		file.close();
 	}
@@ -35,12 +78,193 @@ void serveFile( const char *filename, struct mg_connection *conn)
 
 }
 
+static void sendJson(struct mg_connection *conn, const char *status,
+		const Json::Value &body)
+{
+	Json::FastWriter writer;
+	string text = writer.write(body);
+	mg_printf(conn, "HTTP/1.1 %s\r\n"
+			"Content-Type: application/json\r\n"
+			"Content-Length: %lu\r\n\r\n", status,
+			(unsigned long)text.size());
+	mg_write(conn, text.data(), text.size());
+}
+
+static void sendError(struct mg_connection *conn, const char *status,
+		const string &error)
+{
+	Json::Value body;
+	body["error"] = error;
+	sendJson(conn, status, body);
+}
+
+enum BodyRead { BODY_READ, BODY_UNSIZED, BODY_TOO_LARGE };
+
+/// the whole body of a request that gives its length, up to @a limit bytes
+static BodyRead readBody(struct mg_connection *conn, string &body,
+		size_t limit)
+{
+	const char *length = mg_get_header(conn, "Content-Length");
+	if(!length)
+		return BODY_UNSIZED;
+	char *end = NULL;
+	unsigned long given = strtoul(length, &end, 10);
+	if(end == length || *end != '\0')
+		return BODY_UNSIZED;
+	if(given > limit)
+		return BODY_TOO_LARGE;
+	size_t left = given;
+	body.reserve(left);
+	char buffer[1 << 14];
+	while(left > 0) {
+		int got = mg_read(conn, buffer,
+				left < sizeof(buffer) ? left : sizeof(buffer));
+		if(got <= 0)
+			return BODY_UNSIZED;
+		body.append(buffer, got);
+		left -= got;
+	}
+	return BODY_READ;
+}
+
+static void submitJob(SliceService &service, struct mg_connection *conn,
+		const struct mg_request_info *request_info)
+{
+	string stl;
+	switch(readBody(conn, stl, MAX_MODEL_MB << 20)) {
+	case BODY_UNSIZED:
+		sendError(conn, "411 Length Required", "Send the model as the body");
+		return;
+	case BODY_TOO_LARGE:
+		sendError(conn, "413 Request Entity Too Large",
+				"The model is larger than the service accepts");
+		return;
+	case BODY_READ:
+		break;
+	}
+	Json::Value overrides;
+	int priority = 0;
+	if(request_info->query_string) {
+		const char *query = request_info->query_string;
+		string config(strlen(query) + 1, '\0');
+		int length = mg_get_var(query, strlen(query), "config",
+				&config[0], config.size());
+		Json::Reader reader;
+		if(length > 0 && !reader.parse(config.substr(0, length), overrides)) {
+			sendError(conn, "400 Bad Request", "The config is not JSON");
+			return;
+		}
+		//the files of the server are not the client's to read or write
+		const Json::Value::Members keys = overrides.isObject() ?
+				overrides.getMemberNames() : Json::Value::Members();
+		for(size_t i = 0; i < keys.size(); ++i) {
+			if(SliceService::namesFile(keys[i])) {
+				sendError(conn, "403 Forbidden", "A job can't set \"" +
+						keys[i] + "\", it names a file on the server");
+				return;
+			}
+		}
+		char number[32];
+		if(mg_get_var(query, strlen(query), "priority", number,
+				sizeof(number)) > 0)
+			priority = atoi(number);
+	}
+	try {
+		SliceService::JobId id = service.submit(stl, overrides, priority);
+		Json::Value body;
+		body["id"] = id;
+		sendJson(conn, "202 Accepted", body);
+	} catch (mgl::Exception &mixup) {
+		sendError(conn, "400 Bad Request", mixup.error);
+	}
+}
+
+static void sendState(SliceService &service, struct mg_connection *conn,
+		SliceService::JobId id)
+{
+	SliceService::JobInfo info;
+	if(!service.info(id, info)) {
+		sendError(conn, "404 Not Found", "No such job");
+		return;
+	}
+	Json::Value body;
+	body["id"] = id;
+	body["state"] = SliceService::stateName(info.state);
+	body["priority"] = info.priority;
+	body["events"] = (Json::UInt)info.events;
+	body["warm"] = info.warm;
+	body["threads"] = info.threads;
+	body["predictedSeconds"] = info.predictedSeconds;
+	body["predictedMemoryMB"] = info.predictedBytes / 1048576.0;
+	body["waitSeconds"] = info.waitSeconds;
+	body["serviceSeconds"] = info.serviceSeconds;
+	if(info.state == SliceService::JOB_FAILED)
+		body["error"] = info.error;
+	sendJson(conn, "200 OK", body);
+}
+
+/// every progress message of a job as it comes, then how it ended
+static void streamEvents(SliceService &service, struct mg_connection *conn,
+		SliceService::JobId id)
+{
+	mg_printf(conn, "HTTP/1.1 200 OK\r\n"
+			"Content-Type: text/event-stream\r\nCache-Control: no-cache\r\n\r\n");
+	size_t seen = 0;
+	while(!stopping) {
+		vector<string> events;
+		string error;
+		SliceService::JobState state = service.poll(id, seen, events, &error);
+		for(size_t i = 0; i < events.size(); ++i) {
+			string event = "event: update\ndata: " + events[i] + "\n\n";
+			if(mg_write(conn, event.data(), event.size()) <= 0)
+				return;
+		}
+		seen += events.size();
+		if(state != SliceService::JOB_QUEUED &&
+				state != SliceService::JOB_RUNNING) {
+			Json::Value end;
+			end["state"] = SliceService::stateName(state);
+			if(state == SliceService::JOB_FAILED)
+				end["error"] = error;
+			Json::FastWriter writer;
+			string event = "event: done\ndata: " + writer.write(end) + "\n";
+			mg_write(conn, event.data(), event.size());
+			return;
+		}
+		idle();
+	}
+}
+
+static void sendGcode(SliceService &service, struct mg_connection *conn,
+		SliceService::JobId id)
+{
+	string gcode;
+	if(service.gcode(id, gcode)) {
+		mg_printf(conn, "HTTP/1.1 200 OK\r\n"
+				"Content-Type: text/plain\r\n"
+				"Content-Length: %lu\r\n\r\n",
+				(unsigned long)gcode.size());
+		mg_write(conn, gcode.data(), gcode.size());
+		return;
+	}
+	vector<string> events;
+	SliceService::JobState state = service.poll(id, 0, events);
+	if(state == SliceService::JOB_UNKNOWN)
+		sendError(conn, "404 Not Found", "No such job");
+	else
+		sendError(conn, "409 Conflict", string("The job is ") +
+				SliceService::stateName(state));
+}
+
 static void *callback(enum mg_event event,
                       struct mg_connection *conn,
                       const struct mg_request_info *request_info) {
 	if (event == MG_NEW_REQUEST)
 	{
+		SliceService &service =
+				*static_cast<SliceService*>(request_info->user_data);
 		string s(request_info->uri);
+		string method(request_info->request_method);
 		if(s=="/favicon.ico")
 		{
 			return (void*)""; // processed
@@ -52,26 +276,40 @@ static void *callback(enum mg_event event,
 			return (void*)""; // processed
 		}
 
-		if(s=="/stream")
+		if(s=="/jobs" && method=="POST")
 		{
-			cout << "#STREAM#" << endl;
-			// Echo requested URI back to the client
-			mg_printf(conn, "HTTP/1.1 200 OK\r\n"
-						  "Content-Type: text/event-stream\r\nCache-Control: no-cache\r\n\r\n");
-
-			for (unsigned int i=0; i < 3; i++)
-			{
-				mg_printf(conn, "event: update\n");
-				mg_printf(conn, "data: {\"msg\":\"hello %d\"}\n\n", i);
-			}
-			return (void*)"";  // Mark as processed
+			submitJob(service, conn, request_info);
+			return (void*)"";
+		}
 
+		const string jobs("/jobs/");
+		if(s.compare(0, jobs.size(), jobs) == 0)
+		{
+			const char *number = s.c_str() + jobs.size();
+			char *rest = NULL;
+			SliceService::JobId id = strtoul(number, &rest, 10);
+			string what(rest);
+			if(rest == number)
+				sendError(conn, "404 Not Found", "No such job");
+			else if(what.empty() && method=="DELETE") {
+				if(service.forget(id))
+					sendJson(conn, "200 OK", Json::Value(Json::objectValue));
+				else
+					sendError(conn, "409 Conflict",
+							"Only finished jobs can be forgotten");
+			}
+			else if(what.empty())
+				sendState(service, conn, id);
+			else if(what=="/events")
+				streamEvents(service, conn, id);
+			else if(what=="/gcode")
+				sendGcode(service, conn, id);
+			else
+				sendError(conn, "404 Not Found", "No such page");
+			return (void*)"";
 		}
 		cout << "get " << s << endl;
-
-
-
-
+		sendError(conn, "404 Not Found", "No such page");
 		return (void*)"";  // Mark as processed
 	}
 	else
@@ -80,13 +318,75 @@ static void *callback(enum mg_event event,
 	}
 }
 
-int main(void) {
-  struct mg_context *ctx;
-  const char *options[] = {"listening_ports", "8080", NULL};
+static void usage() {
+	cout << "Usage: serviz [-c config] [-a address] [-p port] "
+			"[-s spool directory]" << endl;
+	cout << "Slices the models posted to /jobs, see src/serviz.cc" << endl;
+	cout << "Listens on 127.0.0.1 unless given an address, 0.0.0.0 for "
+			"every interface" << endl;
+}
 
-  ctx = mg_start(&callback, NULL, options);
-  getchar();  // Wait until user hits "enter"
-  mg_stop(ctx);
+int main(int argc, char *argv[]) {
+	string configFile = "miracle.config";
+	string address = "127.0.0.1";
+	string port = "8080";
+	string spoolDir = ".";
+	for(int i = 1; i < argc; ++i) {
+		string arg(argv[i]);
+		if(i + 1 < argc && arg == "-c")
+			configFile = argv[++i];
+		else if(i + 1 < argc && arg == "-a")
+			address = argv[++i];
+		else if(i + 1 < argc && arg == "-p")
+			port = argv[++i];
+		else if(i + 1 < argc && arg == "-s")
+			spoolDir = argv[++i];
+		else {
+			usage();
+			return -1;
+		}
+	}
+
+	Configuration config;
+	try {
+		config.readFromFile(configFile);
+	} catch (mgl::Exception &mixup) {
+		cerr << "ERROR: " << mixup.error << endl;
+		return -1;
+	}
+	config["programName"] = GRUE_PROGRAM_NAME;
+	config["versionStr"] = GRUE_VERSION;
+	config["firmware"] = "unknown";
+	if (false == config.isMember("machineName")) {
+		config["machineName"] = "Machine Name Unknown";
+	}
+
+	SliceService *service = NULL;
+	try {
+		service = new SliceService(config, spoolDir);
+	} catch (mgl::Exception &mixup) {
+		cerr << "ERROR: " << mixup.error << endl;
+		return -1;
+	}
+	signal(SIGINT, stop);
+	signal(SIGTERM, stop);
+
+	const string listening = address + ":" + port;
+	const char *options[] = {"listening_ports", listening.c_str(), NULL};
+	struct mg_context *ctx = mg_start(&callback, service, options);
+	if(!ctx) {
+		cerr << "ERROR: can't listen on " << listening << endl;
+		delete service;
+		return -1;
+	}
+	cout << "Slicing jobs on " << listening << endl;
+	service->start();
+	while(!stopping)
+		idle();
+	//the jobs running when stopped are finished first
+	service->stop();
+	mg_stop(ctx);
+	delete service;
 
-  return 0;
+	return 0;
 }
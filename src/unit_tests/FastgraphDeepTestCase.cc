@@ -109,6 +109,87 @@ void FastgraphDeepTestCase::testLoopOrdering() {
     CPPUNIT_ASSERT_EQUAL(expected, output.str());
 }
 
+void FastgraphDeepTestCase::testIterativeTravel() {
+    class DerivedConfig : public GrueConfig {
+    public:
+        DerivedConfig() {
+            doGraphOptimization = true;
+            startingX = 0;
+            startingY = 0;
+            iterativeEffort = 4;
+            iterativeTimeLimit = 0;
+        }
+    };
+    DerivedConfig grueCfg;
+    pather_optimizer_fastgraph optimizator(grueCfg);
+    typedef pather_optimizer_fastgraph::LabeledOpenPaths LabeledOpenPaths;
+    
+    PathLabel infill(PathLabel::TYP_INFILL, PathLabel::OWN_MODEL, 0);
+    PathLabel inset(PathLabel::TYP_INSET, PathLabel::OWN_MODEL, 10);
+    //short vertical lines visited out of order
+    const int order[] = {0, 4, 1, 3, 2, 5, 9, 6, 8, 7};
+    const size_t lineCount = sizeof(order) / sizeof(order[0]);
+    LabeledOpenPaths paths;
+    for(size_t i = 0; i < lineCount; ++i) {
+        //a closed loop in the middle that must not move
+        if(i == 5) {
+            LabeledOpenPath loop(inset);
+            loop.myPath.appendPoint(Point2Type(25, 0));
+            loop.myPath.appendPoint(Point2Type(26, 0));
+            loop.myPath.appendPoint(Point2Type(26, 1));
+            loop.myPath.appendPoint(Point2Type(25, 0));
+            paths.push_back(loop);
+        }
+        LabeledOpenPath line(infill);
+        line.myPath.appendPoint(Point2Type(order[i] * 5.0, 0));
+        line.myPath.appendPoint(Point2Type(order[i] * 5.0, 1));
+        paths.push_back(line);
+    }
+    LabeledOpenPaths original = paths;
+    Point2Type entry(0, 0);
+    Scalar before = pather_optimizer_fastgraph::travelLength(paths, entry);
+    pather_optimizer_fastgraph::boundary_container bounds;
+    
+    std::cout << "Shortening travel between lines" << std::endl;
+    Scalar saved = optimizator.optimizeIterative(paths, entry, bounds, 0);
+    Scalar after = pather_optimizer_fastgraph::travelLength(paths, entry);
+    CPPUNIT_ASSERT(saved > 0);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(before - after, saved, 1e-9);
+    CPPUNIT_ASSERT_EQUAL(original.size(), paths.size());
+    
+    std::cout << "Testing that the loop stayed between the same lines" << 
+            std::endl;
+    LabeledOpenPaths::const_iterator iter = paths.begin();
+    for(size_t i = 0; i < lineCount + 1; ++i, ++iter) {
+        CPPUNIT_ASSERT_EQUAL(i == 5, iter->myLabel.isInset());
+        if(iter->myLabel.isInfill()) {
+            Scalar x = iter->myPath.fromStart()->x;
+            CPPUNIT_ASSERT_EQUAL(i < 5, x < 25);
+        }
+    }
+    
+    std::cout << "Testing that travel does not cross a wall more often" << 
+            std::endl;
+    paths = original;
+    bounds.insert(Segment2Type(Point2Type(12, -1), Point2Type(12, 2)));
+    bounds.insert(Segment2Type(Point2Type(-1, 0.5), Point2Type(13, 0.5)));
+    size_t crossings[2] = {0, 0};
+    for(int pass = 0; pass < 2; ++pass) {
+        if(pass)
+            optimizator.optimizeIterative(paths, entry, bounds, 0);
+        Point2Type last = entry;
+        for(iter = paths.begin(); iter != paths.end(); ++iter) {
+            Segment2Type travel(last, *iter->myPath.fromStart());
+            if(last != travel.b && 
+                    pather_optimizer_fastgraph::crossesBounds(travel, bounds))
+                ++crossings[pass];
+            last = *iter->myPath.fromEnd();
+        }
+    }
+    CPPUNIT_ASSERT_EQUAL(original.size(), paths.size());
+    CPPUNIT_ASSERT(crossings[1] <= crossings[0]);
+}
+
 void FastgraphDeepTestCase::displayBucket(mgl::pather_optimizer_fastgraph::bucket& 
         bucket) {
     bucket.m_hierarchy.repr(std::cerr);
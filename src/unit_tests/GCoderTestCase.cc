@@ -11,11 +11,16 @@
 #include "mgl/meshy.h"
 #include "mgl/configuration.h"
 #include "mgl/gcoder.h"
+#include "mgl/gcoder_writer.h"
+#include "mgl/layer_stream.h"
+#include "mgl/s3g_writer.h"
 #include "mgl/abstractable.h"
 
 #include <sys/stat.h>
 #include <unistd.h>
+#include <iterator>
 #include <list>
+#include <sstream>
 
 using namespace std;
 using namespace mgl;
@@ -355,6 +360,47 @@ void GCoderTestCase::testFloatFormat() {
 
 }
 
+void GCoderTestCase::testScalarFormat() {
+	//the fast formatter must print exactly what a stream would
+	srand(1234);
+	static const Scalar specials[] = {0.0, -0.0, 0.0005, -0.0005, 0.0625, 
+			2.5, 1e-7, -1e-7, 123456789.0, 0.1, 1e20, -1e20, 99.9995};
+	std::vector<Scalar> values(specials, 
+			specials + sizeof(specials) / sizeof(*specials));
+	for(int i = 0; i < 2000; ++i) {
+		Scalar value = (rand() - RAND_MAX / 2) / Scalar(rand() % 1000 + 1);
+		values.push_back(value);
+		values.push_back(floor(value * 1000) / 1000 + 0.0005);
+	}
+	for(unsigned int precision = 0; precision < 8; ++precision) {
+		for(int fixed = 0; fixed < 2; ++fixed) {
+			stringstream expected;
+			expected.precision(precision);
+			if(fixed)
+				expected.setf(ios::fixed);
+			for(size_t i = 0; i < values.size(); ++i) {
+				expected.str("");
+				expected << values[i];
+				char buffer[64];
+				size_t length = formatScalar(buffer, sizeof(buffer), 
+						values[i], expected);
+				CPPUNIT_ASSERT_EQUAL(expected.str(), 
+						string(buffer, length));
+			}
+		}
+	}
+	//lines come out whole, with no flush needed
+	stringstream out;
+	out.precision(3);
+	out.setf(ios::fixed);
+	{
+		GCodeLine line(out);
+		line << "G1 X" << 1.0 << " Y" << -2.5 << ' ' << 'A' << 0.0005;
+		line.end();
+	}
+	CPPUNIT_ASSERT_EQUAL(string("G1 X1.000 Y-2.500 A0.001\n"), out.str());
+}
+
 void initHorizontalGridPath(SliceData &d, 
 		double lowerX, 
 		double lowerY, 
@@ -612,3 +658,225 @@ void GCoderTestCase::testMultiGrid() {
 	CPPUNIT_ASSERT(ifstream(SINGLE_EXTRUDER_WITH_PATH));
 	std::cout << "Exiting:" << __FUNCTION__ << endl;
 }
+
+/// layers of infill, alternating direction, as the pather would hand over
+static void initLabeledGrid(LayerPaths& layerpaths, int layerCount) {
+	for (int layer = 0; layer < layerCount; ++layer) {
+		layerpaths.push_back(LayerPaths::Layer(0.27 * layer, 0.27, 0.4, 
+				layer));
+		LayerPaths::Layer::ExtruderLayer exlayer;
+		for (int i = 0; i < 10; ++i) {
+			OpenPath line;
+			Point2Type p0(-10 + 2 * i, -10);
+			Point2Type p1(-10 + 2 * i, 10);
+			if ((i + layer) % 2)
+				std::swap(p0, p1);
+			if (layer % 2) {
+				std::swap(p0.x, p0.y);
+				std::swap(p1.x, p1.y);
+			}
+			line.appendPoint(p0);
+			line.appendPoint(p1);
+			exlayer.paths.push_back(LabeledOpenPath(PathLabel(
+					PathLabel::TYP_INFILL, PathLabel::OWN_MODEL, 
+					LayerPaths::Layer::ExtruderLayer::INFILL_LABEL_VALUE), 
+					line));
+		}
+		layerpaths.back().extruders.push_back(exlayer);
+	}
+}
+
+void GCoderTestCase::testStreaming() {
+	Configuration config;
+	config.readFromFile("miracle.config");
+	//progress is counted differently when streaming
+	config["doPrintProgress"] = false;
+	GrueConfig grueCfg;
+	grueCfg.loadFromFile(config);
+	
+	LayerPaths whole;
+	initLabeledGrid(whole, 6);
+	stringstream expected;
+	GCoder all(grueCfg);
+	all.writeGcodeFile(whole, LayerMeasure(0, 0.27), expected, "grid");
+	
+	//layers written as they arrive come out the same, and are freed
+	LayerPaths arriving;
+	initLabeledGrid(arriving, 6);
+	stringstream streamed;
+	GCoder each(grueCfg);
+	LayerWriter writer(each, streamed);
+	each.beginGcodeFile(streamed, "grid", 6);
+	while (!arriving.empty())
+		writer.layerReady(arriving, arriving.begin());
+	each.endGcodeFile(streamed);
+	CPPUNIT_ASSERT_EQUAL(expected.str(), streamed.str());
+	CPPUNIT_ASSERT_EQUAL(all.getPrintDuration(), each.getPrintDuration());
+	
+	//the queue passes layers on in order, without copying them
+	LayerPaths source;
+	initLabeledGrid(source, 3);
+	const LayerPaths::Layer* first = &*source.begin();
+	LayerQueue queue(4);
+	queue.layerReady(source, source.begin());
+	queue.layerReady(source, source.begin());
+	CPPUNIT_ASSERT_EQUAL(size_t(1), source.layerCount());
+	LayerPaths taken;
+	CPPUNIT_ASSERT(queue.pop(taken));
+	CPPUNIT_ASSERT(first == &*taken.begin());
+	CPPUNIT_ASSERT(queue.pop(taken));
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.27, taken.back().layerZ, 1e-9);
+	CPPUNIT_ASSERT_EQUAL(size_t(2), queue.peak());
+	//after closing, layers are dropped
+	queue.close();
+	queue.layerReady(source, source.begin());
+	CPPUNIT_ASSERT(source.empty());
+	CPPUNIT_ASSERT(!queue.pop(taken));
+	CPPUNIT_ASSERT_EQUAL(size_t(2), taken.layerCount());
+}
+
+static bool contains(const string& gcode, const string& text) {
+	return gcode.find(text) != string::npos;
+}
+
+void GCoderTestCase::testCommentLevels() {
+	Configuration config;
+	config.readFromFile("miracle.config");
+	const char* levels[] = { "none", "layer", "path", "move" };
+	const size_t levelCount = sizeof(levels) / sizeof(*levels);
+	vector<string> outputs;
+	for (size_t level = 0; level < levelCount; ++level) {
+		config["commentLevel"] = levels[level];
+		GrueConfig grueCfg;
+		grueCfg.loadFromFile(config);
+		LayerPaths layers;
+		initLabeledGrid(layers, 3);
+		stringstream gcode;
+		GCoder gcoder(grueCfg);
+		gcoder.writeGcodeFile(layers, LayerMeasure(0, 0.27), gcode, "grid");
+		outputs.push_back(gcode.str());
+	}
+	const string open = config["commentOpen"].asString();
+	
+	//none writes no comments at all
+	CPPUNIT_ASSERT(!contains(outputs[0], open));
+	//layer has the layer headers, without path or move comments
+	CPPUNIT_ASSERT(contains(outputs[1], open + "Slice 1"));
+	CPPUNIT_ASSERT(contains(outputs[1], "Estimated layer time"));
+	CPPUNIT_ASSERT(!contains(outputs[1], "move into position"));
+	CPPUNIT_ASSERT(!contains(outputs[1], "snort"));
+	CPPUNIT_ASSERT(!contains(outputs[1], "d: "));
+	//path adds travel and retraction, still without move lengths
+	CPPUNIT_ASSERT(contains(outputs[2], open + "Slice 1"));
+	CPPUNIT_ASSERT(contains(outputs[2], "move into position"));
+	CPPUNIT_ASSERT(contains(outputs[2], "squirt"));
+	CPPUNIT_ASSERT(contains(outputs[2], "snort"));
+	CPPUNIT_ASSERT(!contains(outputs[2], "d: "));
+	//and move the length of every extruding move
+	CPPUNIT_ASSERT(contains(outputs[3], "move into position"));
+	CPPUNIT_ASSERT(contains(outputs[3], "d: "));
+	//each level writes the same commands, only the comments differ
+	for (size_t level = 1; level < levelCount; ++level) {
+		CPPUNIT_ASSERT(outputs[level - 1].size() < outputs[level].size());
+		CPPUNIT_ASSERT_EQUAL(commandsOf(outputs[0], open), 
+				commandsOf(outputs[level], open));
+	}
+}
+
+void GCoderTestCase::testX3gHeader() {
+	const string textStart = outputDir + "text_start.gcode";
+	const string x3gStart = outputDir + "x3g_start.x3g";
+	{
+		ofstream text(textStart.c_str());
+		text << "M104 S220 T0\n";
+		ofstream x3g(x3gStart.c_str(), ios::out | ios::binary);
+		const Scalar stepsPerMm[S3gWriter::AXES] = {1, 1, 1, 1, 1};
+		S3gWriter writer(x3g, stepsPerMm);
+		writer.setTemperature(0, 220);
+		writer.waitForTool(0, 600);
+	}
+	Configuration config;
+	config.readFromFile("miracle.config");
+	config["outputFormat"] = "x3g";
+	
+	//text gcode in x3g output would be played as garbage commands
+	config["startGcode"] = textStart;
+	GrueConfig textCfg;
+	textCfg.loadFromFile(config);
+	LayerPaths layers;
+	initLabeledGrid(layers, 2);
+	stringstream rejected(ios::in | ios::out | ios::binary);
+	GCoder textGcoder(textCfg);
+	bool thrown = false;
+	try {
+		textGcoder.writeGcodeFile(layers, LayerMeasure(0, 0.27), rejected, 
+				"grid");
+	} catch (const GcoderException&) {
+		thrown = true;
+	}
+	CPPUNIT_ASSERT(thrown);
+	
+	//an x3g start is copied in as it is, ahead of the moves
+	config["startGcode"] = x3gStart;
+	config["endGcode"] = x3gStart;
+	GrueConfig x3gCfg;
+	x3gCfg.loadFromFile(config);
+	stringstream written(ios::in | ios::out | ios::binary);
+	GCoder x3gGcoder(x3gCfg);
+	x3gGcoder.writeGcodeFile(layers, LayerMeasure(0, 0.27), written, "grid");
+	ifstream start(x3gStart.c_str(), ios::in | ios::binary);
+	const string startBytes((istreambuf_iterator<char>(start)), 
+			istreambuf_iterator<char>());
+	CPPUNIT_ASSERT(!startBytes.empty());
+	const string output = written.str();
+	CPPUNIT_ASSERT(output.size() > 2 * startBytes.size());
+	CPPUNIT_ASSERT_EQUAL(startBytes, output.substr(0, startBytes.size()));
+	CPPUNIT_ASSERT_EQUAL(startBytes, 
+			output.substr(output.size() - startBytes.size()));
+}
+
+/// the grid, with a half circle across each layer to fit arcs to
+static void initCurvedGrid(LayerPaths& layerpaths, int layerCount) {
+	initLabeledGrid(layerpaths, layerCount);
+	int layer = 0;
+	for (LayerPaths::layer_iterator it = layerpaths.begin(); 
+			it != layerpaths.end(); 
+			++it, ++layer) {
+		OpenPath curve;
+		const Scalar radius = 12 + 0.5 * (layer % 3);
+		for (int i = 0; i <= 72; ++i) {
+			Scalar angle = M_TAU / 2 * i / 72 + (layer % 2 ? M_TAU / 2 : 0);
+			curve.appendPoint(Point2Type(radius * cos(angle), 
+					radius * sin(angle)));
+		}
+		it->extruders.back().paths.push_back(LabeledOpenPath(PathLabel(
+				PathLabel::TYP_INSET, PathLabel::OWN_MODEL, 1), curve));
+	}
+}
+
+void GCoderTestCase::testParallel() {
+	Configuration config;
+	config.readFromFile("miracle.config");
+	//the state a chunk hands the next is where these go wrong
+	config["doModalMoves"] = true;
+	config["doRelativeE"] = true;
+	config["doArcFitting"] = true;
+	const int layerCount = 40;
+	vector<string> outputs;
+	for (unsigned int threads = 1; threads <= 4; threads += 3) {
+		config["gcodeThreads"] = threads;
+		GrueConfig grueCfg;
+		grueCfg.loadFromFile(config);
+		LayerPaths layers;
+		initCurvedGrid(layers, layerCount);
+		stringstream gcode;
+		GCoder gcoder(grueCfg);
+		gcoder.writeGcodeFile(layers, LayerMeasure(0, 0.27), gcode, "grid");
+		outputs.push_back(gcode.str());
+	}
+	CPPUNIT_ASSERT(contains(outputs[0], "\nM83"));
+	CPPUNIT_ASSERT(contains(outputs[0], "\nG2 ") || 
+			contains(outputs[0], "\nG3 "));
+	CPPUNIT_ASSERT(contains(outputs[0], "Arc fitting: "));
+	CPPUNIT_ASSERT_EQUAL(outputs[0], outputs[1]);
+}
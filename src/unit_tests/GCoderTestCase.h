@@ -20,6 +20,11 @@ class GCoderTestCase : public CPPUNIT_NS::TestFixture
   CPPUNIT_TEST( testSimplePath );
   CPPUNIT_TEST( testGridPath );
   CPPUNIT_TEST( testMultiGrid );
+  CPPUNIT_TEST( testScalarFormat );
+  CPPUNIT_TEST( testStreaming );
+  CPPUNIT_TEST( testCommentLevels );
+  CPPUNIT_TEST( testX3gHeader );
+  CPPUNIT_TEST( testParallel );
 
 
   CPPUNIT_TEST_SUITE_END();
@@ -36,6 +41,11 @@ protected:
   void testFloatFormat();
   void testGridPath();
   void testMultiGrid();
+  void testScalarFormat();
+  void testStreaming();
+  void testCommentLevels();
+  void testX3gHeader();
+  void testParallel();
 
 };
 
@@ -1,11 +1,16 @@
 #include "UnitTestUtils.h"
 #include "GantryTestCase.h"
 
+#include "mgl/arc_fitter.h"
 #include "mgl/gcoder_gantry.h"
 #include "mgl/gcoder.h"
+#include "mgl/motion_model.h"
+#include "mgl/s3g_writer.h"
 
+#include <cstdlib>
 #include <iostream>
 #include <sstream>
+#include <vector>
 
 using namespace std;
 using namespace mgl;
@@ -176,3 +181,463 @@ void GantryTestCase::testConfig(){
 }
 
 
+void GantryTestCase::testMotionModel(){
+	static const Scalar tol = 1e-6;
+	MotionModel unlimited;
+	CPPUNIT_ASSERT(!unlimited.isAccelerated());
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(2.0, unlimited.moveTime(100, 0, 50, 0), tol);
+	
+	MotionModel model(100, 0.05);
+	//trapezoid: 0.5s up to speed, 0.5s down, 75mm of cruising
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(2.5, model.moveTime(100, 0, 50, 0), tol);
+	//already at speed, only the deceleration is lost
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(2.25, model.moveTime(100, 50, 50, 0), tol);
+	//triangle: 4mm never reaches 50mm/s, peaks at 20mm/s
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.4, model.moveTime(4, 0, 50, 0), tol);
+	
+	Point2Type east(1, 0), west(-1, 0), north(0, 1);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(50.0, 
+			model.junctionSpeed(east, east, 50), tol);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, 
+			model.junctionSpeed(east, west, 50), tol);
+	Scalar corner = model.junctionSpeed(east, north, 50);
+	CPPUNIT_ASSERT(corner > 0 && corner < 50);
+	
+	//a right angle costs more than going straight
+	MotionEstimate straight(model), turn(model);
+	straight.reset(Point2Type(0, 0));
+	straight.moveTo(Point2Type(50, 0), 50);
+	straight.moveTo(Point2Type(100, 0), 50);
+	turn.reset(Point2Type(0, 0));
+	turn.moveTo(Point2Type(50, 0), 50);
+	turn.moveTo(Point2Type(50, 50), 50);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(2.5, straight.total(), tol);
+	CPPUNIT_ASSERT(turn.total() > straight.total());
+	CPPUNIT_ASSERT(turn.total() < 2 * model.moveTime(50, 0, 50, 0) + tol);
+	
+	//links are ranked by corners only where an acceleration is given
+	Configuration config;
+	config.readFromFile("miracle.config");
+	GrueConfig grueCfg;
+	grueCfg.loadFromFile(config);
+	CPPUNIT_ASSERT(grueCfg.get_maxAcceleration() > 0);
+	CPPUNIT_ASSERT(!grueCfg.get_doCornerLinks());
+	config["maxAcceleration"] = 1500.0;
+	grueCfg.loadFromFile(config);
+	CPPUNIT_ASSERT(grueCfg.get_doCornerLinks());
+	config["doCornerLinks"] = false;
+	grueCfg.loadFromFile(config);
+	CPPUNIT_ASSERT(!grueCfg.get_doCornerLinks());
+}
+void GantryTestCase::testMotionPlanner(){
+	static const Scalar tol = 1e-6;
+	MotionModel model(100, 0.05);
+	
+	//many short collinear moves plan like one long move
+	MotionPlanner planner(model);
+	planner.reset(Point2Type(0, 0));
+	for(int i = 1; i <= 100; ++i)
+		planner.moveTo(Point2Type(i, 0), 50);
+	CPPUNIT_ASSERT_EQUAL(size_t(100), planner.size());
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(model.moveTime(100, 0, 50, 0), 
+			planner.plan(), tol);
+	
+	//stops and dwells add up
+	planner.reset(Point2Type(0, 0));
+	planner.moveTo(Point2Type(100, 0), 50);
+	planner.stop();
+	planner.moveTo(Point2Type(200, 0), 50);
+	planner.dwell(0.25);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(5.25, planner.plan(), tol);
+	
+	//a reversal is a full stop
+	planner.reset(Point2Type(0, 0));
+	planner.moveTo(Point2Type(100, 0), 50);
+	planner.moveTo(Point2Type(0, 0), 50);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(5.0, planner.plan(), tol);
+	
+	//without acceleration everything is distance over speed
+	MotionPlanner unlimited;
+	unlimited.reset(Point2Type(0, 0));
+	unlimited.moveTo(Point2Type(30, 40), 25);
+	unlimited.moveTo(Point2Type(30, 0), 20);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(4.0, unlimited.plan(), tol);
+}
+void GantryTestCase::testModalMoves(){
+	Configuration config;
+	config.readFromFile("miracle.config");
+	config["doModalMoves"] = true;
+	config["doRelativeE"] = true;
+	config["commentLevel"] = "none";
+	GrueConfig grueCfg;
+	grueCfg.loadFromFile(config);
+	
+	Gantry gantry(grueCfg);
+	const Extruder& uder = grueCfg.get_extruders()[0];
+	gantry.set_current_extruder_index(uder.code);
+	Extrusion usion = grueCfg.get_extrusionProfiles().begin()->second;
+	stringstream ss;
+	ss.precision(3);
+	ss.setf(ios::fixed);
+	
+	//the first move gives every axis, later ones only what changed
+	gantry.g1(ss, 10, 20, 0.3, 3000, 0, 0, NULL);
+	gantry.g1(ss, 15, 20, 0.3, 3000, 0, 0, NULL);
+	gantry.g1(ss, 15, 20, 0.3, 3000, 0, 0, NULL);
+	gantry.g1(ss, 15, 25 + SAMESAME_TOL / 2, 0.3, 2000, 0, 0, NULL);
+	CPPUNIT_ASSERT_EQUAL(string(
+			"G1 X10.000 Y20.000 Z0.300 F3000.000\n"
+			"G1 X15.000\n"
+			"G1 Y25.000 F2000.000\n"), ss.str());
+	
+	//relative extrusion adds up to the absolute positions
+	ss.str("");
+	gantry.set_extruding(true);
+	Scalar absolute = gantry.getCurrentE();
+	for(int i = 0; i < 1000; ++i) {
+		gantry.g1(ss, uder, usion, 15 + 0.5 * ((i + 1) % 2), 25 + 0.01 * i, 
+				0.3, 2000, 0.3, 0.5, NULL);
+	}
+	absolute = gantry.getCurrentE() - absolute;
+	Scalar sum = 0;
+	string line;
+	while(getline(ss, line)) {
+		size_t axis = line.find(static_cast<char>(uder.code));
+		if(axis != string::npos)
+			sum += atof(line.c_str() + axis + 1);
+	}
+	CPPUNIT_ASSERT(absolute > 0);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(absolute, sum, 1e-3);
+}
+
+void GantryTestCase::testArcs(){
+	//a half circle to the left, a straight line, and a half circle to 
+	//the right, with a little noise
+	std::vector<Point2Type> points;
+	for(int i = 0; i <= 72; ++i) {
+		Scalar angle = M_TAU / 2 * i / 72;
+		Scalar noise = 0.002 * ((i % 3) - 1);
+		points.push_back(Point2Type((10 + noise) * cos(angle), 
+				(10 + noise) * sin(angle)));
+	}
+	points.push_back(Point2Type(-10, -20));
+	for(int i = 1; i <= 72; ++i) {
+		Scalar angle = M_TAU / 2 * i / 72;
+		points.push_back(Point2Type(-20 + 10 * cos(angle), 
+				-20 - 10 * sin(angle)));
+	}
+	ArcFitter fitter(0.01);
+	std::vector<ArcFitter::Piece> pieces;
+	fitter.fit(points, pieces);
+	CPPUNIT_ASSERT_EQUAL(size_t(3), pieces.size());
+	CPPUNIT_ASSERT(pieces[0].isArc);
+	CPPUNIT_ASSERT(!pieces[0].clockwise);
+	CPPUNIT_ASSERT_EQUAL(size_t(72), pieces[0].end);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0, pieces[0].center.magnitude(), 0.01);
+	CPPUNIT_ASSERT(!pieces[1].isArc);
+	CPPUNIT_ASSERT(pieces[2].isArc);
+	CPPUNIT_ASSERT(pieces[2].clockwise);
+	CPPUNIT_ASSERT_EQUAL(points.size() - 1, pieces[2].end);
+	CPPUNIT_ASSERT_EQUAL(points.size() - 1, fitter.movesIn());
+	CPPUNIT_ASSERT_EQUAL(size_t(3), fitter.movesOut());
+	CPPUNIT_ASSERT_EQUAL(size_t(2), fitter.arcs());
+	CPPUNIT_ASSERT(fitter.maxDeviation() > 0);
+	CPPUNIT_ASSERT(fitter.maxDeviation() <= 0.01);
+	
+	//corners are never rounded off, and a closed circle can't be one arc
+	std::vector<Point2Type> square;
+	square.push_back(Point2Type(0, 0));
+	square.push_back(Point2Type(1, 0));
+	square.push_back(Point2Type(1, 1));
+	square.push_back(Point2Type(0, 1));
+	square.push_back(Point2Type(0, 0));
+	fitter.fit(square, pieces);
+	CPPUNIT_ASSERT_EQUAL(size_t(4), pieces.size());
+	std::vector<Point2Type> circle;
+	for(int i = 0; i <= 72; ++i) {
+		Scalar angle = M_TAU * i / 72;
+		circle.push_back(Point2Type(5 * cos(angle), 5 * sin(angle)));
+	}
+	fitter.fit(circle, pieces);
+	CPPUNIT_ASSERT_EQUAL(size_t(2), pieces.size());
+	CPPUNIT_ASSERT(pieces[0].isArc);
+	CPPUNIT_ASSERT_EQUAL(size_t(71), pieces[0].end);
+	CPPUNIT_ASSERT(!pieces[1].isArc);
+	
+	//the arc extrudes for its length, not the length of its chord
+	Configuration config;
+	config.readFromFile("miracle.config");
+	GrueConfig grueCfg;
+	grueCfg.loadFromFile(config);
+	Gantry gantry(grueCfg);
+	const Extruder& uder = grueCfg.get_extruders()[0];
+	gantry.set_current_extruder_index(uder.code);
+	Extrusion usion = grueCfg.get_extrusionProfiles().begin()->second;
+	stringstream ss;
+	ss.precision(3);
+	ss.setf(ios::fixed);
+	gantry.g1(ss, 10, 0, 0.3, 3000, 0, 0, NULL);
+	gantry.set_extruding(true);
+	ss.str("");
+	Scalar startE = gantry.getCurrentE();
+	gantry.arc(ss, uder, usion, -10, 0, 0.3, Point2Type(0, 0), false, 
+			2000, 0.3, 0.5, NULL);
+	Scalar expectedE = usion.crossSectionArea(0.3, 0.5) * M_TAU / 2 * 10 / 
+			uder.feedCrossSectionArea();
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(expectedE, gantry.getCurrentE() - startE, 
+			1e-9);
+	stringstream expected;
+	expected.precision(3);
+	expected.setf(ios::fixed);
+	expected << "G3 X-10.000 Y0.000 Z0.300 I-10.000 J0.000 F2000.000 "
+			<< static_cast<char>(uder.code) << gantry.getCurrentE() << "\n";
+	CPPUNIT_ASSERT_EQUAL(expected.str(), ss.str());
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(-10, gantry.get_x(), 1e-9);
+	
+	//started off its circle, its radii would differ, so it is a line
+	Scalar off = 2 * grueCfg.get_arcTolerance();
+	gantry.g1(ss, -10 - off, 0, 0.3, 3000, 0, 0, NULL);
+	CPPUNIT_ASSERT(!gantry.arcFits(10, 0, Point2Type(0, 0)));
+	CPPUNIT_ASSERT(gantry.arcFits(10, 0, Point2Type(-off / 2, 0)));
+	ss.str("");
+	gantry.arc(ss, uder, usion, 10, 0, 0.3, Point2Type(0, 0), false, 
+			2000, 0.3, 0.5, NULL);
+	CPPUNIT_ASSERT_EQUAL(string("G1 "), ss.str().substr(0, 3));
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(10, gantry.get_x(), 1e-9);
+	
+	//and it is checked for bounds as a line is
+	bool thrown = false;
+	try {
+		gantry.arc(ss, uder, usion, -10, 0, 0.3, Point2Type(0, 1e9), 
+				false, 2000, 0.3, 0.5, NULL);
+	} catch (const GcoderException&) {
+		thrown = true;
+	}
+	CPPUNIT_ASSERT(thrown);
+}
+
+/// one decoded s3g command: its id and its arguments, widened to long
+struct X3gCommand {
+	unsigned int id;
+	std::vector<long> args;
+};
+
+/// read a little endian integer of @a bytes bytes from @a data at @a pos
+static long x3gInteger(const string& data, size_t& pos, size_t bytes, 
+		bool isSigned) {
+	CPPUNIT_ASSERT(pos + bytes <= data.size());
+	unsigned long value = 0;
+	for(size_t i = 0; i < bytes; ++i)
+		value |= static_cast<unsigned long>(
+				static_cast<unsigned char>(data[pos + i])) << (8 * i);
+	pos += bytes;
+	if(isSigned && bytes == 4)
+		return static_cast<int32_t>(value);
+	return static_cast<long>(value);
+}
+
+/// decode the commands S3gWriter writes, failing on anything else
+static std::vector<X3gCommand> decodeX3g(const string& data) {
+	std::vector<X3gCommand> commands;
+	size_t pos = 0;
+	while(pos < data.size()) {
+		X3gCommand command;
+		command.id = static_cast<unsigned char>(data[pos++]);
+		switch(command.id) {
+		case S3gWriter::CMD_QUEUE_POINT:
+			for(int axis = 0; axis < 5; ++axis)
+				command.args.push_back(x3gInteger(data, pos, 4, true));
+			command.args.push_back(x3gInteger(data, pos, 4, false));
+			command.args.push_back(x3gInteger(data, pos, 1, false));
+			break;
+		case S3gWriter::CMD_SET_POSITION:
+			for(int axis = 0; axis < 5; ++axis)
+				command.args.push_back(x3gInteger(data, pos, 4, true));
+			break;
+		case S3gWriter::CMD_CHANGE_TOOL:
+			command.args.push_back(x3gInteger(data, pos, 1, false));
+			break;
+		case S3gWriter::CMD_WAIT_FOR_TOOL:
+			command.args.push_back(x3gInteger(data, pos, 1, false));
+			command.args.push_back(x3gInteger(data, pos, 2, false));
+			command.args.push_back(x3gInteger(data, pos, 2, false));
+			break;
+		case S3gWriter::CMD_TOOL_ACTION: {
+			command.args.push_back(x3gInteger(data, pos, 1, false));
+			command.args.push_back(x3gInteger(data, pos, 1, false));
+			size_t length = x3gInteger(data, pos, 1, false);
+			command.args.push_back(x3gInteger(data, pos, length, false));
+			break;
+		}
+		case S3gWriter::CMD_BUILD_PERCENTAGE:
+			command.args.push_back(x3gInteger(data, pos, 1, false));
+			command.args.push_back(x3gInteger(data, pos, 1, false));
+			break;
+		case S3gWriter::CMD_DELAY:
+			command.args.push_back(x3gInteger(data, pos, 4, false));
+			break;
+		default:
+			CPPUNIT_FAIL("unknown x3g command");
+		}
+		commands.push_back(command);
+	}
+	return commands;
+}
+
+void GantryTestCase::testX3g(){
+	Configuration config;
+	config.readFromFile("miracle.config");
+	GrueConfig grueCfg;
+	grueCfg.loadFromFile(config);
+	const Extruder& uder = grueCfg.get_extruders()[0];
+	Extrusion usion = grueCfg.get_extrusionProfiles().begin()->second;
+	
+	const Scalar stepsPerMm[S3gWriter::AXES] = {100, 100, 400, 50, 50};
+	stringstream out(ios::in | ios::out | ios::binary);
+	S3gWriter x3g(out, stepsPerMm);
+	Gantry gantry(grueCfg);
+	gantry.set_current_extruder_index('A');
+	gantry.setBinary(&x3g);
+	
+	//moves come out as absolute steps, timed by their length and feed
+	Scalar startX = gantry.get_x();
+	Scalar startY = gantry.get_y();
+	Scalar startZ = gantry.get_z();
+	gantry.g1(out, 10, 20.004, 0.3, 3000, 0, 0, "no comments in x3g");
+	gantry.set_extruding(false);
+	gantry.squirt(out, uder, usion);
+	Scalar squirtE = gantry.getCurrentE();
+	gantry.g1(out, uder, usion, 15, 20, 0.3, 1200, 0.3, 0.5, NULL);
+	Scalar lineE = gantry.getCurrentE();
+	x3g.changeTool(1);
+	x3g.setTemperature(1, 230);
+	x3g.setPlatformTemperature(0, 110);
+	x3g.waitForTool(1, 600);
+	x3g.setFan(1, true);
+	x3g.setBuildPercentage(42);
+	x3g.delay(1.5);
+	const Scalar home[S3gWriter::AXES] = {-1, -2, 0, 1, 2};
+	x3g.setPosition(home);
+	
+	std::vector<X3gCommand> commands = decodeX3g(out.str());
+	CPPUNIT_ASSERT_EQUAL(size_t(11), commands.size());
+	
+	const X3gCommand& travel = commands[0];
+	CPPUNIT_ASSERT_EQUAL(unsigned(S3gWriter::CMD_QUEUE_POINT), travel.id);
+	CPPUNIT_ASSERT_EQUAL(1000L, travel.args[0]);
+	CPPUNIT_ASSERT_EQUAL(2000L, travel.args[1]);
+	CPPUNIT_ASSERT_EQUAL(120L, travel.args[2]);
+	CPPUNIT_ASSERT_EQUAL(0L, travel.args[3]);
+	CPPUNIT_ASSERT_EQUAL(0L, travel.args[4]);
+	Scalar distance = sqrt((10 - startX) * (10 - startX) + 
+			(20.004 - startY) * (20.004 - startY) + 
+			(0.3 - startZ) * (0.3 - startZ));
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(distance / 50 * 1e6, 
+			Scalar(travel.args[5]), 1);
+	CPPUNIT_ASSERT_EQUAL(0L, travel.args[6]);
+	
+	const X3gCommand& squirt = commands[1];
+	CPPUNIT_ASSERT_EQUAL(unsigned(S3gWriter::CMD_QUEUE_POINT), squirt.id);
+	CPPUNIT_ASSERT_EQUAL(1000L, squirt.args[0]);
+	//the firmware feeds filament as the extruder steps go down
+	CPPUNIT_ASSERT_EQUAL(-long(floor(squirtE * 50 + 0.5)), squirt.args[3]);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(squirtE / uder.retractRate * 1e6, 
+			Scalar(squirt.args[5]), 1);
+	
+	const X3gCommand& line = commands[2];
+	CPPUNIT_ASSERT_EQUAL(1500L, line.args[0]);
+	CPPUNIT_ASSERT_EQUAL(2000L, line.args[1]);
+	CPPUNIT_ASSERT_EQUAL(-long(floor(lineE * 50 + 0.5)), line.args[3]);
+	CPPUNIT_ASSERT(line.args[3] < squirt.args[3]);
+	CPPUNIT_ASSERT(line.args[3] < 0);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(5.0 / 20 * 1e6, Scalar(line.args[5]), 1);
+	
+	CPPUNIT_ASSERT_EQUAL(unsigned(S3gWriter::CMD_CHANGE_TOOL), 
+			commands[3].id);
+	CPPUNIT_ASSERT_EQUAL(1L, commands[3].args[0]);
+	CPPUNIT_ASSERT_EQUAL(unsigned(S3gWriter::CMD_TOOL_ACTION), 
+			commands[4].id);
+	CPPUNIT_ASSERT_EQUAL(1L, commands[4].args[0]);
+	CPPUNIT_ASSERT_EQUAL(long(S3gWriter::TOOL_SET_TEMPERATURE), 
+			commands[4].args[1]);
+	CPPUNIT_ASSERT_EQUAL(230L, commands[4].args[2]);
+	CPPUNIT_ASSERT_EQUAL(long(S3gWriter::TOOL_SET_PLATFORM_TEMPERATURE), 
+			commands[5].args[1]);
+	CPPUNIT_ASSERT_EQUAL(110L, commands[5].args[2]);
+	CPPUNIT_ASSERT_EQUAL(unsigned(S3gWriter::CMD_WAIT_FOR_TOOL), 
+			commands[6].id);
+	CPPUNIT_ASSERT_EQUAL(600L, commands[6].args[2]);
+	CPPUNIT_ASSERT_EQUAL(long(S3gWriter::TOOL_FAN), commands[7].args[1]);
+	CPPUNIT_ASSERT_EQUAL(1L, commands[7].args[2]);
+	CPPUNIT_ASSERT_EQUAL(unsigned(S3gWriter::CMD_BUILD_PERCENTAGE), 
+			commands[8].id);
+	CPPUNIT_ASSERT_EQUAL(42L, commands[8].args[0]);
+	CPPUNIT_ASSERT_EQUAL(unsigned(S3gWriter::CMD_DELAY), commands[9].id);
+	CPPUNIT_ASSERT_EQUAL(1500L, commands[9].args[0]);
+	CPPUNIT_ASSERT_EQUAL(unsigned(S3gWriter::CMD_SET_POSITION), 
+			commands[10].id);
+	CPPUNIT_ASSERT_EQUAL(-100L, commands[10].args[0]);
+	CPPUNIT_ASSERT_EQUAL(-200L, commands[10].args[1]);
+	CPPUNIT_ASSERT_EQUAL(-50L, commands[10].args[3]);
+	CPPUNIT_ASSERT_EQUAL(-100L, commands[10].args[4]);
+}
+
+/// travel, squirt, lines, an arc and a snort, to compare gantries by
+static void writeDeferredMoves(Gantry& gantry, ostream& ss, 
+		const Extruder& uder, const Extrusion& usion) {
+	gantry.g1(ss, 10, 20, 0.3, 3000, 0, 0, NULL);
+	gantry.squirt(ss, uder, usion);
+	for(int i = 0; i < 200; ++i) {
+		gantry.g1(ss, uder, usion, 10 + 0.37 * ((i + 1) % 2), 
+				20 + 0.013 * i, 0.3, 2000, 0.3, 0.5, NULL);
+	}
+	gantry.arc(ss, uder, usion, 20, 20, 0.3, Point2Type(15, 20), true, 
+			2000, 0.3, 0.5, NULL);
+	gantry.snort(ss, uder, usion);
+	gantry.g1(ss, 30, 40, 0.3, 3000, 0, 0, NULL);
+}
+
+void GantryTestCase::testDeferredE(){
+	for(int relative = 0; relative < 2; ++relative) {
+		Configuration config;
+		config.readFromFile("miracle.config");
+		config["doRelativeE"] = relative != 0;
+		config["commentLevel"] = "none";
+		GrueConfig grueCfg;
+		grueCfg.loadFromFile(config);
+		const Extruder& uder = grueCfg.get_extruders()[0];
+		Extrusion usion = grueCfg.get_extrusionProfiles().begin()->second;
+		
+		Gantry direct(grueCfg);
+		direct.set_current_extruder_index(uder.code);
+		direct.set_a(123.4567);
+		const Gantry::State start = direct.getState();
+		stringstream expected;
+		expected.precision(3);
+		expected.setf(ios::fixed);
+		
+		//the deferring gantry starts from a different extruder position, 
+		//which must not show in the text
+		Gantry deferring(grueCfg);
+		deferring.setState(start);
+		deferring.set_a(0);
+		Gantry::DeferredE record;
+		deferring.deferE(&record);
+		stringstream text;
+		text.copyfmt(expected);
+		
+		writeDeferredMoves(direct, expected, uder, usion);
+		writeDeferredMoves(deferring, text, uder, usion);
+		CPPUNIT_ASSERT(!record.fields.empty());
+		
+		Gantry joined(grueCfg);
+		joined.setState(start);
+		stringstream result;
+		result.copyfmt(expected);
+		joined.writeDeferred(result, text.str(), record);
+		
+		CPPUNIT_ASSERT_EQUAL(expected.str(), result.str());
+		CPPUNIT_ASSERT_EQUAL(direct.get_a(), joined.get_a());
+		CPPUNIT_ASSERT(deferring.getState().sameMotion(direct.getState()));
+	}
+}
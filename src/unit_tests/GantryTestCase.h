@@ -20,6 +20,12 @@ class GantryTestCase : public CPPUNIT_NS::TestFixture{
 	CPPUNIT_TEST( testG1Extrude );
 	CPPUNIT_TEST( testSquirtSnort );
 	CPPUNIT_TEST( testConfig );
+	CPPUNIT_TEST( testMotionModel );
+	CPPUNIT_TEST( testMotionPlanner );
+	CPPUNIT_TEST( testModalMoves );
+	CPPUNIT_TEST( testArcs );
+	CPPUNIT_TEST( testX3g );
+	CPPUNIT_TEST( testDeferredE );
 	
 	CPPUNIT_TEST_SUITE_END();
 	
@@ -32,6 +38,12 @@ protected:
 	void testG1Extrude();
 	void testSquirtSnort();
 	void testConfig();
+	void testMotionModel();
+	void testMotionPlanner();
+	void testModalMoves();
+	void testArcs();
+	void testX3g();
+	void testDeferredE();
 };
 
 
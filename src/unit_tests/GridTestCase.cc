@@ -72,7 +72,80 @@ void GridTestCase::testGridRangesToOpenPaths() {
 	CPPUNIT_ASSERT_EQUAL(path->fromEnd()->y, 1.0);
 	
 }
-	
-	
 
-	
+void GridTestCase::testWindowedGridRanges() {
+	Limits limits;
+	limits.grow(Point3Type(-50, -50, 0));
+	limits.grow(Point3Type(50, 50, 10));
+	Grid grid(limits, 1.0);
+
+	//a small square in one corner of a large grid
+	LoopList loops;
+	loops.push_back(Loop());
+	Loop& square = loops.back();
+	Loop::cw_iterator at = square.insertPointAfter(Point2Type(30.5, 30.5), 
+			square.clockwiseEnd());
+	at = square.insertPointAfter(Point2Type(30.5, 20.5), at);
+	at = square.insertPointAfter(Point2Type(20.5, 20.5), at);
+	at = square.insertPointAfter(Point2Type(20.5, 30.5), at);
+
+	GridWindow window = grid.windowForLoops(loops);
+	CPPUNIT_ASSERT(!window.empty());
+	CPPUNIT_ASSERT(window.xCount() < grid.getXValues().size());
+	CPPUNIT_ASSERT(window.yCount() < grid.getYValues().size());
+	CPPUNIT_ASSERT(grid.getXValues()[window.xBegin] < 20.5);
+	CPPUNIT_ASSERT(grid.getXValues()[window.xEnd - 1] > 30.5);
+
+	GridRanges windowed, full;
+	grid.createGridRanges(loops, window, windowed);
+	grid.createGridRanges(loops, grid.fullWindow(), full);
+	CPPUNIT_ASSERT_EQUAL(full.raysCount(), windowed.raysCount());
+	for (size_t i = 0; i < windowed.xRays.size(); ++i) {
+		const vector<ScalarRange>& a = windowed.xRays[i];
+		const vector<ScalarRange>& b = full.xRays[windowed.xRaysOffset + i];
+		CPPUNIT_ASSERT_EQUAL(b.size(), a.size());
+		for (size_t j = 0; j < a.size(); ++j) {
+			CPPUNIT_ASSERT_EQUAL(b[j].min, a[j].min);
+			CPPUNIT_ASSERT_EQUAL(b[j].max, a[j].max);
+		}
+	}
+
+	//subsampling picks the same global lines with or without a window
+	GridRanges windowedSparse, fullSparse;
+	grid.subSample(windowed, 3, windowedSparse);
+	grid.subSample(full, 3, fullSparse);
+	for (size_t i = 0; i < windowedSparse.yRays.size(); ++i) {
+		CPPUNIT_ASSERT_EQUAL(
+				fullSparse.yRays[windowedSparse.yRaysOffset + i].size(), 
+				windowedSparse.yRays[i].size());
+	}
+
+	OpenPathList windowedPaths, fullPaths;
+	grid.gridRangesToOpenPaths(windowedSparse, X_AXIS, windowedPaths);
+	grid.gridRangesToOpenPaths(fullSparse, X_AXIS, fullPaths);
+	CPPUNIT_ASSERT_EQUAL(fullPaths.size(), windowedPaths.size());
+	CPPUNIT_ASSERT(!windowedPaths.empty());
+	CPPUNIT_ASSERT_EQUAL(fullPaths.front().fromStart()->y, 
+			windowedPaths.front().fromStart()->y);
+
+	CPPUNIT_ASSERT(grid.windowForLoops(LoopList()).empty());
+
+	//an empty table, as a layer without loops makes, against a windowed one
+	GridRanges empty, emptyDiff, emptyUnion, emptyTersection;
+	empty.xRaysOffset = 7;
+	empty.yRaysOffset = 7;
+	grid.gridRangeDifference(empty, windowed, emptyDiff);
+	CPPUNIT_ASSERT(emptyDiff.xRays.empty());
+	CPPUNIT_ASSERT(emptyDiff.yRays.empty());
+	CPPUNIT_ASSERT_EQUAL((size_t)7, emptyDiff.xRaysOffset);
+	grid.gridRangeUnion(empty, windowed, emptyUnion);
+	CPPUNIT_ASSERT_EQUAL(windowed.raysCount(), emptyUnion.raysCount());
+	CPPUNIT_ASSERT_EQUAL(windowed.xRaysOffset, emptyUnion.xRaysOffset);
+	grid.gridRangeIntersection(empty, windowed, emptyTersection);
+	CPPUNIT_ASSERT_EQUAL((size_t)0, emptyTersection.raysCount());
+
+	GridRanges kept;
+	grid.gridRangeDifference(windowed, empty, kept);
+	CPPUNIT_ASSERT_EQUAL(windowed.raysCount(), kept.raysCount());
+	CPPUNIT_ASSERT_EQUAL(windowed.yRaysOffset, kept.yRaysOffset);
+}
@@ -9,6 +9,7 @@ class GridTestCase : public CPPUNIT_NS::TestFixture
 {
 	CPPUNIT_TEST_SUITE( GridTestCase );
 	CPPUNIT_TEST( testGridRangesToOpenPaths );
+	CPPUNIT_TEST( testWindowedGridRanges );
     CPPUNIT_TEST_SUITE_END();
 
 
@@ -17,6 +18,7 @@ public:
 
 protected:
 	void testGridRangesToOpenPaths();
+	void testWindowedGridRanges();
 
 };
 
@@ -0,0 +1,149 @@
+#include "UnitTestUtils.h"
+#include "InstancerTestCase.h"
+
+#include "mgl/configuration.h"
+#include "mgl/instancer.h"
+
+#include <vector>
+
+using namespace std;
+using namespace mgl;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( InstancerTestCase );
+
+typedef LayerPaths::Layer::ExtruderLayer::LabeledPathList LabeledPathList;
+
+/// a layer of a part: an inset loop around (0,0), then a line of infill
+static LayerPaths::Layer partLayer() {
+	LayerPaths::Layer layer;
+	layer.extruders.push_back(LayerPaths::Layer::ExtruderLayer(0));
+	LabeledPathList& paths = layer.extruders.back().paths;
+	paths.push_back(LabeledOpenPath(PathLabel(PathLabel::TYP_INSET, 
+			PathLabel::OWN_MODEL, 10)));
+	OpenPath& loop = paths.back().myPath;
+	loop.appendPoint(Point2Type(-1, -1));
+	loop.appendPoint(Point2Type(1, -1));
+	loop.appendPoint(Point2Type(1, 1));
+	loop.appendPoint(Point2Type(-1, -1));
+	paths.push_back(LabeledOpenPath(PathLabel(PathLabel::TYP_INFILL, 
+			PathLabel::OWN_MODEL, 5)));
+	OpenPath& line = paths.back().myPath;
+	line.appendPoint(Point2Type(-0.5, 0));
+	line.appendPoint(Point2Type(0.5, 0));
+	return layer;
+}
+
+static Point2Type startOf(const LabeledOpenPath& path) {
+	return *path.myPath.fromStart();
+}
+
+void InstancerTestCase::testCopies(){
+	vector<Point2Type> offsets;
+	offsets.push_back(Point2Type(0, 0));
+	offsets.push_back(Point2Type(20, 0));
+	offsets.push_back(Point2Type(0, 20));
+	LayerPaths layers;
+	layers.push_back(partLayer());
+	layers.push_back(partLayer());
+	Instancer instancer(offsets, Point2Type(0, 0));
+	instancer.replicate(layers);
+	
+	for(LayerPaths::layer_iterator layer = layers.begin(); 
+			layer != layers.end(); ++layer) {
+		const LabeledPathList& paths = layer->extruders.front().paths;
+		CPPUNIT_ASSERT_EQUAL((size_t)6, paths.size());
+		//every copy keeps the part's paths, in order, moved together
+		LabeledPathList::const_iterator path = paths.begin();
+		for(size_t copy = 0; copy < offsets.size(); ++copy) {
+			CPPUNIT_ASSERT(path->myLabel.isInset());
+			Point2Type corner = startOf(*path);
+			++path;
+			CPPUNIT_ASSERT(path->myLabel.isInfill());
+			Point2Type infill = startOf(*path);
+			++path;
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5, infill.x - corner.x, 1e-9);
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(1, infill.y - corner.y, 1e-9);
+		}
+	}
+}
+
+void InstancerTestCase::testOrder(){
+	//listed far from near, from a start beside the last
+	vector<Point2Type> offsets;
+	offsets.push_back(Point2Type(0, 0));
+	offsets.push_back(Point2Type(40, 0));
+	offsets.push_back(Point2Type(80, 0));
+	LayerPaths layers;
+	layers.push_back(partLayer());
+	layers.push_back(partLayer());
+	Instancer instancer(offsets, Point2Type(100, 0));
+	instancer.replicate(layers);
+	
+	//the first layer starts nearest the start and works back
+	const LabeledPathList& first = layers.begin()->extruders.front().paths;
+	LabeledPathList::const_iterator path = first.begin();
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(79, startOf(*path).x, 1e-9);
+	++path; ++path;
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(39, startOf(*path).x, 1e-9);
+	++path; ++path;
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(-1, startOf(*path).x, 1e-9);
+	//and the next starts where it ended
+	const LabeledPathList& second = 
+			(++layers.begin())->extruders.front().paths;
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(-1, startOf(second.front()).x, 1e-9);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(79.5, startOf(second.back()).x, 1e-9);
+}
+
+void InstancerTestCase::testStream(){
+	class CountingSink : public LayerSink {
+	public:
+		CountingSink() : paths(0) {}
+		void layerReady(LayerPaths& from, LayerPaths::layer_iterator layer) {
+			paths += layer->extruders.front().paths.size();
+			from.erase(layer);
+		}
+		size_t paths;
+	};
+	vector<Point2Type> offsets(4, Point2Type(0, 0));
+	for(size_t i = 0; i < offsets.size(); ++i)
+		offsets[i] = Point2Type(10.0 * i, 0);
+	CountingSink sink;
+	Instancer instancer(offsets, Point2Type(0, 0), &sink);
+	LayerPaths layers;
+	layers.push_back(partLayer());
+	instancer.layerReady(layers, layers.begin());
+	CPPUNIT_ASSERT_EQUAL((size_t)8, sink.paths);
+	CPPUNIT_ASSERT(layers.empty());
+	
+	//no offsets leaves the part as it is
+	Instancer none(vector<Point2Type>(), Point2Type(0, 0));
+	layers.push_back(partLayer());
+	none.replicate(layers);
+	CPPUNIT_ASSERT_EQUAL((size_t)2, 
+			layers.begin()->extruders.front().paths.size());
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(-1, 
+			startOf(layers.begin()->extruders.front().paths.front()).x, 1e-9);
+}
+
+void InstancerTestCase::testConfig(){
+	Configuration config;
+	config.readFromFile("miracle.config");
+	GrueConfig grueCfg;
+	grueCfg.loadFromFile(config);
+	CPPUNIT_ASSERT(grueCfg.get_instances().empty());
+	
+	Json::Value placements(Json::arrayValue);
+	Json::Value placement(Json::arrayValue);
+	placement.append(30);
+	placement.append(-12.5);
+	placements.append(placement);
+	config["instances"] = placements;
+	grueCfg.loadFromFile(config);
+	CPPUNIT_ASSERT_EQUAL((size_t)1, grueCfg.get_instances().size());
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(30, grueCfg.get_instances()[0].x, 1e-9);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(-12.5, grueCfg.get_instances()[0].y, 1e-9);
+	
+	placements[0u].append(1);
+	config["instances"] = placements;
+	CPPUNIT_ASSERT_THROW(grueCfg.loadFromFile(config), mgl::Exception);
+}
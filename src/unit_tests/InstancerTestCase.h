@@ -0,0 +1,30 @@
+/* 
+ * File:   InstancerTestCase.h
+ *
+ */
+
+#ifndef INSTANCERTESTCASE_H
+#define	INSTANCERTESTCASE_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class InstancerTestCase : public CPPUNIT_NS::TestFixture{
+	
+	CPPUNIT_TEST_SUITE( InstancerTestCase );
+	
+	CPPUNIT_TEST( testCopies );
+	CPPUNIT_TEST( testOrder );
+	CPPUNIT_TEST( testStream );
+	CPPUNIT_TEST( testConfig );
+	
+	CPPUNIT_TEST_SUITE_END();
+	
+protected:
+	void testCopies();
+	void testOrder();
+	void testStream();
+	void testConfig();
+};
+
+
+#endif	/* INSTANCERTESTCASE_H */
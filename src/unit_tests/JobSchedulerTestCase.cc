@@ -0,0 +1,89 @@
+#include "UnitTestUtils.h"
+#include "JobSchedulerTestCase.h"
+
+#include "mgl/job_scheduler.h"
+#include "mgl/abstractable.h"
+
+using namespace std;
+using namespace mgl;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( JobSchedulerTestCase );
+
+void JobSchedulerTestCase::testOrder(){
+	JobScheduler scheduler(1, 0);
+	JobScheduler::JobId id = 0;
+	CPPUNIT_ASSERT(!scheduler.admit(0, id));
+	scheduler.add(1, 0, 100, 0, 0);
+	scheduler.add(2, 0, 10, 0, 0);
+	scheduler.add(3, 1, 1000, 0, 0);
+	//priority first, however long
+	CPPUNIT_ASSERT(scheduler.admit(0, id));
+	CPPUNIT_ASSERT_EQUAL(3u, id);
+	//one at a time
+	CPPUNIT_ASSERT(!scheduler.admit(0, id));
+	scheduler.finish(3);
+	//then the shortest
+	CPPUNIT_ASSERT(scheduler.admit(0, id));
+	CPPUNIT_ASSERT_EQUAL(2u, id);
+	scheduler.finish(2);
+	CPPUNIT_ASSERT(scheduler.admit(0, id));
+	CPPUNIT_ASSERT_EQUAL(1u, id);
+	CPPUNIT_ASSERT_EQUAL(size_t(0), scheduler.waitingCount());
+	CPPUNIT_ASSERT_EQUAL(size_t(1), scheduler.runningCount());
+}
+
+void JobSchedulerTestCase::testAging(){
+	JobScheduler scheduler(1, 0);
+	JobScheduler::JobId id = 0;
+	scheduler.add(1, 0, 1000, 0, 0);
+	scheduler.add(2, 0, 10, 0, 5);
+	//a short job passes a long one that has not waited long
+	CPPUNIT_ASSERT(scheduler.admit(6, id));
+	CPPUNIT_ASSERT_EQUAL(2u, id);
+	scheduler.finish(2);
+	//but not once the long one has waited about as long as it takes
+	scheduler.add(3, 0, 10, 0, 995);
+	CPPUNIT_ASSERT(scheduler.admit(1000, id));
+	CPPUNIT_ASSERT_EQUAL(1u, id);
+}
+
+void JobSchedulerTestCase::testMemory(){
+	JobScheduler scheduler(3, 100);
+	JobScheduler::JobId id = 0;
+	scheduler.add(1, 0, 1, 60, 0);
+	scheduler.add(2, 0, 2, 50, 0);
+	scheduler.add(3, 0, 3, 10, 0);
+	CPPUNIT_ASSERT(scheduler.admit(0, id));
+	CPPUNIT_ASSERT_EQUAL(1u, id);
+	CPPUNIT_ASSERT_EQUAL(size_t(60), scheduler.reservedBytes());
+	//the next does not fit, and the one after it does not pass it
+	CPPUNIT_ASSERT(!scheduler.admit(0, id));
+	scheduler.finish(1);
+	CPPUNIT_ASSERT(scheduler.admit(0, id));
+	CPPUNIT_ASSERT_EQUAL(2u, id);
+	CPPUNIT_ASSERT(scheduler.admit(0, id));
+	CPPUNIT_ASSERT_EQUAL(3u, id);
+	CPPUNIT_ASSERT_EQUAL(size_t(60), scheduler.reservedBytes());
+	//larger than the whole budget, it runs alone
+	scheduler.add(4, 0, 1, 500, 0);
+	CPPUNIT_ASSERT(!scheduler.admit(0, id));
+	scheduler.finish(2);
+	scheduler.finish(3);
+	CPPUNIT_ASSERT(!scheduler.overBudget());
+	CPPUNIT_ASSERT(scheduler.admit(0, id));
+	CPPUNIT_ASSERT_EQUAL(4u, id);
+	//and no other job can join it
+	CPPUNIT_ASSERT(scheduler.overBudget());
+}
+
+void JobSchedulerTestCase::testPredictBytes(){
+	JobFeatures small(100, 50, 400);
+	JobFeatures large(30000, 200, 3000);
+	CPPUNIT_ASSERT(JobScheduler::predictBytes(small) > 0);
+	CPPUNIT_ASSERT(JobScheduler::predictBytes(large) > 
+			10 * JobScheduler::predictBytes(small));
+	JobFeatures supported = large;
+	supported.support = true;
+	CPPUNIT_ASSERT(JobScheduler::predictBytes(supported) > 
+			JobScheduler::predictBytes(large));
+}
@@ -0,0 +1,30 @@
+/* 
+ * File:   JobSchedulerTestCase.h
+ *
+ */
+
+#ifndef JOBSCHEDULERTESTCASE_H
+#define	JOBSCHEDULERTESTCASE_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class JobSchedulerTestCase : public CPPUNIT_NS::TestFixture{
+	
+	CPPUNIT_TEST_SUITE( JobSchedulerTestCase );
+	
+	CPPUNIT_TEST( testOrder );
+	CPPUNIT_TEST( testAging );
+	CPPUNIT_TEST( testMemory );
+	CPPUNIT_TEST( testPredictBytes );
+	
+	CPPUNIT_TEST_SUITE_END();
+	
+protected:
+	void testOrder();
+	void testAging();
+	void testMemory();
+	void testPredictBytes();
+};
+
+
+#endif	/* JOBSCHEDULERTESTCASE_H */
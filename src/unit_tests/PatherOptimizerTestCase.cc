@@ -162,5 +162,37 @@ void PatherOptimizerTestCase::testCompleteness() {
 	CPPUNIT_ASSERT_MESSAGE("Not all points were traversed!", points.empty());
 }
 
-
-
+void PatherOptimizerTestCase::testNearestOrder() {
+	static const int PATH_COUNT = 50;
+	pather_optimizer optimizer;
+	
+	//a row of short paths, added out of order
+	for(int i = 0; i < PATH_COUNT; ++i) {
+		int position = (i * 17) % PATH_COUNT;
+		OpenPath path;
+		path.appendPoint(Point2Type(position * 3.0, 0));
+		path.appendPoint(Point2Type(position * 3.0 + 1.0, 0));
+		optimizer.addPath(path);
+	}
+	//far away, but with a higher value, so it must come first
+	OpenPath important;
+	important.appendPoint(Point2Type(1000, 1000));
+	important.appendPoint(Point2Type(1001, 1000));
+	optimizer.addPath(important, 
+			PathLabel(PathLabel::TYP_INSET, PathLabel::OWN_MODEL, 1));
+	
+	std::list<OpenPath> optimizedList;
+	cout << "Optimizing a row of paths" << endl;
+	optimizer.optimize(optimizedList);
+	
+	CPPUNIT_ASSERT_EQUAL(size_t(PATH_COUNT + 1), optimizedList.size());
+	std::list<OpenPath>::const_iterator iter = optimizedList.begin();
+	CPPUNIT_ASSERT(*iter->fromStart() == Point2Type(1000, 1000));
+	cout << "Make sure the row is walked from its nearest end" << endl;
+	++iter;
+	for(int position = PATH_COUNT - 1; position >= 0; --position, ++iter) {
+		CPPUNIT_ASSERT(*iter->fromStart() == 
+				Point2Type(position * 3.0 + 1.0, 0));
+		CPPUNIT_ASSERT(*iter->fromEnd() == Point2Type(position * 3.0, 0));
+	}
+}
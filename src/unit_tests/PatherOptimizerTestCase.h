@@ -16,6 +16,7 @@ class PatherOptimizerTestCase : public CPPUNIT_NS::TestFixture {
 	
 	CPPUNIT_TEST( testBasics );
 	CPPUNIT_TEST( testBoundary );
+	CPPUNIT_TEST( testNearestOrder );
 	
 	CPPUNIT_TEST_SUITE_END();
 public:
@@ -24,6 +25,7 @@ protected:
 	void testBasics();
 	void testBoundary();
 	void testCompleteness();
+	void testNearestOrder();
 };
 
 
@@ -0,0 +1,198 @@
+#include "UnitTestUtils.h"
+#include "PatherTestCase.h"
+
+#include "mgl/miracle.h"
+#include "mgl/task_scheduler.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+using namespace mgl;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( PatherTestCase );
+
+typedef LayerPaths::Layer::ExtruderLayer ExtruderLayer;
+typedef ExtruderLayer::LabeledPathList LabeledPathList;
+
+/// the paths of a layer that print, each as its points in order
+static vector<vector<Point2Type> > printOf(const ExtruderLayer& layer) {
+	vector<vector<Point2Type> > result;
+	for(LabeledPathList::const_iterator path = layer.paths.begin(); 
+			path != layer.paths.end(); ++path) {
+		if(path->myLabel.isConnection())
+			continue;
+		result.push_back(vector<Point2Type>());
+		for(OpenPath::const_iterator point = path->myPath.fromStart(); 
+				point != path->myPath.end(); ++point)
+			result.back().push_back(*point);
+	}
+	return result;
+}
+
+/// whether @a after is @a before, its points rotated or reversed
+static bool samePath(vector<Point2Type> before, vector<Point2Type> after) {
+	if(before.size() != after.size())
+		return false;
+	if(before == after)
+		return true;
+	reverse(after.begin(), after.end());
+	if(before == after)
+		return true;
+	if(!(before.front() == before.back()) || !(after.front() == after.back()))
+		return false;
+	before.pop_back();
+	after.pop_back();
+	for(size_t shift = 0; shift < before.size(); ++shift) {
+		rotate(after.begin(), after.begin() + 1, after.end());
+		if(before == after)
+			return true;
+		vector<Point2Type> backwards(after.rbegin(), after.rend());
+		if(before == backwards)
+			return true;
+	}
+	return false;
+}
+
+void PatherTestCase::testChunks(){
+	Configuration config;
+	config.readFromFile("miracle.config");
+	config["doGraphOptimization"] = true;
+	GrueConfig grueCfg;
+	grueCfg.loadFromFile(config);
+	
+	Meshy mesh(grueCfg);
+	mesh.readStlFile("inputs/3D_Knot.stl");
+	mesh.alignToPlate();
+	Limits limits = mesh.readLimits();
+	Segmenter segmenter(grueCfg);
+	segmenter.tablaturize(mesh);
+	Slicer slicer(grueCfg);
+	LayerLoops layerLoops(0.0, grueCfg.get_layerH());
+	slicer.generateLoops(segmenter, layerLoops);
+	LoopProcessor processor(grueCfg);
+	LayerLoops processedLoops;
+	processor.processLoops(layerLoops, processedLoops);
+	Regioner regioner(grueCfg);
+	RegionList regions;
+	Grid grid;
+	regioner.generateSkeleton(processedLoops, processedLoops.layerMeasure, 
+			regions, limits, grid);
+	
+	const unsigned int threadCounts[] = { 1, 2, 3, 4 };
+	for(size_t i = 0; i < sizeof(threadCounts) / sizeof(*threadCounts); 
+			++i) {
+		const unsigned int threads = threadCounts[i];
+		config["pathingThreads"] = threads;
+		grueCfg.loadFromFile(config);
+		Pather pather(grueCfg);
+		LayerPaths layers;
+		pather.generatePaths(grueCfg, regions, processedLoops.layerMeasure, 
+				grid, layers);
+		const PathingReport& report = pather.report();
+		
+		size_t layerCount = 0;
+		for(LayerPaths::const_layer_iterator layer = layers.begin(); 
+				layer != layers.end(); ++layer, ++layerCount) {
+			CPPUNIT_ASSERT_EQUAL((size_t)1, layer->extruders.size());
+		}
+		CPPUNIT_ASSERT_EQUAL(regions.size(), report.layerCount);
+		CPPUNIT_ASSERT_EQUAL(report.layerCount, report.layers.size());
+		CPPUNIT_ASSERT_EQUAL(report.layerCount, layerCount);
+		//chunks only where the threads really run at once
+		const bool parallel = TaskScheduler(threads).parallel();
+		CPPUNIT_ASSERT_EQUAL(parallel ? (size_t)threads : (size_t)1, 
+				report.threadCount);
+		if(parallel) {
+			CPPUNIT_ASSERT(report.predictedLayers > 0);
+			CPPUNIT_ASSERT(report.predictedLayers < 
+					report.threadCount * 4);
+		} else {
+			CPPUNIT_ASSERT_EQUAL((size_t)0, report.predictedLayers);
+			CPPUNIT_ASSERT_EQUAL(0.0, (double)report.predictionError);
+			CPPUNIT_ASSERT_EQUAL(0.0, (double)report.fixupSavings);
+		}
+		//the fix-up only ever shortens the way into a layer
+		CPPUNIT_ASSERT(report.fixupSavings >= 0);
+		CPPUNIT_ASSERT(report.predictionError >= 0);
+		CPPUNIT_ASSERT(report.entryTravel >= 0);
+		Scalar saved = 0;
+		for(size_t layer = 0; layer < report.layers.size(); ++layer)
+			saved += report.layers[layer].travelSaved;
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(saved, report.iterativeSavings, 1e-6);
+	}
+}
+
+void PatherTestCase::testFixLayerEntry(){
+	Configuration config;
+	config.readFromFile("miracle.config");
+	config["doFixedLayerStart"] = false;
+	GrueConfig grueCfg;
+	grueCfg.loadFromFile(config);
+	Pather pather(grueCfg);
+	
+	//a loop, a connection out of its seam, then a line of infill
+	ExtruderLayer layer(0);
+	layer.paths.push_back(LabeledOpenPath(PathLabel(PathLabel::TYP_INSET, 
+			PathLabel::OWN_MODEL, 10)));
+	OpenPath& loop = layer.paths.back().myPath;
+	loop.appendPoint(Point2Type(0, 0));
+	loop.appendPoint(Point2Type(10, 0));
+	loop.appendPoint(Point2Type(10, 10));
+	loop.appendPoint(Point2Type(0, 10));
+	loop.appendPoint(Point2Type(0, 0));
+	layer.paths.push_back(LabeledOpenPath(PathLabel(
+			PathLabel::TYP_CONNECTION, PathLabel::OWN_MODEL, 0)));
+	layer.paths.back().myPath.appendPoint(Point2Type(0, 0));
+	layer.paths.back().myPath.appendPoint(Point2Type(3, 3));
+	layer.paths.push_back(LabeledOpenPath(PathLabel(PathLabel::TYP_INFILL, 
+			PathLabel::OWN_MODEL, 5)));
+	layer.paths.back().myPath.appendPoint(Point2Type(3, 3));
+	layer.paths.back().myPath.appendPoint(Point2Type(7, 3));
+	
+	//a line on its own, which may be reversed
+	ExtruderLayer line(0);
+	line.paths.push_back(LabeledOpenPath(PathLabel(PathLabel::TYP_INFILL, 
+			PathLabel::OWN_MODEL, 5)));
+	line.paths.back().myPath.appendPoint(Point2Type(0, 0));
+	line.paths.back().myPath.appendPoint(Point2Type(5, 0));
+	line.paths.back().myPath.appendPoint(Point2Type(5, 5));
+	
+	const Point2Type exits[] = { Point2Type(-1, -1), Point2Type(11, 1), 
+			Point2Type(9, 12), Point2Type(5, 6), Point2Type(-2, 10) };
+	const ExtruderLayer* layers[] = { &layer, &line };
+	for(size_t which = 0; which < 2; ++which) {
+		const vector<vector<Point2Type> > before = printOf(*layers[which]);
+		for(size_t i = 0; i < sizeof(exits) / sizeof(*exits); ++i) {
+			ExtruderLayer fixed(*layers[which]);
+			pather.fixLayerEntry(grueCfg, exits[i], fixed);
+			const vector<vector<Point2Type> > after = printOf(fixed);
+			//every path that prints is still there, in its place
+			CPPUNIT_ASSERT_EQUAL(before.size(), after.size());
+			CPPUNIT_ASSERT(samePath(before.front(), after.front()));
+			for(size_t path = 1; path < before.size(); ++path)
+				CPPUNIT_ASSERT(before[path] == after[path]);
+			//and the way in is no longer than it was
+			const Point2Type oldStart = before.front().front();
+			const Point2Type newStart = after.front().front();
+			CPPUNIT_ASSERT((newStart - exits[i]).magnitude() <= 
+					(oldStart - exits[i]).magnitude());
+		}
+	}
+	
+	//the loop starts at its corner nearest the exit
+	ExtruderLayer fixed(layer);
+	pather.fixLayerEntry(grueCfg, Point2Type(9, 12), fixed);
+	CPPUNIT_ASSERT(*fixed.paths.front().myPath.fromStart() == 
+			Point2Type(10, 10));
+	CPPUNIT_ASSERT(*fixed.paths.front().myPath.fromEnd() == 
+			Point2Type(10, 10));
+	//with the connection from its old seam dropped
+	CPPUNIT_ASSERT_EQUAL((size_t)2, fixed.paths.size());
+	
+	//and the line is reversed to start at its far end
+	ExtruderLayer reversed(line);
+	pather.fixLayerEntry(grueCfg, Point2Type(6, 6), reversed);
+	CPPUNIT_ASSERT(*reversed.paths.front().myPath.fromStart() == 
+			Point2Type(5, 5));
+}
@@ -0,0 +1,26 @@
+/* 
+ * File:   PatherTestCase.h
+ *
+ */
+
+#ifndef PATHERTESTCASE_H
+#define	PATHERTESTCASE_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class PatherTestCase : public CPPUNIT_NS::TestFixture{
+	
+	CPPUNIT_TEST_SUITE( PatherTestCase );
+	
+	CPPUNIT_TEST( testChunks );
+	CPPUNIT_TEST( testFixLayerEntry );
+	
+	CPPUNIT_TEST_SUITE_END();
+	
+protected:
+	void testChunks();
+	void testFixLayerEntry();
+};
+
+
+#endif	/* PATHERTESTCASE_H */
@@ -0,0 +1,114 @@
+#include "UnitTestUtils.h"
+#include "ProgressModelTestCase.h"
+
+#include "mgl/abstractable.h"
+#include "mgl/configuration.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace std;
+using namespace mgl;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( ProgressModelTestCase );
+
+/// shows the messages a ProgressJSONStreamTotal would write
+class TotalProbe : public ProgressJSONStreamTotal {
+public:
+	TotalProbe(const GrueConfig& grueCfg) 
+			: ProgressJSONStreamTotal(grueCfg) {}
+	Json::Value message(const char* taskName, unsigned int percent) {
+		onStart(taskName, 100);
+		return makeJson(taskName, percent);
+	}
+};
+
+void ProgressModelTestCase::testFit(){
+	//seconds that follow the terms exactly
+	vector<JobFeatures> samples;
+	vector<Scalar> seconds;
+	for(size_t i = 1; i <= 6; ++i) {
+		JobFeatures features(1000 * i * i, 50 * i, 400 + 100 * (i % 3));
+		samples.push_back(features);
+		seconds.push_back(0.5 + 2e-4 * features.triangles + 
+				1e-2 * features.layers);
+	}
+	ProgressModel model;
+	model.fit("test", samples, seconds);
+	JobFeatures unseen(20000, 200, 500);
+	Scalar expected = 0.5 + 2e-4 * 20000 + 1e-2 * 200;
+	Scalar predicted = model.predict("test", unseen);
+	CPPUNIT_ASSERT(fabs(predicted - expected) < 0.02 * expected);
+	//the support term never varied, so it stays out of the prediction
+	unseen.support = true;
+	CPPUNIT_ASSERT(fabs(model.predict("test", unseen) - predicted) < 
+			0.02 * expected);
+	//never negative
+	CPPUNIT_ASSERT_EQUAL(ProgressModel::MIN_SECONDS, 
+			model.predict("unknown", unseen));
+}
+
+void ProgressModelTestCase::testLoad(){
+	ProgressModel model;
+	JobFeatures features(10000, 100, 2500);
+	CPPUNIT_ASSERT(model.knows("Path generation"));
+	Json::Value fitted;
+	Json::Value& coefficients = fitted["tasks"]["Path generation"];
+	coefficients.append(3.0);
+	for(unsigned int i = 1; i < JobFeatures::TERM_COUNT; ++i)
+		coefficients.append(0.0);
+	Scalar before = model.predict("gcode", features);
+	model.load(fitted);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(3.0, 
+			model.predict("Path generation", features), 1e-9);
+	//tasks left out keep their coefficients
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(before, model.predict("gcode", features), 
+			1e-9);
+	//round trip
+	ProgressModel copy;
+	copy.load(model.toJson());
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(3.0, 
+			copy.predict("Path generation", features), 1e-9);
+	
+	Json::Value shortRow;
+	shortRow["tasks"]["gcode"].append(1.0);
+	CPPUNIT_ASSERT_THROW(model.load(shortRow), mgl::Exception);
+	CPPUNIT_ASSERT_THROW(model.loadFile("no/such/model.json"), 
+			mgl::Exception);
+}
+
+void ProgressModelTestCase::testTotal(){
+	Configuration config;
+	config.readFromFile("miracle.config");
+	GrueConfig grueCfg;
+	grueCfg.loadFromFile(config);
+	
+	TotalProbe probe(grueCfg);
+	probe.onFeatures(JobFeatures(20000, 150, 2500));
+	const char* tasks[] = { "outlines", "Loop Processing", "insets", 
+			"spurs", "flat surfaces", "roofing", "flooring", "infills", 
+			"Path generation" };
+	unsigned int last = 0;
+	unsigned int beforePaths = 0;
+	for(size_t task = 0; task < sizeof(tasks) / sizeof(tasks[0]); ++task) {
+		if(string(tasks[task]) == "Path generation")
+			beforePaths = last;
+		for(unsigned int percent = 0; percent <= 100; percent += 50) {
+			Json::Value msg = probe.message(tasks[task], percent);
+			unsigned int total = msg["totalPercentComplete"].asUInt();
+			CPPUNIT_ASSERT(total >= last);
+			CPPUNIT_ASSERT(total <= 100);
+			last = total;
+			CPPUNIT_ASSERT(msg["etaSeconds"].isNumeric());
+			CPPUNIT_ASSERT(msg["etaSeconds"].asDouble() >= 0);
+			//with nothing done, the whole prediction is left
+			if(task == 0 && percent == 0)
+				CPPUNIT_ASSERT(msg["etaSeconds"].asDouble() > 0);
+		}
+	}
+	//planning paths is a large part of the job
+	CPPUNIT_ASSERT(last - beforePaths >= 10);
+	//the gcode is still to be written, unless it was streamed
+	if(!grueCfg.get_doStreaming())
+		CPPUNIT_ASSERT(last < 100);
+}
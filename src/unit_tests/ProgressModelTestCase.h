@@ -0,0 +1,29 @@
+/* 
+ * File:   ProgressModelTestCase.h
+ *
+ */
+
+#ifndef PROGRESSMODELTESTCASE_H
+#define	PROGRESSMODELTESTCASE_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class ProgressModelTestCase : public CPPUNIT_NS::TestFixture{
+	
+	CPPUNIT_TEST_SUITE( ProgressModelTestCase );
+	
+	CPPUNIT_TEST( testFit );
+	CPPUNIT_TEST( testLoad );
+	CPPUNIT_TEST( testTotal );
+	
+	CPPUNIT_TEST_SUITE_END();
+	
+protected:
+	void testFit();
+	void testLoad();
+	void testTotal();
+};
+
+
+#endif	/* PROGRESSMODELTESTCASE_H */
+
@@ -0,0 +1,170 @@
+#include "UnitTestUtils.h"
+#include "SliceBatchTestCase.h"
+
+#include "mgl/abstractable.h"
+#include "mgl/gcoder_writer.h"
+#include "mgl/miracle.h"
+#include "mgl/slice_batch.h"
+
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+using namespace mgl;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( SliceBatchTestCase );
+
+static string outDir("outputs/test_cases/SliceBatchTestCase/");
+static const char* box = "inputs/20mm_Calibration_Box.stl";
+
+static SliceBatch::Entry entry(const string& model, const Json::Value& overrides,
+		const string& output) {
+	SliceBatch::Entry made;
+	made.model = model;
+	made.overrides = overrides;
+	made.output = outDir + output;
+	return made;
+}
+
+/// the gcode miracleGrue writes for @a model on its own
+static string sliceAlone(const string& model, const Json::Value& overrides) {
+	Configuration config = baseConfig();
+	const Json::Value::Members keys = overrides.isObject() ?
+			overrides.getMemberNames() : Json::Value::Members();
+	for(size_t i = 0; i < keys.size(); ++i)
+		config[keys[i].c_str()] = overrides[keys[i]];
+	GrueConfig grueCfg;
+	grueCfg.loadFromFile(config);
+	ostringstream gcode;
+	RegionList regions;
+	vector<SliceData> slices;
+	miracleGrue(grueCfg, model.c_str(), NULL, gcode, -1, -1, regions, slices);
+	return gcode.str();
+}
+
+void SliceBatchTestCase::setUp(){
+	MyComputer computer;
+	computer.fileSystem.guarenteeDirectoryExistsRecursive(outDir.c_str());
+}
+
+void SliceBatchTestCase::testManifest(){
+	const string manifest = outDir + "manifest.json";
+	{
+		ofstream out(manifest.c_str());
+		out << "[ {\"model\": \"a.stl\"},\n"
+				"{\"model\": \"b.stl\", \"config\": {\"infillDensity\": 0.3},"
+				" \"output\": \"b.x3g\"} ]";
+	}
+	vector<SliceBatch::Entry> entries;
+	SliceBatch::readManifest(manifest, entries);
+	CPPUNIT_ASSERT_EQUAL((size_t)2, entries.size());
+	CPPUNIT_ASSERT_EQUAL(string("a.stl"), entries[0].model);
+	CPPUNIT_ASSERT(entries[0].output.empty());
+	CPPUNIT_ASSERT(entries[0].overrides.isNull());
+	CPPUNIT_ASSERT_EQUAL(string("b.x3g"), entries[1].output);
+	CPPUNIT_ASSERT_EQUAL(0.3, entries[1].overrides["infillDensity"].asDouble());
+	
+	{
+		ofstream out(manifest.c_str());
+		out << "[ {\"config\": {}} ]";
+	}
+	CPPUNIT_ASSERT_THROW(SliceBatch::readManifest(manifest, entries), 
+			mgl::Exception);
+	{
+		ofstream out(manifest.c_str());
+		out << "{\"model\": \"a.stl\"}";
+	}
+	CPPUNIT_ASSERT_THROW(SliceBatch::readManifest(manifest, entries), 
+			mgl::Exception);
+	//the whole batch is timed at once, not an entry
+	{
+		ofstream out(manifest.c_str());
+		out << "[ {\"model\": \"a.stl\", "
+				"\"config\": {\"timingReport\": \"a.json\"}} ]";
+	}
+	CPPUNIT_ASSERT_THROW(SliceBatch::readManifest(manifest, entries), 
+			mgl::Exception);
+}
+
+void SliceBatchTestCase::testGcodeOnly(){
+	CPPUNIT_ASSERT(SliceBatch::gcodeOnly("startGcode"));
+	CPPUNIT_ASSERT(SliceBatch::gcodeOnly("doFanCommand"));
+	CPPUNIT_ASSERT(SliceBatch::gcodeOnly("gcodeDecimals"));
+	//the pather plans with these
+	CPPUNIT_ASSERT(!SliceBatch::gcodeOnly("infillDensity"));
+	CPPUNIT_ASSERT(!SliceBatch::gcodeOnly("layerHeight"));
+	CPPUNIT_ASSERT(!SliceBatch::gcodeOnly("extruders"));
+	CPPUNIT_ASSERT(!SliceBatch::gcodeOnly("rapidMoveFeedRateXY"));
+	CPPUNIT_ASSERT(!SliceBatch::gcodeOnly("startX"));
+}
+
+void SliceBatchTestCase::testShared(){
+	Json::Value plain;
+	Json::Value fanless;
+	fanless["doFanCommand"] = false;
+	fanless["gcodeDecimals"] = 2;
+	Json::Value denser;
+	denser["infillDensity"] = 0.3;
+	Json::Value thinner;
+	thinner["layerHeight"] = 0.2;
+	
+	vector<SliceBatch::Entry> entries;
+	entries.push_back(entry(box, plain, "plain.gcode"));
+	entries.push_back(entry(box, denser, "denser.gcode"));
+	entries.push_back(entry(box, fanless, "fanless.gcode"));
+	entries.push_back(entry(box, thinner, "thinner.gcode"));
+	
+	SliceBatch batch(baseConfig());
+	vector<SliceBatch::Result> results;
+	batch.run(entries, results);
+	CPPUNIT_ASSERT_EQUAL(entries.size(), results.size());
+	for(size_t i = 0; i < results.size(); ++i)
+		CPPUNIT_ASSERT(results[i].ok);
+	
+	//the fan and decimals change only the gcode
+	CPPUNIT_ASSERT(results[0].planned != results[2].planned);
+	//more infill is planned again on the same segmenting
+	CPPUNIT_ASSERT(results[1].planned);
+	CPPUNIT_ASSERT(!results[1].segmented);
+	//another layer height is segmented again
+	CPPUNIT_ASSERT(results[3].segmented);
+	size_t segmented = 0, planned = 0;
+	for(size_t i = 0; i < results.size(); ++i) {
+		segmented += results[i].segmented;
+		planned += results[i].planned;
+	}
+	CPPUNIT_ASSERT_EQUAL((size_t)2, segmented);
+	CPPUNIT_ASSERT_EQUAL((size_t)3, planned);
+	
+	//and each is what slicing it alone writes
+	const string open = baseConfig()["commentOpen"].asString();
+	CPPUNIT_ASSERT_EQUAL(commandsOf(sliceAlone(box, plain), open), 
+			commandsOf(readFile(results[0].output), open));
+	CPPUNIT_ASSERT_EQUAL(commandsOf(sliceAlone(box, denser), open), 
+			commandsOf(readFile(results[1].output), open));
+	CPPUNIT_ASSERT_EQUAL(commandsOf(sliceAlone(box, fanless), open), 
+			commandsOf(readFile(results[2].output), open));
+	CPPUNIT_ASSERT_EQUAL(commandsOf(sliceAlone(box, thinner), open), 
+			commandsOf(readFile(results[3].output), open));
+}
+
+void SliceBatchTestCase::testFailure(){
+	Json::Value plain;
+	Json::Value fanless;
+	fanless["doFanCommand"] = false;
+	vector<SliceBatch::Entry> entries;
+	entries.push_back(entry("inputs/no_such_model.stl", plain, "none.gcode"));
+	entries.push_back(entry("inputs/no_such_model.stl", fanless, 
+			"none2.gcode"));
+	entries.push_back(entry(box, plain, "after.gcode"));
+	
+	SliceBatch batch(baseConfig());
+	vector<SliceBatch::Result> results;
+	batch.run(entries, results);
+	CPPUNIT_ASSERT(!results[0].ok);
+	CPPUNIT_ASSERT(!results[0].error.empty());
+	CPPUNIT_ASSERT(!results[1].ok);
+	CPPUNIT_ASSERT_EQUAL(results[0].error, results[1].error);
+	//one entry failing does not stop the others
+	CPPUNIT_ASSERT(results[2].ok);
+}
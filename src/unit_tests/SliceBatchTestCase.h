@@ -0,0 +1,33 @@
+/* 
+ * File:   SliceBatchTestCase.h
+ *
+ */
+
+#ifndef SLICEBATCHTESTCASE_H
+#define	SLICEBATCHTESTCASE_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class SliceBatchTestCase : public CPPUNIT_NS::TestFixture{
+	
+	CPPUNIT_TEST_SUITE( SliceBatchTestCase );
+	
+	CPPUNIT_TEST( testManifest );
+	CPPUNIT_TEST( testGcodeOnly );
+	CPPUNIT_TEST( testShared );
+	CPPUNIT_TEST( testFailure );
+	
+	CPPUNIT_TEST_SUITE_END();
+	
+public:
+	void setUp();
+	
+protected:
+	void testManifest();
+	void testGcodeOnly();
+	void testShared();
+	void testFailure();
+};
+
+
+#endif	/* SLICEBATCHTESTCASE_H */
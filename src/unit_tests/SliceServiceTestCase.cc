@@ -0,0 +1,266 @@
+#include "UnitTestUtils.h"
+#include "SliceServiceTestCase.h"
+
+#include "mgl/abstractable.h"
+#include "mgl/slice_service.h"
+
+#include <jsoncpp/json/reader.h>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+using namespace mgl;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( SliceServiceTestCase );
+
+static string spoolDir("outputs/test_cases/SliceServiceTestCase");
+
+static bool warmStart(const SliceService& service, SliceService::JobId id) {
+	SliceService::JobInfo info;
+	CPPUNIT_ASSERT(service.info(id, info));
+	return info.warm;
+}
+
+void SliceServiceTestCase::setUp(){
+	MyComputer computer;
+	computer.fileSystem.guarenteeDirectoryExistsRecursive(spoolDir.c_str());
+}
+
+void SliceServiceTestCase::testJob(){
+	SliceService service(baseConfig(), spoolDir);
+	string gcode;
+	vector<string> events;
+	CPPUNIT_ASSERT_EQUAL(SliceService::JOB_UNKNOWN, 
+			service.poll(1, 0, events));
+	
+	SliceService::JobId id = service.submit(
+			readFile("inputs/20mm_Calibration_Box.stl"), Json::Value());
+	CPPUNIT_ASSERT_EQUAL(SliceService::JOB_QUEUED, 
+			service.poll(id, 0, events));
+	CPPUNIT_ASSERT(!service.gcode(id, gcode));
+	//queued jobs are kept
+	CPPUNIT_ASSERT(!service.forget(id));
+	
+	CPPUNIT_ASSERT(service.runNext());
+	CPPUNIT_ASSERT(!service.runNext());
+	CPPUNIT_ASSERT_EQUAL(SliceService::JOB_DONE, 
+			service.poll(id, 0, events));
+	SliceService::JobInfo info;
+	CPPUNIT_ASSERT(service.info(id, info));
+	CPPUNIT_ASSERT(!info.warm);
+	CPPUNIT_ASSERT(info.predictedSeconds > 0);
+	CPPUNIT_ASSERT(info.predictedBytes > 0);
+	CPPUNIT_ASSERT(info.serviceSeconds > 0);
+	CPPUNIT_ASSERT(info.threads >= 1);
+	CPPUNIT_ASSERT(service.gcode(id, gcode));
+	CPPUNIT_ASSERT(gcode.find("G1") != string::npos);
+	
+	//every message is JSON, and polling again gives only new ones
+	CPPUNIT_ASSERT(!events.empty());
+	Json::Reader reader;
+	for(size_t i = 0; i < events.size(); ++i) {
+		Json::Value msg;
+		CPPUNIT_ASSERT(reader.parse(events[i], msg));
+		CPPUNIT_ASSERT(events[i].find('\n') == string::npos);
+	}
+	vector<string> more;
+	service.poll(id, events.size(), more);
+	CPPUNIT_ASSERT(more.empty());
+	
+	CPPUNIT_ASSERT(service.forget(id));
+	CPPUNIT_ASSERT_EQUAL(SliceService::JOB_UNKNOWN, 
+			service.poll(id, 0, events));
+}
+
+void SliceServiceTestCase::testWarm(){
+	SliceService service(baseConfig(), spoolDir, 1);
+	const string box = readFile("inputs/20mm_Calibration_Box.stl");
+	Json::Value denser;
+	denser["infillDensity"] = 0.3;
+	Json::Value thinner;
+	thinner["layerHeight"] = 0.2;
+	
+	SliceService::JobId first = service.submit(box, Json::Value());
+	SliceService::JobId same = service.submit(box, Json::Value());
+	SliceService::JobId filled = service.submit(box, denser);
+	SliceService::JobId layered = service.submit(box, thinner);
+	SliceService::JobId back = service.submit(box, Json::Value());
+	//one at a time, in order
+	CPPUNIT_ASSERT(service.runNext());
+	CPPUNIT_ASSERT(service.runNext());
+	CPPUNIT_ASSERT(service.runNext());
+	CPPUNIT_ASSERT(service.runNext());
+	CPPUNIT_ASSERT(service.runNext());
+	CPPUNIT_ASSERT(!service.runNext());
+	
+	CPPUNIT_ASSERT(!warmStart(service, first));
+	CPPUNIT_ASSERT(warmStart(service, same));
+	//infill does not change the slices, the layer height does
+	CPPUNIT_ASSERT(warmStart(service, filled));
+	CPPUNIT_ASSERT(!warmStart(service, layered));
+	//only one model is kept
+	CPPUNIT_ASSERT(!warmStart(service, back));
+	
+	//a warm start makes the same gcode
+	string cold;
+	string warm;
+	CPPUNIT_ASSERT(service.gcode(first, cold));
+	CPPUNIT_ASSERT(service.gcode(same, warm));
+	const string open = baseConfig()["commentOpen"].asString();
+	CPPUNIT_ASSERT(commandsOf(cold, open) == commandsOf(warm, open));
+	string thin;
+	CPPUNIT_ASSERT(service.gcode(layered, thin));
+	CPPUNIT_ASSERT(commandsOf(thin, open) != commandsOf(cold, open));
+}
+
+void SliceServiceTestCase::testFailure(){
+	SliceService service(baseConfig(), spoolDir);
+	Json::Value wrong(Json::arrayValue);
+	CPPUNIT_ASSERT_THROW(service.submit("solid", wrong), mgl::Exception);
+	
+	SliceService::JobId id = service.submit("not a model", Json::Value());
+	CPPUNIT_ASSERT(service.runNext());
+	vector<string> events;
+	string error;
+	CPPUNIT_ASSERT_EQUAL(SliceService::JOB_FAILED, 
+			service.poll(id, 0, events, &error));
+	CPPUNIT_ASSERT(!error.empty());
+	string gcode;
+	CPPUNIT_ASSERT(!service.gcode(id, gcode));
+	CPPUNIT_ASSERT(service.forget(id));
+}
+
+void SliceServiceTestCase::testPriority(){
+	SliceService service(baseConfig(), spoolDir);
+	const string box = readFile("inputs/20mm_Calibration_Box.stl");
+	SliceService::JobId low = service.submit(box, Json::Value(), 0);
+	SliceService::JobId high = service.submit(box, Json::Value(), 1);
+	CPPUNIT_ASSERT(service.runNext());
+	vector<string> events;
+	CPPUNIT_ASSERT_EQUAL(SliceService::JOB_DONE, 
+			service.poll(high, 0, events));
+	CPPUNIT_ASSERT_EQUAL(SliceService::JOB_QUEUED, 
+			service.poll(low, 0, events));
+	SliceService::JobInfo waiting;
+	CPPUNIT_ASSERT(service.info(low, waiting));
+	CPPUNIT_ASSERT_EQUAL(0, waiting.priority);
+	CPPUNIT_ASSERT(waiting.serviceSeconds == 0);
+	SliceService::JobInfo ran;
+	CPPUNIT_ASSERT(service.info(high, ran));
+	//the low one waited while the high one ran
+	CPPUNIT_ASSERT(waiting.waitSeconds > ran.serviceSeconds);
+	CPPUNIT_ASSERT(service.runNext());
+}
+
+void SliceServiceTestCase::testConcurrent(){
+	Configuration config = baseConfig();
+	config["maxConcurrentJobs"] = 2;
+	config["threads"] = 2;
+	SliceService service(config, spoolDir);
+	const string box = readFile("inputs/20mm_Calibration_Box.stl");
+	Json::Value denser;
+	denser["infillDensity"] = 0.3;
+	vector<SliceService::JobId> ids;
+	ids.push_back(service.submit(box, Json::Value()));
+	ids.push_back(service.submit(box, denser));
+	ids.push_back(service.submit(box, Json::Value()));
+	service.start();
+	for(size_t i = 0; i < ids.size(); ++i) {
+		vector<string> events;
+		while(service.poll(ids[i], 0, events) != SliceService::JOB_DONE) {
+			CPPUNIT_ASSERT(service.poll(ids[i], 0, events) != 
+					SliceService::JOB_FAILED);
+			events.clear();
+		}
+	}
+	service.stop();
+	//jobs side by side make what they make alone
+	string first;
+	string again;
+	CPPUNIT_ASSERT(service.gcode(ids[0], first));
+	CPPUNIT_ASSERT(service.gcode(ids[2], again));
+	const string open = baseConfig()["commentOpen"].asString();
+	CPPUNIT_ASSERT(commandsOf(first, open) == commandsOf(again, open));
+	SliceService::JobInfo info;
+	CPPUNIT_ASSERT(service.info(ids[1], info));
+	CPPUNIT_ASSERT(info.threads >= 1 && info.threads <= 2);
+}
+
+void SliceServiceTestCase::testFileKeys(){
+	CPPUNIT_ASSERT(SliceService::namesFile("startGcode"));
+	CPPUNIT_ASSERT(SliceService::namesFile("timingReport"));
+	CPPUNIT_ASSERT(!SliceService::namesFile("infillDensity"));
+	const string start = spoolDir + "/secret.gcode";
+	{
+		ofstream secret(start.c_str());
+		secret << "M117 secret\n";
+	}
+	//a job can't have the server's files copied into its gcode
+	SliceService service(baseConfig(), spoolDir);
+	Json::Value reading;
+	reading["startGcode"] = start;
+	reading["infillDensity"] = 0.3;
+	SliceService::JobId id = service.submit(
+			readFile("inputs/20mm_Calibration_Box.stl"), reading);
+	CPPUNIT_ASSERT(service.runNext());
+	string gcode;
+	CPPUNIT_ASSERT(service.gcode(id, gcode));
+	CPPUNIT_ASSERT(gcode.find("secret") == string::npos);
+	//its other changes still apply
+	Json::Value denser;
+	denser["infillDensity"] = 0.3;
+	SliceService::JobId plain = service.submit(
+			readFile("inputs/20mm_Calibration_Box.stl"), denser);
+	CPPUNIT_ASSERT(service.runNext());
+	string expected;
+	CPPUNIT_ASSERT(service.gcode(plain, expected));
+	const string open = baseConfig()["commentOpen"].asString();
+	CPPUNIT_ASSERT(commandsOf(expected, open) == commandsOf(gcode, open));
+}
+
+void SliceServiceTestCase::testAdmission(){
+	const string box = readFile("inputs/20mm_Calibration_Box.stl");
+	Configuration config = baseConfig();
+	config["maxConcurrentJobs"] = 2;
+	config["threads"] = 4;
+	vector<string> events;
+	{
+		//each job gets its slot's share, so the jobs never crowd the cores
+		SliceService service(config, spoolDir);
+		SliceService::JobId alone = service.submit(box, Json::Value());
+		CPPUNIT_ASSERT(service.runNext());
+		SliceService::JobId first = service.submit(box, Json::Value());
+		SliceService::JobId second = service.submit(box, Json::Value());
+		CPPUNIT_ASSERT(service.runNext());
+		CPPUNIT_ASSERT(service.runNext());
+		SliceService::JobInfo info;
+		//even one started alone, which another may join
+		CPPUNIT_ASSERT(service.info(alone, info));
+		CPPUNIT_ASSERT_EQUAL(2u, info.threads);
+		CPPUNIT_ASSERT(service.info(first, info));
+		CPPUNIT_ASSERT_EQUAL(2u, info.threads);
+		CPPUNIT_ASSERT(service.info(second, info));
+		CPPUNIT_ASSERT_EQUAL(2u, info.threads);
+	}
+	
+	//a model larger than the whole budget still runs, alone
+	config["jobMemoryBudget"] = 1;
+	SliceService service(config, spoolDir);
+	SliceService::JobId early = service.submit(box, Json::Value(), 0);
+	SliceService::JobId urgent = service.submit(box, Json::Value(), 1);
+	SliceService::JobId late = service.submit(box, Json::Value(), 0);
+	CPPUNIT_ASSERT(service.runNext());
+	SliceService::JobInfo info;
+	CPPUNIT_ASSERT(service.info(urgent, info));
+	CPPUNIT_ASSERT_EQUAL(SliceService::JOB_DONE, info.state);
+	CPPUNIT_ASSERT(info.predictedBytes > (size_t(1) << 20));
+	CPPUNIT_ASSERT_EQUAL(4u, info.threads);
+	//then the one predicted to end soonest, counting how long it waited
+	CPPUNIT_ASSERT(service.runNext());
+	CPPUNIT_ASSERT_EQUAL(SliceService::JOB_DONE, 
+			service.poll(early, 0, events));
+	CPPUNIT_ASSERT_EQUAL(SliceService::JOB_QUEUED, 
+			service.poll(late, 0, events));
+	CPPUNIT_ASSERT(service.runNext());
+	CPPUNIT_ASSERT(!service.runNext());
+}
@@ -0,0 +1,39 @@
+/* 
+ * File:   SliceServiceTestCase.h
+ *
+ */
+
+#ifndef SLICESERVICETESTCASE_H
+#define	SLICESERVICETESTCASE_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class SliceServiceTestCase : public CPPUNIT_NS::TestFixture{
+	
+	CPPUNIT_TEST_SUITE( SliceServiceTestCase );
+	
+	CPPUNIT_TEST( testJob );
+	CPPUNIT_TEST( testWarm );
+	CPPUNIT_TEST( testFailure );
+	CPPUNIT_TEST( testPriority );
+	CPPUNIT_TEST( testConcurrent );
+	CPPUNIT_TEST( testFileKeys );
+	CPPUNIT_TEST( testAdmission );
+	
+	CPPUNIT_TEST_SUITE_END();
+	
+public:
+	void setUp();
+	
+protected:
+	void testJob();
+	void testWarm();
+	void testFailure();
+	void testPriority();
+	void testConcurrent();
+	void testFileKeys();
+	void testAdmission();
+};
+
+
+#endif	/* SLICESERVICETESTCASE_H */
@@ -9,6 +9,8 @@
 #include "mgl/basic_boxlist.h"
 #include "mgl/basic_rtree.h"
 #include "mgl/basic_quadtree.h"
+#include "mgl/basic_kdtree.h"
+#include "mgl/segment_grid_index.h"
 #include <cmath>
 #include <ctime>
 
@@ -474,7 +476,122 @@ void SpacialTestCase::testQPerformance() {
 //    std::cout << "Writing tree to cout" << std::endl;
 //    rtree.repr(std::cout);
 }
-
-
-
-
+void SpacialTestCase::testKdtreeNearest() {
+    srand(0);
+    typedef basic_kdtree<size_t> tree_type;
+    typedef std::vector<tree_type::point_value> point_vector;
+    typedef std::pair<Scalar, size_t> distance_index;
+    
+    static const size_t POINT_COUNT = 2000;
+    Scalar range = 100;
+    
+    point_vector points;
+    for(size_t i = 0; i < POINT_COUNT; ++i) {
+        //snap to a coarse grid so that there are plenty of ties
+        Point2Type point = randVector(range);
+        point.x = floor(point.x / 5.0) * 5.0;
+        point.y = floor(point.y / 5.0) * 5.0;
+        points.push_back(tree_type::point_value(point, i));
+    }
+    tree_type tree(points.begin(), points.end());
+    CPPUNIT_ASSERT_EQUAL(POINT_COUNT, tree.size());
+    
+    std::cout << "Erasing every third point" << std::endl;
+    std::vector<bool> erased(POINT_COUNT, false);
+    for(size_t i = 0; i < POINT_COUNT; i += 3) {
+        CPPUNIT_ASSERT(tree.erase(points[i].first, points[i].second));
+        erased[i] = true;
+    }
+    CPPUNIT_ASSERT(!tree.erase(points[0].first, points[0].second));
+    
+    for(size_t test = 0; test < 20; ++test) {
+        Point2Type query = randVector(range);
+        std::vector<distance_index> expected;
+        for(size_t i = 0; i < POINT_COUNT; ++i) {
+            if(erased[i])
+                continue;
+            expected.push_back(distance_index(
+                    (points[i].first - query).squaredMagnitude(), i));
+        }
+        std::sort(expected.begin(), expected.end());
+        
+        tree_type::nearest_query nearest(tree, query);
+        size_t found;
+        Scalar distance;
+        for(size_t i = 0; i < expected.size(); ++i) {
+            CPPUNIT_ASSERT(nearest.next(found, distance));
+            CPPUNIT_ASSERT_EQUAL(expected[i].second, found);
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[i].first, distance, 1e-9);
+            //values erased during a query are skipped
+            if(i == 10) {
+                tree.erase(points[expected[11].second].first, 
+                        expected[11].second);
+                erased[expected[11].second] = true;
+                ++i;
+            }
+        }
+        CPPUNIT_ASSERT(!nearest.next(found, distance));
+    }
+}
+void SpacialTestCase::testSegmentGridIntersects() {
+    srand(0);
+    typedef std::vector<Segment2Type> segment_vector;
+    
+    static const size_t SEGMENT_COUNT = 3000;
+    Scalar range = 100;
+    
+    segment_grid_index index;
+    segment_vector segments;
+    CPPUNIT_ASSERT(!index.intersects(Segment2Type(Point2Type(0,0), 
+            Point2Type(range, range))));
+    for(size_t i = 0; i < SEGMENT_COUNT; ++i) {
+        Point2Type a = randVector(range);
+        //mostly short segments, like boundaries, with some long ones
+        Point2Type b = a + randVector(i % 50 ? 4.0 : range) - 
+                randVector(i % 50 ? 4.0 : range);
+        //some segments exactly on the grid lines
+        if(i % 7 == 0) {
+            a.x = floor(a.x);
+            b.x = a.x;
+        }
+        segments.push_back(Segment2Type(a, b));
+        index.insert(segments.back());
+    }
+    CPPUNIT_ASSERT_EQUAL(SEGMENT_COUNT, index.size());
+    
+    for(size_t test = 0; test < 500; ++test) {
+        //probes of all lengths, some leaving the indexed area
+        Point2Type a = randVector(range * 1.2) - Point2Type(10, 10);
+        Point2Type b = a + randVector(test % 2 ? 10.0 : range) - 
+                randVector(test % 2 ? 10.0 : range);
+        if(test % 10 == 0)
+            b.y = a.y;
+        if(test % 10 == 1)
+            b.x = a.x;
+        Segment2Type probe(a, b);
+        size_t expected = 0;
+        for(segment_vector::const_iterator iter = segments.begin(); 
+                iter != segments.end(); 
+                ++iter) {
+            if(iter->intersects(probe))
+                ++expected;
+        }
+        CPPUNIT_ASSERT_EQUAL(expected, index.countIntersections(probe));
+        CPPUNIT_ASSERT_EQUAL(expected != 0, index.intersects(probe));
+    }
+    //a probe along an indexed segment crosses every segment touching it
+    Segment2Type probe = segments[SEGMENT_COUNT / 2];
+    size_t expected = 0;
+    for(segment_vector::const_iterator iter = segments.begin(); 
+            iter != segments.end(); 
+            ++iter) {
+        if(iter->intersects(probe))
+            ++expected;
+    }
+    CPPUNIT_ASSERT_EQUAL(expected, index.countIntersections(probe));
+    
+    segment_grid_index other;
+    other.swap(index);
+    CPPUNIT_ASSERT(index.empty());
+    CPPUNIT_ASSERT_EQUAL(expected, other.countIntersections(probe));
+}
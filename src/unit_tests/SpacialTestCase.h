@@ -30,6 +30,8 @@ private:
 //    CPPUNIT_TEST( testQtreeStress );
     CPPUNIT_TEST( testPerformance );
 //    CPPUNIT_TEST( testQPerformance );
+    CPPUNIT_TEST( testKdtreeNearest );
+    CPPUNIT_TEST( testSegmentGridIntersects );
     CPPUNIT_TEST_SUITE_END();
 public:
     void setUp();
@@ -47,6 +49,8 @@ protected:
     void testQtreeStress();
     void testPerformance(); //boxlist, rtree
     void testQPerformance();
+    void testKdtreeNearest();
+    void testSegmentGridIntersects();
     
 };
 
@@ -0,0 +1,253 @@
+#include "UnitTestUtils.h"
+#include "StageTimerTestCase.h"
+
+#include "mgl/stage_timer.h"
+#include "mgl/abstractable.h"
+#include "mgl/container_sizes.h"
+
+#include <jsoncpp/json/reader.h>
+#include <set>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+using namespace std;
+using namespace mgl;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( StageTimerTestCase );
+
+/// starts a task for each name, as the pipeline classes do
+class TaskRunner : public Progressive {
+public:
+	void run(const char* first, const char* second) {
+		initProgress(first, 1);
+		tick();
+		initProgress(second, 1);
+		tick();
+	}
+};
+
+void StageTimerTestCase::tearDown(){
+	StageTimer::disable();
+}
+
+void StageTimerTestCase::testDisabled(){
+	StageTimer::enable();
+	StageTimer::disable();
+	{
+		StageTimer::Scope scope("ignored");
+		StageTimer::count(StageTimer::CLIPPER_CALLS);
+		CPPUNIT_ASSERT(StageTimer::current() == NULL);
+	}
+	Json::Value timing;
+	StageTimer::report(timing);
+	CPPUNIT_ASSERT_EQUAL(0u, timing["stages"].size());
+}
+
+void StageTimerTestCase::testNesting(){
+	StageTimer::enable();
+	{
+		StageTimer::Scope outer("outer");
+		for(int call = 0; call < 3; ++call) {
+			StageTimer::Scope inner("inner");
+		}
+		StageTimer::Scope other("other");
+	}
+	{
+		StageTimer::Scope outer("outer");
+	}
+	StageTimer::disable();
+	Json::Value timing;
+	StageTimer::report(timing);
+	CPPUNIT_ASSERT_EQUAL(1u, timing["stages"].size());
+	const Json::Value& outer = timing["stages"][0u];
+	CPPUNIT_ASSERT_EQUAL(string("outer"), outer["name"].asString());
+	CPPUNIT_ASSERT_EQUAL(2u, outer["calls"].asUInt());
+	CPPUNIT_ASSERT_EQUAL(2u, outer["stages"].size());
+	CPPUNIT_ASSERT_EQUAL(string("inner"), 
+			outer["stages"][0u]["name"].asString());
+	CPPUNIT_ASSERT_EQUAL(3u, outer["stages"][0u]["calls"].asUInt());
+	CPPUNIT_ASSERT_EQUAL(string("other"), 
+			outer["stages"][1u]["name"].asString());
+	CPPUNIT_ASSERT(outer["wallSeconds"].asDouble() >= 
+			outer["stages"][0u]["wallSeconds"].asDouble());
+	CPPUNIT_ASSERT(timing["wallSeconds"].asDouble() >= 0);
+}
+
+void StageTimerTestCase::testTasks(){
+	StageTimer::enable();
+	TaskRunner runner;
+	StageTimer::Task stage;
+	stage.start("first");
+	runner.run("a", "b");
+	//the runner's last task is still open, and ends with the stage
+	stage.start("second");
+	runner.run("c", "d");
+	stage.stop();
+	StageTimer::disable();
+	Json::Value timing;
+	StageTimer::report(timing);
+	CPPUNIT_ASSERT_EQUAL(2u, timing["stages"].size());
+	const Json::Value& first = timing["stages"][0u];
+	const Json::Value& second = timing["stages"][1u];
+	CPPUNIT_ASSERT_EQUAL(2u, first["stages"].size());
+	CPPUNIT_ASSERT_EQUAL(string("b"), first["stages"][1u]["name"].asString());
+	CPPUNIT_ASSERT_EQUAL(2u, second["stages"].size());
+	CPPUNIT_ASSERT_EQUAL(string("c"), second["stages"][0u]["name"].asString());
+	CPPUNIT_ASSERT_EQUAL(0u, second["stages"][0u]["stages"].size());
+}
+
+void StageTimerTestCase::testCounts(){
+	StageTimer::enable();
+	{
+		StageTimer::Scope outer("outer");
+		StageTimer::count(StageTimer::RAY_CASTS, 5);
+		StageTimer::Scope inner("inner");
+		StageTimer::count(StageTimer::RAY_CASTS);
+		StageTimer::count(StageTimer::LINK_PROBES, 2);
+	}
+	StageTimer::disable();
+	Json::Value timing;
+	StageTimer::report(timing);
+	const Json::Value& outer = timing["stages"][0u];
+	const Json::Value& inner = outer["stages"][0u];
+	//a stage counts what its sub-stages did
+	CPPUNIT_ASSERT_EQUAL(6u, outer["counts"]["rayCasts"].asUInt());
+	CPPUNIT_ASSERT_EQUAL(2u, outer["counts"]["linkProbes"].asUInt());
+	CPPUNIT_ASSERT_EQUAL(1u, inner["counts"]["rayCasts"].asUInt());
+	CPPUNIT_ASSERT(!inner["counts"].isMember("clipperCalls"));
+}
+
+void StageTimerTestCase::testTrace(){
+	StageTimer::enable(true);
+	{
+		StageTimer::Scope stage("stage");
+		StageTimer::Event layer("layer", 7);
+		StageTimer::Event call("call");
+	}
+	StageTimer::disable();
+	//a disabled trace records nothing more
+	{
+		StageTimer::Event late("late");
+	}
+	std::ostringstream trace;
+	StageTimer::writeTrace(trace);
+	Json::Value parsed;
+	Json::Reader reader;
+	CPPUNIT_ASSERT(reader.parse(trace.str(), parsed));
+	const Json::Value& events = parsed["traceEvents"];
+	//thread name, then spans in the order they ended
+	CPPUNIT_ASSERT_EQUAL(4u, events.size());
+	CPPUNIT_ASSERT_EQUAL(string("M"), events[0u]["ph"].asString());
+	CPPUNIT_ASSERT_EQUAL(string("call"), events[1u]["name"].asString());
+	CPPUNIT_ASSERT_EQUAL(string("layer"), events[2u]["name"].asString());
+	CPPUNIT_ASSERT_EQUAL(7, events[2u]["args"]["layer"].asInt());
+	CPPUNIT_ASSERT_EQUAL(string("stage"), events[3u]["name"].asString());
+	CPPUNIT_ASSERT_EQUAL(string("stage"), events[3u]["cat"].asString());
+	CPPUNIT_ASSERT_EQUAL(string("X"), events[3u]["ph"].asString());
+	CPPUNIT_ASSERT(events[3u]["ts"].asDouble() <= 
+			events[2u]["ts"].asDouble());
+	CPPUNIT_ASSERT(events[3u]["dur"].asDouble() >= 
+			events[2u]["dur"].asDouble());
+}
+
+void StageTimerTestCase::testMemory(){
+	LayerLoops layerloops(0.0, 0.2);
+	LayerLoops::Layer layer;
+	Loop square;
+	square.insertPointBefore(Point2Type(0, 0), square.clockwiseEnd());
+	square.insertPointBefore(Point2Type(0, 1), square.clockwiseEnd());
+	square.insertPointBefore(Point2Type(1, 1), square.clockwiseEnd());
+	square.insertPointBefore(Point2Type(1, 0), square.clockwiseEnd());
+	layer.push_back(square);
+	layerloops.push_back(layer);
+	layerloops.push_back(LayerLoops::Layer());
+
+	StageTimer::enable();
+	{
+		StageTimer::Scope stage("stage");
+		StageTimer::countAllocation(100);
+		StageTimer::countAllocation(28);
+		Json::Value sizes;
+		containerSizes(layerloops, sizes);
+		StageTimer::recordSizes("layerLoops", sizes);
+	}
+	StageTimer::disable();
+	Json::Value timing;
+	StageTimer::report(timing);
+	const Json::Value& stage = timing["stages"][0u];
+	CPPUNIT_ASSERT_EQUAL(2u, stage["counts"]["allocations"].asUInt());
+	CPPUNIT_ASSERT_EQUAL(128u, stage["counts"]["allocatedBytes"].asUInt());
+	CPPUNIT_ASSERT(stage["peakRssKb"].asInt() >= 0);
+	CPPUNIT_ASSERT(stage["peakRssGrowthKb"].asInt() >= 0);
+
+	const Json::Value& sizes = timing["sizes"]["layerLoops"];
+	CPPUNIT_ASSERT_EQUAL(2u, sizes["layers"].asUInt());
+	CPPUNIT_ASSERT_EQUAL(1u, sizes["loops"].asUInt());
+	CPPUNIT_ASSERT_EQUAL(4u, sizes["points"].asUInt());
+	CPPUNIT_ASSERT_EQUAL(4u, sizes["pointsPerLayer"][0u].asUInt());
+	CPPUNIT_ASSERT_EQUAL(0u, sizes["loopsPerLayer"][1u].asUInt());
+	CPPUNIT_ASSERT(sizes["bytes"].asDouble() > 4 * sizeof(Point2Type));
+}
+
+/// times a scope under the stage it is given, then lets its thread end
+#ifdef _WIN32
+static DWORD WINAPI timeAway(LPVOID parent) {
+#else
+static void* timeAway(void* parent) {
+#endif
+	StageTimer::Scope away("away", static_cast<StageTimer::Stage*>(parent));
+	StageTimer::Event event("event", 3);
+	return 0;
+}
+
+void StageTimerTestCase::testOtherThreads(){
+	//a thread OpenMP knows nothing of, gone before the report
+	StageTimer::enable(true);
+	{
+		StageTimer::Scope stage("stage");
+		StageTimer::Stage* parent = StageTimer::current();
+#ifdef _WIN32
+		HANDLE thread = CreateThread(NULL, 0, timeAway, parent, 0, NULL);
+		WaitForSingleObject(thread, INFINITE);
+		CloseHandle(thread);
+#else
+		pthread_t thread;
+		pthread_create(&thread, NULL, timeAway, parent);
+		pthread_join(thread, NULL);
+#endif
+	}
+	StageTimer::disable();
+	Json::Value report;
+	StageTimer::report(report);
+	const Json::Value& away = report["stages"][0u]["stages"][0u];
+	CPPUNIT_ASSERT_EQUAL(string("away"), away["name"].asString());
+	CPPUNIT_ASSERT_EQUAL(1u, away["calls"].asUInt());
+	//its trace outlives it, on a timeline of its own
+	std::ostringstream trace;
+	StageTimer::writeTrace(trace);
+	Json::Value parsed;
+	Json::Reader reader;
+	CPPUNIT_ASSERT(reader.parse(trace.str(), parsed));
+	const Json::Value& events = parsed["traceEvents"];
+	set<int> threads;
+	bool found = false;
+	for(Json::Value::ArrayIndex index = 0; index < events.size(); ++index) {
+		threads.insert(events[index]["tid"].asInt());
+		if(events[index]["name"].asString() == "event")
+			found = events[index]["args"]["layer"].asInt() == 3;
+	}
+	CPPUNIT_ASSERT(found);
+	CPPUNIT_ASSERT_EQUAL(size_t(2), threads.size());
+	//and is dropped once timing starts again
+	StageTimer::enable(true);
+	StageTimer::disable();
+	std::ostringstream empty;
+	StageTimer::writeTrace(empty);
+	CPPUNIT_ASSERT(reader.parse(empty.str(), parsed));
+	CPPUNIT_ASSERT_EQUAL(0u, parsed["traceEvents"].size());
+}
@@ -0,0 +1,39 @@
+/* 
+ * File:   StageTimerTestCase.h
+ *
+ */
+
+#ifndef STAGETIMERTESTCASE_H
+#define	STAGETIMERTESTCASE_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class StageTimerTestCase : public CPPUNIT_NS::TestFixture{
+	
+	CPPUNIT_TEST_SUITE( StageTimerTestCase );
+	
+	CPPUNIT_TEST( testDisabled );
+	CPPUNIT_TEST( testNesting );
+	CPPUNIT_TEST( testTasks );
+	CPPUNIT_TEST( testCounts );
+	CPPUNIT_TEST( testTrace );
+	CPPUNIT_TEST( testMemory );
+	CPPUNIT_TEST( testOtherThreads );
+	
+	CPPUNIT_TEST_SUITE_END();
+	
+public:
+	void tearDown();
+protected:
+	void testDisabled();
+	void testNesting();
+	void testTasks();
+	void testCounts();
+	void testTrace();
+	void testMemory();
+	void testOtherThreads();
+};
+
+
+#endif	/* STAGETIMERTESTCASE_H */
+
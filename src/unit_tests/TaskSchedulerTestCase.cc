@@ -0,0 +1,204 @@
+#include "UnitTestUtils.h"
+#include "TaskSchedulerTestCase.h"
+
+#include "mgl/task_scheduler.h"
+#include "mgl/Exception.h"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace mgl;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( TaskSchedulerTestCase );
+
+/// counts each index it is given, and which chunk it came in
+class Visitor {
+public:
+	Visitor(size_t count) : visits(count, 0), chunks(count, 0) {}
+	void operator()(size_t begin, size_t end, size_t chunk) {
+		for(size_t i = begin; i < end; ++i) {
+			++visits[i];
+			chunks[i] = chunk;
+		}
+	}
+	vector<int> visits;
+	vector<size_t> chunks;
+};
+
+/// adds up numbers of different sizes, where the order shows
+class Harmonic {
+public:
+	double operator()(size_t begin, size_t end, size_t) {
+		double sum = 0;
+		for(size_t i = begin; i < end; ++i)
+			sum += 1.0 / (i + 1) + (i % 7 ? 1e10 : -1e10);
+		return sum;
+	}
+};
+
+static double add(double a, double b) {
+	return a + b;
+}
+
+/// notes whether the tasks it waits for finished before it started
+class Step : public Task {
+public:
+	Step(vector<int>& doneFlags, size_t myIndex, 
+			const vector<size_t>& waitsFor, bool& allInOrder) 
+			: done(doneFlags), index(myIndex), prerequisites(waitsFor), 
+			inOrder(allInOrder) {}
+	void run() {
+		for(size_t i = 0; i < prerequisites.size(); ++i) {
+			if(!done[prerequisites[i]])
+				inOrder = false;
+		}
+		done[index] = 1;
+	}
+private:
+	vector<int>& done;
+	size_t index;
+	vector<size_t> prerequisites;
+	bool& inOrder;
+};
+
+/// throws, or cancels the rest, or just notes it ran
+class Action : public Task {
+public:
+	enum Kind { RUN, THROW, CANCEL };
+	Action(Kind what, int& ranFlag, TaskScheduler* owner = NULL) 
+			: kind(what), ran(ranFlag), scheduler(owner) {}
+	void run() {
+		ran = 1;
+		if(kind == THROW) {
+			Exception failure("step failed");
+			throw failure;
+		}
+		if(kind == CANCEL)
+			scheduler->cancel();
+	}
+private:
+	Kind kind;
+	int& ran;
+	TaskScheduler* scheduler;
+};
+
+void TaskSchedulerTestCase::testParallelFor(){
+	const unsigned int threads[] = { 1, 4 };
+	for(size_t t = 0; t < 2; ++t) {
+		TaskScheduler scheduler(threads[t]);
+		Visitor visitor(1000);
+		scheduler.parallelFor(0, 1000, 37, visitor);
+		for(size_t i = 0; i < 1000; ++i) {
+			CPPUNIT_ASSERT_EQUAL(1, visitor.visits[i]);
+			//chunks are contiguous and in order
+			if(i)
+				CPPUNIT_ASSERT(visitor.chunks[i] >= visitor.chunks[i - 1]);
+		}
+		CPPUNIT_ASSERT_EQUAL(size_t(0), visitor.chunks.front());
+		CPPUNIT_ASSERT_EQUAL(size_t(36), visitor.chunks.back());
+	}
+	//part of a range, in fewer chunks than threads
+	TaskScheduler scheduler(8);
+	Visitor visitor(10);
+	scheduler.parallelFor(4, 7, 2, visitor);
+	for(size_t i = 0; i < 10; ++i)
+		CPPUNIT_ASSERT_EQUAL(i >= 4 && i < 7 ? 1 : 0, visitor.visits[i]);
+}
+
+void TaskSchedulerTestCase::testReduce(){
+	Harmonic harmonic;
+	TaskScheduler one(1);
+	const double expected = one.parallelReduce(0, 100000, 64, 0.0, 
+			harmonic, add);
+	const unsigned int threads[] = { 2, 3, 8 };
+	for(size_t t = 0; t < 3; ++t) {
+		TaskScheduler scheduler(threads[t]);
+		//exactly the same, not just close
+		CPPUNIT_ASSERT(expected == scheduler.parallelReduce(0, 100000, 64, 
+				0.0, harmonic, add));
+	}
+}
+
+void TaskSchedulerTestCase::testGraph(){
+	/* a diamond, 0 before 1 and 2, both before 3, and a chain of 
+	 tasks each after the one before, beside it */
+	const size_t chainLength = 20;
+	vector<int> done(4 + chainLength, 0);
+	bool inOrder = true;
+	TaskGraph graph;
+	vector<vector<size_t> > waits(done.size());
+	waits[1].push_back(0);
+	waits[2].push_back(0);
+	waits[3].push_back(1);
+	waits[3].push_back(2);
+	for(size_t i = 5; i < done.size(); ++i)
+		waits[i].push_back(i - 1);
+	for(size_t i = 0; i < done.size(); ++i)
+		graph.add(new Step(done, i, waits[i], inOrder));
+	for(size_t i = 0; i < done.size(); ++i) {
+		for(size_t w = 0; w < waits[i].size(); ++w)
+			graph.depend(i, waits[i][w]);
+	}
+	TaskScheduler scheduler(4);
+	scheduler.run(graph);
+	CPPUNIT_ASSERT(inOrder);
+	for(size_t i = 0; i < done.size(); ++i)
+		CPPUNIT_ASSERT_EQUAL(1, done[i]);
+	
+	//a cycle is refused before anything runs
+	TaskGraph cycle;
+	int ran[2] = { 0, 0 };
+	cycle.add(new Action(Action::RUN, ran[0]));
+	cycle.add(new Action(Action::RUN, ran[1]));
+	cycle.depend(0, 1);
+	cycle.depend(1, 0);
+	CPPUNIT_ASSERT_THROW(scheduler.run(cycle), mgl::Exception);
+	CPPUNIT_ASSERT_EQUAL(0, ran[0] + ran[1]);
+}
+
+void TaskSchedulerTestCase::testFailure(){
+	const unsigned int threads[] = { 1, 4 };
+	for(size_t t = 0; t < 2; ++t) {
+		TaskScheduler scheduler(threads[t]);
+		TaskGraph graph;
+		int ran[3] = { 0, 0, 0 };
+		graph.add(new Action(Action::THROW, ran[0]));
+		graph.add(new Action(Action::RUN, ran[1]));
+		graph.add(new Action(Action::RUN, ran[2]));
+		graph.depend(1, 0);
+		graph.depend(2, 1);
+		string message;
+		try {
+			scheduler.run(graph);
+		} catch (const mgl::Exception& failure) {
+			message = failure.what();
+		}
+		CPPUNIT_ASSERT_EQUAL(string("step failed"), message);
+		CPPUNIT_ASSERT_EQUAL(1, ran[0]);
+		//what waited on the failure never ran
+		CPPUNIT_ASSERT_EQUAL(0, ran[1] + ran[2]);
+		CPPUNIT_ASSERT(scheduler.cancelled());
+		
+		//the next run starts afresh
+		TaskGraph again;
+		int ranAgain = 0;
+		again.add(new Action(Action::RUN, ranAgain));
+		scheduler.run(again);
+		CPPUNIT_ASSERT_EQUAL(1, ranAgain);
+	}
+}
+
+void TaskSchedulerTestCase::testCancel(){
+	TaskScheduler scheduler(3);
+	TaskGraph graph;
+	int ran[4] = { 0, 0, 0, 0 };
+	TaskGraph::TaskId stop = graph.add(
+			new Action(Action::CANCEL, ran[0], &scheduler));
+	for(size_t i = 1; i < 4; ++i)
+		graph.depend(graph.add(new Action(Action::RUN, ran[i])), stop);
+	//cancelling is not a failure
+	scheduler.run(graph);
+	CPPUNIT_ASSERT_EQUAL(1, ran[0]);
+	CPPUNIT_ASSERT_EQUAL(0, ran[1] + ran[2] + ran[3]);
+}
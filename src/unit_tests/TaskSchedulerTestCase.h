@@ -0,0 +1,33 @@
+/* 
+ * File:   TaskSchedulerTestCase.h
+ *
+ */
+
+#ifndef TASKSCHEDULERTESTCASE_H
+#define	TASKSCHEDULERTESTCASE_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class TaskSchedulerTestCase : public CPPUNIT_NS::TestFixture{
+	
+	CPPUNIT_TEST_SUITE( TaskSchedulerTestCase );
+	
+	CPPUNIT_TEST( testParallelFor );
+	CPPUNIT_TEST( testReduce );
+	CPPUNIT_TEST( testGraph );
+	CPPUNIT_TEST( testFailure );
+	CPPUNIT_TEST( testCancel );
+	
+	CPPUNIT_TEST_SUITE_END();
+	
+protected:
+	void testParallelFor();
+	void testReduce();
+	void testGraph();
+	void testFailure();
+	void testCancel();
+};
+
+
+#endif	/* TASKSCHEDULERTESTCASE_H */
+
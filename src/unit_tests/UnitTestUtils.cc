@@ -6,6 +6,10 @@
 
 #include "mgl/ScadDebugFile.h"
 
+#include <cppunit/extensions/HelperMacros.h>
+#include <fstream>
+#include <sstream>
+
 using namespace mgl;
 using namespace std;
 
@@ -46,6 +50,34 @@ void clip(const std::vector<Segment2Type> &in,
 
 };
 
+string readFile(const string& filename) {
+	ifstream file(filename.c_str(), ios::in | ios::binary);
+	CPPUNIT_ASSERT(file.good());
+	ostringstream bytes;
+	bytes << file.rdbuf();
+	return bytes.str();
+}
+
+string commandsOf(const string& gcode, const string& commentOpen) {
+	stringstream in(gcode);
+	string commands;
+	string line;
+	while (getline(in, line)) {
+		line = line.substr(0, line.find(commentOpen));
+		while (!line.empty() && line[line.size() - 1] == ' ')
+			line.erase(line.size() - 1);
+		if (!line.empty())
+			commands += line + '\n';
+	}
+	return commands;
+}
+
+Configuration baseConfig() {
+	Configuration config;
+	config.readFromFile("miracle.config");
+	return config;
+}
+
 
 #ifdef WIN32
 
@@ -1,7 +1,10 @@
 #ifndef UNIT_TEST_UTIL_H_
 #define UNIT_TEST_UTIL_H_
 
+#include <string>
+
 #include "mgl/mgl.h"
+#include "mgl/configuration.h"
 
 void clip(const std::vector<mgl::Segment2Type> &in,
 			unsigned int min,
@@ -10,6 +13,15 @@ void clip(const std::vector<mgl::Segment2Type> &in,
 
 void  mkDebugPath(const char *path);
 
+/// the bytes of @a filename, asserting it could be read
+std::string readFile(const std::string& filename);
+
+/// @a gcode without blank lines or comments, which open with @a commentOpen
+std::string commandsOf(const std::string& gcode, const std::string& commentOpen);
+
+/// miracle.config, the settings most tests start from
+mgl::Configuration baseConfig();
+
 
 #endif
 
@@ -0,0 +1,479 @@
+/**
+   MiracleGrue - Model Generator for toolpathing. <http://www.grue.makerbot.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+ */
+
+/*
+ Times each stage of the pipeline on its own, for a set of models and
+ configurations, and writes the results as JSON so builds can be
+ compared. Built with scons --bench.
+
+ usage: mgl_bench [-c config] [-r repeats] [-v variant]... [-o out.json]
+                  [-f model.json] [model.stl]...
+
+ Without models, the bundled ones are used. Without -v, every variant
+ is run. With repeats, each stage keeps its fastest time. Allocations
+ are those StageTimer counts, on the threads that time stages.
+
+ With -f, the seconds of each progress task are also fitted to the
+ features of the jobs, and written as a progress model for the
+ progressModelFile setting. Without -v, -f runs the default, support and
+ raft variants, which between them run every task.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#include <sys/time.h>
+#endif
+
+#ifdef OMPFF
+#include <omp.h>
+#endif
+
+#include <jsoncpp/json/writer.h>
+
+#include "mgl/abstractable.h"
+#include "mgl/configuration.h"
+#include "mgl/miracle.h"
+#include "mgl/stage_timer.h"
+#include "mgl/log.h"
+
+using namespace std;
+using namespace mgl;
+
+/// what the process has used so far
+class Usage {
+public:
+    static Usage now() {
+        Usage usage;
+#ifdef _WIN32
+        usage.wall = GetTickCount() / 1000.0;
+        usage.cpu = double(clock()) / CLOCKS_PER_SEC;
+        usage.peakRssKb = 0;
+#else
+        timeval tv;
+        gettimeofday(&tv, NULL);
+        usage.wall = tv.tv_sec + tv.tv_usec / 1e6;
+        rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        usage.cpu = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+                ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+#ifdef __APPLE__
+        usage.peakRssKb = ru.ru_maxrss / 1024;
+#else
+        usage.peakRssKb = ru.ru_maxrss;
+#endif
+#endif
+        usage.allocations = StageTimer::total(StageTimer::ALLOCATIONS);
+        usage.allocatedBytes =
+                StageTimer::total(StageTimer::ALLOCATED_BYTES);
+        return usage;
+    }
+    double wall;
+    double cpu;
+    long peakRssKb;
+    size_t allocations;
+    size_t allocatedBytes;
+};
+
+/// the cost of one stage, or of a part of one
+class StageResult {
+public:
+    StageResult(const string& stageName = "") : name(stageName), wall(0),
+            cpu(0), peakRssKb(0), allocations(0), allocatedBytes(0) {}
+    void measure(const Usage& from, const Usage& to) {
+        wall = to.wall - from.wall;
+        cpu = to.cpu - from.cpu;
+        peakRssKb = to.peakRssKb;
+        allocations = to.allocations - from.allocations;
+        allocatedBytes = to.allocatedBytes - from.allocatedBytes;
+    }
+    /// keep the faster of this and @a other
+    void keepFastest(const StageResult& other) {
+        if(other.wall < wall) {
+            wall = other.wall;
+            cpu = other.cpu;
+        }
+        for(size_t i = 0; i < parts.size() && i < other.parts.size(); ++i)
+            parts[i].keepFastest(other.parts[i]);
+    }
+    Json::Value toJson() const {
+        Json::Value value;
+        value["name"] = name;
+        value["wallSeconds"] = wall;
+        value["cpuSeconds"] = cpu;
+        value["peakRssKb"] = Json::Value::Int(peakRssKb);
+        value["allocations"] = Json::Value::UInt(allocations);
+        value["allocatedBytes"] = double(allocatedBytes);
+        if(!parts.empty()) {
+            value["substages"] = Json::Value(Json::arrayValue);
+            for(size_t i = 0; i < parts.size(); ++i)
+                value["substages"].append(parts[i].toJson());
+        }
+        return value;
+    }
+    string name;
+    double wall;
+    double cpu;
+    long peakRssKb;
+    size_t allocations;
+    size_t allocatedBytes;
+    vector<StageResult> parts;
+};
+
+/**
+ Measures a stage, and the tasks it reports through its progress bar as
+ parts of it, such as the insets, spurs and roofing of the regioner.
+ */
+class StageClock : public ProgressBar {
+public:
+    StageClock() : current(NULL) {}
+    void begin(StageResult& stage) {
+        current = &stage;
+        //the threads the stage hands work to count toward it
+        timing.start(stage.name.c_str());
+        stageStart = Usage::now();
+        partStart = stageStart;
+        partName = "";
+    }
+    void end() {
+        Usage finish = Usage::now();
+        closePart(finish);
+        current->measure(stageStart, finish);
+        current = NULL;
+        timing.stop();
+    }
+    void onStart(const char* taskName, unsigned int) {
+        if(!current)
+            return;
+        Usage now = Usage::now();
+        closePart(now);
+        partStart = now;
+        partName = taskName;
+    }
+    void onTick(const char*, unsigned int, unsigned int) {}
+private:
+    void closePart(const Usage& now) {
+        //work done before the first task only counts toward the stage
+        if(partName.empty())
+            return;
+        StageResult part(partName);
+        part.measure(partStart, now);
+        current->parts.push_back(part);
+        partName = "";
+    }
+    StageResult* current;
+    StageTimer::Task timing;
+    Usage stageStart;
+    Usage partStart;
+    string partName;
+};
+
+/// counts what is written to it and throws it away
+class CountingBuffer : public streambuf {
+public:
+    CountingBuffer() : bytes(0), lines(0) {}
+    size_t bytes;
+    size_t lines;
+protected:
+    int overflow(int c) {
+        if(c != EOF) {
+            ++bytes;
+            if(c == '\n')
+                ++lines;
+        }
+        return c;
+    }
+    streamsize xsputn(const char* s, streamsize n) {
+        bytes += n;
+        for(streamsize i = 0; i < n; ++i)
+            if(s[i] == '\n')
+                ++lines;
+        return n;
+    }
+};
+
+/// settings changed from the configuration for one benchmark run
+class Variant {
+public:
+    Variant(const char* variantName, const char* key = NULL,
+            const char* value = NULL, const char* key2 = NULL,
+            const char* value2 = NULL) : name(variantName) {
+        if(key)
+            settings.push_back(make_pair(string(key), string(value)));
+        if(key2)
+            settings.push_back(make_pair(string(key2), string(value2)));
+    }
+    void apply(Configuration& config) const {
+        for(size_t i = 0; i < settings.size(); ++i) {
+            const string& value = settings[i].second;
+            if(value == "true" || value == "false")
+                config[settings[i].first.c_str()] = value == "true";
+            else if(value.find_first_not_of("0123456789") == string::npos)
+                config[settings[i].first.c_str()] = atoi(value.c_str());
+            else
+                config[settings[i].first.c_str()] = value;
+        }
+    }
+    string name;
+    vector<pair<string, string> > settings;
+};
+
+static vector<Variant> allVariants() {
+    vector<Variant> variants;
+    variants.push_back(Variant("default"));
+    variants.push_back(Variant("support", "doSupport", "true"));
+    variants.push_back(Variant("raft", "doRaft", "true"));
+    variants.push_back(Variant("noGraph", "doGraphOptimization", "false"));
+    //show what leaving comments out saves
+    variants.push_back(Variant("noComments", "commentLevel", "none"));
+    variants.push_back(Variant("layerComments", "commentLevel", "layer"));
+    variants.push_back(Variant("threads", "threads", "4"));
+    return variants;
+}
+
+static const char* BUNDLED_MODELS[] = {
+    "inputs/3D_Knot.stl",
+    "inputs/Land.stl",
+    "inputs/Water.stl",
+    "stl/planetgeartest.stl",
+    "inputs/20mm_Calibration_Box.stl"
+};
+
+/// every stage of miracleGrue, one after the other
+static Json::Value runPipeline(const GrueConfig& grueCfg,
+        const char* modelFile, vector<StageResult>& stages,
+        JobFeatures& features) {
+    StageClock clock;
+    stages.clear();
+    stages.push_back(StageResult("stl"));
+    stages.push_back(StageResult("segmenter"));
+    stages.push_back(StageResult("slicer"));
+    stages.push_back(StageResult("loopProcessor"));
+    stages.push_back(StageResult("regioner"));
+    stages.push_back(StageResult("pather"));
+    stages.push_back(StageResult("gcoder"));
+
+    clock.begin(stages[0]);
+    Meshy mesh(grueCfg);
+    mesh.readStlFile(modelFile);
+    mesh.alignToPlate();
+    Limits limits = mesh.readLimits();
+    clock.end();
+
+    clock.begin(stages[1]);
+    Segmenter segmenter(grueCfg);
+    segmenter.tablaturize(mesh);
+    clock.end();
+    features = jobFeatures(grueCfg, segmenter, limits);
+
+    clock.begin(stages[2]);
+    Slicer slicer(grueCfg, &clock);
+    LayerLoops layerloops(0.0, grueCfg.get_layerH());
+    slicer.generateLoops(segmenter, layerloops);
+    clock.end();
+
+    clock.begin(stages[3]);
+    LayerLoops processedLoops;
+    LoopProcessor processor(grueCfg, &clock);
+    processor.processLoops(layerloops, processedLoops);
+    clock.end();
+
+    clock.begin(stages[4]);
+    LayerMeasure& layerMeasure = processedLoops.layerMeasure;
+    RegionList regions;
+    Grid grid;
+    Regioner regioner(grueCfg, &clock);
+    regioner.generateSkeleton(processedLoops, layerMeasure, regions,
+            limits, grid);
+    clock.end();
+
+    clock.begin(stages[5]);
+    Pather pather(grueCfg, &clock);
+    LayerPaths layers;
+    pather.generatePaths(grueCfg, regions, layerMeasure, grid, layers);
+    clock.end();
+
+    clock.begin(stages[6]);
+    CountingBuffer counter;
+    ostream gout(&counter);
+    GCoder gcoder(grueCfg, &clock);
+    gcoder.writeGcodeFile(layers, layerMeasure, gout, modelFile);
+    clock.end();
+
+    Json::Value output;
+    output["layers"] = Json::Value::UInt(layers.layerCount());
+    output["gcodeBytes"] = Json::Value::UInt(counter.bytes);
+    output["gcodeLines"] = Json::Value::UInt(counter.lines);
+    output["printSeconds"] = gcoder.getPrintDuration();
+    output["triangles"] = Json::Value::UInt(features.triangles);
+    output["footprint"] = features.footprint;
+    return output;
+}
+
+static void usage() {
+    cerr << "usage: mgl_bench [-c config] [-r repeats] [-v variant]... "
+            "[-o out.json] [-f model.json] [model.stl]..." << endl;
+    cerr << "variants:";
+    vector<Variant> variants = allVariants();
+    for(size_t i = 0; i < variants.size(); ++i)
+        cerr << " " << variants[i].name;
+    cerr << endl;
+}
+
+int main(int argc, char** argv) {
+    string configFile = "miracle.config";
+    string outFile;
+    string fitFile;
+    unsigned int repeats = 1;
+    vector<string> models;
+    vector<string> variantNames;
+    for(int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if(arg == "-c" && hasValue) {
+            configFile = argv[++i];
+        } else if(arg == "-o" && hasValue) {
+            outFile = argv[++i];
+        } else if(arg == "-f" && hasValue) {
+            fitFile = argv[++i];
+        } else if(arg == "-r" && hasValue) {
+            repeats = std::max(1, atoi(argv[++i]));
+        } else if(arg == "-v" && hasValue) {
+            variantNames.push_back(argv[++i]);
+        } else if(arg.size() && arg[0] == '-') {
+            usage();
+            return 1;
+        } else {
+            models.push_back(arg);
+        }
+    }
+    if(models.empty()) {
+        for(size_t i = 0;
+                i < sizeof(BUNDLED_MODELS) / sizeof(BUNDLED_MODELS[0]); ++i)
+            models.push_back(BUNDLED_MODELS[i]);
+    }
+    if(!fitFile.empty() && variantNames.empty()) {
+        variantNames.push_back("default");
+        variantNames.push_back("support");
+        variantNames.push_back("raft");
+    }
+    vector<Variant> variants;
+    vector<Variant> known = allVariants();
+    for(size_t i = 0; i < known.size(); ++i) {
+        if(variantNames.empty() || find(variantNames.begin(),
+                variantNames.end(), known[i].name) != variantNames.end())
+            variants.push_back(known[i]);
+    }
+    if(variants.empty()) {
+        usage();
+        return 1;
+    }
+    g_debugVerbosity = log_severe;
+    //for the allocations each stage makes, counted by allocation_hook.cc
+    StageTimer::enable();
+
+    Json::Value results;
+    results["config"] = configFile;
+    results["repeats"] = repeats;
+#ifdef OMPFF
+    results["multiThread"] = true;
+    results["maxThreads"] = omp_get_max_threads();
+#else
+    results["multiThread"] = false;
+    results["maxThreads"] = 1;
+#endif
+    results["runs"] = Json::Value(Json::arrayValue);
+    //the jobs each progress task ran in, and the seconds it took
+    map<string, vector<JobFeatures> > taskFeatures;
+    map<string, vector<Scalar> > taskSeconds;
+
+    for(size_t model = 0; model < models.size(); ++model) {
+        for(size_t variant = 0; variant < variants.size(); ++variant) {
+            Configuration config;
+            config.readFromFile(configFile.c_str());
+            variants[variant].apply(config);
+            GrueConfig grueCfg;
+            Json::Value run;
+            vector<StageResult> fastest;
+            JobFeatures features;
+            try {
+                grueCfg.loadFromFile(config);
+                for(unsigned int rep = 0; rep < repeats; ++rep) {
+                    vector<StageResult> stages;
+                    run = runPipeline(grueCfg, models[model].c_str(), stages,
+                            features);
+                    if(fastest.empty()) {
+                        fastest = stages;
+                    } else {
+                        for(size_t i = 0; i < stages.size(); ++i)
+                            fastest[i].keepFastest(stages[i]);
+                    }
+                }
+            } catch (const std::exception& failure) {
+                cerr << models[model] << " " << variants[variant].name <<
+                        ": " << failure.what() << endl;
+                run["error"] = failure.what();
+            }
+            run["model"] = models[model];
+            run["variant"] = variants[variant].name;
+            run["stages"] = Json::Value(Json::arrayValue);
+            double total = 0;
+            for(size_t i = 0; i < fastest.size(); ++i) {
+                run["stages"].append(fastest[i].toJson());
+                total += fastest[i].wall;
+            }
+            run["totalWallSeconds"] = total;
+            for(size_t i = 0; i < fastest.size(); ++i) {
+                const vector<StageResult>& parts = fastest[i].parts;
+                for(size_t part = 0; part < parts.size(); ++part) {
+                    taskFeatures[parts[part].name].push_back(features);
+                    taskSeconds[parts[part].name].push_back(parts[part].wall);
+                }
+            }
+            results["runs"].append(run);
+            fprintf(stderr, "%-36s %-10s %8.3fs", models[model].c_str(),
+                    variants[variant].name.c_str(), total);
+            for(size_t i = 0; i < fastest.size(); ++i)
+                fprintf(stderr, " %s %.3f", fastest[i].name.c_str(),
+                        fastest[i].wall);
+            fprintf(stderr, "\n");
+        }
+    }
+
+    Json::StyledWriter writer;
+    if(!fitFile.empty()) {
+        ProgressModel fitted;
+        for(map<string, vector<JobFeatures> >::const_iterator task =
+                taskFeatures.begin(); task != taskFeatures.end(); ++task)
+            fitted.fit(task->first, task->second, taskSeconds[task->first]);
+        ofstream out(fitFile.c_str());
+        out << writer.write(fitted.toJson());
+    }
+    if(outFile.empty()) {
+        cout << writer.write(results);
+    } else {
+        ofstream out(outFile.c_str());
+        out << writer.write(results);
+    }
+    return 0;
+}